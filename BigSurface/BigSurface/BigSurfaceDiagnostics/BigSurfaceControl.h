@@ -0,0 +1,88 @@
+//
+//  BigSurfaceControl.h
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef BigSurfaceControl_h
+#define BigSurfaceControl_h
+
+#include <libkern/OSTypes.h>
+
+/*
+ * Interface of the control user client, shared with user space tools. Open
+ * BigSurfaceDiagnostics with type kBigSurfaceControlClientType. Every call
+ * reads or writes a whole batch, so a tool needs one round trip instead of
+ * a registry lookup per value. Ids and layouts only ever grow.
+ */
+#define BIGSURFACE_CONTROL_VERSION          1
+#define BIGSURFACE_CONTROL_MAX_BATTERIES    4
+
+enum {
+    kBigSurfaceDiagnosticsClientType = 0,
+    kBigSurfaceControlClientType,
+};
+
+enum BigSurfaceControlMethod {
+    kBigSurfaceControlGetTunables = 0,  // out: BigSurfaceTunableTable
+    kBigSurfaceControlSetTunables,      // in: BigSurfaceTunableSetting[], all or nothing, needs admin
+    kBigSurfaceControlCopySnapshot,     // out: number of counters, BigSurfaceSnapshot followed by PerfCounterSnapshot[]
+    kBigSurfaceControlMethodCount,
+};
+
+// ids are stable
+enum BigSurfaceTunable {
+    BigSurfaceTunablePerformanceMode = 0,   // 1 normal ... 4 best performance
+    BigSurfaceTunableBatteryPollInterval,   // ms between battery status updates
+    BigSurfaceTunableALSPollInterval,       // ms between ambient light samples
+    BigSurfaceTunableALSChangeThreshold,    // lux, smaller changes are not announced to the system
+    BigSurfaceTunableMEIIdleTimeout,        // ms without traffic before the ME enters d0i3, 0 never
+    BigSurfaceTunableCount,
+};
+
+struct BigSurfaceTunableSetting {
+    UInt32  tunable;
+    UInt32  value;
+};
+
+struct BigSurfaceTunableTable {
+    UInt32  count;      // BigSurfaceTunableCount of the running kext
+    UInt32  value[BigSurfaceTunableCount];
+    UInt32  minimum[BigSurfaceTunableCount];
+    UInt32  maximum[BigSurfaceTunableCount];
+};
+
+enum BigSurfaceBatteryFlags {
+    kBigSurfaceBatteryConnected = 1 << 0,
+    kBigSurfaceBatteryFull      = 1 << 1,
+    kBigSurfaceBatteryCritical  = 1 << 2,
+    kBigSurfaceBatteryBad       = 1 << 3,
+};
+
+struct BigSurfaceBatterySnapshot {
+    UInt32  flags;                  // BigSurfaceBatteryFlags
+    UInt32  state;                  // BST state
+    UInt32  remainingCapacity;      // mAh
+    UInt32  fullChargeCapacity;     // mAh
+    UInt32  designCapacity;         // mAh
+    UInt32  cycleCount;
+    UInt32  presentVoltage;         // mV
+    SInt32  presentRate;            // mA, negative while discharging
+    SInt32  averageRate;            // mA, negative while discharging
+    UInt32  timeToEmpty;            // min
+    UInt32  timeToFull;             // min
+    UInt16  temperature;            // 0.1 K, the battery is the only thermal sensor we read
+    UInt16  reserved;
+};
+
+struct BigSurfaceSnapshot {
+    UInt32  version;
+    UInt32  batteryCount;
+    UInt32  externalPower;
+    UInt32  counterCount;           // PerfCounterSnapshot records following this header
+    UInt64  timestamp;              // mach absolute time
+    BigSurfaceBatterySnapshot   batteries[BIGSURFACE_CONTROL_MAX_BATTERIES];
+};
+
+#endif /* BigSurfaceControl_h */
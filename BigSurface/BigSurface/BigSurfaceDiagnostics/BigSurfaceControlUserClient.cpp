@@ -0,0 +1,147 @@
+//
+//  BigSurfaceControlUserClient.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include "BigSurfaceControlUserClient.hpp"
+#include "../Tunables.hpp"
+#include "../SurfaceBattery/BatteryManager.hpp"
+
+#define super IOUserClient
+OSDefineMetaClassAndStructors(BigSurfaceControlUserClient, IOUserClient)
+
+const IOExternalMethodDispatch BigSurfaceControlUserClient::methods[kBigSurfaceControlMethodCount] = {
+    {   // kBigSurfaceControlGetTunables
+        reinterpret_cast<IOExternalMethodAction>(&BigSurfaceControlUserClient::getTunables), 0, 0, 0, sizeof(BigSurfaceTunableTable)
+    },
+    {   // kBigSurfaceControlSetTunables
+        reinterpret_cast<IOExternalMethodAction>(&BigSurfaceControlUserClient::setTunables), 0, kIOUCVariableStructureSize, 0, 0
+    },
+    {   // kBigSurfaceControlCopySnapshot
+        reinterpret_cast<IOExternalMethodAction>(&BigSurfaceControlUserClient::copySnapshot), 0, 0, 1, kIOUCVariableStructureSize
+    },
+};
+
+bool BigSurfaceControlUserClient::initWithTask(task_t owningTask, void *securityID, UInt32 type, OSDictionary *properties) {
+    if (!super::initWithTask(owningTask, securityID, type, properties))
+        return false;
+    // anybody may read, only admin may change how the hardware behaves
+    privileged = clientHasPrivilege(owningTask, kIOClientPrivilegeAdministrator) == kIOReturnSuccess;
+    return true;
+}
+
+bool BigSurfaceControlUserClient::start(IOService *provider) {
+    owner = OSDynamicCast(BigSurfaceDiagnostics, provider);
+    if (!owner)
+        return false;
+    return super::start(provider);
+}
+
+IOReturn BigSurfaceControlUserClient::clientClose() {
+    if (!isInactive())
+        terminate();
+    return kIOReturnSuccess;
+}
+
+IOReturn BigSurfaceControlUserClient::externalMethod(uint32_t selector, IOExternalMethodArguments *arguments, IOExternalMethodDispatch *dispatch, OSObject *target, void *reference) {
+    if (selector >= kBigSurfaceControlMethodCount)
+        return kIOReturnUnsupported;
+
+    dispatch = const_cast<IOExternalMethodDispatch *>(&methods[selector]);
+    target = this;
+    return super::externalMethod(selector, arguments, dispatch, target, reference);
+}
+
+IOReturn BigSurfaceControlUserClient::getTunables(BigSurfaceControlUserClient *target, void *reference, IOExternalMethodArguments *arguments) {
+    Tunables::copyTable(static_cast<BigSurfaceTunableTable *>(arguments->structureOutput));
+    return kIOReturnSuccess;
+}
+
+IOReturn BigSurfaceControlUserClient::setTunables(BigSurfaceControlUserClient *target, void *reference, IOExternalMethodArguments *arguments) {
+    if (!target->privileged)
+        return kIOReturnNotPrivileged;
+
+    UInt32 size = arguments->structureInputSize;
+    if (!arguments->structureInput || !size || size % sizeof(BigSurfaceTunableSetting))
+        return kIOReturnBadArgument;
+
+    return Tunables::setBatch(static_cast<const BigSurfaceTunableSetting *>(arguments->structureInput), size / sizeof(BigSurfaceTunableSetting));
+}
+
+void BigSurfaceControlUserClient::fillSnapshot(BigSurfaceSnapshot *snapshot) {
+    bzero(snapshot, sizeof(BigSurfaceSnapshot));
+    snapshot->version = BIGSURFACE_CONTROL_VERSION;
+    clock_get_uptime(&snapshot->timestamp);
+
+    BatteryManager *manager = BatteryManager::getShared();
+    if (!manager)
+        return;
+
+    UInt8 cnt = manager->batteryCount < BIGSURFACE_CONTROL_MAX_BATTERIES ? manager->batteryCount : BIGSURFACE_CONTROL_MAX_BATTERIES;
+    snapshot->batteryCount = cnt;
+
+    IOSimpleLockLock(manager->stateLock);
+    snapshot->externalPower = manager->externalPowerConnected();
+    for (UInt8 i = 0; i < cnt; i++) {
+        const BatteryInfo &info = manager->state.btInfo[i];
+        BigSurfaceBatterySnapshot *battery = &snapshot->batteries[i];
+        if (info.connected)
+            battery->flags |= kBigSurfaceBatteryConnected;
+        if (info.state.batteryIsFull)
+            battery->flags |= kBigSurfaceBatteryFull;
+        if (info.state.critical)
+            battery->flags |= kBigSurfaceBatteryCritical;
+        if (info.state.bad)
+            battery->flags |= kBigSurfaceBatteryBad;
+        battery->state = info.state.state;
+        battery->remainingCapacity = info.state.remainingCapacity;
+        battery->fullChargeCapacity = info.state.lastFullChargeCapacity;
+        battery->designCapacity = info.designCapacity;
+        battery->cycleCount = info.cycle;
+        battery->presentVoltage = info.state.presentVoltage;
+        battery->presentRate = info.state.signedPresentRate;
+        battery->averageRate = info.state.signedAverageRate;
+        battery->timeToEmpty = info.state.averageTimeToEmpty;
+        battery->timeToFull = info.state.timeToFull;
+        battery->temperature = info.state.temperatureDecikelvin;
+    }
+    IOSimpleLockUnlock(manager->stateLock);
+}
+
+IOReturn BigSurfaceControlUserClient::copySnapshot(BigSurfaceControlUserClient *target, void *reference, IOExternalMethodArguments *arguments) {
+    IOMemoryDescriptor *desc = arguments->structureOutputDescriptor;
+    UInt32 size = desc ? static_cast<UInt32>(desc->getLength()) : arguments->structureOutputSize;
+    if (size < sizeof(BigSurfaceSnapshot))
+        return kIOReturnBadArgument;
+
+    // everything is assembled in one buffer so a single copy reaches user space
+    UInt32 max_cnt = (size - sizeof(BigSurfaceSnapshot)) / sizeof(PerfCounterSnapshot);
+    // the descriptor length comes from user space, never allocate more than there are counters
+    UInt32 available = perfCounterCount();
+    if (desc && max_cnt > available)
+        max_cnt = available;
+    UInt32 capacity = sizeof(BigSurfaceSnapshot) + max_cnt * sizeof(PerfCounterSnapshot);
+    UInt8 *buffer = desc ? tagNewArray<UInt8>(AllocTagDiagnostics, capacity) : static_cast<UInt8 *>(arguments->structureOutput);
+    if (!buffer)
+        return kIOReturnNoMemory;
+
+    BigSurfaceSnapshot *snapshot = reinterpret_cast<BigSurfaceSnapshot *>(buffer);
+    fillSnapshot(snapshot);
+    UInt32 cnt = perfSnapshotAllCounters(reinterpret_cast<PerfCounterSnapshot *>(buffer + sizeof(BigSurfaceSnapshot)), max_cnt);
+    snapshot->counterCount = cnt < max_cnt ? cnt : max_cnt;
+    UInt32 length = sizeof(BigSurfaceSnapshot) + snapshot->counterCount * sizeof(PerfCounterSnapshot);
+
+    if (desc) {
+        if (desc->prepare() == kIOReturnSuccess) {
+            desc->writeBytes(0, buffer, length);
+            desc->complete();
+        }
+        tagFree(buffer);
+    } else {
+        arguments->structureOutputSize = length;
+    }
+    arguments->scalarOutput[0] = cnt;
+    return kIOReturnSuccess;
+}
@@ -0,0 +1,41 @@
+//
+//  BigSurfaceControlUserClient.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef BigSurfaceControlUserClient_hpp
+#define BigSurfaceControlUserClient_hpp
+
+#include <IOKit/IOUserClient.h>
+
+#include "BigSurfaceDiagnostics.hpp"
+#include "BigSurfaceControl.h"
+
+class EXPORT BigSurfaceControlUserClient : public IOUserClient {
+    OSDeclareDefaultStructors(BigSurfaceControlUserClient);
+
+public:
+    bool initWithTask(task_t owningTask, void *securityID, UInt32 type, OSDictionary *properties) override;
+
+    bool start(IOService *provider) override;
+
+    IOReturn clientClose() override;
+
+    IOReturn externalMethod(uint32_t selector, IOExternalMethodArguments *arguments, IOExternalMethodDispatch *dispatch, OSObject *target, void *reference) override;
+
+private:
+    BigSurfaceDiagnostics*  owner {nullptr};
+    bool                    privileged {false};
+
+    static const IOExternalMethodDispatch methods[kBigSurfaceControlMethodCount];
+
+    static IOReturn getTunables(BigSurfaceControlUserClient *target, void *reference, IOExternalMethodArguments *arguments);
+    static IOReturn setTunables(BigSurfaceControlUserClient *target, void *reference, IOExternalMethodArguments *arguments);
+    static IOReturn copySnapshot(BigSurfaceControlUserClient *target, void *reference, IOExternalMethodArguments *arguments);
+
+    static void fillSnapshot(BigSurfaceSnapshot *snapshot);
+};
+
+#endif /* BigSurfaceControlUserClient_hpp */
@@ -0,0 +1,178 @@
+//
+//  BigSurfaceDiagnostics.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include "BigSurfaceDiagnostics.hpp"
+#include "BigSurfaceDiagnosticsUserClient.hpp"
+#include "BigSurfaceControlUserClient.hpp"
+#include "../PowerOrchestrator.hpp"
+#include "../BootTimeline.hpp"
+#include "../TaggedAllocator.hpp"
+#include "../SurfaceBattery/BatteryManager.hpp"
+
+#define super IOService
+OSDefineMetaClassAndStructors(BigSurfaceDiagnostics, IOService)
+
+bool BigSurfaceDiagnostics::start(IOService *provider) {
+    if (!super::start(provider))
+        return false;
+
+    trace_memory = IOBufferMemoryDescriptor::withOptions(kIODirectionInOut | kIOMemoryKernelUserShared, sizeof(TraceBuffer), PAGE_SIZE);
+    if (!trace_memory) {
+        LOG("Failed to allocate trace buffer");
+        goto exit;
+    }
+    bzero(trace_memory->getBytesNoCopy(), sizeof(TraceBuffer));
+    traceAttachBuffer(static_cast<TraceBuffer *>(trace_memory->getBytesNoCopy()));
+    setProperty("TraceBufferSize", sizeof(TraceBuffer), 32);
+
+    // the report is optional, diagnostics work without it
+    if (!soak.init())
+        LOG("Failed to allocate soak monitor");
+
+    work_loop = WorkLoopBands::acquire(WorkLoopBandTelemetry);
+    if (!work_loop) {
+        LOG("Failed to create work loop");
+        goto exit;
+    }
+    command_gate = IOCommandGate::commandGate(this);
+    if (!command_gate) {
+        LOG("Failed to create command gate");
+        goto exit;
+    }
+    work_loop->addEventSource(command_gate);
+    publish_timer = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &BigSurfaceDiagnostics::publishTimeout));
+    if (!publish_timer) {
+        LOG("Failed to create publish timer");
+        goto exit;
+    }
+    work_loop->addEventSource(publish_timer);
+    publishProperties();
+    TimerCoalescer::setTimeoutMS(publish_timer, DIAGNOSTICS_PUBLISH_INTERVAL, DIAGNOSTICS_PUBLISH_TOLERANCE);
+
+    registerService();
+    return true;
+exit:
+    releaseResources();
+    return false;
+}
+
+void BigSurfaceDiagnostics::stop(IOService *provider) {
+    releaseResources();
+    super::stop(provider);
+}
+
+void BigSurfaceDiagnostics::releaseResources() {
+    if (publish_timer) {
+        publish_timer->cancelTimeout();
+        publish_timer->disable();
+        work_loop->removeEventSource(publish_timer);
+        OSSafeReleaseNULL(publish_timer);
+    }
+    if (command_gate) {
+        work_loop->removeEventSource(command_gate);
+        OSSafeReleaseNULL(command_gate);
+    }
+    WorkLoopBands::release(WorkLoopBandTelemetry, work_loop);
+    soak.free();
+    if (trace_memory) {
+        // returns once no tracepoint writes to the buffer any more
+        traceAttachBuffer(nullptr);
+        OSSafeReleaseNULL(trace_memory);
+    }
+}
+
+IOReturn BigSurfaceDiagnostics::newUserClient(task_t owningTask, void *securityID, UInt32 type, OSDictionary *props, IOUserClient **handler) {
+    IOUserClient *client;
+    switch (type) {
+        case kBigSurfaceDiagnosticsClientType:
+            client = OSTypeAlloc(BigSurfaceDiagnosticsUserClient);
+            break;
+        case kBigSurfaceControlClientType:
+            client = OSTypeAlloc(BigSurfaceControlUserClient);
+            break;
+        default:
+            return kIOReturnBadArgument;
+    }
+    if (!client)
+        return kIOReturnNoMemory;
+
+    if (!client->initWithTask(owningTask, securityID, type, props) || !client->attach(this)) {
+        client->release();
+        return kIOReturnError;
+    }
+    if (!client->start(this)) {
+        client->detach(this);
+        client->release();
+        return kIOReturnError;
+    }
+    *handler = client;
+    return kIOReturnSuccess;
+}
+
+IOReturn BigSurfaceDiagnostics::setTraceMask(UInt32 mask) {
+    if (!trace_memory)
+        return kIOReturnNotReady;
+    traceSetMask(mask & ((1U << TraceSubsystemCount) - 1));
+    return kIOReturnSuccess;
+}
+
+IOReturn BigSurfaceDiagnostics::publishProperties() {
+    if (!command_gate)
+        return kIOReturnNotReady;
+    return command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &BigSurfaceDiagnostics::publishPropertiesGated));
+}
+
+void BigSurfaceDiagnostics::publishTimeout(IOTimerEventSource *timer) {
+    soak.sample();
+    publishPropertiesGated();
+    TimerCoalescer::setTimeoutMS(timer, DIAGNOSTICS_PUBLISH_INTERVAL, DIAGNOSTICS_PUBLISH_TOLERANCE);
+}
+
+IOReturn BigSurfaceDiagnostics::publishPropertiesGated() {
+    OSDictionary *counters = perfCopyAllCounters();
+    if (counters) {
+        setProperty("PerfCounters", counters);
+        counters->release();
+    }
+    OSDictionary *timeline = PowerOrchestrator::copyWakeTimeline();
+    if (timeline) {
+        setProperty("WakeTimeline", timeline);
+        timeline->release();
+    }
+    OSArray *boot = BootTimeline::copyTimeline();
+    if (boot) {
+        setProperty("BootTimeline", boot);
+        boot->release();
+    }
+    OSDictionary *allocations = tagCopyStatistics();
+    if (allocations) {
+        setProperty("Allocations", allocations);
+        allocations->release();
+    }
+    OSArray *sites = tagCopyLiveSites();
+    if (sites) {
+        setProperty("AllocationSites", sites);
+        sites->release();
+    }
+    OSDictionary *report = soak.copyReport();
+    if (report) {
+        setProperty("Soak", report);
+        report->release();
+    }
+    return kIOReturnSuccess;
+}
+
+IOMemoryDescriptor *BigSurfaceDiagnostics::copyTraceBuffer() {
+    if (trace_memory)
+        trace_memory->retain();
+    return trace_memory;
+}
+
+IOMemoryDescriptor *BigSurfaceDiagnostics::copyBatteryHistory() {
+    BatteryManager *manager = BatteryManager::getShared();
+    return manager ? manager->copyHistoryBuffer() : nullptr;
+}
@@ -0,0 +1,65 @@
+//
+//  BigSurfaceDiagnostics.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef BigSurfaceDiagnostics_hpp
+#define BigSurfaceDiagnostics_hpp
+
+#include <IOKit/IOBufferMemoryDescriptor.h>
+#include <IOKit/IOCommandGate.h>
+#include <IOKit/IOTimerEventSource.h>
+#include <IOKit/IOWorkLoop.h>
+
+#include "../helpers.hpp"
+#include "../WorkLoopBands.hpp"
+#include "../TimerCoalescer.hpp"
+#include "Tracepoints.hpp"
+#include "PerfCounters.hpp"
+#include "SoakMonitor.hpp"
+
+// properties are refreshed on request, the timer only keeps the soak checkpoints going
+#define DIAGNOSTICS_PUBLISH_INTERVAL    (SOAK_CHECKPOINT_INTERVAL * 1000)   // ms
+#define DIAGNOSTICS_PUBLISH_TOLERANCE   60000   // ms
+
+/*
+ * Kext wide diagnostics, matched on IOResources so it is always around
+ * before and after the device drivers.
+ */
+class EXPORT BigSurfaceDiagnostics : public IOService {
+    OSDeclareDefaultStructors(BigSurfaceDiagnostics);
+
+public:
+    bool start(IOService *provider) override;
+
+    void stop(IOService *provider) override;
+
+    IOReturn newUserClient(task_t owningTask, void *securityID, UInt32 type, OSDictionary *props, IOUserClient **handler) override;
+
+    IOReturn setTraceMask(UInt32 mask);
+
+    // rebuild the published counters, timelines and reports now
+    IOReturn publishProperties();
+
+    IOMemoryDescriptor *copyTraceBuffer();
+
+    // nullptr until the battery driver started
+    IOMemoryDescriptor *copyBatteryHistory();
+
+private:
+    IOBufferMemoryDescriptor*   trace_memory {nullptr};
+    IOWorkLoop*                 work_loop {nullptr};
+    IOTimerEventSource*         publish_timer {nullptr};
+    IOCommandGate*              command_gate {nullptr};
+    SoakMonitor                 soak;
+
+    void releaseResources();
+
+    void publishTimeout(IOTimerEventSource *timer);
+
+    IOReturn publishPropertiesGated();
+};
+
+#endif /* BigSurfaceDiagnostics_hpp */
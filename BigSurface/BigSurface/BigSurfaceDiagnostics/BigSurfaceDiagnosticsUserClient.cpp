@@ -0,0 +1,123 @@
+//
+//  BigSurfaceDiagnosticsUserClient.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include "BigSurfaceDiagnosticsUserClient.hpp"
+
+#define super IOUserClient
+OSDefineMetaClassAndStructors(BigSurfaceDiagnosticsUserClient, IOUserClient)
+
+const IOExternalMethodDispatch BigSurfaceDiagnosticsUserClient::methods[kBigSurfaceDiagnosticsMethodCount] = {
+    {   // kBigSurfaceDiagnosticsSetTraceMask
+        reinterpret_cast<IOExternalMethodAction>(&BigSurfaceDiagnosticsUserClient::setTraceMask), 1, 0, 0, 0
+    },
+    {   // kBigSurfaceDiagnosticsGetTraceMask
+        reinterpret_cast<IOExternalMethodAction>(&BigSurfaceDiagnosticsUserClient::getTraceMask), 0, 0, 1, 0
+    },
+    {   // kBigSurfaceDiagnosticsCopyCounters
+        reinterpret_cast<IOExternalMethodAction>(&BigSurfaceDiagnosticsUserClient::copyCounters), 0, 0, 1, kIOUCVariableStructureSize
+    },
+    {   // kBigSurfaceDiagnosticsPublish
+        reinterpret_cast<IOExternalMethodAction>(&BigSurfaceDiagnosticsUserClient::publish), 0, 0, 0, 0
+    },
+};
+
+bool BigSurfaceDiagnosticsUserClient::initWithTask(task_t owningTask, void *securityID, UInt32 type, OSDictionary *properties) {
+    if (!super::initWithTask(owningTask, securityID, type, properties))
+        return false;
+    // the trace carries input timing, only admin may turn it on or read it
+    privileged = clientHasPrivilege(owningTask, kIOClientPrivilegeAdministrator) == kIOReturnSuccess;
+    return true;
+}
+
+bool BigSurfaceDiagnosticsUserClient::start(IOService *provider) {
+    owner = OSDynamicCast(BigSurfaceDiagnostics, provider);
+    if (!owner)
+        return false;
+    return super::start(provider);
+}
+
+IOReturn BigSurfaceDiagnosticsUserClient::clientClose() {
+    if (!isInactive())
+        terminate();
+    return kIOReturnSuccess;
+}
+
+IOReturn BigSurfaceDiagnosticsUserClient::clientMemoryForType(UInt32 type, IOOptionBits *options, IOMemoryDescriptor **memory) {
+    switch (type) {
+        case kBigSurfaceDiagnosticsTraceBuffer:
+            if (!privileged)
+                return kIOReturnNotPrivileged;
+            *memory = owner->copyTraceBuffer();
+            break;
+        case kBigSurfaceDiagnosticsBatteryHistory:
+            *memory = owner->copyBatteryHistory();
+            break;
+        default:
+            return kIOReturnBadArgument;
+    }
+    if (!*memory)
+        return kIOReturnNotReady;
+    *options = kIOMapReadOnly;
+    return kIOReturnSuccess;
+}
+
+IOReturn BigSurfaceDiagnosticsUserClient::externalMethod(uint32_t selector, IOExternalMethodArguments *arguments, IOExternalMethodDispatch *dispatch, OSObject *target, void *reference) {
+    if (selector >= kBigSurfaceDiagnosticsMethodCount)
+        return kIOReturnUnsupported;
+
+    dispatch = const_cast<IOExternalMethodDispatch *>(&methods[selector]);
+    target = this;
+    return super::externalMethod(selector, arguments, dispatch, target, reference);
+}
+
+IOReturn BigSurfaceDiagnosticsUserClient::setTraceMask(BigSurfaceDiagnosticsUserClient *target, void *reference, IOExternalMethodArguments *arguments) {
+    if (!target->privileged)
+        return kIOReturnNotPrivileged;
+    return target->owner->setTraceMask(static_cast<UInt32>(arguments->scalarInput[0]));
+}
+
+IOReturn BigSurfaceDiagnosticsUserClient::getTraceMask(BigSurfaceDiagnosticsUserClient *target, void *reference, IOExternalMethodArguments *arguments) {
+    arguments->scalarOutput[0] = gTraceMask;
+    return kIOReturnSuccess;
+}
+
+IOReturn BigSurfaceDiagnosticsUserClient::copyCounters(BigSurfaceDiagnosticsUserClient *target, void *reference, IOExternalMethodArguments *arguments) {
+    IOMemoryDescriptor *desc = arguments->structureOutputDescriptor;
+    UInt32 size = desc ? static_cast<UInt32>(desc->getLength()) : arguments->structureOutputSize;
+    UInt32 max_cnt = size / sizeof(PerfCounterSnapshot);
+    UInt32 cnt;
+
+    if (!desc) {
+        cnt = perfSnapshotAllCounters(static_cast<PerfCounterSnapshot *>(arguments->structureOutput), max_cnt);
+    } else {
+        // large requests come in as a descriptor, never allocate more than there are counters
+        UInt32 available = perfCounterCount();
+        if (max_cnt > available)
+            max_cnt = available;
+        if (!max_cnt) {
+            arguments->scalarOutput[0] = perfSnapshotAllCounters(nullptr, 0);
+            return kIOReturnSuccess;
+        }
+        PerfCounterSnapshot *snapshots = tagNewArray<PerfCounterSnapshot>(AllocTagDiagnostics, max_cnt);
+        if (!snapshots)
+            return kIOReturnNoMemory;
+        cnt = perfSnapshotAllCounters(snapshots, max_cnt);
+        if (desc->prepare() == kIOReturnSuccess) {
+            desc->writeBytes(0, snapshots, (cnt < max_cnt ? cnt : max_cnt) * sizeof(PerfCounterSnapshot));
+            desc->complete();
+        }
+        tagFree(snapshots);
+    }
+    arguments->scalarOutput[0] = cnt;
+    if (!desc)
+        arguments->structureOutputSize = (cnt < max_cnt ? cnt : max_cnt) * sizeof(PerfCounterSnapshot);
+    return kIOReturnSuccess;
+}
+
+IOReturn BigSurfaceDiagnosticsUserClient::publish(BigSurfaceDiagnosticsUserClient *target, void *reference, IOExternalMethodArguments *arguments) {
+    return target->owner->publishProperties();
+}
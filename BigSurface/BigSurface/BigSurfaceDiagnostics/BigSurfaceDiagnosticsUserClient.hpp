@@ -0,0 +1,54 @@
+//
+//  BigSurfaceDiagnosticsUserClient.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef BigSurfaceDiagnosticsUserClient_hpp
+#define BigSurfaceDiagnosticsUserClient_hpp
+
+#include <IOKit/IOUserClient.h>
+
+#include "BigSurfaceDiagnostics.hpp"
+
+enum BigSurfaceDiagnosticsMethod {
+    kBigSurfaceDiagnosticsSetTraceMask = 0,     // in: mask of BIT(TraceSubsystem), admin
+    kBigSurfaceDiagnosticsGetTraceMask,         // out: mask
+    kBigSurfaceDiagnosticsCopyCounters,         // out: number of counters, PerfCounterSnapshot[]
+    kBigSurfaceDiagnosticsPublish,              // refresh the registry properties of the service
+    kBigSurfaceDiagnosticsMethodCount,
+};
+
+enum BigSurfaceDiagnosticsMemoryType {
+    kBigSurfaceDiagnosticsTraceBuffer = 0,      // TraceBuffer, read only, admin
+    kBigSurfaceDiagnosticsBatteryHistory,       // BatteryHistoryBuffer, read only
+};
+
+class EXPORT BigSurfaceDiagnosticsUserClient : public IOUserClient {
+    OSDeclareDefaultStructors(BigSurfaceDiagnosticsUserClient);
+
+public:
+    bool initWithTask(task_t owningTask, void *securityID, UInt32 type, OSDictionary *properties) override;
+
+    bool start(IOService *provider) override;
+
+    IOReturn clientClose() override;
+
+    IOReturn clientMemoryForType(UInt32 type, IOOptionBits *options, IOMemoryDescriptor **memory) override;
+
+    IOReturn externalMethod(uint32_t selector, IOExternalMethodArguments *arguments, IOExternalMethodDispatch *dispatch, OSObject *target, void *reference) override;
+
+private:
+    BigSurfaceDiagnostics*  owner {nullptr};
+    bool                    privileged {false};
+
+    static const IOExternalMethodDispatch methods[kBigSurfaceDiagnosticsMethodCount];
+
+    static IOReturn setTraceMask(BigSurfaceDiagnosticsUserClient *target, void *reference, IOExternalMethodArguments *arguments);
+    static IOReturn getTraceMask(BigSurfaceDiagnosticsUserClient *target, void *reference, IOExternalMethodArguments *arguments);
+    static IOReturn copyCounters(BigSurfaceDiagnosticsUserClient *target, void *reference, IOExternalMethodArguments *arguments);
+    static IOReturn publish(BigSurfaceDiagnosticsUserClient *target, void *reference, IOExternalMethodArguments *arguments);
+};
+
+#endif /* BigSurfaceDiagnosticsUserClient_hpp */
@@ -0,0 +1,167 @@
+//
+//  PerfCounters.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <IOKit/IOLib.h>
+#include <IOKit/IOLocks.h>
+#include <libkern/c++/OSNumber.h>
+
+#include "PerfCounters.hpp"
+
+#define PERF_CACHE_LINE_CNT     (64 / sizeof(UInt64))
+
+static IOLock *registry_lock = nullptr;
+static PerfCounterGroup *registry[PERF_MAX_GROUPS];
+
+static IOLock *registryLock() {
+    // drivers may come up before the diagnostics service, create it on first use
+    if (!registry_lock) {
+        IOLock *lock = IOLockAlloc();
+        if (lock && !OSCompareAndSwapPtr(nullptr, lock, reinterpret_cast<void * volatile *>(&registry_lock)))
+            IOLockFree(lock);
+    }
+    return registry_lock;
+}
+
+PerfCounterGroup *PerfCounterGroup::create(const char *name, const char * const *counter_names, UInt32 counter_cnt) {
+    IOLock *lock = registryLock();
+    if (!lock || !counter_cnt)
+        return nullptr;
+
+    PerfCounterGroup *group = new PerfCounterGroup;
+    if (!group)
+        return nullptr;
+    strlcpy(group->name, name, sizeof(group->name));
+    group->counter_names = counter_names;
+    group->counter_cnt = counter_cnt;
+    group->stride = (counter_cnt + PERF_CACHE_LINE_CNT - 1) / PERF_CACHE_LINE_CNT * PERF_CACHE_LINE_CNT;
+    group->values = static_cast<UInt64 *>(IOMallocAligned(TRACE_MAX_CPUS * group->stride * sizeof(UInt64), 64));
+    if (!group->values) {
+        delete group;
+        return nullptr;
+    }
+    bzero(group->values, TRACE_MAX_CPUS * group->stride * sizeof(UInt64));
+
+    bool registered = false;
+    IOLockLock(lock);
+    for (int i = 0; i < PERF_MAX_GROUPS; i++) {
+        if (!registry[i]) {
+            registry[i] = group;
+            registered = true;
+            break;
+        }
+    }
+    IOLockUnlock(lock);
+
+    // an unregistered group would count without ever being published
+    if (!registered) {
+        IOLog("PerfCounters::Registry full, counter group %s not created\n", name);
+        IOFreeAligned(group->values, TRACE_MAX_CPUS * group->stride * sizeof(UInt64));
+        delete group;
+        return nullptr;
+    }
+    return group;
+}
+
+void PerfCounterGroup::destroy(PerfCounterGroup *group) {
+    if (!group)
+        return;
+
+    IOLockLock(registry_lock);
+    for (int i = 0; i < PERF_MAX_GROUPS; i++) {
+        if (registry[i] == group) {
+            registry[i] = nullptr;
+            break;
+        }
+    }
+    IOLockUnlock(registry_lock);
+
+    IOFreeAligned(group->values, TRACE_MAX_CPUS * group->stride * sizeof(UInt64));
+    delete group;
+}
+
+UInt64 PerfCounterGroup::read(UInt32 idx) const {
+    UInt64 sum = 0;
+    if (idx >= counter_cnt)
+        return 0;
+    for (int cpu = 0; cpu < TRACE_MAX_CPUS; cpu++)
+        sum += values[cpu * stride + idx];
+    return sum;
+}
+
+OSDictionary *PerfCounterGroup::copySnapshot() const {
+    OSDictionary *dict = OSDictionary::withCapacity(counter_cnt);
+    if (!dict)
+        return nullptr;
+    for (UInt32 i = 0; i < counter_cnt; i++) {
+        OSNumber *num = OSNumber::withNumber(read(i), 64);
+        if (num) {
+            dict->setObject(counter_names[i], num);
+            num->release();
+        }
+    }
+    return dict;
+}
+
+OSDictionary *perfCopyAllCounters() {
+    IOLock *lock = registryLock();
+    if (!lock)
+        return nullptr;
+
+    OSDictionary *dict = OSDictionary::withCapacity(PERF_MAX_GROUPS);
+    if (!dict)
+        return nullptr;
+    IOLockLock(lock);
+    for (int i = 0; i < PERF_MAX_GROUPS; i++) {
+        if (!registry[i])
+            continue;
+        OSDictionary *group = registry[i]->copySnapshot();
+        if (group) {
+            dict->setObject(registry[i]->getName(), group);
+            group->release();
+        }
+    }
+    IOLockUnlock(lock);
+    return dict;
+}
+
+UInt32 perfCounterCount() {
+    IOLock *lock = registryLock();
+    UInt32 cnt = 0;
+    if (!lock)
+        return 0;
+
+    IOLockLock(lock);
+    for (int i = 0; i < PERF_MAX_GROUPS; i++) {
+        if (registry[i])
+            cnt += registry[i]->getCount();
+    }
+    IOLockUnlock(lock);
+    return cnt;
+}
+
+UInt32 perfSnapshotAllCounters(PerfCounterSnapshot *snapshots, UInt32 max_cnt) {
+    IOLock *lock = registryLock();
+    UInt32 cnt = 0;
+    if (!lock)
+        return 0;
+
+    IOLockLock(lock);
+    for (int i = 0; i < PERF_MAX_GROUPS; i++) {
+        PerfCounterGroup *group = registry[i];
+        if (!group)
+            continue;
+        for (UInt32 j = 0; j < group->getCount(); j++, cnt++) {
+            if (cnt >= max_cnt)
+                continue;
+            strlcpy(snapshots[cnt].group, group->getName(), PERF_NAME_LEN);
+            strlcpy(snapshots[cnt].name, group->getCounterName(j), PERF_NAME_LEN);
+            snapshots[cnt].value = group->read(j);
+        }
+    }
+    IOLockUnlock(lock);
+    return cnt;
+}
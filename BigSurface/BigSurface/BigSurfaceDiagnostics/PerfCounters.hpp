@@ -0,0 +1,77 @@
+//
+//  PerfCounters.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef PerfCounters_hpp
+#define PerfCounters_hpp
+
+#include <libkern/OSAtomic.h>
+#include <libkern/c++/OSDictionary.h>
+
+#include "Tracepoints.hpp"
+#include "../TaggedAllocator.hpp"
+
+/*
+ * Named 64 bit counters declared by every driver. Each CPU increments its
+ * own copy so hot paths never share a cache line, the copies are only summed
+ * when somebody reads them. Groups register themselves in a global table the
+ * diagnostics service publishes.
+ */
+#define PERF_MAX_GROUPS         16
+#define PERF_NAME_LEN           32
+
+struct PerfCounterSnapshot {
+    char    group[PERF_NAME_LEN];
+    char    name[PERF_NAME_LEN];
+    UInt64  value;
+};
+
+class PerfCounterGroup : public TaggedObject<AllocTagDiagnostics> {
+public:
+    // counter_names has to outlive the group, nullptr when out of memory or all PERF_MAX_GROUPS slots are taken
+    static PerfCounterGroup *create(const char *name, const char * const *counter_names, UInt32 counter_cnt);
+
+    static void destroy(PerfCounterGroup *group);
+
+    inline void add(UInt32 idx, UInt64 delta = 1) {
+        OSAddAtomic64(static_cast<SInt64>(delta), reinterpret_cast<volatile SInt64 *>(&values[(cpu_number() % TRACE_MAX_CPUS) * stride + idx]));
+    }
+
+    UInt64 read(UInt32 idx) const;
+
+    // {counter name: value}, caller releases
+    OSDictionary *copySnapshot() const;
+
+    const char *getName() const { return name; }
+
+    UInt32 getCount() const { return counter_cnt; }
+
+    const char *getCounterName(UInt32 idx) const { return counter_names[idx]; }
+
+private:
+    char                name[PERF_NAME_LEN];
+    const char * const *counter_names;
+    UInt32              counter_cnt;
+    UInt32              stride;     // counters per CPU, padded to a cache line
+    UInt64*             values;
+};
+
+#define PERF_COUNT(group, idx)          \
+    do {                                \
+        if (group)                      \
+            (group)->add(idx);          \
+    } while (0)
+
+// {group name: {counter name: value}}, caller releases
+OSDictionary *perfCopyAllCounters();
+
+// number of counters in all registered groups
+UInt32 perfCounterCount();
+
+// fill up to max_cnt snapshots, returns the number of counters available
+UInt32 perfSnapshotAllCounters(PerfCounterSnapshot *snapshots, UInt32 max_cnt);
+
+#endif /* PerfCounters_hpp */
@@ -0,0 +1,171 @@
+//
+//  SoakMonitor.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <IOKit/IOLib.h>
+#include <libkern/c++/OSNumber.h>
+#include <kern/clock.h>
+
+#include "SoakMonitor.hpp"
+
+static void setNumber(OSDictionary *dict, const char *key, UInt64 value) {
+    OSNumber *num = OSNumber::withNumber(value, 64);
+    if (num) {
+        dict->setObject(key, num);
+        num->release();
+    }
+}
+
+bool SoakMonitor::init() {
+    baseline = tagNewArray<PerfCounterSnapshot>(AllocTagDiagnostics, SOAK_MAX_COUNTERS);
+    current = tagNewArray<PerfCounterSnapshot>(AllocTagDiagnostics, SOAK_MAX_COUNTERS);
+    if (!baseline || !current) {
+        free();
+        return false;
+    }
+    nanoseconds_to_absolutetime(SOAK_CHECKPOINT_INTERVAL * 1000000000ULL, &interval);
+    clock_get_uptime(&start);
+    takeCheckpoint(start);
+    return true;
+}
+
+void SoakMonitor::free() {
+    tagFree(baseline);
+    tagFree(current);
+    baseline = current = nullptr;
+    baseline_cnt = 0;
+    checkpoint_cnt = 0;
+}
+
+void SoakMonitor::sample() {
+    if (!baseline)
+        return;
+    UInt64 now;
+    clock_get_uptime(&now);
+    if (now - checkpointAt(0).timestamp >= interval)
+        takeCheckpoint(now);
+}
+
+void SoakMonitor::takeCheckpoint(UInt64 now) {
+    Checkpoint *checkpoint = &checkpoints[checkpoint_cnt % SOAK_CHECKPOINT_CNT];
+    checkpoint->timestamp = now;
+    for (int i = 0; i < AllocTagCount; i++)
+        checkpoint->live_bytes[i] = tagLiveBytes(static_cast<AllocTag>(i));
+    checkpoint_cnt++;
+
+    UInt32 cnt = perfSnapshotAllCounters(baseline, SOAK_MAX_COUNTERS);
+    baseline_cnt = cnt < SOAK_MAX_COUNTERS ? cnt : SOAK_MAX_COUNTERS;
+}
+
+OSDictionary *SoakMonitor::copyReport() {
+    if (!baseline)
+        return nullptr;
+
+    OSDictionary *report = OSDictionary::withCapacity(4);
+    if (!report)
+        return nullptr;
+
+    UInt64 now, ns;
+    clock_get_uptime(&now);
+    absolutetime_to_nanoseconds(now - start, &ns);
+    setNumber(report, "Uptime", ns / 1000000000ULL);
+    setNumber(report, "Checkpoints", checkpoint_cnt);
+
+    OSDictionary *memory = copyMemoryReport(now);
+    if (memory) {
+        report->setObject("Memory", memory);
+        memory->release();
+    }
+    OSDictionary *rates = copyRateReport(now);
+    if (rates) {
+        report->setObject("Rates", rates);
+        rates->release();
+    }
+    return report;
+}
+
+OSDictionary *SoakMonitor::copyMemoryReport(UInt64 now) {
+    OSDictionary *memory = OSDictionary::withCapacity(AllocTagCount);
+    if (!memory)
+        return nullptr;
+
+    UInt32 kept = checkpoint_cnt < SOAK_CHECKPOINT_CNT ? checkpoint_cnt : SOAK_CHECKPOINT_CNT;
+    const Checkpoint &oldest = checkpointAt(kept - 1);
+    UInt64 ns;
+    absolutetime_to_nanoseconds(now - oldest.timestamp, &ns);
+
+    for (int i = 0; i < AllocTagCount; i++) {
+        OSDictionary *entry = OSDictionary::withCapacity(3);
+        if (!entry)
+            continue;
+        UInt64 live = tagLiveBytes(static_cast<AllocTag>(i));
+        setNumber(entry, "LiveBytes", live);
+
+        // a leak keeps growing, a cache that filled up levels off, shrinking reads as zero
+        UInt64 growth = live > oldest.live_bytes[i] ? live - oldest.live_bytes[i] : 0;
+        UInt64 hour_fraction = ns / 3600;   // ns per second of an hour
+        setNumber(entry, "GrowthPerHour", hour_fraction ? growth * 1000000000ULL / hour_fraction : 0);
+
+        UInt32 growing = 0;
+        UInt64 newer = live;
+        for (UInt32 age = 0; age < kept; age++) {
+            UInt64 older = checkpointAt(age).live_bytes[i];
+            if (newer <= older)
+                break;
+            growing++;
+            newer = older;
+        }
+        setNumber(entry, "GrowingHours", growing);
+
+        memory->setObject(tagName(static_cast<AllocTag>(i)), entry);
+        entry->release();
+    }
+    return memory;
+}
+
+OSDictionary *SoakMonitor::copyRateReport(UInt64 now) {
+    OSDictionary *rates = OSDictionary::withCapacity(PERF_MAX_GROUPS);
+    if (!rates)
+        return nullptr;
+
+    UInt64 ns;
+    absolutetime_to_nanoseconds(now - checkpointAt(0).timestamp, &ns);
+    // too short after a checkpoint to extrapolate
+    if (ns < 60000000000ULL)
+        return rates;
+
+    UInt32 cnt = perfSnapshotAllCounters(current, SOAK_MAX_COUNTERS);
+    if (cnt > SOAK_MAX_COUNTERS)
+        cnt = SOAK_MAX_COUNTERS;
+
+    for (UInt32 i = 0; i < cnt; i++) {
+        PerfCounterSnapshot *counter = &current[i];
+        UInt64 before = 0;
+        // groups only ever get added, so the counter usually is at the same index
+        if (i < baseline_cnt && !strncmp(baseline[i].group, counter->group, PERF_NAME_LEN) && !strncmp(baseline[i].name, counter->name, PERF_NAME_LEN))
+            before = baseline[i].value;
+        else {
+            for (UInt32 j = 0; j < baseline_cnt; j++) {
+                if (!strncmp(baseline[j].group, counter->group, PERF_NAME_LEN) && !strncmp(baseline[j].name, counter->name, PERF_NAME_LEN)) {
+                    before = baseline[j].value;
+                    break;
+                }
+            }
+        }
+
+        OSDictionary *group = OSDynamicCast(OSDictionary, rates->getObject(counter->group));
+        if (!group) {
+            group = OSDictionary::withCapacity(8);
+            if (!group)
+                continue;
+            rates->setObject(counter->group, group);
+            group->release();
+        }
+        UInt64 delta = counter->value > before ? counter->value - before : 0;
+        setNumber(group, counter->name, delta * 3600 * 1000 / (ns / 1000000));
+    }
+    return rates;
+}
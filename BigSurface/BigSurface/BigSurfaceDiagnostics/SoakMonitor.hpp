@@ -0,0 +1,68 @@
+//
+//  SoakMonitor.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef SoakMonitor_hpp
+#define SoakMonitor_hpp
+
+#include <libkern/c++/OSDictionary.h>
+
+#include "PerfCounters.hpp"
+#include "../TaggedAllocator.hpp"
+
+/*
+ * Long running view of the drivers under real load. Once an hour the live
+ * bytes of every allocation tag and all performance counters are kept as a
+ * checkpoint, the report compares the current values against them so slow
+ * memory growth and rising error rates stand out after days of uptime.
+ * Only used from the diagnostics work loop, nothing is locked.
+ */
+#define SOAK_CHECKPOINT_INTERVAL    3600    // s
+#define SOAK_CHECKPOINT_CNT         48      // checkpoints kept
+#define SOAK_MAX_COUNTERS           128
+
+class SoakMonitor {
+public:
+    bool init();
+
+    void free();
+
+    // called periodically, takes a checkpoint when one is due
+    void sample();
+
+    /*
+     * {Uptime, Checkpoints, Memory: {tag: {LiveBytes, GrowthPerHour, GrowingHours}},
+     *  Rates: {group: {counter: per hour since the last checkpoint}}}, caller releases
+     */
+    OSDictionary *copyReport();
+
+private:
+    struct Checkpoint {
+        UInt64  timestamp;      // mach absolute time
+        UInt64  live_bytes[AllocTagCount];
+    };
+
+    Checkpoint  checkpoints[SOAK_CHECKPOINT_CNT] {};
+    UInt32      checkpoint_cnt {0};     // total taken, the ring keeps the last SOAK_CHECKPOINT_CNT
+    UInt64      start {0};
+    UInt64      interval {0};           // mach absolute time
+
+    PerfCounterSnapshot*    baseline {nullptr};     // counters at the last checkpoint
+    PerfCounterSnapshot*    current {nullptr};
+    UInt32      baseline_cnt {0};
+
+    const Checkpoint &checkpointAt(UInt32 age) const {
+        return checkpoints[(checkpoint_cnt - 1 - age) % SOAK_CHECKPOINT_CNT];
+    }
+
+    void takeCheckpoint(UInt64 now);
+
+    OSDictionary *copyMemoryReport(UInt64 now);
+
+    OSDictionary *copyRateReport(UInt64 now);
+};
+
+#endif /* SoakMonitor_hpp */
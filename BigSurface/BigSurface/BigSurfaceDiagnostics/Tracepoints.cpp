@@ -0,0 +1,71 @@
+//
+//  Tracepoints.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <IOKit/IOLib.h>
+#include <libkern/OSAtomic.h>
+#include <kern/clock.h>
+
+#include "Tracepoints.hpp"
+
+volatile UInt32 gTraceMask = 0;
+static TraceBuffer * volatile trace_buffer = nullptr;
+static volatile SInt32 trace_writers = 0;  // tracepoints that may still hold trace_buffer
+
+static void traceWrite(TraceBuffer *buffer, UInt8 subsystem, UInt16 event, UInt64 arg0, UInt64 arg1) {
+    // migrating after reading the cpu number is harmless, the slot is reserved atomically
+    UInt32 cpu = static_cast<UInt32>(cpu_number());
+    TraceRing *ring = &buffer->rings[cpu % TRACE_MAX_CPUS];
+    UInt32 pos = static_cast<UInt32>(OSIncrementAtomic(reinterpret_cast<volatile SInt32 *>(&ring->head)));
+    TraceRecord *record = &ring->records[pos & (TRACE_RING_DEPTH - 1)];
+
+    record->seq = 0;
+    OSMemoryBarrier();
+    clock_get_uptime(&record->timestamp);
+    record->event = event;
+    record->subsystem = subsystem;
+    record->cpu = static_cast<UInt8>(cpu);
+    record->arg0 = arg0;
+    record->arg1 = arg1;
+    OSMemoryBarrier();
+    record->seq = pos + 1;
+}
+
+void traceRecord(UInt8 subsystem, UInt16 event, UInt64 arg0, UInt64 arg1) {
+    // announce ourselves before loading the buffer, detaching waits for us
+    OSIncrementAtomic(&trace_writers);
+    TraceBuffer *buffer = trace_buffer;
+    if (buffer)
+        traceWrite(buffer, subsystem, event, arg0, arg1);
+    OSDecrementAtomic(&trace_writers);
+}
+
+void traceAttachBuffer(TraceBuffer *buffer) {
+    if (!buffer) {
+        traceSetMask(0);
+        trace_buffer = nullptr;
+        OSMemoryBarrier();
+        // the buffer may be freed once we return, wait for writers that already loaded it
+        while (trace_writers)
+            IOSleep(1);
+        return;
+    }
+    buffer->hdr.version = TRACE_BUFFER_VERSION;
+    buffer->hdr.cpu_cnt = TRACE_MAX_CPUS;
+    buffer->hdr.depth = TRACE_RING_DEPTH;
+    buffer->hdr.record_size = sizeof(TraceRecord);
+    OSMemoryBarrier();
+    trace_buffer = buffer;
+}
+
+void traceSetMask(UInt32 mask) {
+    // tracepoints stay off until there is somewhere to write to
+    if (!trace_buffer)
+        mask = 0;
+    gTraceMask = mask;
+    if (trace_buffer)
+        trace_buffer->hdr.mask = mask;
+}
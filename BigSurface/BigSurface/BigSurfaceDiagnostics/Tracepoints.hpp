@@ -0,0 +1,107 @@
+//
+//  Tracepoints.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef Tracepoints_hpp
+#define Tracepoints_hpp
+
+#include <libkern/OSTypes.h>
+
+/*
+ * Binary tracepoints shared by all drivers. A disabled tracepoint costs one
+ * load and one branch on the global mask. Enabled ones write a fixed size
+ * record into the ring of the current CPU, the ring space is reserved with
+ * an atomic increment so writers never block and the oldest records are
+ * overwritten. The whole buffer is mapped read only into the decoder.
+ */
+#define TRACE_BUFFER_VERSION        1
+#define TRACE_MAX_CPUS              16
+#define TRACE_RING_DEPTH            256     // records per CPU, power of 2
+
+enum TraceSubsystem {
+    TraceSSH = 0,
+    TraceMEI,
+    TraceBattery,
+    TraceALS,
+    TraceButton,
+    TraceSubsystemCount,
+};
+
+// ids are stable, the decoder keeps the same table
+enum TraceEvent {
+    // SSH
+    TraceSSHRxBuffer = 0x100,   // length
+    TraceSSHFrame,              // frame type, seq id
+    TraceSSHFrameError,         // received length
+    TraceSSHCommand,            // tc << 24 | tid << 16 | cid << 8 | iid, seq or request id
+    TraceSSHRetransmit,         // seq id, trial count
+    TraceSSHResponse,           // request id, data length
+    TraceSSHTimeout,            // request id
+    TraceSSHEvent,              // tc << 8 | cid, iid
+    // MEI
+    TraceMEIInterrupt = 0x200,  // host status
+    TraceMEIClientRead,         // client address, fragment length
+    TraceMEIMessageComplete,    // client address, message length
+    TraceMEIDelivery,           // message length, interrupt to dispatch in absolute time
+    TraceMEIReset,              // MEIFailureType, backoff in ms
+    // battery
+    TraceBatteryStatus = 0x300, // battery index, BST state
+    TraceBatteryInfo,           // battery index
+    TraceSMBusRequest,          // address << 8 | command, protocol
+    // ALS
+    TraceALSPoll = 0x400,       // clear channel count
+    // buttons
+    TraceButtonEvent = 0x500,   // button index, pressed
+};
+
+struct TraceRecord {
+    UInt64  timestamp;      // mach absolute time
+    UInt32  seq;            // ring position + 1, written last
+    UInt16  event;
+    UInt8   subsystem;
+    UInt8   cpu;
+    UInt64  arg0;
+    UInt64  arg1;
+};
+
+struct TraceRing {
+    volatile UInt32 head;   // total records reserved on this CPU
+    UInt32          reserved[15];   // keep heads on their own cache line
+    TraceRecord     records[TRACE_RING_DEPTH];
+};
+
+struct TraceBufferHeader {
+    UInt32          version;
+    UInt32          cpu_cnt;
+    UInt32          depth;
+    UInt32          record_size;
+    volatile UInt32 mask;   // copy of the enable mask for the decoder
+    UInt32          reserved[11];
+};
+
+struct TraceBuffer {
+    TraceBufferHeader   hdr;
+    TraceRing           rings[TRACE_MAX_CPUS];
+};
+
+extern "C" int cpu_number(void);
+
+extern volatile UInt32 gTraceMask;
+
+void traceRecord(UInt8 subsystem, UInt16 event, UInt64 arg0, UInt64 arg1);
+
+// detaching with nullptr sleeps until running tracepoints are done with the old buffer
+void traceAttachBuffer(TraceBuffer *buffer);
+
+void traceSetMask(UInt32 mask);
+
+#define TRACEPOINT(sub, event, arg0, arg1)                                              \
+    do {                                                                                \
+        if (__builtin_expect(gTraceMask & (1U << (sub)), 0))                            \
+            traceRecord((sub), (event), static_cast<UInt64>(arg0), static_cast<UInt64>(arg1)); \
+    } while (0)
+
+#endif /* Tracepoints_hpp */
@@ -0,0 +1,95 @@
+//
+//  BootTimeline.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <libkern/OSAtomic.h>
+#include <libkern/c++/OSDictionary.h>
+#include <libkern/c++/OSNumber.h>
+#include <libkern/c++/OSString.h>
+#include <kern/clock.h>
+
+#include "BootTimeline.hpp"
+
+struct BootStageState {
+    volatile UInt64 begin;      // mach absolute time, 0 before the stage
+    volatile UInt64 end;
+};
+
+static const char *stage_names[BootStageCount] = {
+    "SSHProbe", "SSHControllerWait", "SSHSettle", "SSHStart", "SSHNubDelay",
+    "MEIStart", "MEIEnumeration",
+    "BatteryStart", "BatterySMCWait", "BatterySMCSubmit", "BatteryFirstStatus",
+    "ALSProbe", "ALSDeviceWait", "ALSStart", "ALSSMCSubmit", "ALSFirstSample",
+    "ButtonProbe", "ButtonControllerWait", "ButtonSettle", "ButtonStart",
+};
+
+static BootStageState stages[BootStageCount];
+
+void BootTimeline::begin(BootStage stage) {
+    if (stages[stage].begin)
+        return;
+    UInt64 now;
+    clock_get_uptime(&now);
+    OSCompareAndSwap64(0, now, &stages[stage].begin);
+}
+
+void BootTimeline::end(BootStage stage) {
+    if (!stages[stage].begin || stages[stage].end)
+        return;
+    UInt64 now;
+    clock_get_uptime(&now);
+    OSCompareAndSwap64(0, now, &stages[stage].end);
+}
+
+OSArray *BootTimeline::copyTimeline() {
+    int order[BootStageCount];
+    int cnt = 0;
+
+    // a handful of stages, insertion sort by start
+    for (int i = 0; i < BootStageCount; i++) {
+        if (!stages[i].begin)
+            continue;
+        int j = cnt++;
+        for (; j > 0 && stages[order[j - 1]].begin > stages[i].begin; j--)
+            order[j] = order[j - 1];
+        order[j] = i;
+    }
+
+    OSArray *timeline = OSArray::withCapacity(cnt ? cnt : 1);
+    if (!timeline)
+        return nullptr;
+
+    for (int i = 0; i < cnt; i++) {
+        BootStageState *state = &stages[order[i]];
+        UInt64 begin = state->begin, end = state->end;
+        OSDictionary *entry = OSDictionary::withCapacity(3);
+        if (!entry)
+            continue;
+        OSString *name = OSString::withCStringNoCopy(stage_names[order[i]]);
+        if (name) {
+            entry->setObject("Name", name);
+            name->release();
+        }
+        UInt64 start_ns, duration_ns;
+        absolutetime_to_nanoseconds(begin, &start_ns);
+        OSNumber *num = OSNumber::withNumber(start_ns / 1000, 64);
+        if (num) {
+            entry->setObject("Start", num);
+            num->release();
+        }
+        if (end) {
+            absolutetime_to_nanoseconds(end - begin, &duration_ns);
+            num = OSNumber::withNumber(duration_ns / 1000, 64);
+            if (num) {
+                entry->setObject("Duration", num);
+                num->release();
+            }
+        }
+        timeline->setObject(entry);
+        entry->release();
+    }
+    return timeline;
+}
@@ -0,0 +1,55 @@
+//
+//  BootTimeline.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef BootTimeline_hpp
+#define BootTimeline_hpp
+
+#include <libkern/c++/OSArray.h>
+
+/*
+ * Start up stages of all drivers, from probe to the point the device is
+ * usable. Only the first run of a stage is kept, so retries after a failed
+ * attempt count towards the stage that was waiting for them. Marking is a
+ * compare and swap on the stage, cheap enough for probe and start paths.
+ */
+enum BootStage {
+    BootStageSSHProbe = 0,
+    BootStageSSHControllerWait,     // GPIO and UART controllers matched
+    BootStageSSHSettle,             // fixed sleep for the UART controller
+    BootStageSSHStart,              // until SAM answered
+    BootStageSSHNubDelay,           // fixed delay before publishing device nubs
+    BootStageMEIStart,
+    BootStageMEIEnumeration,        // HBM start request until all client properties arrived
+    BootStageBatteryStart,
+    BootStageBatterySMCWait,        // AppleSMC matched
+    BootStageBatterySMCSubmit,      // until VirtualSMC accepted the plugin
+    BootStageBatteryFirstStatus,    // until the first status reached the battery manager
+    BootStageALSProbe,
+    BootStageALSDeviceWait,         // ACPI0008 matched
+    BootStageALSStart,
+    BootStageALSSMCSubmit,          // until VirtualSMC accepted the plugin
+    BootStageALSFirstSample,        // until the first lux value
+    BootStageButtonProbe,
+    BootStageButtonControllerWait,  // GPIO controller matched
+    BootStageButtonSettle,          // fixed sleep for the GPIO controller
+    BootStageButtonStart,
+    BootStageCount,
+};
+
+class BootTimeline {
+public:
+    static void begin(BootStage stage);
+
+    // ignored unless the stage began
+    static void end(BootStage stage);
+
+    // [{Name, Start, Duration}] ordered by start, in us since boot, Duration
+    // missing while the stage runs, caller releases
+    static OSArray *copyTimeline();
+};
+
+#endif /* BootTimeline_hpp */
@@ -0,0 +1,39 @@
+//
+//  CoreTypes.h
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef CoreTypes_h
+#define CoreTypes_h
+
+/*
+ * Protocol cores (framing, checksums, slot and battery math) only include
+ * this header, never IOKit, so they build on any host as well. The driver
+ * classes are thin shims around them that own locks, timers and registers.
+ */
+#ifdef KERNEL
+#include <IOKit/IOTypes.h>
+#else
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t     UInt8;
+typedef uint16_t    UInt16;
+typedef uint32_t    UInt32;
+typedef uint64_t    UInt64;
+typedef int8_t      SInt8;
+typedef int16_t     SInt16;
+typedef int32_t     SInt32;
+typedef int64_t     SInt64;
+typedef uint64_t    AbsoluteTime;
+#endif
+
+#define BIT(nr) (1UL << (nr))
+
+#ifndef GENMASK
+#define GENMASK(h, l) (((~0UL) << (l)) & (~0UL >> (64 - 1 - (h))))
+#endif
+
+#endif /* CoreTypes_h */
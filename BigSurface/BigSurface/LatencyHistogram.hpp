@@ -0,0 +1,118 @@
+//
+//  LatencyHistogram.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef LatencyHistogram_hpp
+#define LatencyHistogram_hpp
+
+#include "CoreTypes.h"
+
+#ifdef KERNEL
+#include <libkern/c++/OSDictionary.h>
+#include <libkern/c++/OSNumber.h>
+#include <kern/clock.h>
+#endif
+
+/*
+ * Log-linear latency histogram in microseconds, every power of two is split
+ * into 4 sub buckets so percentiles stay within 25% of the real value.
+ * Recording is meant to happen from a single thread, readers may see a
+ * slightly torn snapshot which is fine for statistics. Host builds only get
+ * the bucket math and record() whatever unit they measure in.
+ */
+#define LATENCY_SUB_BUCKET_BITS     2
+#define LATENCY_SUB_BUCKET_CNT      (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_BUCKET_CNT          128
+
+struct LatencyHistogram {
+    UInt32  buckets[LATENCY_BUCKET_CNT];
+    UInt64  count;
+    UInt64  total;
+    UInt64  max;
+
+    void reset() {
+        for (int i = 0; i < LATENCY_BUCKET_CNT; i++)
+            buckets[i] = 0;
+        count = total = max = 0;
+    }
+
+    static int bucketIndex(UInt64 us) {
+        if (us < LATENCY_SUB_BUCKET_CNT)
+            return static_cast<int>(us);
+        int msb = 63 - __builtin_clzll(us);
+        int idx = (msb - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKET_CNT + ((us >> (msb - LATENCY_SUB_BUCKET_BITS)) & (LATENCY_SUB_BUCKET_CNT - 1));
+        return idx < LATENCY_BUCKET_CNT ? idx : LATENCY_BUCKET_CNT - 1;
+    }
+
+    static UInt64 bucketUpperBound(int idx) {
+        if (idx < LATENCY_SUB_BUCKET_CNT)
+            return idx;
+        int msb = idx / LATENCY_SUB_BUCKET_CNT + LATENCY_SUB_BUCKET_BITS - 1;
+        UInt64 lower = (1ULL << msb) | (static_cast<UInt64>(idx % LATENCY_SUB_BUCKET_CNT) << (msb - LATENCY_SUB_BUCKET_BITS));
+        return lower + (1ULL << (msb - LATENCY_SUB_BUCKET_BITS)) - 1;
+    }
+
+    void record(UInt64 us) {
+        buckets[bucketIndex(us)]++;
+        count++;
+        total += us;
+        if (us > max)
+            max = us;
+    }
+
+#ifdef KERNEL
+    // record the interval between two clock_get_uptime() stamps
+    void recordInterval(UInt64 from, UInt64 to) {
+        UInt64 ns;
+        if (!from || to < from)
+            return;
+        absolutetime_to_nanoseconds(to - from, &ns);
+        record(ns / 1000);
+    }
+
+    void recordSince(UInt64 stamp) {
+        UInt64 now;
+        clock_get_uptime(&now);
+        recordInterval(stamp, now);
+    }
+
+#endif
+
+    // permille: 500 for p50, 990 for p99
+    UInt64 percentile(UInt32 permille) const {
+        if (!count)
+            return 0;
+        UInt64 target = (count * permille + 999) / 1000;
+        UInt64 sum = 0;
+        for (int i = 0; i < LATENCY_BUCKET_CNT; i++) {
+            sum += buckets[i];
+            if (sum >= target)
+                return bucketUpperBound(i) < max ? bucketUpperBound(i) : max;
+        }
+        return max;
+    }
+
+#ifdef KERNEL
+    // summary suitable for the IORegistry, caller releases
+    OSDictionary *copySummary() const {
+        OSDictionary *dict = OSDictionary::withCapacity(4);
+        if (!dict)
+            return nullptr;
+        const char *keys[] = {"Count", "P50", "P99", "Max"};
+        UInt64 values[] = {count, percentile(500), percentile(990), max};
+        for (int i = 0; i < 4; i++) {
+            OSNumber *num = OSNumber::withNumber(values[i], 64);
+            if (num) {
+                dict->setObject(keys[i], num);
+                num->release();
+            }
+        }
+        return dict;
+    }
+#endif
+};
+
+#endif /* LatencyHistogram_hpp */
@@ -0,0 +1,22 @@
+//
+//  ModuleStop.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <mach/kmod.h>
+
+#include "TimerCoalescer.hpp"
+#include "WorkLoopBands.hpp"
+
+/*
+ * MODULE_STOP of the kext. The kext only unloads once every driver has
+ * stopped, so nothing uses the shared helpers any more and the state they
+ * created on first use can go.
+ */
+extern "C" kern_return_t BigSurface_stop(kmod_info_t *ki, void *data) {
+    TimerCoalescer::teardown();
+    WorkLoopBands::teardown();
+    return KERN_SUCCESS;
+}
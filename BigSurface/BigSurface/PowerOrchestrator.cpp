@@ -0,0 +1,198 @@
+//
+//  PowerOrchestrator.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <IOKit/IOLib.h>
+#include <IOKit/IOLocks.h>
+#include <libkern/OSAtomic.h>
+#include <libkern/c++/OSNumber.h>
+
+#include "PowerOrchestrator.hpp"
+
+struct PowerDomainState {
+    IOService*                      driver;
+    PowerOrchestrator::Transition   transition;
+    thread_call_t                   call;
+    bool                            ready;
+    UInt64                          begin;
+    UInt64                          end;
+};
+
+static const char *domain_names[PowerDomainCount] = {"SSH", "MEI", "Battery", "ALS", "Button"};
+
+static IOLock *power_lock = nullptr;
+static PowerDomainState domains[PowerDomainCount];
+static UInt64 wake_epoch = 0;
+static bool epoch_valid = false;
+
+static IOLock *powerLock() {
+    // drivers start in any order, create it on first use
+    if (!power_lock) {
+        IOLock *lock = IOLockAlloc();
+        if (lock && !OSCompareAndSwapPtr(nullptr, lock, reinterpret_cast<void * volatile *>(&power_lock)))
+            IOLockFree(lock);
+    }
+    return power_lock;
+}
+
+static void runTransition(thread_call_param_t param0, thread_call_param_t param1) {
+    PowerDomain domain = static_cast<PowerDomain>(reinterpret_cast<uintptr_t>(param0));
+    bool wake = param1 != nullptr;
+    PowerDomainState *state = &domains[domain];
+    IOService *driver = state->driver;
+
+    state->transition(driver, wake);
+
+    IOLockLock(power_lock);
+    clock_get_uptime(&state->end);
+    if (wake) {
+        state->ready = true;
+        IOLockWakeup(power_lock, state, false);
+    }
+    IOLockUnlock(power_lock);
+
+    driver->acknowledgeSetPowerState();
+    driver->release();
+}
+
+bool PowerOrchestrator::registerDomain(PowerDomain domain, IOService *driver, Transition transition) {
+    IOLock *lock = powerLock();
+    if (!lock)
+        return false;
+
+    thread_call_t call = thread_call_allocate_with_options(runTransition, reinterpret_cast<thread_call_param_t>(domain), THREAD_CALL_PRIORITY_KERNEL, 0);
+    if (!call)
+        return false;
+
+    IOLockLock(lock);
+    if (domains[domain].driver) {
+        IOLockUnlock(lock);
+        thread_call_free(call);
+        return false;
+    }
+    domains[domain].driver = driver;
+    domains[domain].transition = transition;
+    domains[domain].call = call;
+    domains[domain].ready = true;
+    domains[domain].begin = domains[domain].end = 0;
+    IOLockUnlock(lock);
+    return true;
+}
+
+void PowerOrchestrator::unregisterDomain(PowerDomain domain, IOService *driver) {
+    if (!power_lock || domains[domain].driver != driver)
+        return;
+
+    thread_call_t call = domains[domain].call;
+    // a transition that never ran still holds the retain from scheduleTransition and owes power management its ack
+    if (thread_call_cancel_wait(call)) {
+        driver->acknowledgeSetPowerState();
+        driver->release();
+    }
+    thread_call_free(call);
+
+    IOLockLock(power_lock);
+    domains[domain].driver = nullptr;
+    domains[domain].transition = nullptr;
+    domains[domain].call = nullptr;
+    // nobody waits for a driver that is gone
+    domains[domain].ready = true;
+    IOLockWakeup(power_lock, &domains[domain], false);
+    IOLockUnlock(power_lock);
+}
+
+IOReturn PowerOrchestrator::scheduleTransition(PowerDomain domain, bool wake) {
+    PowerDomainState *state = &domains[domain];
+    if (!power_lock || !state->driver)
+        return kIOPMAckImplied;
+
+    IOLockLock(power_lock);
+    clock_get_uptime(&state->begin);
+    state->end = 0;
+    if (wake && !epoch_valid) {
+        wake_epoch = state->begin;
+        epoch_valid = true;
+    } else if (!wake) {
+        epoch_valid = false;
+        state->ready = false;
+    }
+    IOLockUnlock(power_lock);
+
+    state->driver->retain();
+    if (thread_call_enter1(state->call, reinterpret_cast<thread_call_param_t>(wake))) {
+        // previous transition still queued, which power management never does
+        state->driver->release();
+        IOLog("PowerOrchestrator::%s transition already pending\n", domain_names[domain]);
+    }
+    return POWER_TRANSITION_MAX_TIME;
+}
+
+void PowerOrchestrator::setReady(PowerDomain domain, bool ready) {
+    IOLock *lock = powerLock();
+    if (!lock)
+        return;
+    IOLockLock(lock);
+    domains[domain].ready = ready;
+    if (ready)
+        IOLockWakeup(lock, &domains[domain], false);
+    IOLockUnlock(lock);
+}
+
+bool PowerOrchestrator::waitReady(PowerDomain domain, UInt32 timeout_ms) {
+    AbsoluteTime abstime, deadline;
+    IOLock *lock = powerLock();
+    if (!lock)
+        return false;
+
+    nanoseconds_to_absolutetime(timeout_ms * 1000000ULL, &abstime);
+    clock_absolutetime_interval_to_deadline(abstime, &deadline);
+
+    IOLockLock(lock);
+    while (domains[domain].driver && !domains[domain].ready) {
+        if (IOLockSleepDeadline(lock, &domains[domain], deadline, THREAD_UNINT) == THREAD_TIMED_OUT)
+            break;
+    }
+    bool ready = !domains[domain].driver || domains[domain].ready;
+    IOLockUnlock(lock);
+    return ready;
+}
+
+OSDictionary *PowerOrchestrator::copyWakeTimeline() {
+    IOLock *lock = powerLock();
+    if (!lock)
+        return nullptr;
+
+    OSDictionary *timeline = OSDictionary::withCapacity(PowerDomainCount);
+    if (!timeline)
+        return nullptr;
+
+    IOLockLock(lock);
+    for (int i = 0; i < PowerDomainCount; i++) {
+        PowerDomainState *state = &domains[i];
+        if (!state->driver || !epoch_valid || state->begin < wake_epoch)
+            continue;
+        OSDictionary *entry = OSDictionary::withCapacity(2);
+        if (!entry)
+            continue;
+        UInt64 start_ns, duration_ns = 0;
+        absolutetime_to_nanoseconds(state->begin - wake_epoch, &start_ns);
+        if (state->end)
+            absolutetime_to_nanoseconds(state->end - state->begin, &duration_ns);
+        const char *keys[] = {"Start", "Duration"};
+        UInt64 values[] = {start_ns / 1000, duration_ns / 1000};
+        for (int j = 0; j < 2; j++) {
+            OSNumber *num = OSNumber::withNumber(values[j], 64);
+            if (num) {
+                entry->setObject(keys[j], num);
+                num->release();
+            }
+        }
+        timeline->setObject(domain_names[i], entry);
+        entry->release();
+    }
+    IOLockUnlock(lock);
+    return timeline;
+}
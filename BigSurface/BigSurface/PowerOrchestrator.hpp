@@ -0,0 +1,54 @@
+//
+//  PowerOrchestrator.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef PowerOrchestrator_hpp
+#define PowerOrchestrator_hpp
+
+#include <IOKit/IOService.h>
+#include <kern/thread_call.h>
+
+/*
+ * Runs the power transitions of all drivers off the power management thread
+ * so independent drivers sleep and wake in parallel. setPowerState returns
+ * right away and the driver is acknowledged once its transition finished.
+ * Dependencies the power tree does not express (buttons need SAM awake) are
+ * waited for with readiness signals instead of fixed sleeps.
+ */
+#define POWER_TRANSITION_MAX_TIME   10000000    // us, before power management gives up on us
+#define POWER_READY_TIMEOUT         1000        // ms
+
+enum PowerDomain {
+    PowerDomainSSH = 0,
+    PowerDomainMEI,
+    PowerDomainBattery,
+    PowerDomainALS,
+    PowerDomainButton,
+    PowerDomainCount,
+};
+
+class PowerOrchestrator {
+public:
+    // runs on a thread call, the driver is acknowledged afterwards
+    typedef void (*Transition)(OSObject *owner, bool wake);
+
+    static bool registerDomain(PowerDomain domain, IOService *driver, Transition transition);
+
+    static void unregisterDomain(PowerDomain domain, IOService *driver);
+
+    // return value is meant to be returned from setPowerState
+    static IOReturn scheduleTransition(PowerDomain domain, bool wake);
+
+    static void setReady(PowerDomain domain, bool ready);
+
+    // domains nobody registered count as ready
+    static bool waitReady(PowerDomain domain, UInt32 timeout_ms);
+
+    // {domain: {Start, Duration}} of the last wake in us, caller releases
+    static OSDictionary *copyWakeTimeline();
+};
+
+#endif /* PowerOrchestrator_hpp */
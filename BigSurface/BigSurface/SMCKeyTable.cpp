@@ -0,0 +1,37 @@
+//
+//  SMCKeyTable.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include "SMCKeyTable.hpp"
+
+static VirtualSMCValue *createValue(const SMCKeyDescriptor &desc, void *owner) {
+    VirtualSMCValue *impl = desc.create ? desc.create(owner, desc.index) : nullptr;
+
+    switch (desc.kind) {
+        case SMCKeyUint8:
+            return VirtualSMCAPI::valueWithUint8(desc.value, impl, desc.attr);
+        case SMCKeyUint16:
+            return VirtualSMCAPI::valueWithUint16(desc.value, impl, desc.attr);
+        case SMCKeySint16:
+            return VirtualSMCAPI::valueWithSint16(desc.value, impl, desc.attr);
+        case SMCKeyFlag:
+            return VirtualSMCAPI::valueWithFlag(desc.value != 0, impl, desc.attr);
+        case SMCKeySp:
+            return VirtualSMCAPI::valueWithSp(desc.value, desc.type, impl, desc.attr);
+        case SMCKeyData:
+            return VirtualSMCAPI::valueWithData(static_cast<const SMC_DATA *>(desc.data), desc.size, desc.type, impl, desc.attr);
+    }
+    return nullptr;
+}
+
+void smcAddKeys(const SMCKeyDescriptor *keys, size_t cnt, decltype(VirtualSMCAPI::Plugin::data) &data, void *owner, size_t index_cnt, bool adapter) {
+    for (size_t i = 0; i < cnt; i++) {
+        const SMCKeyDescriptor &desc = keys[i];
+        if (desc.index == SMC_KEY_ADAPTER ? !adapter : (desc.index != SMC_KEY_SHARED && desc.index >= index_cnt))
+            continue;
+        VirtualSMCAPI::addKey(desc.key, data, createValue(desc, owner));
+    }
+}
@@ -0,0 +1,75 @@
+//
+//  SMCKeyTable.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef SMCKeyTable_hpp
+#define SMCKeyTable_hpp
+
+#include <VirtualSMCSDK/kern_vsmcapi.hpp>
+
+/*
+ * VirtualSMC plugins declare their keys as a constexpr table. Tables are
+ * checked to be sorted at compile time, so filling a plugin is a linear
+ * pass and the keystore can binary search it without a runtime qsort.
+ */
+#define SMC_KEY_SHARED      0xFF    // always present
+#define SMC_KEY_ADAPTER     0xFE    // present when there is an AC adapter
+
+enum SMCKeyKind : UInt8 {
+    SMCKeyUint8 = 0,
+    SMCKeyUint16,
+    SMCKeySint16,
+    SMCKeyFlag,
+    SMCKeySp,
+    SMCKeyData,
+};
+
+typedef VirtualSMCValue *(*SMCKeyFactory)(void *owner, size_t index);
+
+struct SMCKeyDescriptor {
+    SMC_KEY             key;
+    UInt8               index;      // battery or sensor the value belongs to
+    SMCKeyKind          kind;
+    SMC_KEY_TYPE        type;       // SMCKeySp and SMCKeyData only
+    UInt8               size;       // SMCKeyData only
+    SInt32              value;      // initial value of numeric kinds
+    const void*         data;       // initial value of SMCKeyData, nullptr for zeros
+    SMC_KEY_ATTRIBUTES  attr;
+    SMCKeyFactory       create;     // nullptr for plain values
+};
+
+template <typename T>
+VirtualSMCValue *smcIndexedValue(void *owner, size_t index) {
+    return new T(index);
+}
+
+template <typename T>
+VirtualSMCValue *smcValue(void *owner, size_t index) {
+    return new T;
+}
+
+template <size_t N>
+constexpr bool smcKeysSorted(const SMCKeyDescriptor (&keys)[N]) {
+    for (size_t i = 1; i < N; i++) {
+        if (keys[i - 1].key >= keys[i].key)
+            return false;
+    }
+    return true;
+}
+
+/**
+ *  Append the keys present on this machine, in table order
+ *
+ *  @param keys       sorted key table
+ *  @param cnt        number of keys in the table
+ *  @param data       plugin key storage
+ *  @param owner      passed to the factories
+ *  @param index_cnt  keys with an index at or above are left out
+ *  @param adapter    whether SMC_KEY_ADAPTER keys are present
+ */
+void smcAddKeys(const SMCKeyDescriptor *keys, size_t cnt, decltype(VirtualSMCAPI::Plugin::data) &data, void *owner, size_t index_cnt, bool adapter);
+
+#endif /* SMCKeyTable_hpp */
@@ -9,6 +9,8 @@
 #ifndef APDS9960Constants_h
 #define APDS9960Constants_h
 
+#include "../CoreTypes.h"
+
 enum {
   GESTURE_NONE = -1,
   GESTURE_UP = 0,
@@ -140,4 +142,10 @@ enum {
 #define GWTIME_30_8MS           6
 #define GWTIME_39_2MS           7
 
+/* Clear channel count to lux, integer so it is usable without the FPU */
+static inline UInt32 apds9960ClearToLux(UInt16 clear)
+{
+    return static_cast<UInt32>(clear) * 3 / 2;
+}
+
 #endif /* APDS9960Constants_h */
@@ -9,11 +9,16 @@
 #include <Headers/kern_util.hpp>
 
 #include "SurfaceAmbientLightSensorDriver.hpp"
+#include "../BigSurfaceDiagnostics/Tracepoints.hpp"
+#include "../BootTimeline.hpp"
 
 #define super IOService
 OSDefineMetaClassAndStructors(SurfaceAmbientLightSensorDriver, IOService);
 
+static const char *counter_names[ALSCounterCount] = {"Polls", "ReadErrors"};
+
 IOService* SurfaceAmbientLightSensorDriver::probe(IOService *provider, SInt32 *score) {
+    BootTimeline::begin(BootStageALSProbe);
     if (!super::probe(provider, score))
         return nullptr;
     
@@ -21,6 +26,7 @@ IOService* SurfaceAmbientLightSensorDriver::probe(IOService *provider, SInt32 *s
     if (!api)
         return nullptr;
       
+    BootTimeline::begin(BootStageALSDeviceWait);
     OSDictionary *dict = nameMatching("ACPI0008");
     IOService *matched = waitForMatchingService(dict, 1000000000);
     alsd_device = OSDynamicCast(IOACPIPlatformDevice, matched);
@@ -30,45 +36,57 @@ IOService* SurfaceAmbientLightSensorDriver::probe(IOService *provider, SInt32 *s
         LOG("Ambient Light Sensor ACPI device not found");
         return nullptr;
     }
+    BootTimeline::end(BootStageALSDeviceWait);
     
-    ALSSensor sensor {ALSSensor::Type::Unknown7, true, 6, false};
-    ALSSensor noSensor {ALSSensor::Type::NoSensor, false, 0, false};
-    SMCAmbientLightValue::Value emptyValue;
-
-    VirtualSMCAPI::addKey(KeyAL, vsmcPlugin.data, VirtualSMCAPI::valueWithUint16(0, &forceBits, SMC_KEY_ATTRIBUTE_READ | SMC_KEY_ATTRIBUTE_WRITE));
-    VirtualSMCAPI::addKey(KeyALI0, vsmcPlugin.data, VirtualSMCAPI::valueWithData(
-        reinterpret_cast<const SMC_DATA *>(&sensor), sizeof(sensor), SmcKeyTypeAli, nullptr, SMC_KEY_ATTRIBUTE_CONST | SMC_KEY_ATTRIBUTE_READ));
-    VirtualSMCAPI::addKey(KeyALI1, vsmcPlugin.data, VirtualSMCAPI::valueWithData(
-        reinterpret_cast<const SMC_DATA *>(&noSensor), sizeof(noSensor), SmcKeyTypeAli, nullptr, SMC_KEY_ATTRIBUTE_CONST | SMC_KEY_ATTRIBUTE_READ));
-    VirtualSMCAPI::addKey(KeyALRV, vsmcPlugin.data, VirtualSMCAPI::valueWithUint16(1, nullptr, SMC_KEY_ATTRIBUTE_CONST | SMC_KEY_ATTRIBUTE_READ));
-    VirtualSMCAPI::addKey(KeyALV0, vsmcPlugin.data, VirtualSMCAPI::valueWithData(
-        reinterpret_cast<const SMC_DATA *>(&emptyValue), sizeof(emptyValue), SmcKeyTypeAlv, new SMCAmbientLightValue(&current_lux, &forceBits),
-        SMC_KEY_ATTRIBUTE_READ | SMC_KEY_ATTRIBUTE_WRITE));
-    VirtualSMCAPI::addKey(KeyALV1, vsmcPlugin.data, VirtualSMCAPI::valueWithData(
-        reinterpret_cast<const SMC_DATA *>(&emptyValue), sizeof(emptyValue), SmcKeyTypeAlv, nullptr,
-        SMC_KEY_ATTRIBUTE_READ | SMC_KEY_ATTRIBUTE_WRITE));
-    VirtualSMCAPI::addKey(KeyMSLD, vsmcPlugin.data, VirtualSMCAPI::valueWithUint8(0));
+    static constexpr ALSSensor sensor {ALSSensor::Type::Unknown7, true, 6, false};
+    static constexpr ALSSensor noSensor {ALSSensor::Type::NoSensor, false, 0, false};
+    static constexpr SMCAmbientLightValue::Value emptyValue {};
+    constexpr SMC_KEY_ATTRIBUTES AttrConst = SMC_KEY_ATTRIBUTE_CONST | SMC_KEY_ATTRIBUTE_READ;
+    constexpr SMC_KEY_ATTRIBUTES AttrRW = SMC_KEY_ATTRIBUTE_READ | SMC_KEY_ATTRIBUTE_WRITE;
+    static constexpr SMCKeyDescriptor keys[] = {
+        {KeyAL, SMC_KEY_SHARED, SMCKeyUint16, 0, 0, 0, nullptr, AttrRW, forceBitsValue},
+        {KeyALI0, SMC_KEY_SHARED, SMCKeyData, SmcKeyTypeAli, sizeof(ALSSensor), 0, &sensor, AttrConst, nullptr},
+        {KeyALI1, SMC_KEY_SHARED, SMCKeyData, SmcKeyTypeAli, sizeof(ALSSensor), 0, &noSensor, AttrConst, nullptr},
+        {KeyALRV, SMC_KEY_SHARED, SMCKeyUint16, 0, 0, 1, nullptr, AttrConst, nullptr},
+        {KeyALV0, SMC_KEY_SHARED, SMCKeyData, SmcKeyTypeAlv, sizeof(emptyValue), 0, &emptyValue, AttrRW, luxValue},
+        {KeyALV1, SMC_KEY_SHARED, SMCKeyData, SmcKeyTypeAlv, sizeof(emptyValue), 0, &emptyValue, AttrRW, nullptr},
+        {KeyMSLD, SMC_KEY_SHARED, SMCKeyUint8, 0, 0, 0, nullptr, SMC_KEY_ATTRIBUTE_READ, nullptr},
+    };
+    static_assert(smcKeysSorted(keys), "SMC keys must be sorted");
+
+    smcAddKeys(keys, arrsize(keys), vsmcPlugin.data, this, 0, false);
     
     LOG("Surface Ambient Light Sensor device found!");
+    BootTimeline::end(BootStageALSProbe);
     return this;
 }
 
+VirtualSMCValue *SurfaceAmbientLightSensorDriver::forceBitsValue(void *owner, size_t index) {
+    return &static_cast<SurfaceAmbientLightSensorDriver *>(owner)->forceBits;
+}
+
+VirtualSMCValue *SurfaceAmbientLightSensorDriver::luxValue(void *owner, size_t index) {
+    auto self = static_cast<SurfaceAmbientLightSensorDriver *>(owner);
+    return new SMCAmbientLightValue(&self->current_lux, &self->forceBits);
+}
+
 bool SurfaceAmbientLightSensorDriver::start(IOService *provider) {
+    BootTimeline::begin(BootStageALSStart);
     if (!super::start(provider))
         return false;
 
-    work_loop = getWorkLoop();
+    work_loop = WorkLoopBands::acquire(WorkLoopBandTelemetry);
     if (!work_loop) {
         LOG("Could not get a IOWorkLoop instance");
         return false;
     }
-    work_loop->retain();
     poller = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &SurfaceAmbientLightSensorDriver::pollALI));
     if (!poller) {
         LOG("Could not create timer event source");
         goto exit;
     }
     work_loop->addEventSource(poller);
+    counters = PerfCounterGroup::create(getName(), counter_names, ALSCounterCount);
     
     if (!api->open(this)) {
         LOG("Could not open API");
@@ -80,11 +98,18 @@ bool SurfaceAmbientLightSensorDriver::start(IOService *provider) {
         goto exit;
     }
     
+    if (!PowerOrchestrator::registerDomain(PowerDomainALS, this, OSMemberFunctionCast(PowerOrchestrator::Transition, this, &SurfaceAmbientLightSensorDriver::powerTransition))) {
+        LOG("Failed to register power domain");
+        goto exit;
+    }
+    
     PMinit();
     api->joinPMtree(this);
     registerPowerDriver(this, myIOPMPowerStates, kIOPMNumberPowerStates);
     
+    BootTimeline::begin(BootStageALSSMCSubmit);
     vsmcNotifier = VirtualSMCAPI::registerHandler(vsmcNotificationHandler, this);
+    BootTimeline::end(BootStageALSStart);
     return vsmcNotifier != nullptr;
 exit:
     releaseResources();
@@ -105,7 +130,9 @@ bool SurfaceAmbientLightSensorDriver::vsmcNotificationHandler(void *sensors, voi
         auto ret = vsmc->callPlatformFunction(VirtualSMCAPI::SubmitPlugin, true, sensors, &self->vsmcPlugin, nullptr, nullptr);
         if (ret == kIOReturnSuccess) {
             IOLog("%s::Plugin submitted\n", self->getName());
-            self->poller->setTimeoutMS(POLLING_INTERVAL);
+            BootTimeline::end(BootStageALSSMCSubmit);
+            BootTimeline::begin(BootStageALSFirstSample);
+            TimerCoalescer::setTimeoutMS(self->poller, Tunables::get(BigSurfaceTunableALSPollInterval), POLLING_TOLERANCE);
             return true;
         } else
             IOLog("%s::Plugin submission failure %X\n", self->getName(), ret);
@@ -176,29 +203,46 @@ void SurfaceAmbientLightSensorDriver::pollALI(IOTimerEventSource *timer) {
     UInt16 color[4];
     if (readRegister(APDS9960_CDATAL, reinterpret_cast<UInt8 *>(color), sizeof(color)) != kIOReturnSuccess) {
         LOG("Read from ALS failed!");
-        poller->setTimeoutMS(POLLING_INTERVAL);
+        PERF_COUNT(counters, ALSCounterReadErrors);
+        TimerCoalescer::setTimeoutMS(poller, Tunables::get(BigSurfaceTunableALSPollInterval), POLLING_TOLERANCE);
+        return;
+    }
+    UInt32 lux = apds9960ClearToLux(color[0]);
+    BootTimeline::end(BootStageALSFirstSample);
+    atomic_store_explicit(&current_lux, lux, memory_order_release);
+    TRACEPOINT(TraceALS, TraceALSPoll, color[0], 0);
+    PERF_COUNT(counters, ALSCounterPolls);
+    
+    // SMC readers always see the latest value, only announce changes worth reacting to
+    UInt32 delta = lux > announced_lux ? lux - announced_lux : announced_lux - lux;
+    if (delta < Tunables::get(BigSurfaceTunableALSChangeThreshold)) {
+        TimerCoalescer::setTimeoutMS(poller, Tunables::get(BigSurfaceTunableALSPollInterval), POLLING_TOLERANCE);
         return;
     }
-    atomic_store_explicit(&current_lux, color[0]*1.5, memory_order_release);
+    announced_lux = lux;
     
     VirtualSMCAPI::postInterrupt(SmcEventALSChange);
     
     OSObject *result;
     OSObject *params[] = {
-        OSNumber::withNumber(current_lux, 32),
+        OSNumber::withNumber(lux, 32),
     };
     alsd_device->evaluateObject("XALI", &result, params, 1);
     OSSafeReleaseNULL(result);
     params[0]->release();
     
 //    LOG("Value: ALI=%04d", current_lux);
-    poller->setTimeoutMS(POLLING_INTERVAL);
+    TimerCoalescer::setTimeoutMS(poller, Tunables::get(BigSurfaceTunableALSPollInterval), POLLING_TOLERANCE);
 }
 
 IOReturn SurfaceAmbientLightSensorDriver::setPowerState(unsigned long whichState, IOService *whatDevice) {
     if (whatDevice != this)
         return kIOReturnInvalid;
-    if (whichState == 0) {
+    return PowerOrchestrator::scheduleTransition(PowerDomainALS, whichState != 0);
+}
+
+void SurfaceAmbientLightSensorDriver::powerTransition(bool wake) {
+    if (!wake) {
         if (awake) {
             poller->cancelTimeout();
             poller->disable();
@@ -211,21 +255,25 @@ IOReturn SurfaceAmbientLightSensorDriver::setPowerState(unsigned long whichState
             awake = true;
             initDevice();
             poller->enable();
-            poller->setTimeoutMS(POLLING_INTERVAL);
+            TimerCoalescer::setTimeoutMS(poller, Tunables::get(BigSurfaceTunableALSPollInterval), POLLING_TOLERANCE);
             DBG_LOG("Woke up");
         }
     }
-    return kIOPMAckImplied;
 }
 
 void SurfaceAmbientLightSensorDriver::releaseResources() {
+    PowerOrchestrator::unregisterDomain(PowerDomainALS, this);
     if (poller) {
         poller->cancelTimeout();
         poller->disable();
         work_loop->removeEventSource(poller);
         OSSafeReleaseNULL(poller);
     }
-    OSSafeReleaseNULL(work_loop);
+    WorkLoopBands::release(WorkLoopBandTelemetry, work_loop);
+    if (counters) {
+        PerfCounterGroup::destroy(counters);
+        counters = nullptr;
+    }
 
     if (api) {
         if (api->isOpen(this)) {
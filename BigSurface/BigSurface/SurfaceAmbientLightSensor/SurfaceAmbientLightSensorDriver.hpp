@@ -19,8 +19,20 @@
 
 #include "AmbientLightValue.hpp"
 #include "APDS9960Constants.h"
+#include "../BigSurfaceDiagnostics/PerfCounters.hpp"
+#include "../PowerOrchestrator.hpp"
+#include "../WorkLoopBands.hpp"
+#include "../TimerCoalescer.hpp"
+#include "../SMCKeyTable.hpp"
+#include "../Tunables.hpp"
 
-#define POLLING_INTERVAL 1000
+#define POLLING_TOLERANCE 250
+
+enum ALSCounter {
+    ALSCounterPolls = 0,
+    ALSCounterReadErrors,
+    ALSCounterCount,
+};
 
 class EXPORT SurfaceAmbientLightSensorDriver : public IOService {
     OSDeclareDefaultStructors(SurfaceAmbientLightSensorDriver);
@@ -41,10 +53,12 @@ private:
     VoodooI2CDeviceNub*     api {nullptr};
     IOWorkLoop*             work_loop {nullptr};
     IOTimerEventSource*     poller {nullptr};
+    PerfCounterGroup*       counters {nullptr};
     
     bool awake {true};
     
     _Atomic(UInt32) current_lux;
+    UInt32 announced_lux {0};
     IONotifier *vsmcNotifier {nullptr};
     static constexpr SMC_KEY KeyAL   = SMC_MAKE_IDENTIFIER('A','L','!',' ');
     static constexpr SMC_KEY KeyALI0 = SMC_MAKE_IDENTIFIER('A','L','I','0');
@@ -84,6 +98,12 @@ private:
     
     void releaseResources();
     
+    void powerTransition(bool wake);
+    
+    static VirtualSMCValue *forceBitsValue(void *owner, size_t index);
+    
+    static VirtualSMCValue *luxValue(void *owner, size_t index);
+    
     inline IOReturn readRegister(UInt8 reg, UInt8* values, size_t len);
     
     inline IOReturn writeRegister(UInt8 reg, UInt8 cmd);
@@ -0,0 +1,164 @@
+//
+//  BatteryHistory.cpp
+//  SurfaceBattery
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <IOKit/IOLib.h>
+#include <libkern/OSAtomic.h>
+#include <Headers/kern_util.hpp>
+
+#include "BatteryHistory.hpp"
+
+static constexpr UInt32 HistoryMask = BATTERY_HISTORY_DEPTH - 1;
+static constexpr UInt64 WindowSeconds[BatteryHistoryWindowCount] = {60, 600, 3600};
+
+bool BatteryHistory::init(UInt8 batteryCount) {
+	memory = IOBufferMemoryDescriptor::withOptions(kIODirectionInOut | kIOMemoryKernelUserShared, sizeof(BatteryHistoryBuffer), PAGE_SIZE);
+	if (!memory) {
+		IOLog("BatteryHistory::Failed to allocate history buffer\n");
+		return false;
+	}
+	buffer = static_cast<BatteryHistoryBuffer *>(memory->getBytesNoCopy());
+	bzero(buffer, sizeof(BatteryHistoryBuffer));
+	buffer->hdr.version = BATTERY_HISTORY_VERSION;
+	buffer->hdr.batteryCount = batteryCount;
+	buffer->hdr.depth = BATTERY_HISTORY_DEPTH;
+	buffer->hdr.sampleSize = sizeof(BatteryHistorySample);
+
+	for (int w = 0; w < BatteryHistoryWindowCount; w++)
+		nanoseconds_to_absolutetime(WindowSeconds[w] * 1000000000ULL, &windowLength[w]);
+	return true;
+}
+
+IOMemoryDescriptor *BatteryHistory::copyBuffer() {
+	if (memory)
+		memory->retain();
+	return memory;
+}
+
+UInt32 BatteryHistory::temperatureBucket(UInt16 temperature) {
+	if (temperature < BATTERY_HISTORY_TEMP_MIN)
+		return 0;
+	UInt32 bucket = (temperature - BATTERY_HISTORY_TEMP_MIN) / BATTERY_HISTORY_TEMP_STEP;
+	return bucket < BATTERY_HISTORY_TEMP_BUCKETS ? bucket : BATTERY_HISTORY_TEMP_BUCKETS - 1;
+}
+
+void BatteryHistory::record(UInt8 index, const BatteryInfo::State &state) {
+	if (!buffer || index >= BatteryManagerState::MaxBatteriesSupported || !state.lastUpdateTime)
+		return;
+
+	BatteryHistoryRing *ring = &buffer->rings[index];
+	Accumulator *acc = &accumulators[index];
+	UInt32 head = ring->head;
+	BatteryHistorySample sample {};
+	sample.timestamp = state.lastUpdateTime;
+	if (head) {
+		const BatteryHistorySample &prev = ring->samples[(head - 1) & HistoryMask];
+		// the update was rejected and the state left untouched
+		if (sample.timestamp <= prev.timestamp)
+			return;
+		UInt64 nsecs;
+		absolutetime_to_nanoseconds(sample.timestamp - prev.timestamp, &nsecs);
+		sample.interval = static_cast<UInt32>(nsecs / 1000000);
+	}
+	sample.remainingCapacity = state.remainingCapacity;
+	sample.presentVoltage = state.presentVoltage;
+	sample.signedPresentRate = state.signedPresentRate;
+	sample.temperature = state.temperatureDecikelvin;
+	sample.state = static_cast<UInt16>(state.state);
+
+	UInt32 seq = ring->seq;
+	ring->seq = seq + 1;
+	OSMemoryBarrier();
+
+	// the slot about to be reused leaves every window first
+	for (int w = 0; w < BatteryHistoryWindowCount; w++)
+		while (head - acc->tail[w] >= BATTERY_HISTORY_DEPTH)
+			evict(ring, acc, w);
+
+	ring->samples[head & HistoryMask] = sample;
+	ring->head = head + 1;
+
+	for (int w = 0; w < BatteryHistoryWindowCount; w++) {
+		acc->rateSum[w] += static_cast<SInt64>(sample.signedPresentRate) * sample.interval;
+		acc->spanSum[w] += sample.interval;
+	}
+	acc->temperatures[temperatureBucket(sample.temperature)]++;
+	if (acc->tail[BatteryHistoryHour] == head) {
+		ring->stats.minVoltage = sample.presentVoltage;
+		ring->stats.maxVoltage = sample.presentVoltage;
+	} else {
+		ring->stats.minVoltage = min(ring->stats.minVoltage, sample.presentVoltage);
+		ring->stats.maxVoltage = max(ring->stats.maxVoltage, sample.presentVoltage);
+	}
+
+	for (int w = 0; w < BatteryHistoryWindowCount; w++) {
+		if (sample.timestamp <= windowLength[w])
+			continue;
+		UInt64 limit = sample.timestamp - windowLength[w];
+		while (acc->tail[w] < head && ring->samples[acc->tail[w] & HistoryMask].timestamp < limit)
+			evict(ring, acc, w);
+	}
+
+	updateStats(ring, acc);
+
+	OSMemoryBarrier();
+	ring->seq = seq + 2;
+}
+
+void BatteryHistory::evict(BatteryHistoryRing *ring, Accumulator *acc, int window) {
+	UInt32 tail = acc->tail[window];
+	const BatteryHistorySample &oldest = ring->samples[tail & HistoryMask];
+	const BatteryHistorySample &next = ring->samples[(tail + 1) & HistoryMask];
+
+	// the interval up to the next sample is no longer covered
+	acc->rateSum[window] -= static_cast<SInt64>(next.signedPresentRate) * next.interval;
+	acc->spanSum[window] -= next.interval;
+
+	if (window == BatteryHistoryHour) {
+		acc->temperatures[temperatureBucket(oldest.temperature)]--;
+		if (oldest.presentVoltage == ring->stats.minVoltage || oldest.presentVoltage == ring->stats.maxVoltage)
+			acc->rescanVoltage = true;
+	}
+	acc->tail[window] = tail + 1;
+}
+
+void BatteryHistory::updateStats(BatteryHistoryRing *ring, Accumulator *acc) {
+	BatteryHistoryStats *stats = &ring->stats;
+	UInt32 head = ring->head;
+	const BatteryHistorySample &newest = ring->samples[(head - 1) & HistoryMask];
+
+	for (int w = 0; w < BatteryHistoryWindowCount; w++) {
+		BatteryHistoryRate *rate = &stats->rates[w];
+		const BatteryHistorySample &oldest = ring->samples[acc->tail[w] & HistoryMask];
+		rate->span = static_cast<UInt32>(acc->spanSum[w]);
+		rate->samples = head - acc->tail[w];
+		rate->meanRate = acc->spanSum[w] ? static_cast<SInt32>(acc->rateSum[w] / static_cast<SInt64>(acc->spanSum[w])) : newest.signedPresentRate;
+		rate->capacityDelta = static_cast<SInt32>(newest.remainingCapacity - oldest.remainingCapacity);
+	}
+
+	// only when an extreme left the window, otherwise min and max were kept up to date on insert
+	if (acc->rescanVoltage) {
+		UInt32 tail = acc->tail[BatteryHistoryHour];
+		stats->minVoltage = stats->maxVoltage = ring->samples[tail & HistoryMask].presentVoltage;
+		for (UInt32 i = tail + 1; i != head; i++) {
+			UInt32 voltage = ring->samples[i & HistoryMask].presentVoltage;
+			stats->minVoltage = min(stats->minVoltage, voltage);
+			stats->maxVoltage = max(stats->maxVoltage, voltage);
+		}
+		acc->rescanVoltage = false;
+	}
+
+	UInt32 total = head - acc->tail[BatteryHistoryHour];
+	UInt32 count = 0;
+	UInt16 *percentiles[] = {&stats->temperatureP50, &stats->temperatureP90, &stats->temperatureP99};
+	static constexpr UInt32 ranks[] = {50, 90, 99};
+	size_t p = 0;
+	for (UInt32 bucket = 0; bucket < BATTERY_HISTORY_TEMP_BUCKETS && p < arrsize(ranks); bucket++) {
+		count += acc->temperatures[bucket];
+		while (p < arrsize(ranks) && count * 100 >= total * ranks[p])
+			*percentiles[p++] = BATTERY_HISTORY_TEMP_MIN + bucket * BATTERY_HISTORY_TEMP_STEP + BATTERY_HISTORY_TEMP_STEP / 2;
+	}
+}
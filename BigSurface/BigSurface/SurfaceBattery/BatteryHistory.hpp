@@ -0,0 +1,126 @@
+//
+//  BatteryHistory.hpp
+//  SurfaceBattery
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef BatteryHistory_hpp
+#define BatteryHistory_hpp
+
+#include <IOKit/IOBufferMemoryDescriptor.h>
+
+#include "BatteryManagerState.hpp"
+
+/*
+ * Every accepted battery status update is appended to a per battery ring
+ * together with rolling statistics over the last minute, ten minutes and
+ * hour, updated incrementally as samples enter and leave each window. The
+ * whole buffer is mapped read only into user space, a ring is consistent
+ * when its seq is even and did not change while it was copied.
+ */
+#define BATTERY_HISTORY_VERSION     1
+#define BATTERY_HISTORY_DEPTH       512     // samples per battery, power of 2
+#define BATTERY_HISTORY_TEMP_MIN    2731    // 0.1 K, lowest temperature bucket
+#define BATTERY_HISTORY_TEMP_STEP   10      // 0.1 K per temperature bucket
+#define BATTERY_HISTORY_TEMP_BUCKETS    64
+
+enum BatteryHistoryWindow {
+	BatteryHistoryMinute = 0,
+	BatteryHistoryTenMinutes,
+	BatteryHistoryHour,
+	BatteryHistoryWindowCount,
+};
+
+struct BatteryHistorySample {
+	UInt64	timestamp;				// mach absolute time
+	UInt32	interval;				// ms since the previous sample, 0 for the first one
+	UInt32	remainingCapacity;		// mAh
+	UInt32	presentVoltage;			// mV
+	SInt32	signedPresentRate;		// mA, negative while discharging
+	UInt16	temperature;			// 0.1 K
+	UInt16	state;					// BST state
+	UInt32	reserved;				// always 0, keeps the tail padding from reaching user space
+};
+
+struct BatteryHistoryRate {
+	UInt32	span;					// ms between the oldest and newest sample in the window
+	UInt32	samples;
+	SInt32	meanRate;				// mA, time weighted
+	SInt32	capacityDelta;			// mAh, newest minus oldest sample
+};
+
+struct BatteryHistoryStats {
+	BatteryHistoryRate	rates[BatteryHistoryWindowCount];
+	// the rest covers the last hour
+	UInt32	minVoltage;				// mV
+	UInt32	maxVoltage;				// mV
+	UInt16	temperatureP50;			// 0.1 K, centre of the bucket
+	UInt16	temperatureP90;
+	UInt16	temperatureP99;
+	UInt16	reserved;
+};
+
+struct BatteryHistoryRing {
+	volatile UInt32		seq;		// odd while the ring is being written
+	UInt32				head;		// total samples recorded
+	UInt32				reserved[14];
+	BatteryHistoryStats	stats;
+	BatteryHistorySample	samples[BATTERY_HISTORY_DEPTH];
+};
+
+struct BatteryHistoryHeader {
+	UInt32	version;
+	UInt32	batteryCount;
+	UInt32	depth;
+	UInt32	sampleSize;
+	UInt32	reserved[12];
+};
+
+struct BatteryHistoryBuffer {
+	BatteryHistoryHeader	hdr;
+	BatteryHistoryRing		rings[BatteryManagerState::MaxBatteriesSupported];
+};
+
+class BatteryHistory {
+public:
+	bool init(UInt8 batteryCount);
+
+	/**
+	 *  Append a status update, callers serialise per battery
+	 *
+	 *  @param index  battery index
+	 *  @param state  state after the update
+	 */
+	void record(UInt8 index, const BatteryInfo::State &state);
+
+	/**
+	 *  @return the shared buffer retained, nullptr if allocation failed
+	 */
+	IOMemoryDescriptor *copyBuffer();
+
+private:
+	/**
+	 *  Running sums behind the published statistics, kernel only
+	 */
+	struct Accumulator {
+		UInt32	tail[BatteryHistoryWindowCount] {};
+		SInt64	rateSum[BatteryHistoryWindowCount] {};		// mA * ms
+		UInt64	spanSum[BatteryHistoryWindowCount] {};		// ms
+		UInt32	temperatures[BATTERY_HISTORY_TEMP_BUCKETS] {};
+		bool	rescanVoltage {false};
+	};
+
+	IOBufferMemoryDescriptor *memory {nullptr};
+	BatteryHistoryBuffer *buffer {nullptr};
+	Accumulator accumulators[BatteryManagerState::MaxBatteriesSupported] {};
+	UInt64 windowLength[BatteryHistoryWindowCount] {};		// mach absolute time
+
+	static UInt32 temperatureBucket(UInt16 temperature);
+
+	void evict(BatteryHistoryRing *ring, Accumulator *acc, int window);
+
+	void updateStats(BatteryHistoryRing *ring, Accumulator *acc);
+};
+
+#endif /* BatteryHistory_hpp */
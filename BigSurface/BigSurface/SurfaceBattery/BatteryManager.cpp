@@ -41,6 +41,21 @@ void BatteryInfo::validateData(SInt32 id) {
     IOLog("BatteryInfo::battery %d cycle count %u remaining capacity %u\n", id, cycle, state.lastFullChargeCapacity);
 }
 
+UInt16 BatteryIdentity::parseManufactureDate(const char *serial) {
+	const char *p = serial;
+	int year = 2016, month = 02, day = 29;
+	while ((p = strstr(p, "20")) != nullptr) { // hope that this code will not survive until 22nd century
+		if (sscanf(p, "%04d%02d%02d", &year, &month, &day) == 3 || 		// YYYYMMDD (Lenovo)
+			sscanf(p, "%04d/%02d/%02d", &year, &month, &day) == 3) {	// YYYY/MM/DD (HP)
+			if (1 <= month && month <= 12 && 1 <= day && day <= 31)
+				return makeBatteryDate(day, month, year);
+		}
+		p++;
+	}
+	// in case we parsed a non-date
+	return makeBatteryDate(29, 02, 2016);
+}
+
 bool BatteryManager::needUpdateBIX(UInt8 index) {
     if (!index or index > batteryCount)
         return false;
@@ -72,9 +87,46 @@ void BatteryManager::updateBatteryInfoExtended(UInt8 index, OSArray *bix) {
         batteries[index].reset();
     else
         batteries[index].updateInfoExtended(bix);
+    publishIdentity(index);
     IOLockUnlock(mainLock);
 }
 
+void BatteryManager::publishIdentity(UInt8 index) {
+	BatteryIdentity identity;
+
+	IOSimpleLockLock(stateLock);
+	const BatteryInfo &info = state.btInfo[index];
+	identity.manufactureDate = info.manufactureDate;
+	memcpy(identity.deviceName, info.deviceName, sizeof(identity.deviceName));
+	memcpy(identity.serial, info.serial, sizeof(identity.serial));
+	memcpy(identity.manufacturer, info.manufacturer, sizeof(identity.manufacturer));
+	IOSimpleLockUnlock(stateLock);
+
+	identity.serial[BatteryInfo::MaxStringLen - 1] = '\0';
+	if (!identity.manufactureDate)
+		identity.manufactureDate = BatteryIdentity::parseManufactureDate(identity.serial);
+
+	// BIX is refreshed periodically but rarely changes, keep readers undisturbed
+	if (!memcmp(&identities[index], &identity, sizeof(BatteryIdentity)))
+		return;
+
+	UInt32 seq = atomic_load_explicit(&identitySeq[index], memory_order_relaxed);
+	atomic_store_explicit(&identitySeq[index], seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	identities[index] = identity;
+	atomic_store_explicit(&identitySeq[index], seq + 2, memory_order_release);
+}
+
+void BatteryManager::copyIdentity(UInt8 index, BatteryIdentity *identity) {
+	UInt32 begin, end;
+	do {
+		begin = atomic_load_explicit(&identitySeq[index], memory_order_acquire);
+		*identity = identities[index];
+		atomic_thread_fence(memory_order_acquire);
+		end = atomic_load_explicit(&identitySeq[index], memory_order_relaxed);
+	} while ((begin & 1) || begin != end);
+}
+
 bool BatteryManager::updateBatteryStatus(UInt8 index, UInt32 *bst) {
     if (!index or index > batteryCount)
         return false;
@@ -83,6 +135,11 @@ bool BatteryManager::updateBatteryStatus(UInt8 index, UInt32 *bst) {
     bool is_full;
     IOLockLock(mainLock);
     is_full = batteries[index].updateStatus(bst);
+    IOSimpleLockLock(stateLock);
+    BatteryInfo::State st = state.btInfo[index].state;
+    IOSimpleLockUnlock(stateLock);
+    if (!st.bogus)
+        history.record(index, st);
     IOLockUnlock(mainLock);
     return is_full;
 }
@@ -180,6 +237,10 @@ UInt16 BatteryManager::calculateBatteryStatus(UInt8 index) {
 	return batteries[index].calculateBatteryStatus();
 }
 
+static const char *counter_names[BatteryCounterCount] = {
+	"SMCReads", "SMBusRequests", "SMBusRefreshes", "BSTUpdates", "BIXUpdates", "SSHFailures",
+};
+
 void BatteryManager::createShared(UInt8 bat_cnt, UInt8 adp_cnt) {
 	if (instance)
 		PANIC("BatteryManager", "attempted to allocate battery manager again");
@@ -192,6 +253,7 @@ void BatteryManager::createShared(UInt8 bat_cnt, UInt8 adp_cnt) {
 	instance->stateLock = IOSimpleLockAlloc();
 	if (!instance->stateLock)
 		PANIC("BatteryManager", "failed to allocate state battery manager lock");
+	instance->counters = PerfCounterGroup::create("BatteryManager", counter_names, BatteryCounterCount);
     
 	atomic_init(&instance->handlerTarget, nullptr);
 	atomic_init(&instance->handler, nullptr);
@@ -220,6 +282,9 @@ void BatteryManager::createShared(UInt8 bat_cnt, UInt8 adp_cnt) {
             instance->batteries[i] = SurfaceBattery(nullptr, i, instance->stateLock, &instance->state.btInfo[i]);
     }
     instance->batteryCount = bat_cnt;
+    instance->history.init(bat_cnt);
+    for (UInt8 i=0; i<bat_cnt; i++)
+        instance->publishIdentity(i);
     
     dict = IOService::nameMatching("ACPI0003");
     deviceIterator = nullptr;
@@ -14,10 +14,23 @@
 #include "SurfaceBattery.hpp"
 #include "SurfaceACAdapter.hpp"
 #include "BatteryManagerState.hpp"
+#include "BatteryHistory.hpp"
 #include <IOKit/pwr_mgt/RootDomain.h>
 #include <Headers/kern_util.hpp>
 #include <stdatomic.h>
 
+#include "../BigSurfaceDiagnostics/PerfCounters.hpp"
+
+enum BatteryCounter {
+	BatteryCounterSMCReads = 0,
+	BatteryCounterSMBusRequests,
+	BatteryCounterSMBusRefreshes,
+	BatteryCounterBSTUpdates,
+	BatteryCounterBIXUpdates,
+	BatteryCounterSSHFailures,
+	BatteryCounterCount,
+};
+
 class EXPORT BatteryManager : public OSObject {
 	OSDeclareDefaultStructors(BatteryManager)
     friend class SurfaceBatteryDriver;
@@ -71,9 +84,33 @@ public:
 	 *  @return calculated value
 	 */
 	UInt16 calculateBatteryStatus(UInt8 index);
+
+	/**
+	 *  Copy battery identity without taking any lock
+	 *
+	 *  @param  index battery index
+	 *  @param  identity copy destination
+	 */
+	void copyIdentity(UInt8 index, BatteryIdentity *identity);
+
+	/**
+	 *  @return status history shared with user space retained, may be nullptr
+	 */
+	IOMemoryDescriptor *copyHistoryBuffer() {
+		return history.copyBuffer();
+	}
     
     AbsoluteTime lastAccess {0};
 
+	/**
+	 *  Performance counters, lives as long as the shared instance
+	 */
+	PerfCounterGroup *counters {nullptr};
+
+	void count(BatteryCounter idx) {
+		PERF_COUNT(counters, idx);
+	}
+
 private:
 	/**
 	 *  The only allowed battery manager instance
@@ -93,6 +130,21 @@ private:
 
 	SurfaceACAdapter adapters[BatteryManagerState::MaxAcAdaptersSupported] {};
 
+	/**
+	 *  Battery identities, written under mainLock and read through identitySeq
+	 */
+	BatteryIdentity identities[BatteryManagerState::MaxBatteriesSupported] {};
+
+	/**
+	 *  Odd while the matching identity is being rewritten
+	 */
+	_Atomic(UInt32) identitySeq[BatteryManagerState::MaxBatteriesSupported] {};
+
+	/**
+	 *  Accepted status updates, written under mainLock
+	 */
+	BatteryHistory history {};
+
 	/**
 	 *  A lock to permit concurrent access
 	 */
@@ -127,6 +179,11 @@ private:
     bool updateAdapterStatus(UInt8 index, UInt32 psr);
     
     bool needUpdateBIX(UInt8 index);
+
+	/**
+	 *  Rebuild battery identity from the latest BIX, called with mainLock held
+	 */
+	void publishIdentity(UInt8 index);
 };
 
 #endif /* BatteryManagerBase_hpp */
@@ -8,6 +8,8 @@
 #ifndef BatteryManagerState_hpp
 #define BatteryManagerState_hpp
 
+#include "../CoreTypes.h"
+
 /**
  *  Aggregated battery information
  */
@@ -106,6 +108,40 @@ struct BatteryInfo {
 	void validateData(SInt32 id=-1);
 };
 
+/**
+ *  Battery identity served to AppleSmartBattery
+ *  Rebuilt only when BIX changes, so string and date commands need neither
+ *  the state lock nor parsing on every poll.
+ */
+struct BatteryIdentity {
+	/**
+	 *  Create battery date in AppleSmartBattery format
+	 *
+	 *  @param day     manufacturing date
+	 *  @param month   manufacturing month
+	 *  @param year    manufacturing year
+	 *
+	 *  @return date in AppleSmartBattery format
+	 */
+	static constexpr UInt16 makeBatteryDate(UInt16 day, UInt16 month, UInt16 year) {
+		return (day & 0x1FU) | ((month & 0xFU) << 5U) | (((year - 1980U) & 0x7FU) << 9U);
+	}
+
+	/**
+	 *  Find a manufacturing date embedded in the serial number
+	 *
+	 *  @param serial  battery serial number
+	 *
+	 *  @return date in AppleSmartBattery format, 2016/02/29 if none is found
+	 */
+	static UInt16 parseManufactureDate(const char *serial);
+
+	UInt16 manufactureDate {0};
+	char deviceName[BatteryInfo::MaxStringLen] {};
+	char serial[BatteryInfo::MaxStringLen] {};
+	char manufacturer[BatteryInfo::MaxStringLen] {};
+};
+
 /**
  *  Aggregated adapter information
  */
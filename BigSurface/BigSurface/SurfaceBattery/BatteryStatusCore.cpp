@@ -0,0 +1,85 @@
+//
+//  BatteryStatusCore.cpp
+//  SurfaceBattery
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include "BatteryStatusCore.hpp"
+
+void BatteryStatusCore::applyStatus(BatteryInfo::State &st, const UInt32 *bst, UInt32 elapsedMs) {
+	UInt32 defaultRate = 5000*1000 / st.designVoltage;  // 5w
+	st.state = bst[BSTState];
+	st.presentRate = bst[BSTPresentRate];
+	st.remainingCapacity = bst[BSTRemainingCapacity];
+	st.presentVoltage = bst[BSTPresentVoltage];
+	if (st.powerUnitIsWatt) {
+		st.presentRate = st.presentRate * 1000 / st.designVoltage;
+		st.remainingCapacity = st.remainingCapacity * 1000 / st.designVoltage;
+	}
+
+	// Sometimes this value can be either reported incorrectly or miscalculated
+	// and exceed the actual capacity. Simply workaround it by capping the value.
+	// REF: https://github.com/acidanthera/bugtracker/issues/565
+	if (st.remainingCapacity > st.lastFullChargeCapacity)
+		st.remainingCapacity = st.lastFullChargeCapacity;
+
+	if (!st.averageRate)
+		st.averageRate = st.presentRate;
+	else	// We will take a 1 minutes window
+		st.averageRate = (60000*st.averageRate + elapsedMs*st.presentRate)/(60000+elapsedMs);
+
+	// Remaining capacity
+	st.averageTimeToEmpty = st.averageRate ? 60 * st.remainingCapacity / st.averageRate : 60 * st.remainingCapacity / defaultRate;
+	st.runTimeToEmpty = st.presentRate ? 60 * st.remainingCapacity / st.presentRate : 60 * st.remainingCapacity / defaultRate;
+
+	// Check battery state
+	bool bogus = false;
+	switch (st.state & BSTStateMask) {
+		case BSTNotCharging: {
+			st.calculatedACAdapterConnected = true;
+			st.batteryIsFull = true;
+			st.chargingCurrent = 0;
+			st.timeToFull = 0;
+			st.signedPresentRate = st.presentRate;
+			st.signedAverageRate = st.averageRate;
+			break;
+		}
+		case BSTDischarging: {
+			st.calculatedACAdapterConnected = false;
+			st.batteryIsFull = false;
+			st.chargingCurrent = 0;
+			st.timeToFull = 0;
+			st.signedPresentRate = -st.presentRate;
+			st.signedAverageRate = -st.averageRate;
+			break;
+		}
+		case BSTCharging: {
+			st.calculatedACAdapterConnected = true;
+			st.batteryIsFull = false;
+			int diff = st.lastFullChargeCapacity - st.remainingCapacity;
+			st.timeToFull = st.averageRate ? 60 * diff / st.averageRate : 60 * diff / defaultRate;
+			st.signedPresentRate = st.presentRate;
+			st.signedAverageRate = st.averageRate;
+			break;
+		}
+		default: {
+			st.batteryIsFull = false;
+			bogus = true;
+			break;
+		}
+	}
+
+	st.lastRemainingCapacity = st.remainingCapacity;
+
+	// bool warning  = st.remainingCapacity <= st.designCapacityWarning || st.runTimeToEmpty < 10;
+	bool critical = st.remainingCapacity <= st.designCapacityLow || st.runTimeToEmpty < 5;
+	if (st.state & BSTCritical)
+		critical = true;
+
+	// When we report battery failure, AppleSmartBatteryManager sets isCharging=false.
+	// So we don't report battery failure when it's charging.
+	st.bad = (st.state & BSTStateMask) != BSTCharging && st.lastFullChargeCapacity < 2 * st.designCapacityWarning;
+	st.bogus = bogus;
+	st.critical = critical;
+}
@@ -0,0 +1,54 @@
+//
+//  BatteryStatusCore.hpp
+//  SurfaceBattery
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef BatteryStatusCore_hpp
+#define BatteryStatusCore_hpp
+
+#include "BatteryManagerState.hpp"
+
+/**
+ *  _BST interpretation, free of IOKit and locking
+ */
+struct BatteryStatusCore {
+	/**
+	 *  Battery status obtained from ACPI _BST
+	 */
+	enum {
+		/**
+		 Means that the battery is not charging and not discharging.
+		 It may happen when the battery is fully charged,
+		 or when AC adapter is connected but charging has not started yet,
+		 or when charging is limited to some percent in BIOS settings.
+		 */
+		BSTNotCharging  = 0,
+		BSTDischarging  = 1 << 0,
+		BSTCharging     = 1 << 1,
+		BSTCritical     = 1 << 2,
+		BSTStateMask    = BSTNotCharging | BSTDischarging | BSTCharging,
+	};
+
+	/**
+	 *  Battery Real-time Information pack layout
+	 */
+	enum {
+		BSTState,
+		BSTPresentRate,
+		BSTRemainingCapacity,
+		BSTPresentVoltage
+	};
+
+	/**
+	 *  Fold a _BST package into the battery state
+	 *
+	 *  @param st         state holding the latest BIX values, updated in place
+	 *  @param bst        _BST package
+	 *  @param elapsedMs  time since the previous update, weights the average rate
+	 */
+	static void applyStatus(BatteryInfo::State &st, const UInt32 *bst, UInt32 elapsedMs);
+};
+
+#endif /* BatteryStatusCore_hpp */
@@ -9,6 +9,7 @@
 #include "SurfaceBatteryDriver.hpp"
 
 SMC_RESULT ACID::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	IOSimpleLockLock(BatteryManager::getShared()->stateLock);
 	auto extConnected = BatteryManager::getShared()->externalPowerConnected();
 	IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
@@ -30,6 +31,7 @@ SMC_RESULT ACID::readAccess() {
 }
 
 SMC_RESULT ACIN::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	bool *ptr = reinterpret_cast<bool *>(data);
 	IOSimpleLockLock(BatteryManager::getShared()->stateLock);
 	*ptr = BatteryManager::getShared()->externalPowerConnected();
@@ -38,11 +40,13 @@ SMC_RESULT ACIN::readAccess() {
 }
 
 SMC_RESULT AC_N::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	data[0] = BatteryManager::getShared()->adapterCount;
 	return SmcSuccess;
 }
 
 SMC_RESULT B0AC::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	SInt16 *ptr = reinterpret_cast<SInt16 *>(data);
 	IOSimpleLockLock(BatteryManager::getShared()->stateLock);
 	*ptr = OSSwapHostToBigInt16(BatteryManager::getShared()->state.btInfo[index].state.signedPresentRate);
@@ -51,6 +55,7 @@ SMC_RESULT B0AC::readAccess() {
 }
 
 SMC_RESULT B0AV::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	UInt16 *ptr = reinterpret_cast<UInt16 *>(data);
 	IOSimpleLockLock(BatteryManager::getShared()->stateLock);
 	*ptr = OSSwapHostToBigInt16(BatteryManager::getShared()->state.btInfo[index].state.presentVoltage);
@@ -59,6 +64,7 @@ SMC_RESULT B0AV::readAccess() {
 }
 
 SMC_RESULT B0BI::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	IOSimpleLockLock(BatteryManager::getShared()->stateLock);
 	data[0] = BatteryManager::getShared()->state.btInfo[index].connected;
 	IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
@@ -66,6 +72,7 @@ SMC_RESULT B0BI::readAccess() {
 }
 
 SMC_RESULT B0CT::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	UInt16 *ptr = reinterpret_cast<UInt16 *>(data);
 	IOSimpleLockLock(BatteryManager::getShared()->stateLock);
 	*ptr = OSSwapHostToBigInt16(BatteryManager::getShared()->state.btInfo[index].cycle);
@@ -75,6 +82,7 @@ SMC_RESULT B0CT::readAccess() {
 
 
 SMC_RESULT B0FC::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	UInt16 *ptr = reinterpret_cast<UInt16 *>(data);
 	IOSimpleLockLock(BatteryManager::getShared()->stateLock);
 	*ptr = OSSwapHostToBigInt16(BatteryManager::getShared()->state.btInfo[index].state.lastFullChargeCapacity);
@@ -83,12 +91,14 @@ SMC_RESULT B0FC::readAccess() {
 }
 
 SMC_RESULT B0PS::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	//TODO: find what is its value when battery is the active power source
 	data[0] = data[1] = 0;
 	return SmcSuccess;
 }
 
 SMC_RESULT B0RM::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	UInt16 *ptr = reinterpret_cast<UInt16 *>(data);
 	IOSimpleLockLock(BatteryManager::getShared()->stateLock);
 	*ptr = OSSwapHostToBigInt16(BatteryManager::getShared()->state.btInfo[index].state.remainingCapacity);
@@ -97,6 +107,7 @@ SMC_RESULT B0RM::readAccess() {
 }
 
 SMC_RESULT B0St::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	UInt16 *ptr = reinterpret_cast<UInt16 *>(data);
 	IOSimpleLockLock(BatteryManager::getShared()->stateLock);
 	*ptr = OSSwapHostToBigInt16(BatteryManager::getShared()->calculateBatteryStatus(index));
@@ -105,6 +116,7 @@ SMC_RESULT B0St::readAccess() {
 }
 
 SMC_RESULT B0TF::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	UInt16 *ptr = reinterpret_cast<UInt16 *>(data);
 	IOSimpleLockLock(BatteryManager::getShared()->stateLock);
 	auto state = BatteryManager::getShared()->state.btInfo[index].state.state & SurfaceBattery::BSTStateMask;
@@ -117,6 +129,7 @@ SMC_RESULT B0TF::readAccess() {
 }
 
 SMC_RESULT BATP::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	bool *ptr = reinterpret_cast<bool *>(data);
 	IOSimpleLockLock(BatteryManager::getShared()->stateLock);
 	*ptr = BatteryManager::getShared()->externalPowerConnected() == false;
@@ -125,6 +138,7 @@ SMC_RESULT BATP::readAccess() {
 }
 
 SMC_RESULT BBAD::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	// TODO: what's with multiple batteries?
 	bool *ptr = reinterpret_cast<bool *>(data);
 	IOSimpleLockLock(BatteryManager::getShared()->stateLock);
@@ -134,6 +148,7 @@ SMC_RESULT BBAD::readAccess() {
 }
 
 SMC_RESULT BBIN::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	bool *ptr = reinterpret_cast<bool *>(data);
 	IOSimpleLockLock(BatteryManager::getShared()->stateLock);
 	*ptr = BatteryManager::getShared()->batteriesConnected();
@@ -142,17 +157,20 @@ SMC_RESULT BBIN::readAccess() {
 }
 
 SMC_RESULT BFCL::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	//TODO: implement this
 	data[0] = 100;
 	return SmcSuccess;
 }
 
 SMC_RESULT BNum::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	data[0] = BatteryManager::getShared()->batteryCount;
 	return SmcSuccess;
 }
 
 SMC_RESULT BSIn::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	enum {
 		BSInCharging          = 1,
 		BSInACPresent         = 2,
@@ -176,6 +194,7 @@ SMC_RESULT BSIn::readAccess() {
 }
 
 SMC_RESULT BRSC::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	// TODO: what's with multiple batteries?
 	data[0] = 0;
 	IOSimpleLockLock(BatteryManager::getShared()->stateLock);
@@ -195,6 +214,7 @@ SMC_RESULT BRSC::readAccess() {
 }
 
 SMC_RESULT CHBI::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	UInt16 *ptr = reinterpret_cast<UInt16 *>(data);
 	IOSimpleLockLock(BatteryManager::getShared()->stateLock);
 	*ptr = OSSwapHostToBigInt16(BatteryManager::getShared()->state.btInfo[0].state.chargingCurrent);
@@ -203,6 +223,7 @@ SMC_RESULT CHBI::readAccess() {
 }
 
 SMC_RESULT CHBV::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	UInt16 *ptr = reinterpret_cast<UInt16 *>(data);
 	IOSimpleLockLock(BatteryManager::getShared()->stateLock);
 	*ptr = OSSwapHostToBigInt16(BatteryManager::getShared()->state.btInfo[0].state.chargingVoltage);
@@ -211,6 +232,7 @@ SMC_RESULT CHBV::readAccess() {
 }
 
 SMC_RESULT CHLC::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	// TODO: does it have any other values?
 	IOSimpleLockLock(BatteryManager::getShared()->stateLock);
 	if (BatteryManager::getShared()->batteryCount > 0 &&
@@ -230,6 +252,7 @@ SMC_RESULT CHLC::readAccess() {
 }
 
 SMC_RESULT TB0T::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
 	UInt16 *ptr = reinterpret_cast<UInt16 *>(data);
 	IOSimpleLockLock(BatteryManager::getShared()->stateLock);
 	*ptr = VirtualSMCAPI::encodeSp(SmcKeyTypeSp78, BatteryManager::getShared()->state.btInfo[index].state.temperature);
@@ -238,6 +261,7 @@ SMC_RESULT TB0T::readAccess() {
 }
 
 SMC_RESULT BC1V::readAccess() {
+	BatteryManager::getShared()->count(BatteryCounterSMCReads);
     UInt16 *ptr = reinterpret_cast<UInt16 *>(data);
     IOSimpleLockLock(BatteryManager::getShared()->stateLock);
     *ptr = OSSwapHostToBigInt16(BatteryManager::getShared()->state.btInfo[index].state.presentVoltage);
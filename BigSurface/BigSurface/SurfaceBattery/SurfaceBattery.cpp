@@ -80,92 +80,19 @@ bool SurfaceBattery::updateStatus(UInt32 *bst) {
         return false;
     }
 	IOSimpleLockUnlock(batteryInfoLock);
-    
-    UInt32 defaultRate = 5000*1000 / st.designVoltage;  // 5w
-	st.state = bst[BSTState];
-	st.presentRate = bst[BSTPresentRate];
-	st.remainingCapacity = bst[BSTRemainingCapacity];
-	st.presentVoltage = bst[BSTPresentVoltage];
-	if (st.powerUnitIsWatt) {
-		st.presentRate = st.presentRate * 1000 / st.designVoltage;
-		st.remainingCapacity = st.remainingCapacity * 1000 / st.designVoltage;
-	}
 
-	// Sometimes this value can be either reported incorrectly or miscalculated
-	// and exceed the actual capacity. Simply workaround it by capping the value.
-	// REF: https://github.com/acidanthera/bugtracker/issues/565
-	if (st.remainingCapacity > st.lastFullChargeCapacity)
-		st.remainingCapacity = st.lastFullChargeCapacity;
-
-    if (!st.averageRate) {
-        st.averageRate = st.presentRate;
-    } else { // We will take a 1 minutes window
-        AbsoluteTime cur_time;
-        UInt64 nsecs;
-        clock_get_uptime(&cur_time);
-        SUB_ABSOLUTETIME(&cur_time, &st.lastUpdateTime);
-        absolutetime_to_nanoseconds(cur_time, &nsecs);
-        UInt32 msecs = (UInt32)(nsecs/1000000);
-        st.averageRate = (60000*st.averageRate + msecs*st.presentRate)/(60000+msecs);
-    }
+    AbsoluteTime cur_time;
+    UInt64 nsecs;
+    clock_get_uptime(&cur_time);
+    SUB_ABSOLUTETIME(&cur_time, &st.lastUpdateTime);
+    absolutetime_to_nanoseconds(cur_time, &nsecs);
+    applyStatus(st, bst, (UInt32)(nsecs/1000000));
     clock_get_uptime(&st.lastUpdateTime);
 
-	// Remaining capacity
-	st.averageTimeToEmpty = st.averageRate ? 60 * st.remainingCapacity / st.averageRate : 60 * st.remainingCapacity / defaultRate;
-	st.runTimeToEmpty = st.presentRate ? 60 * st.remainingCapacity / st.presentRate : 60 * st.remainingCapacity / defaultRate;
-
-	// Check battery state
-	bool bogus = false;
-	switch (st.state & BSTStateMask) {
-		case BSTNotCharging: {
-			st.calculatedACAdapterConnected = true;
-			st.batteryIsFull = true;
-			st.chargingCurrent = 0;
-			st.timeToFull = 0;
-			st.signedPresentRate = st.presentRate;
-			st.signedAverageRate = st.averageRate;
-			break;
-		}
-		case BSTDischarging: {
-			st.calculatedACAdapterConnected = false;
-			st.batteryIsFull = false;
-			st.chargingCurrent = 0;
-			st.timeToFull = 0;
-			st.signedPresentRate = -st.presentRate;
-			st.signedAverageRate = -st.averageRate;
-			break;
-		}
-		case BSTCharging: {
-			st.calculatedACAdapterConnected = true;
-			st.batteryIsFull = false;
-			int diff = st.lastFullChargeCapacity - st.remainingCapacity;
-            st.timeToFull = st.averageRate ? 60 * diff / st.averageRate : 60 * diff / defaultRate;
-			st.signedPresentRate = st.presentRate;
-			st.signedAverageRate = st.averageRate;
-			break;
-		}
-		default: {
-            IOLog("SurfaceBattery::Bogus status data from battery %d (%x)", id, st.state);
-			st.batteryIsFull = false;
-			bogus = true;
-			break;
-		}
-	}
-
-	st.lastRemainingCapacity = st.remainingCapacity;
-
-	// bool warning  = st.remainingCapacity <= st.designCapacityWarning || st.runTimeToEmpty < 10;
-	bool critical = st.remainingCapacity <= st.designCapacityLow || st.runTimeToEmpty < 5;
-	if (st.state & BSTCritical) {
+	if (st.bogus)
+        IOLog("SurfaceBattery::Bogus status data from battery %d (%x)", id, st.state);
+	if (st.state & BSTCritical)
         IOLog("SurfaceBattery::Battery %d is in critical state", id);
-		critical = true;
-	}
-
-	// When we report battery failure, AppleSmartBatteryManager sets isCharging=false.
-	// So we don't report battery failure when it's charging.
-	st.bad = (st.state & BSTStateMask) != BSTCharging && st.lastFullChargeCapacity < 2 * st.designCapacityWarning;
-	st.bogus = bogus;
-	st.critical = critical;
 
 	IOSimpleLockLock(batteryInfoLock);
 	batteryInfo->state = st;
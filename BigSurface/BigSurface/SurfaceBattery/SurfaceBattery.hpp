@@ -9,9 +9,9 @@
 #define SurfaceBattery_hpp
 
 #include <IOKit/acpi/IOACPIPlatformDevice.h>
-#include "BatteryManagerState.hpp"
+#include "BatteryStatusCore.hpp"
 
-class SurfaceBattery {
+class SurfaceBattery : public BatteryStatusCore {
     friend class BatteryManager;
 public:
 	/**
@@ -19,23 +19,6 @@ public:
 	 */
 	static constexpr UInt8 AverageBoundPercent = 25;
 
-	/**
-	 *  Battery status obtained from ACPI _BST
-	 */
-	enum {
-		/**
-		 Means that the battery is not charging and not discharging.
-		 It may happen when the battery is fully charged,
-		 or when AC adapter is connected but charging has not started yet,
-		 or when charging is limited to some percent in BIOS settings.
-		 */
-		BSTNotCharging  = 0,
-		BSTDischarging  = 1 << 0,
-		BSTCharging     = 1 << 1,
-		BSTCritical     = 1 << 2,
-		BSTStateMask    = BSTNotCharging | BSTDischarging | BSTCharging,
-	};
-
 	/**
 	 *  Reference to shared lock for refreshing battery info
 	 */
@@ -134,16 +117,6 @@ private:
 		BIXBatteryType,
 		BIXOEMInformation,
 	};
-
-	/**
-	 *  Battery Real-time Information pack layout
-	 */
-	enum {
-		BSTState,
-		BSTPresentRate,
-		BSTRemainingCapacity,
-		BSTPresentVoltage
-	};
 };
 
 #endif /* SurfaceBattery_hpp */
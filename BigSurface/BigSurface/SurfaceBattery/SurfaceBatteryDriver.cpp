@@ -10,6 +10,8 @@
 
 #include "SurfaceBatteryDriver.hpp"
 #include "KeyImplementations.hpp"
+#include "../BigSurfaceDiagnostics/Tracepoints.hpp"
+#include "../BootTimeline.hpp"
 #include <IOKit/battery/AppleSmartBatteryCommands.h>
 
 #define super IOService
@@ -48,6 +50,7 @@ void SurfaceBatteryDriver::updateBatteryInformation(IOInterruptEventSource *send
     bool connected = false;
     if (nub->getBatteryConnection(1, &connected) != kIOReturnSuccess) {
         LOG("Failed to get battery connection status from SSH!");
+        BatteryManager::getShared()->count(BatteryCounterSSHFailures);
         bix_fail = true;
         // It is impossible to occur unless the battery is not present
         bat_missing = true;
@@ -59,8 +62,11 @@ void SurfaceBatteryDriver::updateBatteryInformation(IOInterruptEventSource *send
         OSArray *bix;
         if (nub->getBatteryInformation(1, &bix) != kIOReturnSuccess) {
             LOG("Failed to get battery information extended from SSH!");
+            BatteryManager::getShared()->count(BatteryCounterSSHFailures);
             bix_fail = true;
         } else {
+            TRACEPOINT(TraceBattery, TraceBatteryInfo, 1, 0);
+            BatteryManager::getShared()->count(BatteryCounterBIXUpdates);
             BatteryManager::getShared()->updateBatteryInfoExtended(1, bix);
             bix->flushCollection();
             OSSafeReleaseNULL(bix);
@@ -84,6 +90,7 @@ void SurfaceBatteryDriver::updateBatteryStatus(IOInterruptEventSource *sender, i
     
     if (nub->getAdaptorStatus(&psr) != kIOReturnSuccess) {
         LOG("Failed to get power source status from SSH!");
+        BatteryManager::getShared()->count(BatteryCounterSSHFailures);
         goto fail;
     } else
         power_connected = BatteryManager::getShared()->updateAdapterStatus(1, psr);
@@ -91,6 +98,7 @@ void SurfaceBatteryDriver::updateBatteryStatus(IOInterruptEventSource *sender, i
     
     if (nub->getBatteryConnection(1, &connected) != kIOReturnSuccess) {
         LOG("Failed to get battery connection status from SSH!");
+        BatteryManager::getShared()->count(BatteryCounterSSHFailures);
         return;
     }
     if (connected) {
@@ -98,9 +106,14 @@ void SurfaceBatteryDriver::updateBatteryStatus(IOInterruptEventSource *sender, i
         UInt32 bst[4];
         if (nub->getBatteryStatus(1, bst, &temp) != kIOReturnSuccess) {
             LOG("Failed to get BST from SSH!");
+            BatteryManager::getShared()->count(BatteryCounterSSHFailures);
             goto fail;
-        } else
+        } else {
+            TRACEPOINT(TraceBattery, TraceBatteryStatus, 1, bst[0]);
+            BatteryManager::getShared()->count(BatteryCounterBSTUpdates);
             BatteryManager::getShared()->updateBatteryStatus(1, bst);
+            BootTimeline::end(BootStageBatteryFirstStatus);
+        }
         if (temp)
             BatteryManager::getShared()->updateBatteryTemperature(1, temp);
         BatteryManager::getShared()->informStatusChanged();
@@ -111,6 +124,7 @@ void SurfaceBatteryDriver::updateBatteryStatus(IOInterruptEventSource *sender, i
             sync = true;    // after finishing quick update, sync with normal update
         timer->setTimeoutMS(BST_UPDATE_QUICK);
     } else {    // sync normal update interval
+        UInt32 interval = Tunables::get(BigSurfaceTunableBatteryPollInterval);
         if (sync) {
             AbsoluteTime cur_time;
             UInt64 nsecs;
@@ -120,13 +134,13 @@ void SurfaceBatteryDriver::updateBatteryStatus(IOInterruptEventSource *sender, i
             SUB_ABSOLUTETIME(&cur_time, &BatteryManager::getShared()->lastAccess);
             IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
             absolutetime_to_nanoseconds(cur_time, &nsecs);
-            UInt8 timerDelta = nsecs / (1000000 * BST_UPDATE_QUICK);
-            if (timerDelta < BST_UPDATE_NORMAL/BST_UPDATE_QUICK - 5) {
-                timer->setTimeoutMS(BST_UPDATE_NORMAL - (2 + timerDelta) * BST_UPDATE_QUICK);
+            UInt64 timerDelta = nsecs / (1000000 * BST_UPDATE_QUICK);
+            if (timerDelta < interval/BST_UPDATE_QUICK - 5) {
+                timer->setTimeoutMS(interval - static_cast<UInt32>(2 + timerDelta) * BST_UPDATE_QUICK);
                 return;
             }
         }
-        timer->setTimeoutMS(BST_UPDATE_NORMAL);
+        TimerCoalescer::setTimeoutMS(timer, interval, BST_UPDATE_TOLERANCE);
     }
     return;
 fail:
@@ -223,23 +237,27 @@ IOService *SurfaceBatteryDriver::probe(IOService *provider, SInt32 *score) {
 }
 
 bool SurfaceBatteryDriver::start(IOService *provider) {
+	BootTimeline::begin(BootStageBatteryStart);
 	if (!super::start(provider))
 		return false;
 
 	// AppleSMC presence is a requirement, wait for it.
+	BootTimeline::begin(BootStageBatterySMCWait);
 	auto dict = nameMatching("AppleSMC");
 	auto applesmc = waitForMatchingService(dict);
 	if (!applesmc) {
 		LOG("Timeout in waiting for AppleSMC");
 		return false;
 	}
+	BootTimeline::end(BootStageBatterySMCWait);
     OSSafeReleaseNULL(dict);
     OSSafeReleaseNULL(applesmc);
     
     const UInt8 adaptCount = BatteryManager::getShared()->adapterCount;
-    const UInt8 batCount = min(BatteryManager::getShared()->batteryCount, MaxIndexCount);
+    const UInt8 batCount = min(BatteryManager::getShared()->batteryCount, SMCBatteryCount);
 
-    work_loop = IOWorkLoop::workLoop();
+    // status updates wait for hub responses, keep them off the control and telemetry bands
+    work_loop = WorkLoopBands::acquire(WorkLoopBandHubClient);
     if (!work_loop) {
         LOG("Could not get work loop!");
         return false;
@@ -266,51 +284,78 @@ bool SurfaceBatteryDriver::start(IOService *provider) {
         goto exit;
     }
     
-	//WARNING: watch out, key addition is sorted here!
-	if (adaptCount > 0) {
-		VirtualSMCAPI::addKey(KeyACEN, vsmcPlugin.data, VirtualSMCAPI::valueWithUint8(0, new ACIN));
-		VirtualSMCAPI::addKey(KeyACFP, vsmcPlugin.data, VirtualSMCAPI::valueWithFlag(false, new ACIN));
-		VirtualSMCAPI::addKey(KeyACID, vsmcPlugin.data, VirtualSMCAPI::valueWithData(nullptr, 8, SmcKeyTypeCh8s, new ACID));
-		VirtualSMCAPI::addKey(KeyACIN, vsmcPlugin.data, VirtualSMCAPI::valueWithFlag(false, new ACIN));
-	}
-
-	for (UInt8 i = 0; i < batCount; i++) {
-		VirtualSMCAPI::addKey(KeyB0AC(i), vsmcPlugin.data, VirtualSMCAPI::valueWithSint16(400, new B0AC(i), SMC_KEY_ATTRIBUTE_PRIVATE_WRITE|SMC_KEY_ATTRIBUTE_WRITE|SMC_KEY_ATTRIBUTE_READ));
-		VirtualSMCAPI::addKey(KeyB0AV(i), vsmcPlugin.data, VirtualSMCAPI::valueWithUint16(13000, new B0AV(i)));
-		VirtualSMCAPI::addKey(KeyB0BI(i), vsmcPlugin.data, VirtualSMCAPI::valueWithUint8(1, new B0BI(i)));
-		VirtualSMCAPI::addKey(KeyB0CT(i), vsmcPlugin.data, VirtualSMCAPI::valueWithUint16(1, new B0CT(i), SMC_KEY_ATTRIBUTE_PRIVATE_WRITE|SMC_KEY_ATTRIBUTE_WRITE|SMC_KEY_ATTRIBUTE_READ));
-		VirtualSMCAPI::addKey(KeyB0FC(i), vsmcPlugin.data, VirtualSMCAPI::valueWithUint16(4000, new B0FC(i), SMC_KEY_ATTRIBUTE_PRIVATE_WRITE|SMC_KEY_ATTRIBUTE_WRITE|SMC_KEY_ATTRIBUTE_READ));
-		VirtualSMCAPI::addKey(KeyB0PS(i), vsmcPlugin.data, VirtualSMCAPI::valueWithData(nullptr, 2, SmcKeyTypeHex, new B0PS(i), SMC_KEY_ATTRIBUTE_PRIVATE_WRITE|SMC_KEY_ATTRIBUTE_WRITE|SMC_KEY_ATTRIBUTE_READ));
-		VirtualSMCAPI::addKey(KeyB0RM(i), vsmcPlugin.data, VirtualSMCAPI::valueWithUint16(2000, new B0RM(i), SMC_KEY_ATTRIBUTE_PRIVATE_WRITE|SMC_KEY_ATTRIBUTE_WRITE|SMC_KEY_ATTRIBUTE_READ));
-		VirtualSMCAPI::addKey(KeyB0St(i), vsmcPlugin.data, VirtualSMCAPI::valueWithData(nullptr, 2, SmcKeyTypeHex, new B0St(i), SMC_KEY_ATTRIBUTE_PRIVATE_WRITE|SMC_KEY_ATTRIBUTE_WRITE|SMC_KEY_ATTRIBUTE_READ));
-		VirtualSMCAPI::addKey(KeyB0TF(i), vsmcPlugin.data, VirtualSMCAPI::valueWithUint16(0, new B0TF(i)));
-		VirtualSMCAPI::addKey(KeyTB0T(i+1), vsmcPlugin.data, VirtualSMCAPI::valueWithSp(0, SmcKeyTypeSp78, new TB0T(i)));
-        if (i == 0)
-            VirtualSMCAPI::addKey(KeyTB0T(0), vsmcPlugin.data, VirtualSMCAPI::valueWithSp(0, SmcKeyTypeSp78, new TB0T(0)));
-	}
-
-	VirtualSMCAPI::addKey(KeyBATP, vsmcPlugin.data, VirtualSMCAPI::valueWithFlag(true, new BATP));
-	VirtualSMCAPI::addKey(KeyBBAD, vsmcPlugin.data, VirtualSMCAPI::valueWithFlag(false, new BBAD));
-	VirtualSMCAPI::addKey(KeyBBIN, vsmcPlugin.data, VirtualSMCAPI::valueWithFlag(true, new BBIN));
-	VirtualSMCAPI::addKey(KeyBFCL, vsmcPlugin.data, VirtualSMCAPI::valueWithUint8(100, new BFCL, SMC_KEY_ATTRIBUTE_READ | SMC_KEY_ATTRIBUTE_WRITE));
-	VirtualSMCAPI::addKey(KeyBNum, vsmcPlugin.data, VirtualSMCAPI::valueWithUint8(1, new BNum));
-	VirtualSMCAPI::addKey(KeyBRSC, vsmcPlugin.data, VirtualSMCAPI::valueWithUint16(40, new BRSC, SMC_KEY_ATTRIBUTE_READ | SMC_KEY_ATTRIBUTE_WRITE | SMC_KEY_ATTRIBUTE_PRIVATE_WRITE));
-	VirtualSMCAPI::addKey(KeyBSIn, vsmcPlugin.data, VirtualSMCAPI::valueWithUint8(0, new BSIn));
-
-	VirtualSMCAPI::addKey(KeyCHBI, vsmcPlugin.data, VirtualSMCAPI::valueWithUint16(0, new CHBI));
-	VirtualSMCAPI::addKey(KeyCHBV, vsmcPlugin.data, VirtualSMCAPI::valueWithUint16(8000, new CHBV));
-	VirtualSMCAPI::addKey(KeyCHLC, vsmcPlugin.data, VirtualSMCAPI::valueWithUint8(1, new CHLC));
-
-    for (UInt8 i = 0; i < batCount; i++) {
-        VirtualSMCAPI::addKey(KeyBC1V(i+1), vsmcPlugin.data, VirtualSMCAPI::valueWithUint16(defaultBatteryCellVoltage, new BC1V(i)));
+    mode_lock = IOLockAlloc();
+    if (!mode_lock) {
+        LOG("Could not allocate performance mode lock!");
+        goto exit;
+    }
+    // the personality carries the initial mode
+    if (OSNumber *mode = OSDynamicCast(OSNumber, getProperty("PerformanceMode"))) {
+        if (Tunables::set(BigSurfaceTunablePerformanceMode, mode->unsigned32BitValue()) != kIOReturnSuccess)
+            LOG("Invalid performance mode %d", mode->unsigned32BitValue());
     }
+    if (!Tunables::subscribe(BigSurfaceTunablePerformanceMode, &SurfaceBatteryDriver::performanceModeChanged, this)) {
+        LOG("Performance mode is already controlled by another driver");
+        goto exit;
+    }
+    
+	// sorted by key, battery keys of every supported battery are listed
+	static constexpr SMC_KEY_ATTRIBUTES AttrRead = SMC_KEY_ATTRIBUTE_READ;
+	static constexpr SMC_KEY_ATTRIBUTES AttrPrivateRW = SMC_KEY_ATTRIBUTE_PRIVATE_WRITE | SMC_KEY_ATTRIBUTE_WRITE | SMC_KEY_ATTRIBUTE_READ;
+	static constexpr SMCKeyDescriptor keys[] = {
+		{KeyACEN, SMC_KEY_ADAPTER, SMCKeyUint8, 0, 0, 0, nullptr, AttrRead, smcValue<ACIN>},
+		{KeyACFP, SMC_KEY_ADAPTER, SMCKeyFlag, 0, 0, 0, nullptr, AttrRead, smcValue<ACIN>},
+		{KeyACID, SMC_KEY_ADAPTER, SMCKeyData, SmcKeyTypeCh8s, 8, 0, nullptr, AttrRead, smcValue<ACID>},
+		{KeyACIN, SMC_KEY_ADAPTER, SMCKeyFlag, 0, 0, 0, nullptr, AttrRead, smcValue<ACIN>},
+		{KeyB0AC(0), 0, SMCKeySint16, 0, 0, 400, nullptr, AttrPrivateRW, smcIndexedValue<B0AC>},
+		{KeyB0AV(0), 0, SMCKeyUint16, 0, 0, 13000, nullptr, AttrRead, smcIndexedValue<B0AV>},
+		{KeyB0BI(0), 0, SMCKeyUint8, 0, 0, 1, nullptr, AttrRead, smcIndexedValue<B0BI>},
+		{KeyB0CT(0), 0, SMCKeyUint16, 0, 0, 1, nullptr, AttrPrivateRW, smcIndexedValue<B0CT>},
+		{KeyB0FC(0), 0, SMCKeyUint16, 0, 0, 4000, nullptr, AttrPrivateRW, smcIndexedValue<B0FC>},
+		{KeyB0PS(0), 0, SMCKeyData, SmcKeyTypeHex, 2, 0, nullptr, AttrPrivateRW, smcIndexedValue<B0PS>},
+		{KeyB0RM(0), 0, SMCKeyUint16, 0, 0, 2000, nullptr, AttrPrivateRW, smcIndexedValue<B0RM>},
+		{KeyB0St(0), 0, SMCKeyData, SmcKeyTypeHex, 2, 0, nullptr, AttrPrivateRW, smcIndexedValue<B0St>},
+		{KeyB0TF(0), 0, SMCKeyUint16, 0, 0, 0, nullptr, AttrRead, smcIndexedValue<B0TF>},
+		{KeyB0AC(1), 1, SMCKeySint16, 0, 0, 400, nullptr, AttrPrivateRW, smcIndexedValue<B0AC>},
+		{KeyB0AV(1), 1, SMCKeyUint16, 0, 0, 13000, nullptr, AttrRead, smcIndexedValue<B0AV>},
+		{KeyB0BI(1), 1, SMCKeyUint8, 0, 0, 1, nullptr, AttrRead, smcIndexedValue<B0BI>},
+		{KeyB0CT(1), 1, SMCKeyUint16, 0, 0, 1, nullptr, AttrPrivateRW, smcIndexedValue<B0CT>},
+		{KeyB0FC(1), 1, SMCKeyUint16, 0, 0, 4000, nullptr, AttrPrivateRW, smcIndexedValue<B0FC>},
+		{KeyB0PS(1), 1, SMCKeyData, SmcKeyTypeHex, 2, 0, nullptr, AttrPrivateRW, smcIndexedValue<B0PS>},
+		{KeyB0RM(1), 1, SMCKeyUint16, 0, 0, 2000, nullptr, AttrPrivateRW, smcIndexedValue<B0RM>},
+		{KeyB0St(1), 1, SMCKeyData, SmcKeyTypeHex, 2, 0, nullptr, AttrPrivateRW, smcIndexedValue<B0St>},
+		{KeyB0TF(1), 1, SMCKeyUint16, 0, 0, 0, nullptr, AttrRead, smcIndexedValue<B0TF>},
+		{KeyBATP, SMC_KEY_SHARED, SMCKeyFlag, 0, 0, 1, nullptr, AttrRead, smcValue<BATP>},
+		{KeyBBAD, SMC_KEY_SHARED, SMCKeyFlag, 0, 0, 0, nullptr, AttrRead, smcValue<BBAD>},
+		{KeyBBIN, SMC_KEY_SHARED, SMCKeyFlag, 0, 0, 1, nullptr, AttrRead, smcValue<BBIN>},
+		{KeyBC1V(1), 0, SMCKeyUint16, 0, 0, defaultBatteryCellVoltage, nullptr, AttrRead, smcIndexedValue<BC1V>},
+		{KeyBC1V(2), 1, SMCKeyUint16, 0, 0, defaultBatteryCellVoltage, nullptr, AttrRead, smcIndexedValue<BC1V>},
+		{KeyBFCL, SMC_KEY_SHARED, SMCKeyUint8, 0, 0, 100, nullptr, SMC_KEY_ATTRIBUTE_READ | SMC_KEY_ATTRIBUTE_WRITE, smcValue<BFCL>},
+		{KeyBNum, SMC_KEY_SHARED, SMCKeyUint8, 0, 0, 1, nullptr, AttrRead, smcValue<BNum>},
+		{KeyBRSC, SMC_KEY_SHARED, SMCKeyUint16, 0, 0, 40, nullptr, AttrPrivateRW, smcValue<BRSC>},
+		{KeyBSIn, SMC_KEY_SHARED, SMCKeyUint8, 0, 0, 0, nullptr, AttrRead, smcValue<BSIn>},
+		{KeyCHBI, SMC_KEY_SHARED, SMCKeyUint16, 0, 0, 0, nullptr, AttrRead, smcValue<CHBI>},
+		{KeyCHBV, SMC_KEY_SHARED, SMCKeyUint16, 0, 0, 8000, nullptr, AttrRead, smcValue<CHBV>},
+		{KeyCHLC, SMC_KEY_SHARED, SMCKeyUint8, 0, 0, 1, nullptr, AttrRead, smcValue<CHLC>},
+		// TB0T duplicates the first battery
+		{KeyTB0T(0), 0, SMCKeySp, SmcKeyTypeSp78, 0, 0, nullptr, AttrRead, smcIndexedValue<TB0T>},
+		{KeyTB0T(1), 0, SMCKeySp, SmcKeyTypeSp78, 0, 0, nullptr, AttrRead, smcIndexedValue<TB0T>},
+		{KeyTB0T(2), 1, SMCKeySp, SmcKeyTypeSp78, 0, 0, nullptr, AttrRead, smcIndexedValue<TB0T>},
+	};
+	static_assert(smcKeysSorted(keys), "SMC keys must be sorted");
 
-	qsort(const_cast<VirtualSMCKeyValue *>(vsmcPlugin.data.data()), vsmcPlugin.data.size(), sizeof(VirtualSMCKeyValue), VirtualSMCKeyValue::compare);
+	smcAddKeys(keys, arrsize(keys), vsmcPlugin.data, this, batCount, adaptCount > 0);
+    
+    if (!PowerOrchestrator::registerDomain(PowerDomainBattery, this, OSMemberFunctionCast(PowerOrchestrator::Transition, this, &SurfaceBatteryDriver::powerTransition))) {
+        LOG("Failed to register power domain");
+        goto exit;
+    }
     
     PMinit();
     nub->joinPMtree(this);
     registerPowerDriver(this, myIOPMPowerStates, kIOPMNumberPowerStates);
 
+	BootTimeline::begin(BootStageBatterySMCSubmit);
 	vsmcNotifier = VirtualSMCAPI::registerHandler(vsmcNotificationHandler, this);
     if (!vsmcNotifier) {
         PMstop();
@@ -318,6 +363,8 @@ bool SurfaceBatteryDriver::start(IOService *provider) {
     }
     
     registerService();
+	BootTimeline::end(BootStageBatteryStart);
+	BootTimeline::begin(BootStageBatteryFirstStatus);
 	return true;
 exit:
     releaseResources();
@@ -330,6 +377,7 @@ bool SurfaceBatteryDriver::vsmcNotificationHandler(void *sensors, void *refCon,
 		auto ret = vsmc->callPlatformFunction(VirtualSMCAPI::SubmitPlugin, true, sensors, &plugin, nullptr, nullptr);
 		if (ret == kIOReturnSuccess) {
 			IOLog("SurfaceBatteryDriver::Plugin submitted\n");
+			BootTimeline::end(BootStageBatterySMCSubmit);
 			return true;
 		} else
             IOLog("SurfaceBatteryDriver::Plugin submission failure %X\n", ret);
@@ -345,6 +393,12 @@ void SurfaceBatteryDriver::stop(IOService *provider) {
 }
 
 void SurfaceBatteryDriver::releaseResources() {
+    PowerOrchestrator::unregisterDomain(PowerDomainBattery, this);
+    Tunables::unsubscribe(BigSurfaceTunablePerformanceMode, this);
+    if (mode_lock) {
+        IOLockFree(mode_lock);
+        mode_lock = nullptr;
+    }
     nub->unregisterBatteryEvent(this);
     if (timer) {
         timer->cancelTimeout();
@@ -362,7 +416,7 @@ void SurfaceBatteryDriver::releaseResources() {
         work_loop->removeEventSource(update_bst);
         OSSafeReleaseNULL(update_bst);
     }
-    OSSafeReleaseNULL(work_loop);
+    WorkLoopBands::release(WorkLoopBandHubClient, work_loop);
 }
 
 IOReturn SurfaceBatteryDriver::setProperties(OSObject *props) {
@@ -370,29 +424,35 @@ IOReturn SurfaceBatteryDriver::setProperties(OSObject *props) {
     if (!dict)
         return kIOReturnError;
     
-    OSCollectionIterator* i = OSCollectionIterator::withCollection(dict);
-    if (i) {
-        while (OSString* key = OSDynamicCast(OSString, i->getNextObject())) {
-            if (key->isEqualTo("PerformanceMode")) {
-                OSNumber *mode = OSDynamicCast(OSNumber, dict->getObject(key));
-                if (mode) {
-                    UInt32 m = mode->unsigned32BitValue();
-                    LOG("Set performance mode to %d", m);
-                    if (nub->setPerformanceMode(m) != kIOReturnSuccess)
-                        LOG("Set performance mode failed!");
-                }
-            }
-        }
-        i->release();
-    }
-    return kIOReturnSuccess;
+    OSNumber *mode = OSDynamicCast(OSNumber, dict->getObject("PerformanceMode"));
+    if (!mode)
+        return kIOReturnSuccess;
+    LOG("Set performance mode to %d", mode->unsigned32BitValue());
+    return Tunables::set(BigSurfaceTunablePerformanceMode, mode->unsigned32BitValue());
+}
+
+void SurfaceBatteryDriver::performanceModeChanged(void *target, BigSurfaceTunable tunable, UInt32 value) {
+    SurfaceBatteryDriver *that = static_cast<SurfaceBatteryDriver *>(target);
+    that->setProperty("PerformanceMode", value, 32);
+    // asleep it is pushed again on wake, which holds the lock until the mode went out
+    IOLockLock(that->mode_lock);
+    if (that->mode_ready && that->nub->setPerformanceMode(value) != kIOReturnSuccess)
+        IOLog("%s::Set performance mode failed!\n", that->getName());
+    IOLockUnlock(that->mode_lock);
 }
 
 IOReturn SurfaceBatteryDriver::setPowerState(unsigned long whichState, IOService *device) {
     if (device != this)
         return kIOReturnInvalid;
-    if (whichState == 0) {
+    return PowerOrchestrator::scheduleTransition(PowerDomainBattery, whichState != 0);
+}
+
+void SurfaceBatteryDriver::powerTransition(bool wake) {
+    if (!wake) {
         if (awake) {
+            IOLockLock(mode_lock);
+            mode_ready = false;
+            IOLockUnlock(mode_lock);
             awake = false;
             bat_missing = false;
             timer->cancelTimeout();
@@ -410,16 +470,16 @@ IOReturn SurfaceBatteryDriver::setPowerState(unsigned long whichState, IOService
             bix_fail = true;
             quick_cnt = BST_UPDATE_QUICK_CNT;
             clock_get_uptime(&last_update);
+            if (!PowerOrchestrator::waitReady(PowerDomainSSH, POWER_READY_TIMEOUT))
+                LOG("SSH not ready after wake");
             updateBatteryStatus(nullptr, 0);
             
-            OSNumber *mode = OSDynamicCast(OSNumber, getProperty("PerformanceMode"));
-            if (mode) {
-                UInt32 m = mode->unsigned32BitValue();
-                if (nub->setPerformanceMode(m) != kIOReturnSuccess)
-                    LOG("Set performance mode failed!");
-            }
+            IOLockLock(mode_lock);
+            if (nub->setPerformanceMode(Tunables::get(BigSurfaceTunablePerformanceMode)) != kIOReturnSuccess)
+                LOG("Set performance mode failed!");
+            mode_ready = true;
+            IOLockUnlock(mode_lock);
             DBG_LOG("Woke up");
         }
     }
-    return kIOPMAckImplied;
 }
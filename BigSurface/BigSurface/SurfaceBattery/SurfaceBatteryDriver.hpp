@@ -10,9 +10,14 @@
 
 #include "BatteryManager.hpp"
 #include "../SurfaceSerialHubDevices/SurfaceBatteryNub.hpp"
+#include "../PowerOrchestrator.hpp"
+#include "../WorkLoopBands.hpp"
+#include "../TimerCoalescer.hpp"
+#include "../SMCKeyTable.hpp"
+#include "../Tunables.hpp"
 
 #define BST_UPDATE_QUICK    1000
-#define BST_UPDATE_NORMAL   30000
+#define BST_UPDATE_TOLERANCE    2000
 #define BST_UPDATE_QUICK_CNT    5
 
 class EXPORT SurfaceBatteryDriver : public IOService {
@@ -24,6 +29,11 @@ class EXPORT SurfaceBatteryDriver : public IOService {
 	static constexpr size_t MaxIndexCount = sizeof("0123456789ABCDEF") - 1;
 	static constexpr const char *KeyIndexes = "0123456789ABCDEF";
 
+	/**
+	 *  Batteries covered by the SMC key table
+	 */
+	static constexpr UInt8 SMCBatteryCount = 2;
+
 	/**
 	 *  Key name declarations
 	 */
@@ -99,6 +109,8 @@ private:
     bool    bat_missing {false};
     bool    sync {false};
     AbsoluteTime last_update {0};
+    IOLock* mode_lock {nullptr};
+    bool    mode_ready {false};     // awake and the hub is up, guarded by mode_lock
 
     void eventReceived(SurfaceBatteryNub *sender, SurfaceBatteryEventType type);
     
@@ -109,6 +121,10 @@ private:
     void pollBatteryStatus(IOTimerEventSource* sender);
     
     void releaseResources();
+    
+    void powerTransition(bool wake);
+    
+    static void performanceModeChanged(void *target, BigSurfaceTunable tunable, UInt32 value);
 };
 
 #endif /* SurfaceBatteryDriver_hpp */
@@ -11,12 +11,13 @@
 #include <IOKit/IOTimerEventSource.h>
 
 #include "SurfaceSMBusController.hpp"
+#include "../BigSurfaceDiagnostics/Tracepoints.hpp"
 
 #define super IOSMBusController
 OSDefineMetaClassAndStructors(SurfaceSMBusController, IOSMBusController)
 
 bool SurfaceSMBusController::start(IOService *provider) {
-	workLoop = IOWorkLoop::workLoop();
+	workLoop = WorkLoopBands::acquire(WorkLoopBandTelemetry);
 	if (!workLoop) {
         IOLog("%s::workLoop allocation failed\n", getName());
 		return false;
@@ -25,13 +26,13 @@ bool SurfaceSMBusController::start(IOService *provider) {
 	requestQueue = OSArray::withCapacity(0);
 	if (!requestQueue) {
         IOLog("%s::requestQueue allocation failure\n", getName());
-		OSSafeReleaseNULL(workLoop);
+		WorkLoopBands::release(WorkLoopBandTelemetry, workLoop);
 		return false;
 	}
 	
 	if (!super::start(provider)) {
         IOLog("%s::parent start failed\n", getName());
-		OSSafeReleaseNULL(workLoop);
+		WorkLoopBands::release(WorkLoopBandTelemetry, workLoop);
 		OSSafeReleaseNULL(requestQueue);
 		return false;
 	}
@@ -43,7 +44,7 @@ bool SurfaceSMBusController::start(IOService *provider) {
     interruptSource = IOInterruptEventSource::interruptEventSource(this, OSMemberFunctionCast(IOInterruptEventAction, this, &SurfaceSMBusController::handleBatteryCommandsEvent));
 	if (!interruptSource) {
         IOLog("%s::failed to allocate interrupt event\n", getName());
-		OSSafeReleaseNULL(workLoop);
+		WorkLoopBands::release(WorkLoopBandTelemetry, workLoop);
 		OSSafeReleaseNULL(requestQueue);
 		return false;
 	}
@@ -64,251 +65,179 @@ IOSMBusStatus SurfaceSMBusController::startRequest(IOSMBusRequest *request) {
 	auto result = super::startRequest(request);
 	if (result != kIOSMBusStatusOK)
         return result;
-	
-	IOSMBusTransaction *transaction = request->transaction;
 
-	if (transaction) {
-		transaction->status = kIOSMBusStatusOK;
-		UInt32 valueToWrite = 0;
-		
-		if (transaction->address == kSMBusManagerAddr && transaction->protocol == kIOSMBusProtocolReadWord) {
-			switch (transaction->command) {
-				case kMStateContCmd: {
-					IOSimpleLockLock(BatteryManager::getShared()->stateLock);
-					valueToWrite = BatteryManager::getShared()->externalPowerConnected() ? kMACPresentBit : 0;
-					IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
-					setReceiveData(transaction, valueToWrite);
-					break;
-				}
-				case kMStateCmd: {
-					IOSimpleLockLock(BatteryManager::getShared()->stateLock);
-					if (BatteryManager::getShared()->batteriesConnected()) {
-						valueToWrite = kMPresentBatt_A_Bit;
-						if ((BatteryManager::getShared()->state.btInfo[0].state.state & SurfaceBattery::BSTStateMask) == SurfaceBattery::BSTCharging)
-							valueToWrite |= kMChargingBatt_A_Bit;
-					}
-					IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
-					setReceiveData(transaction, valueToWrite);
-					break;
-				}
-				default: {
-					// Nothing should be done here since AppleSmartBattery always calls bzero fo transaction
-					// Let's also not set transaction status to error value since it can be an unknown command
-					break;
-				}
-			}
-		}
+	// answered in order by the next handleBatteryCommandsEvent pass
+	if (!refreshStart)
+		clock_get_uptime(&refreshStart);
+	if (!requestQueue->setObject(request)) {
+        IOLog("%s::startRequest failed to append a request\n", getName());
+		return kIOSMBusStatusUnknownFailure;
+	}
+    interruptSource->interruptOccurred(nullptr, this, 0);
+    
+    IOSimpleLockLock(BatteryManager::getShared()->stateLock);
+    clock_get_uptime(&BatteryManager::getShared()->lastAccess);
+    IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
+
+	return result;
+}
 
-		if (transaction->address == kSMBusBatteryAddr && transaction->protocol == kIOSMBusProtocolReadWord) {
-			//FIXME: maybe the incoming data show us which battery is queried about? Or it's in the address?
+void SurfaceSMBusController::takeSnapshot(SMBusSnapshot &snapshot) {
+	auto &bmgr = *BatteryManager::getShared();
+	IOSimpleLockLock(bmgr.stateLock);
+	snapshot.info = bmgr.state.btInfo[0];
+	snapshot.batteryStatus = bmgr.calculateBatteryStatus(0);
+	snapshot.externalPowerConnected = bmgr.externalPowerConnected();
+	snapshot.batteriesConnected = bmgr.batteriesConnected();
+	IOSimpleLockUnlock(bmgr.stateLock);
+	bmgr.copyIdentity(0, &snapshot.identity);
+}
 
-			switch (transaction->command) {
-				case kBBatteryStatusCmd: {
-					setReceiveData(transaction, BatteryManager::getShared()->calculateBatteryStatus(0));
-					break;
-				}
-				case kBManufacturerAccessCmd: {
-					if (transaction->sendDataCount == 2 &&
-						(transaction->sendData[0] == kBExtendedPFStatusCmd ||
-						 transaction->sendData[0] == kBExtendedOperationStatusCmd)) {
-						// AppleSmartBatteryManager ignores these values.
-						setReceiveData(transaction, 0);
-					}
-					//CHECKME: Should else case be handled?
-					break;
-				}
-				case kBPackReserveCmd:
-				case kBDesignCycleCount9CCmd: {
-					setReceiveData(transaction, 1000);
-					break;
-				}
-                case kBReadCellVoltage1Cmd:
-                case kBReadCellVoltage2Cmd:
-                case kBReadCellVoltage3Cmd:
-                case kBReadCellVoltage4Cmd: {
-                    setReceiveData(transaction, defaultBatteryCellVoltage);
-                    break;
-                }
-                case kBVoltageCmd: {
-                    IOSimpleLockLock(BatteryManager::getShared()->stateLock);
-                    auto value = BatteryManager::getShared()->state.btInfo[0].state.presentVoltage;
-                    IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
-                    setReceiveData(transaction, value);
-                    break;
-                }
-				case kBCurrentCmd: {
-					IOSimpleLockLock(BatteryManager::getShared()->stateLock);
-					auto value = BatteryManager::getShared()->state.btInfo[0].state.signedPresentRate;
-					IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
-					setReceiveData(transaction, value);
-					break;
-				}
-				case kBAverageCurrentCmd: {
-					IOSimpleLockLock(BatteryManager::getShared()->stateLock);
-					auto value = BatteryManager::getShared()->state.btInfo[0].state.signedAverageRate;
-					IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
-					setReceiveData(transaction, value);
-					break;
-				}
-				case kBSerialNumberCmd:
-				case kBMaxErrorCmd:
-					break;
-				case kBRunTimeToEmptyCmd: {
-					IOSimpleLockLock(BatteryManager::getShared()->stateLock);
-					auto value = BatteryManager::getShared()->state.btInfo[0].state.runTimeToEmpty;
-					IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
-					setReceiveData(transaction, value);
-					break;
-				}
-				case kBAverageTimeToEmptyCmd: {
-					IOSimpleLockLock(BatteryManager::getShared()->stateLock);
-					auto value = BatteryManager::getShared()->state.btInfo[0].state.averageTimeToEmpty;
-					IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
-					setReceiveData(transaction, value);
-					break;
-				}
-				case kBTemperatureCmd: {
-					IOSimpleLockLock(BatteryManager::getShared()->stateLock);
-					auto value = BatteryManager::getShared()->state.btInfo[0].state.temperatureDecikelvin;
-					IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
-					setReceiveData(transaction, value);
-					break;
-				}
-				case kBDesignCapacityCmd: {
-					IOSimpleLockLock(BatteryManager::getShared()->stateLock);
-					auto value = BatteryManager::getShared()->state.btInfo[0].designCapacity;
-					IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
-					setReceiveData(transaction, value);
-					break;
-				}
-				case kBCycleCountCmd: {
-					IOSimpleLockLock(BatteryManager::getShared()->stateLock);
-					auto value = BatteryManager::getShared()->state.btInfo[0].cycle;
-					IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
-					setReceiveData(transaction, value);
-					break;
-				}
-				case kBAverageTimeToFullCmd: {
-					IOSimpleLockLock(BatteryManager::getShared()->stateLock);
-					auto value = BatteryManager::getShared()->state.btInfo[0].state.timeToFull;
-					IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
-					setReceiveData(transaction, value);
-					break;
-				}
-				case kBRemainingCapacityCmd: {
-					IOSimpleLockLock(BatteryManager::getShared()->stateLock);
-					auto value = BatteryManager::getShared()->state.btInfo[0].state.remainingCapacity;
-					IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
-					setReceiveData(transaction, value);
-					break;
-				}
-				case kBFullChargeCapacityCmd: {
-					IOSimpleLockLock(BatteryManager::getShared()->stateLock);
-					auto value = BatteryManager::getShared()->state.btInfo[0].state.lastFullChargeCapacity;
-					IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
-					setReceiveData(transaction, value);
-					break;
-				}
-				case kBManufactureDateCmd: {
-					UInt16 value = 0;
-					IOSimpleLockLock(BatteryManager::getShared()->stateLock);
-					if (BatteryManager::getShared()->state.btInfo[0].manufactureDate) {
-						value = BatteryManager::getShared()->state.btInfo[0].manufactureDate;
-					} else {
-						strncpy(reinterpret_cast<char *>(transaction->receiveData), BatteryManager::getShared()->state.btInfo[0].serial, kSMBusMaximumDataSize);
-						transaction->receiveData[kSMBusMaximumDataSize-1] = '\0';
-					}
-					IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
+void SurfaceSMBusController::answerRequest(IOSMBusTransaction *transaction, const SMBusSnapshot &snapshot) {
+	TRACEPOINT(TraceBattery, TraceSMBusRequest, transaction->address << 8 | transaction->command, transaction->protocol);
+	BatteryManager::getShared()->count(BatteryCounterSMBusRequests);
+	transaction->status = kIOSMBusStatusOK;
 
-					if (!value) {
-						const char* p = reinterpret_cast<char *>(transaction->receiveData);
-						bool found = false;
-						int year = 2016, month = 02, day = 29;
-						while ((p = strstr(p, "20")) != nullptr) { // hope that this code will not survive until 22nd century
-							if (sscanf(p, "%04d%02d%02d", &year, &month, &day) == 3 || 		// YYYYMMDD (Lenovo)
-								sscanf(p, "%04d/%02d/%02d", &year, &month, &day) == 3) {	// YYYY/MM/DD (HP)
-								if (1 <= month && month <= 12 && 1 <= day && day <= 31) {
-									found = true;
-									break;
-								}
-							}
-							p++;
-						}
-						
-						if (!found) { // in case we parsed a non-date
-							year = 2016;
-							month = 02;
-							day = 29;
-						}
-						value = makeBatteryDate(day, month, year);
-					}
-					
-					setReceiveData(transaction, value);
-					break;
+	if (transaction->address == kSMBusManagerAddr && transaction->protocol == kIOSMBusProtocolReadWord) {
+		switch (transaction->command) {
+			case kMStateContCmd: {
+				setReceiveData(transaction, snapshot.externalPowerConnected ? kMACPresentBit : 0);
+				break;
+			}
+			case kMStateCmd: {
+				UInt16 valueToWrite = 0;
+				if (snapshot.batteriesConnected) {
+					valueToWrite = kMPresentBatt_A_Bit;
+					if ((snapshot.info.state.state & SurfaceBattery::BSTStateMask) == SurfaceBattery::BSTCharging)
+						valueToWrite |= kMChargingBatt_A_Bit;
 				}
-				//CHECKME: Should there be a default setting receiveDataCount to 0 or status failure?
+				setReceiveData(transaction, valueToWrite);
+				break;
 			}
-		}
-
-		if (transaction->address == kSMBusBatteryAddr &&
-			transaction->protocol == kIOSMBusProtocolWriteWord &&
-			transaction->command == kBManufacturerAccessCmd) {
-			if (transaction->sendDataCount == 2 && (transaction->sendData[0] == kBExtendedPFStatusCmd || transaction->sendData[0] == kBExtendedOperationStatusCmd)) {
-				// Nothing can be done here since we don't write any values to hardware, we fake response for this command in handler for
-				// kIOSMBusProtocolReadWord/kBManufacturerAccessCmd. Anyway, AppleSmartBattery::transactionCompletion ignores this response.
-				// If we can see this log statement, it means that fields sendDataCount and sendData have a proper offset in IOSMBusTransaction
+			default: {
+				// Nothing should be done here since AppleSmartBattery always calls bzero fo transaction
+				// Let's also not set transaction status to error value since it can be an unknown command
+				break;
 			}
 		}
+	}
+
+	if (transaction->address == kSMBusBatteryAddr && transaction->protocol == kIOSMBusProtocolReadWord) {
+		//FIXME: maybe the incoming data show us which battery is queried about? Or it's in the address?
 
-		if (transaction->address == kSMBusBatteryAddr && transaction->protocol == kIOSMBusProtocolReadBlock) {
-			switch (transaction->command) {
-				case kBManufacturerNameCmd: {
-					transaction->receiveDataCount = kSMBusMaximumDataSize;
-					IOSimpleLockLock(BatteryManager::getShared()->stateLock);
-					strncpy(reinterpret_cast<char *>(transaction->receiveData), BatteryManager::getShared()->state.btInfo[0].manufacturer, kSMBusMaximumDataSize);
-					transaction->receiveData[kSMBusMaximumDataSize-1] = '\0';
-					IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
-					break;
+		switch (transaction->command) {
+			case kBBatteryStatusCmd: {
+				setReceiveData(transaction, snapshot.batteryStatus);
+				break;
+			}
+			case kBManufacturerAccessCmd: {
+				if (transaction->sendDataCount == 2 &&
+					(transaction->sendData[0] == kBExtendedPFStatusCmd ||
+					 transaction->sendData[0] == kBExtendedOperationStatusCmd)) {
+					// AppleSmartBatteryManager ignores these values.
+					setReceiveData(transaction, 0);
 				}
-				case kBAppleHardwareSerialCmd:
-					transaction->receiveDataCount = kSMBusMaximumDataSize;
-					IOSimpleLockLock(BatteryManager::getShared()->stateLock);
-					strncpy(reinterpret_cast<char *>(transaction->receiveData), BatteryManager::getShared()->state.btInfo[0].serial, kSMBusMaximumDataSize);
-					transaction->receiveData[kSMBusMaximumDataSize-1] = '\0';
-					IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
-					break;
-				case kBDeviceNameCmd:
-					transaction->receiveDataCount = kSMBusMaximumDataSize;
-					IOSimpleLockLock(BatteryManager::getShared()->stateLock);
-					strncpy(reinterpret_cast<char *>(transaction->receiveData), BatteryManager::getShared()->state.btInfo[0].deviceName, kSMBusMaximumDataSize);
-					transaction->receiveData[kSMBusMaximumDataSize-1] = '\0';
-					IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
-					break;
-				case kBManufacturerDataCmd:
-					transaction->receiveDataCount = sizeof(BatteryInfo::BatteryManufacturerData);
-					IOSimpleLockLock(BatteryManager::getShared()->stateLock);
-					memcpy(reinterpret_cast<UInt16 *>(transaction->receiveData), &BatteryManager::getShared()->state.btInfo[0].batteryManufacturerData, sizeof(BatteryInfo::BatteryManufacturerData));
-					IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
-					break;
-				case kBManufacturerInfoCmd:
-					break;
-				// Let other commands slip if any.
-				// receiveDataCount is already 0, and status failure results in retries - it's not what we want.
+				//CHECKME: Should else case be handled?
+				break;
+			}
+			case kBPackReserveCmd:
+			case kBDesignCycleCount9CCmd: {
+				setReceiveData(transaction, 1000);
+				break;
+			}
+            case kBReadCellVoltage1Cmd:
+            case kBReadCellVoltage2Cmd:
+            case kBReadCellVoltage3Cmd:
+            case kBReadCellVoltage4Cmd: {
+                setReceiveData(transaction, defaultBatteryCellVoltage);
+                break;
+            }
+            case kBVoltageCmd: {
+                setReceiveData(transaction, snapshot.info.state.presentVoltage);
+                break;
+            }
+			case kBCurrentCmd: {
+				setReceiveData(transaction, snapshot.info.state.signedPresentRate);
+				break;
+			}
+			case kBAverageCurrentCmd: {
+				setReceiveData(transaction, snapshot.info.state.signedAverageRate);
+				break;
+			}
+			case kBSerialNumberCmd:
+			case kBMaxErrorCmd:
+				break;
+			case kBRunTimeToEmptyCmd: {
+				setReceiveData(transaction, snapshot.info.state.runTimeToEmpty);
+				break;
+			}
+			case kBAverageTimeToEmptyCmd: {
+				setReceiveData(transaction, snapshot.info.state.averageTimeToEmpty);
+				break;
 			}
+			case kBTemperatureCmd: {
+				setReceiveData(transaction, snapshot.info.state.temperatureDecikelvin);
+				break;
+			}
+			case kBDesignCapacityCmd: {
+				setReceiveData(transaction, snapshot.info.designCapacity);
+				break;
+			}
+			case kBCycleCountCmd: {
+				setReceiveData(transaction, snapshot.info.cycle);
+				break;
+			}
+			case kBAverageTimeToFullCmd: {
+				setReceiveData(transaction, snapshot.info.state.timeToFull);
+				break;
+			}
+			case kBRemainingCapacityCmd: {
+				setReceiveData(transaction, snapshot.info.state.remainingCapacity);
+				break;
+			}
+			case kBFullChargeCapacityCmd: {
+				setReceiveData(transaction, snapshot.info.state.lastFullChargeCapacity);
+				break;
+			}
+			case kBManufactureDateCmd:
+				setReceiveData(transaction, snapshot.identity.manufactureDate);
+				break;
+			//CHECKME: Should there be a default setting receiveDataCount to 0 or status failure?
 		}
 	}
 
-	if (!requestQueue->setObject(request)) {
-        IOLog("%s::startRequest failed to append a request\n", getName());
-		return kIOSMBusStatusUnknownFailure;
+	if (transaction->address == kSMBusBatteryAddr &&
+		transaction->protocol == kIOSMBusProtocolWriteWord &&
+		transaction->command == kBManufacturerAccessCmd) {
+		if (transaction->sendDataCount == 2 && (transaction->sendData[0] == kBExtendedPFStatusCmd || transaction->sendData[0] == kBExtendedOperationStatusCmd)) {
+			// Nothing can be done here since we don't write any values to hardware, we fake response for this command in handler for
+			// kIOSMBusProtocolReadWord/kBManufacturerAccessCmd. Anyway, AppleSmartBattery::transactionCompletion ignores this response.
+			// If we can see this log statement, it means that fields sendDataCount and sendData have a proper offset in IOSMBusTransaction
+		}
 	}
-    interruptSource->interruptOccurred(nullptr, this, 0);
-    
-    IOSimpleLockLock(BatteryManager::getShared()->stateLock);
-    clock_get_uptime(&BatteryManager::getShared()->lastAccess);
-    IOSimpleLockUnlock(BatteryManager::getShared()->stateLock);
 
-	return result;
+	if (transaction->address == kSMBusBatteryAddr && transaction->protocol == kIOSMBusProtocolReadBlock) {
+		switch (transaction->command) {
+			case kBManufacturerNameCmd:
+			case kBAppleHardwareSerialCmd:
+			case kBDeviceNameCmd: {
+				const char *src = transaction->command == kBManufacturerNameCmd ? snapshot.identity.manufacturer :
+								  transaction->command == kBDeviceNameCmd ? snapshot.identity.deviceName : snapshot.identity.serial;
+				transaction->receiveDataCount = kSMBusMaximumDataSize;
+				memcpy(transaction->receiveData, src, BatteryInfo::MaxStringLen);
+				transaction->receiveData[kSMBusMaximumDataSize-1] = '\0';
+				break;
+			}
+			case kBManufacturerDataCmd:
+				transaction->receiveDataCount = sizeof(BatteryInfo::BatteryManufacturerData);
+				memcpy(reinterpret_cast<UInt16 *>(transaction->receiveData), &snapshot.info.batteryManufacturerData, sizeof(BatteryInfo::BatteryManufacturerData));
+				break;
+			case kBManufacturerInfoCmd:
+				break;
+			// Let other commands slip if any.
+			// receiveDataCount is already 0, and status failure results in retries - it's not what we want.
+		}
+	}
 }
 
 void SurfaceSMBusController::handleBatteryCommandsEvent(IOInterruptEventSource *sender, int count) {
@@ -318,13 +247,47 @@ void SurfaceSMBusController::handleBatteryCommandsEvent(IOInterruptEventSource *
 	// to us in IOSMBusController::performTransactionGated.
 	// OSArray::removeObject takes away our ownership, and then
 	// IOSMBusController::completeRequest releases the request inside.
+	if (requestQueue->getCount() == 0)
+		return;
 
+	// AppleSmartBattery issues the next transaction from the completion of the
+	// previous one, so a whole refresh drains here against a single snapshot
+	SMBusSnapshot snapshot;
+	UInt32 transactions = 0;
+	takeSnapshot(snapshot);
 	while (requestQueue->getCount() != 0) {
 		auto request = OSDynamicCast(IOSMBusRequest, requestQueue->getObject(0));
 		requestQueue->removeObject(0);
-		if (request != nullptr)
+		if (request != nullptr) {
+			if (request->transaction)
+				answerRequest(request->transaction, snapshot);
 			completeRequest(request);
+			transactions++;
+		}
+	}
+
+	refreshLatency.recordSince(refreshStart);
+	refreshStart = 0;
+	BatteryManager::getShared()->count(BatteryCounterSMBusRefreshes);
+	publishRefreshStatistics(transactions);
+}
+
+void SurfaceSMBusController::publishRefreshStatistics(UInt32 transactions) {
+	OSDictionary *stats = OSDictionary::withCapacity(2);
+	if (!stats)
+		return;
+	OSNumber *num = OSNumber::withNumber(transactions, 32);
+	if (num) {
+		stats->setObject("LastTransactions", num);
+		num->release();
+	}
+	OSDictionary *latency = refreshLatency.copySummary();
+	if (latency) {
+		stats->setObject("Latency", latency);
+		latency->release();
 	}
+	setProperty("SMBusRefresh", stats);
+	stats->release();
 }
 
 IOReturn SurfaceSMBusController::handleACPINotification(void *target) {
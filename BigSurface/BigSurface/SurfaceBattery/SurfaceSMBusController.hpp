@@ -13,6 +13,19 @@
 #include <IOKit/battery/AppleSmartBatteryCommands.h>
 
 #include "BatteryManager.hpp"
+#include "../LatencyHistogram.hpp"
+#include "../WorkLoopBands.hpp"
+
+/**
+ *  Battery state an entire refresh is answered from
+ */
+struct SMBusSnapshot {
+	BatteryInfo info {};
+	BatteryIdentity identity {};
+	UInt16 batteryStatus {0};
+	bool externalPowerConnected {false};
+	bool batteriesConnected {false};
+};
 
 class EXPORT SurfaceSMBusController : public IOSMBusController {
 	OSDeclareDefaultStructors(SurfaceSMBusController)
@@ -47,17 +60,36 @@ class EXPORT SurfaceSMBusController : public IOSMBusController {
 	OSArray *requestQueue {nullptr};
 
 	/**
-	 *  Create battery date in AppleSmartBattery format
+	 *  When the first request of the refresh in progress was queued
+	 */
+	AbsoluteTime refreshStart {0};
+
+	/**
+	 *  Time from the first request of a refresh until the queue is drained
+	 */
+	LatencyHistogram refreshLatency {};
+
+	/**
+	 *  Copy everything requests are answered from under a single lock hold
 	 *
-	 *  @param day     manufacturing date
-	 *  @param month   manufacturing month
-	 *  @param year    manufacturing year
+	 *  @param snapshot  destination
+	 */
+	static void takeSnapshot(SMBusSnapshot &snapshot);
+
+	/**
+	 *  Fill in the response of a single transaction
 	 *
-	 *  @return date in AppleSmartBattery format
+	 *  @param transaction  SMBus transaction
+	 *  @param snapshot     battery state of this refresh
 	 */
-	static constexpr UInt16 makeBatteryDate(UInt16 day, UInt16 month, UInt16 year) {
-		return (day & 0x1FU) | ((month & 0xFU) << 5U) | (((year - 1980U) & 0x7FU) << 9U);
-	}
+	static void answerRequest(IOSMBusTransaction *transaction, const SMBusSnapshot &snapshot);
+
+	/**
+	 *  Publish transactions of the last refresh and refresh latency
+	 *
+	 *  @param transactions  number of transactions completed in the last refresh
+	 */
+	void publishRefreshStatistics(UInt32 transactions);
 
 public:	
 	/**
@@ -7,6 +7,9 @@
 //
 
 #include "SurfaceButtonDriver.hpp"
+#include "../BigSurfaceDiagnostics/Tracepoints.hpp"
+#include "../BootTimeline.hpp"
+#include "../TimerCoalescer.hpp"
 
 #define super IOService
 OSDefineMetaClassAndStructors(SurfaceButtonDriver, IOService)
@@ -82,29 +85,78 @@ IOReturn SurfaceButtonDriver::getDeviceResources() {
     }
 }
 
+bool SurfaceButtonDriver::filterInterrupt(IOFilterInterruptEventSource* sender) {
+    int btn_idx = sender->getIntIndex();
+    UInt64 now;
+    clock_get_uptime(&now);
+    if (!irq_time[btn_idx])
+        irq_time[btn_idx] = now;
+    // the power button pin always reads high, its status comes from the edge count
+    if (fast_path && btn_idx != POWER_BUTTON_IDX) {
+        /*
+         * Primary interrupt context: this relies on VoodooGPIO's getPinStatus()
+         * being a plain register read that neither blocks nor takes a lock.
+         */
+        UInt64 read_done;
+        irq_pin_status[btn_idx] = gpio_controller->getPinStatus(gpio_pin[btn_idx]);
+        clock_get_uptime(&read_done);
+        irq_read_time[btn_idx] = read_done - now;
+    }
+    return true;
+}
+
+UInt64 SurfaceButtonDriver::consumeInterruptTime(int btn_idx) {
+    UInt64 irq = irq_time[btn_idx];
+    if (irq) {
+        irq_time[btn_idx] = 0;
+        latency[ButtonLatencyDispatch].recordSince(irq);
+    }
+    return irq;
+}
+
+bool SurfaceButtonDriver::readPinStatus(int btn_idx) {
+    if (fast_path) {
+        // the filter only stamps the read, the histogram is updated here on the work loop
+        UInt64 read = irq_read_time[btn_idx];
+        if (read) {
+            UInt64 ns;
+            irq_read_time[btn_idx] = 0;
+            absolutetime_to_nanoseconds(read, &ns);
+            latency[ButtonLatencyRead].record(ns / 1000);
+        }
+        return irq_pin_status[btn_idx];
+    }
+    UInt64 start;
+    clock_get_uptime(&start);
+    bool button_status = gpio_controller->getPinStatus(gpio_pin[btn_idx]);
+    latency[ButtonLatencyRead].recordSince(start);
+    return button_status;
+}
+
 void SurfaceButtonDriver::powerInterruptOccured(IOInterruptEventSource* src, int intCount) {
-    response(POWER_BUTTON_IDX, intCount % 2);
+    UInt64 irq = consumeInterruptTime(POWER_BUTTON_IDX);
+    response(POWER_BUTTON_IDX, intCount % 2, irq);
 }
 
 void SurfaceButtonDriver::volumeUpInterruptOccured(IOInterruptEventSource* src, int intCount) {
+    UInt64 irq = consumeInterruptTime(VOLUME_UP_BUTTON_IDX);
     if (!awake)
         return;
     stopInterrupt(VOLUME_DOWN_BUTTON_IDX);
-    bool button_status = gpio_controller->getPinStatus(gpio_pin[VOLUME_UP_BUTTON_IDX]);
-    response(VOLUME_UP_BUTTON_IDX, button_status);
+    response(VOLUME_UP_BUTTON_IDX, readPinStatus(VOLUME_UP_BUTTON_IDX), irq);
     startInterrupt(VOLUME_DOWN_BUTTON_IDX);
 }
 
 void SurfaceButtonDriver::volumeDownInterruptOccured(IOInterruptEventSource* src, int intCount) {
+    UInt64 irq = consumeInterruptTime(VOLUME_DOWN_BUTTON_IDX);
     if (!awake)
         return;
     stopInterrupt(VOLUME_UP_BUTTON_IDX);
-    bool button_status = gpio_controller->getPinStatus(gpio_pin[VOLUME_DOWN_BUTTON_IDX]);
-    response(VOLUME_DOWN_BUTTON_IDX, button_status);
+    response(VOLUME_DOWN_BUTTON_IDX, readPinStatus(VOLUME_DOWN_BUTTON_IDX), irq);
     startInterrupt(VOLUME_UP_BUTTON_IDX);
 }
 
-void SurfaceButtonDriver::response(int btn_idx, bool status) {
+void SurfaceButtonDriver::response(int btn_idx, bool status, UInt64 irq) {
     if (btn_idx >= BTN_CNT)
         return;
     
@@ -115,10 +167,39 @@ void SurfaceButtonDriver::response(int btn_idx, bool status) {
     } else
         btn_status[btn_idx] = status;
     DBG_LOG("%s %s!", BTN_DESCRIPTION[btn_idx], btn_status[btn_idx]?"pressed":"released");
+    TRACEPOINT(TraceButton, TraceButtonEvent, btn_idx, btn_status[btn_idx]);
+    UInt64 report, now;
+    clock_get_uptime(&report);
     button_device->simulateKeyboardEvent(BTN_CMD_PAGE[btn_idx], BTN_CMD[btn_idx], btn_status[btn_idx]);
+    clock_get_uptime(&now);
+    latency[ButtonLatencyReport].recordInterval(report, now);
+    latency[ButtonLatencyTotal].recordInterval(irq, now);
+}
+
+// runs on the telemetry band, the input band only records
+void SurfaceButtonDriver::publishLatency(IOTimerEventSource* timer) {
+    static const char *stage_names[ButtonLatencyStageCount] = {"Dispatch", "Read", "Report", "Total"};
+    TimerCoalescer::setTimeoutMS(timer, BTN_STATS_INTERVAL, BTN_STATS_TOLERANCE);
+    UInt64 cnt = latency[ButtonLatencyTotal].count;
+    if (cnt == published_cnt)
+        return;
+    published_cnt = cnt;
+    OSDictionary *stats = OSDictionary::withCapacity(ButtonLatencyStageCount);
+    if (!stats)
+        return;
+    for (int i = 0; i < ButtonLatencyStageCount; i++) {
+        OSDictionary *summary = latency[i].copySummary();
+        if (summary) {
+            stats->setObject(stage_names[i], summary);
+            summary->release();
+        }
+    }
+    setProperty("ButtonLatency", stats);
+    stats->release();
 }
 
 IOService *SurfaceButtonDriver::probe(IOService *provider, SInt32 *score){
+    BootTimeline::begin(BootStageButtonProbe);
     if (!super::probe(provider, score))
         return nullptr;
     
@@ -131,31 +212,40 @@ IOService *SurfaceButtonDriver::probe(IOService *provider, SInt32 *score){
         return nullptr;
     }
     
+    BootTimeline::begin(BootStageButtonControllerWait);
     gpio_controller = getGPIOController();
     if (!gpio_controller) {
         LOG("Could not find GPIO controller, exiting");
         return nullptr;
     }
+    BootTimeline::end(BootStageButtonControllerWait);
     // Give the GPIO controller some time to load
+    BootTimeline::begin(BootStageButtonSettle);
     IOSleep(100);
+    BootTimeline::end(BootStageButtonSettle);
     
     LOG("Surface ACPI button device found!");
+    BootTimeline::end(BootStageButtonProbe);
     
     return this;
 }
 
 bool SurfaceButtonDriver::start(IOService *provider) {
+    BootTimeline::begin(BootStageButtonStart);
     if (!super::start(provider))
         return false;
 
-    work_loop = IOWorkLoop::workLoop();
+    if (OSBoolean *fast = OSDynamicCast(OSBoolean, getProperty("FilterFastPath")))
+        fast_path = fast->isTrue();
+    
+    work_loop = WorkLoopBands::acquire(WorkLoopBandInput);
     if (!work_loop) {
         LOG("Could not get work loop");
         goto exit;
     }
-    interrupt_source[POWER_BUTTON_IDX] = IOInterruptEventSource::interruptEventSource(this, OSMemberFunctionCast(IOInterruptEventAction, this, &SurfaceButtonDriver::powerInterruptOccured), this, POWER_BUTTON_IDX);
-    interrupt_source[VOLUME_UP_BUTTON_IDX] = IOInterruptEventSource::interruptEventSource(this, OSMemberFunctionCast(IOInterruptEventAction, this, &SurfaceButtonDriver::volumeUpInterruptOccured), this, VOLUME_UP_BUTTON_IDX);
-    interrupt_source[VOLUME_DOWN_BUTTON_IDX] = IOInterruptEventSource::interruptEventSource(this, OSMemberFunctionCast(IOInterruptEventAction, this, &SurfaceButtonDriver::volumeDownInterruptOccured), this, VOLUME_DOWN_BUTTON_IDX);
+    interrupt_source[POWER_BUTTON_IDX] = IOFilterInterruptEventSource::filterInterruptEventSource(this, OSMemberFunctionCast(IOInterruptEventAction, this, &SurfaceButtonDriver::powerInterruptOccured), OSMemberFunctionCast(IOFilterInterruptAction, this, &SurfaceButtonDriver::filterInterrupt), this, POWER_BUTTON_IDX);
+    interrupt_source[VOLUME_UP_BUTTON_IDX] = IOFilterInterruptEventSource::filterInterruptEventSource(this, OSMemberFunctionCast(IOInterruptEventAction, this, &SurfaceButtonDriver::volumeUpInterruptOccured), OSMemberFunctionCast(IOFilterInterruptAction, this, &SurfaceButtonDriver::filterInterrupt), this, VOLUME_UP_BUTTON_IDX);
+    interrupt_source[VOLUME_DOWN_BUTTON_IDX] = IOFilterInterruptEventSource::filterInterruptEventSource(this, OSMemberFunctionCast(IOInterruptEventAction, this, &SurfaceButtonDriver::volumeDownInterruptOccured), OSMemberFunctionCast(IOFilterInterruptAction, this, &SurfaceButtonDriver::filterInterrupt), this, VOLUME_DOWN_BUTTON_IDX);
     if (!interrupt_source[POWER_BUTTON_IDX] || !interrupt_source[VOLUME_UP_BUTTON_IDX] || !interrupt_source[VOLUME_DOWN_BUTTON_IDX]) {
         LOG("Could not create interrupt event source");
         goto exit;
@@ -164,16 +254,35 @@ bool SurfaceButtonDriver::start(IOService *provider) {
     work_loop->addEventSource(interrupt_source[VOLUME_UP_BUTTON_IDX]);
     work_loop->addEventSource(interrupt_source[VOLUME_DOWN_BUTTON_IDX]);
     
+    telemetry_loop = WorkLoopBands::acquire(WorkLoopBandTelemetry);
+    if (!telemetry_loop) {
+        LOG("Could not get telemetry work loop");
+        goto exit;
+    }
+    stats_timer = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &SurfaceButtonDriver::publishLatency));
+    if (!stats_timer) {
+        LOG("Could not create statistics timer");
+        goto exit;
+    }
+    telemetry_loop->addEventSource(stats_timer);
+    TimerCoalescer::setTimeoutMS(stats_timer, BTN_STATS_INTERVAL, BTN_STATS_TOLERANCE);
+    
     button_device = OSTypeAlloc(SurfaceButtonDevice);
     if (!button_device || !button_device->init() || !button_device->attach(this) || !button_device->start(this)) {
         LOG("Failed to init and start Surface Button HID Device!");
         goto exit;
     }
     
+    if (!PowerOrchestrator::registerDomain(PowerDomainButton, this, OSMemberFunctionCast(PowerOrchestrator::Transition, this, &SurfaceButtonDriver::powerTransition))) {
+        LOG("Failed to register power domain");
+        goto exit;
+    }
+    
     PMinit();
     acpi_device->joinPMtree(this);
     registerPowerDriver(this, myIOPMPowerStates, kIOPMNumberPowerStates);
     
+    BootTimeline::end(BootStageButtonStart);
     return true;
 exit:
     releaseResources();
@@ -189,7 +298,11 @@ void SurfaceButtonDriver::stop(IOService *provider) {
 IOReturn SurfaceButtonDriver::setPowerState(unsigned long whichState, IOService *whatDevice) {
     if (whatDevice != this)
         return kIOReturnInvalid;
-    if (whichState == 0) {
+    return PowerOrchestrator::scheduleTransition(PowerDomainButton, whichState != 0);
+}
+
+void SurfaceButtonDriver::powerTransition(bool wake) {
+    if (!wake) {
         if (awake) {
             stopInterrupt(POWER_BUTTON_IDX);
             stopInterrupt(VOLUME_UP_BUTTON_IDX);
@@ -200,14 +313,15 @@ IOReturn SurfaceButtonDriver::setPowerState(unsigned long whichState, IOService
     } else {
         if (!awake) {
             awake = true;
-            IOSleep(100);   // Wait for SSH to notify d0-entry and display-on
+            // SSH has to notify d0-entry and display-on first
+            if (!PowerOrchestrator::waitReady(PowerDomainSSH, POWER_READY_TIMEOUT))
+                LOG("SSH not ready after wake");
             startInterrupt(POWER_BUTTON_IDX);
             startInterrupt(VOLUME_UP_BUTTON_IDX);
             startInterrupt(VOLUME_DOWN_BUTTON_IDX);
             DBG_LOG("Woke up");
         }
     }
-    return kIOPMAckImplied;
 }
 
 IOReturn SurfaceButtonDriver::enableInterrupt(int source) {
@@ -248,6 +362,14 @@ void SurfaceButtonDriver::stopInterrupt(int source) {
 }
 
 void SurfaceButtonDriver::releaseResources() {
+    PowerOrchestrator::unregisterDomain(PowerDomainButton, this);
+    if (stats_timer) {
+        stats_timer->cancelTimeout();
+        stats_timer->disable();
+        telemetry_loop->removeEventSource(stats_timer);
+        OSSafeReleaseNULL(stats_timer);
+    }
+    WorkLoopBands::release(WorkLoopBandTelemetry, telemetry_loop);
     if (interrupt_source[POWER_BUTTON_IDX]) {
         stopInterrupt(POWER_BUTTON_IDX);
         work_loop->removeEventSource(interrupt_source[POWER_BUTTON_IDX]);
@@ -263,7 +385,7 @@ void SurfaceButtonDriver::releaseResources() {
         work_loop->removeEventSource(interrupt_source[VOLUME_DOWN_BUTTON_IDX]);
         OSSafeReleaseNULL(interrupt_source[VOLUME_DOWN_BUTTON_IDX]);
     }
-    OSSafeReleaseNULL(work_loop);
+    WorkLoopBands::release(WorkLoopBandInput, work_loop);
     
     OSSafeReleaseNULL(button_device);
 }
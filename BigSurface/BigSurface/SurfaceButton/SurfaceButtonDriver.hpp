@@ -10,11 +10,16 @@
 #define SurfaceButtonDriver_hpp
 
 #include <IOKit/acpi/IOACPIPlatformDevice.h>
+#include <IOKit/IOFilterInterruptEventSource.h>
+#include <IOKit/IOTimerEventSource.h>
 
 #include "../../../Dependencies/VoodooGPIO/VoodooGPIO/VoodooGPIO.hpp"
 #include "../../../Dependencies/VoodooSerial/VoodooSerial/ACPIParser/VoodooACPIResourcesParser.hpp"
 #include "../helpers.hpp"
 #include "SurfaceButtonDevice.hpp"
+#include "../PowerOrchestrator.hpp"
+#include "../WorkLoopBands.hpp"
+#include "../LatencyHistogram.hpp"
 
 #define BTN_CNT 3
 
@@ -22,17 +27,31 @@
 #define VOLUME_UP_BUTTON_IDX    1
 #define VOLUME_DOWN_BUTTON_IDX  2
 
+#define BTN_STATS_INTERVAL      5000    // ms
+#define BTN_STATS_TOLERANCE     1000    // ms
+
 const char *BTN_DESCRIPTION[BTN_CNT] = {"Power Button", "Volume Up Button", "Volume Down Button"};
 const UInt32 BTN_CMD[BTN_CNT] = {kHIDUsage_Csmr_Power, kHIDUsage_Csmr_VolumeIncrement, kHIDUsage_Csmr_VolumeDecrement};
 const UInt32 BTN_CMD_PAGE[BTN_CNT] = {kHIDPage_Consumer, kHIDPage_Consumer, kHIDPage_Consumer};
 
+// stages from the GPIO edge to the HID report, the last one is end to end
+enum ButtonLatencyStage {
+    ButtonLatencyDispatch = 0,  // interrupt filter to the action on the work loop
+    ButtonLatencyRead,          // getPinStatus, inside the filter on the fast path
+    ButtonLatencyReport,        // HID report
+    ButtonLatencyTotal,
+    ButtonLatencyStageCount,
+};
+
 class EXPORT SurfaceButtonDriver : public IOService {
     OSDeclareDefaultStructors(SurfaceButtonDriver);
     
 private:
     IOWorkLoop*             work_loop {nullptr};
+    IOWorkLoop*             telemetry_loop {nullptr};
+    IOTimerEventSource*     stats_timer {nullptr};
     VoodooGPIO*             gpio_controller {nullptr};
-    IOInterruptEventSource* interrupt_source[BTN_CNT] = {nullptr, nullptr, nullptr};
+    IOFilterInterruptEventSource* interrupt_source[BTN_CNT] = {nullptr, nullptr, nullptr};
     IOACPIPlatformDevice*   acpi_device {nullptr};
     SurfaceButtonDevice*    button_device {nullptr};
     
@@ -42,25 +61,47 @@ private:
     UInt16  gpio_pin[BTN_CNT] = {0,0,0};
     bool    awake {false};    
     
+    /*
+     * With FilterFastPath set in the personality the pin is read in the
+     * interrupt filter, so the status belongs to the edge that raised the
+     * interrupt and the work loop only sends the report.
+     */
+    bool            fast_path {false};
+    volatile UInt64 irq_time[BTN_CNT] = {0,0,0};    // first unhandled edge
+    volatile bool   irq_pin_status[BTN_CNT] = {false, false, false};
+    volatile UInt64 irq_read_time[BTN_CNT] = {0,0,0};   // duration of the filter's pin read, absolute time
+    LatencyHistogram latency[ButtonLatencyStageCount] {};
+    UInt64          published_cnt {0};      // edges covered by the last ButtonLatency property
+    
     void startInterrupt(int source);
     
     void stopInterrupt(int source);
     
     void releaseResources();
     
+    void powerTransition(bool wake);
+    
     IOReturn getDeviceResources();
     
     IOReturn parseButtonResources(VoodooACPIResourcesParser* parser1, VoodooACPIResourcesParser* parser2, VoodooACPIResourcesParser* parser3);
     
     VoodooGPIO* getGPIOController();
     
+    bool filterInterrupt(IOFilterInterruptEventSource* sender);
+    
+    UInt64 consumeInterruptTime(int btn_idx);
+    
+    bool readPinStatus(int btn_idx);
+    
     void powerInterruptOccured(IOInterruptEventSource* src, int intCount);
     
     void volumeUpInterruptOccured(IOInterruptEventSource* src, int intCount);
     
     void volumeDownInterruptOccured(IOInterruptEventSource* src, int intCount);
     
-    void response(int btn_idx, bool status);
+    void response(int btn_idx, bool status, UInt64 irq);
+    
+    void publishLatency(IOTimerEventSource* timer);
     
 public:
     IOReturn enableInterrupt(int source) override;
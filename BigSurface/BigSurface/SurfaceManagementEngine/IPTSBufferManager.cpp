@@ -0,0 +1,130 @@
+//
+//  IPTSBufferManager.cpp
+//  SurfaceTouchScreen
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include "IPTSBufferManager.hpp"
+
+IPTSBufferManager::~IPTSBufferManager() {
+    deallocate();
+}
+
+IOReturn IPTSBufferManager::allocate(UInt32 data_size, UInt32 feedback_size) {
+    if (isAllocated(data_size, feedback_size))
+        return kIOReturnSuccess;
+    deallocate();
+    
+    IOReturn ret = kIOReturnSuccess;
+    for (int i = 0; i < IPTS_BUFFERS && ret == kIOReturnSuccess; i++) {
+        ret = allocateBuffer(&data[i], data_size);
+        if (ret == kIOReturnSuccess)
+            ret = allocateBuffer(&feedback[i], feedback_size);
+    }
+    if (ret == kIOReturnSuccess)
+        ret = allocateBuffer(&doorbell, sizeof(UInt32));
+    if (ret == kIOReturnSuccess)
+        ret = allocateBuffer(&workqueue, IPTS_WORKQUEUE_SIZE);
+    if (ret == kIOReturnSuccess)
+        ret = allocateBuffer(&hid2me, feedback_size);
+    
+    if (ret != kIOReturnSuccess) {
+        deallocate();
+        return ret;
+    }
+    allocated = true;
+    return kIOReturnSuccess;
+}
+
+void IPTSBufferManager::deallocate() {
+    for (int i = 0; i < IPTS_BUFFERS; i++) {
+        freeBuffer(&data[i]);
+        freeBuffer(&feedback[i]);
+    }
+    freeBuffer(&doorbell);
+    freeBuffer(&workqueue);
+    freeBuffer(&hid2me);
+    allocated = false;
+}
+
+IOReturn IPTSBufferManager::allocateBuffer(IPTSDMABuffer *buffer, UInt32 size) {
+    IODMACommand::Segment64 segment;
+    UInt64 offset = 0;
+    UInt32 num_segments = 1;
+    
+    buffer->size = size;
+    buffer->memory = IOBufferMemoryDescriptor::inTaskWithPhysicalMask(kernel_task, kIODirectionInOut | kIOMemoryPhysicallyContiguous, size, 0xFFFFFFFFFFFFF000ULL);
+    if (!buffer->memory)
+        return kIOReturnNoMemory;
+    if (buffer->memory->prepare() != kIOReturnSuccess) {
+        OSSafeReleaseNULL(buffer->memory);
+        return kIOReturnNoMemory;
+    }
+    buffer->vaddr = static_cast<UInt8 *>(buffer->memory->getBytesNoCopy());
+    memset(buffer->vaddr, 0, size);
+    
+    buffer->dma = IODMACommand::withSpecification(kIODMACommandOutputHost64, 64, 0, IODMACommand::kMapped, 0, 1);
+    if (!buffer->dma || buffer->dma->setMemoryDescriptor(buffer->memory) != kIOReturnSuccess ||
+        buffer->dma->gen64IOVMSegments(&offset, &segment, &num_segments) != kIOReturnSuccess || num_segments != 1) {
+        freeBuffer(buffer);
+        return kIOReturnNoResources;
+    }
+    buffer->iova = segment.fIOVMAddr;
+    return kIOReturnSuccess;
+}
+
+void IPTSBufferManager::freeBuffer(IPTSDMABuffer *buffer) {
+    if (buffer->dma) {
+        buffer->dma->clearMemoryDescriptor();
+        OSSafeReleaseNULL(buffer->dma);
+    }
+    if (buffer->memory) {
+        buffer->memory->complete();
+        OSSafeReleaseNULL(buffer->memory);
+    }
+    buffer->vaddr = nullptr;
+    buffer->iova = 0;
+}
+
+void IPTSBufferManager::fillMemoryWindow(IPTSSetMemWindow *window) {
+    memset(window, 0, sizeof(IPTSSetMemWindow));
+    for (int i = 0; i < IPTS_BUFFERS; i++) {
+        window->data_addr_lower[i] = static_cast<UInt32>(data[i].iova);
+        window->data_addr_upper[i] = static_cast<UInt32>(data[i].iova >> 32);
+        window->feedback_addr_lower[i] = static_cast<UInt32>(feedback[i].iova);
+        window->feedback_addr_upper[i] = static_cast<UInt32>(feedback[i].iova >> 32);
+    }
+    window->workqueue_addr_lower = static_cast<UInt32>(workqueue.iova);
+    window->workqueue_addr_upper = static_cast<UInt32>(workqueue.iova >> 32);
+    window->doorbell_addr_lower = static_cast<UInt32>(doorbell.iova);
+    window->doorbell_addr_upper = static_cast<UInt32>(doorbell.iova >> 32);
+    window->hid2me_addr_lower = static_cast<UInt32>(hid2me.iova);
+    window->hid2me_addr_upper = static_cast<UInt32>(hid2me.iova >> 32);
+    window->hid2me_size = hid2me.size;
+    window->workqueue_item_size = IPTS_WORKQUEUE_ITEM_SIZE;
+    window->workqueue_size = IPTS_WORKQUEUE_SIZE;
+    
+    *reinterpret_cast<volatile UInt32 *>(doorbell.vaddr) = 0;
+    current = 0;
+}
+
+const UInt8 *IPTSBufferManager::peekFilled(UInt32 *index, UInt32 *len) {
+    if (!allocated)
+        return nullptr;
+    
+    UInt32 bell = *reinterpret_cast<volatile UInt32 *>(doorbell.vaddr);
+    if (bell == current)
+        return nullptr;
+    // the doorbell must be read before the buffer contents
+    __sync_synchronize();
+    
+    *index = current % IPTS_BUFFERS;
+    IPTSDMABuffer *buffer = &data[*index];
+    const IPTSData *header = reinterpret_cast<const IPTSData *>(buffer->vaddr);
+    *len = sizeof(IPTSData) + header->size;
+    if (*len > buffer->size)
+        *len = buffer->size;
+    filled_cnt++;
+    return buffer->vaddr;
+}
@@ -0,0 +1,72 @@
+//
+//  IPTSBufferManager.hpp
+//  SurfaceTouchScreen
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef IPTSBufferManager_hpp
+#define IPTSBufferManager_hpp
+
+#include <IOKit/IOBufferMemoryDescriptor.h>
+#include <IOKit/IODMACommand.h>
+
+#include "IPTSProtocol.h"
+#include "../helpers.hpp"
+#include "../TaggedAllocator.hpp"
+
+// the READY_FOR_DATA response drains the buffers, polling only catches a lost one
+#define IPTS_DOORBELL_POLL_INTERVAL     100     // ms
+#define IPTS_DOORBELL_POLL_TOLERANCE    50      // ms
+#define IPTS_BUFFER_MAX_SIZE            (256 * 1024)
+
+struct IPTSDMABuffer {
+    IOBufferMemoryDescriptor*   memory;
+    IODMACommand*               dma;
+    UInt8*                      vaddr;
+    UInt64                      iova;
+    UInt32                      size;
+};
+
+/*
+ * Host side of the IPTS memory window: the device writes frames into one of
+ * IPTS_BUFFERS data buffers and bumps the doorbell, the host consumes them in
+ * order and hands each back with a feedback command.
+ */
+class IPTSBufferManager : public TaggedObject<AllocTagIPTS> {
+public:
+    ~IPTSBufferManager();
+    
+    IOReturn allocate(UInt32 data_size, UInt32 feedback_size);
+    
+    void deallocate();
+    
+    bool isAllocated(UInt32 data_size, UInt32 feedback_size) {
+        return allocated && data[0].size == data_size && feedback[0].size == feedback_size;
+    }
+    
+    // SET_MEM_WINDOW payload describing the buffers, also restarts from buffer 0
+    void fillMemoryWindow(IPTSSetMemWindow *window);
+    
+    // next filled buffer in order, nullptr if the doorbell has not moved
+    const UInt8 *peekFilled(UInt32 *index, UInt32 *len);
+    
+    void consumed() { current++; }
+    
+    UInt64 filled_cnt {0};
+    
+private:
+    IPTSDMABuffer   data[IPTS_BUFFERS] {};
+    IPTSDMABuffer   feedback[IPTS_BUFFERS] {};
+    IPTSDMABuffer   doorbell {};
+    IPTSDMABuffer   workqueue {};
+    IPTSDMABuffer   hid2me {};
+    UInt32          current {0};
+    bool            allocated {false};
+    
+    IOReturn allocateBuffer(IPTSDMABuffer *buffer, UInt32 size);
+    
+    void freeBuffer(IPTSDMABuffer *buffer);
+};
+
+#endif /* IPTSBufferManager_hpp */
@@ -0,0 +1,172 @@
+//
+//  IPTSContactDetector.cpp
+//  SurfaceTouchScreen
+//
+//  Created by agent on 2026/10/18.
+//
+
+// IPTS_DETECT_SCALAR keeps the kext code path on the host, to hold both to the same output
+#if !defined(KERNEL) && !defined(IPTS_DETECT_SCALAR)
+#if defined(__AVX2__)
+#define IPTS_DETECT_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#define IPTS_DETECT_SSE2
+#include <emmintrin.h>
+#endif
+#endif
+
+#include "IPTSContactDetector.hpp"
+
+static UInt64 isqrt(UInt64 n) {
+    UInt64 res = 0;
+    UInt64 bit = 1ULL << 62;
+    while (bit > n)
+        bit >>= 2;
+    while (bit) {
+        if (n >= res + bit) {
+            n -= res + bit;
+            res = (res >> 1) + bit;
+        } else
+            res >>= 1;
+        bit >>= 2;
+    }
+    return res;
+}
+
+UInt32 IPTSContactDetector::detect(const IPTSHeatmapDim *dim, const UInt8 *heatmap, IPTSContact *contacts, UInt32 max_contacts) {
+    UInt32 len = dim->width * dim->height;
+    if (!len || len > IPTS_HEATMAP_MAX_SIZE || dim->z_max <= dim->z_min)
+        return 0;
+    
+    UInt8 range = dim->z_max - dim->z_min;
+    UInt8 limit = range * IPTS_CONTACT_THRESHOLD_PCT / 100;
+    if (!limit)
+        limit = 1;
+    
+    // most frames are empty, skip segmentation entirely for them
+    if (!threshold(heatmap, len, dim->z_max, limit))
+        return 0;
+    
+    UInt32 cnt = 0;
+    for (UInt32 i = 0; i < len && cnt < max_contacts; i++) {
+        if (map[i] && segment(i, dim->width, dim->height, range, &contacts[cnt]))
+            cnt++;
+    }
+    return cnt;
+}
+
+UInt32 IPTSContactDetector::threshold(const UInt8 *heatmap, UInt32 len, UInt8 z_max, UInt8 limit) {
+    UInt32 active = 0;
+    UInt32 i = 0;
+    
+    // the sensor reports z_max for no touch, invert so that touch is positive
+#if defined(IPTS_DETECT_AVX2)
+    __m256i zmax32 = _mm256_set1_epi8(static_cast<char>(z_max));
+    __m256i limit32 = _mm256_set1_epi8(static_cast<char>(limit));
+    for (; i + 32 <= len; i += 32) {
+        __m256i value = _mm256_subs_epu8(zmax32, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(heatmap + i)));
+        __m256i keep = _mm256_cmpeq_epi8(_mm256_max_epu8(value, limit32), value);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(map + i), _mm256_and_si256(value, keep));
+        active += __builtin_popcount(static_cast<UInt32>(_mm256_movemask_epi8(keep)));
+    }
+#endif
+#if defined(IPTS_DETECT_AVX2) || defined(IPTS_DETECT_SSE2)
+    __m128i zmax16 = _mm_set1_epi8(static_cast<char>(z_max));
+    __m128i limit16 = _mm_set1_epi8(static_cast<char>(limit));
+    for (; i + 16 <= len; i += 16) {
+        __m128i value = _mm_subs_epu8(zmax16, _mm_loadu_si128(reinterpret_cast<const __m128i *>(heatmap + i)));
+        __m128i keep = _mm_cmpeq_epi8(_mm_max_epu8(value, limit16), value);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(map + i), _mm_and_si128(value, keep));
+        active += __builtin_popcount(static_cast<UInt32>(_mm_movemask_epi8(keep)));
+    }
+#endif
+    for (; i < len; i++) {
+        UInt8 value = heatmap[i] < z_max ? z_max - heatmap[i] : 0;
+        if (value >= limit) {
+            map[i] = value;
+            active++;
+        } else
+            map[i] = 0;
+    }
+    return active;
+}
+
+bool IPTSContactDetector::segment(UInt32 seed, UInt8 width, UInt8 height, UInt8 range, IPTSContact *contact) {
+    UInt64 sum = 0, sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0;
+    UInt32 pixels = 0;
+    UInt8 peak = 0;
+    UInt32 top = 0;
+    
+    // flood fill, pixels are cleared in the map when pushed so each is pushed once
+    auto visit = [&](UInt32 idx) {
+        UInt8 value = map[idx];
+        UInt32 x = idx % width;
+        UInt32 y = idx / width;
+        map[idx] = 0;
+        sum += value;
+        sx += x * value;
+        sy += y * value;
+        sxx += x * x * value;
+        syy += y * y * value;
+        sxy += x * y * value;
+        pixels++;
+        if (value > peak)
+            peak = value;
+        stack[top++] = idx;
+    };
+    
+    visit(seed);
+    while (top) {
+        UInt32 idx = stack[--top];
+        UInt32 x = idx % width;
+        UInt32 y = idx / width;
+        if (x > 0 && map[idx - 1])
+            visit(idx - 1);
+        if (x + 1 < width && map[idx + 1])
+            visit(idx + 1);
+        if (y > 0 && map[idx - width])
+            visit(idx - width);
+        if (y + 1 < height && map[idx + width])
+            visit(idx + width);
+    }
+    
+    if (pixels < IPTS_CONTACT_MIN_PIXELS || !sum)
+        return false;
+    
+    // centroid in 1/256 pixels, second moments in 1/65536 pixels^2
+    SInt64 mx = static_cast<SInt64>((sx << 8) / sum);
+    SInt64 my = static_cast<SInt64>((sy << 8) / sum);
+    SInt64 cxx = static_cast<SInt64>((sxx << 16) / sum) - mx * mx;
+    SInt64 cyy = static_cast<SInt64>((syy << 16) / sum) - my * my;
+    SInt64 cxy = static_cast<SInt64>((sxy << 16) / sum) - mx * my;
+    if (cxx < 0)
+        cxx = 0;
+    if (cyy < 0)
+        cyy = 0;
+    
+    // eigenvalues of the covariance matrix give the ellipse axes
+    SInt64 half_trace = (cxx + cyy) / 2;
+    SInt64 half_diff = (cxx - cyy) / 2;
+    SInt64 root = static_cast<SInt64>(isqrt(static_cast<UInt64>(half_diff * half_diff + cxy * cxy)));
+    SInt64 major = half_trace + root;
+    SInt64 minor = half_trace - root;
+    if (minor < 0)
+        minor = 0;
+    
+    contact->x = static_cast<UInt16>(mx);
+    contact->y = static_cast<UInt16>(my);
+    UInt64 major_axis = 2 * isqrt(static_cast<UInt64>(major));
+    UInt64 minor_axis = 2 * isqrt(static_cast<UInt64>(minor));
+    contact->major = static_cast<UInt16>(major_axis > 0xFFFF ? 0xFFFF : major_axis);
+    contact->minor = static_cast<UInt16>(minor_axis > 0xFFFF ? 0xFFFF : minor_axis);
+    contact->peak = peak;
+    
+    // palms are large and flat, trust them less
+    UInt32 confidence = peak * 255U / range;
+    if (pixels > IPTS_CONTACT_PALM_PIXELS)
+        confidence /= 2;
+    contact->confidence = static_cast<UInt8>(confidence > 255 ? 255 : confidence);
+    contact->reserved = 0;
+    return true;
+}
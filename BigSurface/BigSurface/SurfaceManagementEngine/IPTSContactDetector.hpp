@@ -0,0 +1,39 @@
+//
+//  IPTSContactDetector.hpp
+//  SurfaceTouchScreen
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef IPTSContactDetector_hpp
+#define IPTSContactDetector_hpp
+
+#include "IPTSProtocol.h"
+
+#define IPTS_HEATMAP_MAX_SIZE       (64 * 64)
+#define IPTS_MAX_CONTACTS           16
+#define IPTS_CONTACT_THRESHOLD_PCT  10      // of the heatmap range
+#define IPTS_CONTACT_MIN_PIXELS     2
+#define IPTS_CONTACT_PALM_PIXELS    64
+
+/*
+ * Thresholds a heatmap, segments it into 4-connected blobs and reports the
+ * intensity weighted centroid and ellipse of each. Only integer math is used.
+ * The kext runs the scalar thresholding pass since the kernel does not save
+ * vector state, host and daemon builds vectorise it with AVX2 or SSE2.
+ */
+class IPTSContactDetector {
+public:
+    // returns the number of contacts written
+    UInt32 detect(const IPTSHeatmapDim *dim, const UInt8 *heatmap, IPTSContact *contacts, UInt32 max_contacts);
+    
+private:
+    UInt8   map[IPTS_HEATMAP_MAX_SIZE];
+    UInt16  stack[IPTS_HEATMAP_MAX_SIZE];
+    
+    UInt32 threshold(const UInt8 *heatmap, UInt32 len, UInt8 z_max, UInt8 limit);
+    
+    bool segment(UInt32 seed, UInt8 width, UInt8 height, UInt8 range, IPTSContact *contact);
+};
+
+#endif /* IPTSContactDetector_hpp */
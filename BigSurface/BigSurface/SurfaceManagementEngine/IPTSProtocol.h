@@ -0,0 +1,234 @@
+//
+//  IPTSProtocol.h
+//  SurfaceTouchScreen
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef IPTSProtocol_h
+#define IPTSProtocol_h
+
+#include "../CoreTypes.h"
+
+/*
+ * IPTS commands and data container format ported from linux & iptsd
+ */
+
+#define IPTS_BUFFERS                    16
+#define IPTS_WORKQUEUE_SIZE             8192
+#define IPTS_WORKQUEUE_ITEM_SIZE        16
+
+#define IPTS_CMD_GET_DEVICE_INFO        0x01
+#define IPTS_CMD_SET_MODE               0x02
+#define IPTS_CMD_SET_MEM_WINDOW         0x03
+#define IPTS_CMD_QUIESCE_IO             0x04
+#define IPTS_CMD_READY_FOR_DATA         0x05
+#define IPTS_CMD_FEEDBACK               0x06
+#define IPTS_CMD_CLEAR_MEM_WINDOW       0x07
+#define IPTS_CMD_RESET_SENSOR           0x0B
+
+#define IPTS_RSP_BIT                    0x80000000
+#define IPTS_RSP(cmd)                   ((cmd) | IPTS_RSP_BIT)
+
+#define IPTS_STATUS_SUCCESS             0x0
+
+#define IPTS_DATA_TYPE_PAYLOAD          0x0
+#define IPTS_DATA_TYPE_ERROR            0x1
+#define IPTS_DATA_TYPE_VENDOR_DATA      0x2
+#define IPTS_DATA_TYPE_HID_REPORT       0x3
+#define IPTS_DATA_TYPE_GET_FEATURES     0x4
+
+#define IPTS_PAYLOAD_FRAME_TYPE_STYLUS  0x6
+#define IPTS_PAYLOAD_FRAME_TYPE_TOUCH   0x8
+
+#define IPTS_REPORT_TYPE_HEATMAP_TIMESTAMP  0x400
+#define IPTS_REPORT_TYPE_HEATMAP_DIM        0x403
+#define IPTS_REPORT_TYPE_HEATMAP            0x425
+#define IPTS_REPORT_TYPE_STYLUS_V1          0x410
+#define IPTS_REPORT_TYPE_STYLUS_V2          0x460
+
+#define IPTS_STYLUS_REPORT_MODE_PROX    BIT(0)
+#define IPTS_STYLUS_REPORT_MODE_RUBBER  BIT(1)
+#define IPTS_STYLUS_REPORT_MODE_BUTTON  BIT(2)
+
+#ifndef PACKED
+#define PACKED __attribute__((packed))
+#endif
+
+struct PACKED IPTSCommand {
+    UInt32 code;
+    UInt8  payload[320];
+};
+
+struct PACKED IPTSResponse {
+    UInt32 code;
+    UInt32 status;
+    UInt8  payload[80];
+};
+
+struct PACKED IPTSSetMemWindow {
+    UInt32 data_addr_lower[IPTS_BUFFERS];
+    UInt32 data_addr_upper[IPTS_BUFFERS];
+    UInt32 workqueue_addr_lower;
+    UInt32 workqueue_addr_upper;
+    UInt32 doorbell_addr_lower;
+    UInt32 doorbell_addr_upper;
+    UInt32 feedback_addr_lower[IPTS_BUFFERS];
+    UInt32 feedback_addr_upper[IPTS_BUFFERS];
+    UInt32 hid2me_addr_lower;
+    UInt32 hid2me_addr_upper;
+    UInt32 hid2me_size;
+    UInt8  reserved1;
+    UInt8  workqueue_item_size;
+    UInt16 workqueue_size;
+    UInt8  reserved[32];
+};
+
+struct PACKED IPTSFeedback {
+    UInt32 buffer;
+    UInt8  reserved[12];
+};
+
+struct PACKED IPTSData {
+    UInt32 type;
+    UInt32 size;
+    UInt32 buffer;
+    UInt8  reserved[52];
+    UInt8  data[];
+};
+
+struct PACKED IPTSPayload {
+    UInt32 counter;
+    UInt32 frames;
+    UInt8  reserved[4];
+    UInt8  data[];
+};
+
+struct PACKED IPTSPayloadFrame {
+    UInt16 index;
+    UInt16 type;
+    UInt32 size;
+    UInt8  reserved[8];
+    UInt8  data[];
+};
+
+struct PACKED IPTSReport {
+    UInt16 type;
+    UInt16 size;
+    UInt8  data[];
+};
+
+struct PACKED IPTSStylusReport {
+    UInt8  elements;
+    UInt8  reserved[3];
+    UInt32 serial;
+    UInt8  data[];
+};
+
+struct PACKED IPTSStylusReportData {
+    UInt16 timestamp;
+    UInt16 mode;
+    UInt16 x;
+    UInt16 y;
+    UInt16 pressure;
+    UInt16 altitude;
+    UInt16 azimuth;
+    UInt16 reserved;
+};
+
+struct PACKED IPTSStylusReportDataV1 {
+    UInt8  reserved[4];
+    UInt8  mode;
+    UInt16 x;
+    UInt16 y;
+    UInt16 pressure;
+    UInt8  reserved2;
+};
+
+struct PACKED IPTSHeatmapDim {
+    UInt8 height;
+    UInt8 width;
+    UInt8 y_min;
+    UInt8 y_max;
+    UInt8 x_min;
+    UInt8 x_max;
+    UInt8 z_min;
+    UInt8 z_max;
+};
+
+struct PACKED IPTSHeatmapTimestamp {
+    UInt8  reserved[2];
+    UInt16 count;
+    UInt32 timestamp;
+};
+
+/*
+ * Compact records written by the in-kernel decoder into the frame ring shared
+ * with user space. Every record starts with IPTSCompactHeader and is padded
+ * to 8 bytes.
+ */
+#define IPTS_COMPACT_ALIGN      8
+
+enum IPTSCompactKind {
+    IPTSCompactPad = 0,     // skip to the start of the ring
+    IPTSCompactStylus,      // IPTSCompactFrame + IPTSStylusSample[count]
+    IPTSCompactHeatmap,     // IPTSCompactFrame + IPTSHeatmapDescriptor + width * height bytes
+    IPTSCompactContacts,    // IPTSCompactFrame + IPTSHeatmapDescriptor + IPTSContact[count]
+};
+
+struct IPTSCompactHeader {
+    UInt32 size;            // including this header and padding
+    UInt16 kind;
+    UInt16 count;
+};
+
+struct IPTSCompactFrame {
+    IPTSCompactHeader hdr;
+    UInt32 counter;         // IPTSPayload counter
+    UInt32 serial;          // stylus serial
+};
+
+struct IPTSStylusSample {
+    UInt16 timestamp;
+    UInt16 mode;
+    UInt16 x;
+    UInt16 y;
+    UInt16 pressure;
+    UInt16 altitude;
+    UInt16 azimuth;
+    UInt16 reserved;
+};
+
+struct IPTSHeatmapDescriptor {
+    IPTSHeatmapDim  dim;
+    UInt32          timestamp;
+    UInt16          count;
+    UInt16          reserved;
+    UInt8           data[];
+};
+
+// positions and axes in 1/256 heatmap pixels
+struct IPTSContact {
+    UInt16 x;
+    UInt16 y;
+    UInt16 major;
+    UInt16 minor;
+    UInt8  peak;
+    UInt8  confidence;
+    UInt16 reserved;
+};
+
+// mapped read only, a copy of what the kernel tracks privately
+struct IPTSFrameRingHeader {
+    volatile UInt32 head;   // next record to be written
+    UInt32          size;   // size of the data area following this header
+    volatile UInt32 dropped;
+    UInt32          reserved[5];
+};
+
+// the only page user space writes, checked by the kernel before every record
+struct IPTSFrameRingTail {
+    volatile UInt32 tail;   // next record to be read
+};
+
+#endif /* IPTSProtocol_h */
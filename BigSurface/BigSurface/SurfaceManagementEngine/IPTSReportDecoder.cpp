@@ -0,0 +1,263 @@
+//
+//  IPTSReportDecoder.cpp
+//  SurfaceTouchScreen
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include "IPTSReportDecoder.hpp"
+
+#define IPTS_ALIGN(len)     (((len) + IPTS_COMPACT_ALIGN - 1) & ~(IPTS_COMPACT_ALIGN - 1))
+
+IPTSFrameRing::~IPTSFrameRing() {
+    OSSafeReleaseNULL(memory);
+    OSSafeReleaseNULL(tail_memory);
+}
+
+bool IPTSFrameRing::init(UInt32 ring_size) {
+    memory = IOBufferMemoryDescriptor::withOptions(kIODirectionInOut | kIOMemoryKernelUserShared, sizeof(IPTSFrameRingHeader) + ring_size, page_size);
+    tail_memory = IOBufferMemoryDescriptor::withOptions(kIODirectionInOut | kIOMemoryKernelUserShared, page_size, page_size);
+    if (!memory || !tail_memory)
+        return false;
+    
+    header = static_cast<IPTSFrameRingHeader *>(memory->getBytesNoCopy());
+    memset(header, 0, sizeof(IPTSFrameRingHeader));
+    header->size = size = ring_size;
+    head = 0;
+    data = reinterpret_cast<UInt8 *>(header + 1);
+    consumer = static_cast<IPTSFrameRingTail *>(tail_memory->getBytesNoCopy());
+    memset(consumer, 0, page_size);
+    return true;
+}
+
+UInt8 *IPTSFrameRing::reserve(UInt32 len) {
+    UInt32 head = this->head;
+    // whatever the daemon wrote, never trust it further than this
+    UInt32 tail = consumer->tail;
+    
+    if (tail >= size || tail % IPTS_COMPACT_ALIGN || len >= size)
+        return nullptr;
+    
+    if (tail > head) {
+        // never let head catch up with tail, that would look empty
+        if (head + len >= tail)
+            return nullptr;
+    } else if (head + len > size || (head + len == size && tail == 0)) {
+        if (len >= tail)
+            return nullptr;
+        IPTSCompactHeader *pad = reinterpret_cast<IPTSCompactHeader *>(data + head);
+        pad->size = size - head;
+        pad->kind = IPTSCompactPad;
+        pad->count = 0;
+        head = 0;
+    }
+    reserved_head = head;
+    return data + head;
+}
+
+void IPTSFrameRing::commit(UInt32 len) {
+    // the record must be visible before the daemon sees the new head
+    __sync_synchronize();
+    head = (reserved_head + len) % size;
+    header->head = head;
+}
+
+bool IPTSReportDecoder::decode(const UInt8 *buf, UInt32 len, IPTSFrameRing *frame_ring) {
+    if (len < sizeof(IPTSData))
+        return false;
+    const IPTSData *container = reinterpret_cast<const IPTSData *>(buf);
+    if (container->type != IPTS_DATA_TYPE_PAYLOAD || container->size > len - sizeof(IPTSData))
+        return false;
+    if (container->size < sizeof(IPTSPayload))
+        return false;
+    
+    ring = frame_ring;
+    const UInt8 *pos = container->data;
+    const UInt8 *end = container->data + container->size;
+    const IPTSPayload *payload = reinterpret_cast<const IPTSPayload *>(pos);
+    counter = payload->counter;
+    pos += sizeof(IPTSPayload);
+    
+    for (UInt32 i = 0; i < payload->frames; i++) {
+        if (end - pos < static_cast<long>(sizeof(IPTSPayloadFrame)))
+            break;
+        const IPTSPayloadFrame *frame = reinterpret_cast<const IPTSPayloadFrame *>(pos);
+        pos += sizeof(IPTSPayloadFrame);
+        if (frame->size > end - pos)
+            break;
+        
+        if (frame->type == IPTS_PAYLOAD_FRAME_TYPE_STYLUS || frame->type == IPTS_PAYLOAD_FRAME_TYPE_TOUCH)
+            decodeReports(frame->data, frame->size);
+        pos += frame->size;
+    }
+    
+    stats.containers++;
+    stats.raw_bytes += len;
+    return true;
+}
+
+void IPTSReportDecoder::decodeReports(const UInt8 *buf, UInt32 len) {
+    const UInt8 *pos = buf;
+    const UInt8 *end = buf + len;
+    has_heatmap_dim = false;
+    
+    while (end - pos >= static_cast<long>(sizeof(IPTSReport))) {
+        const IPTSReport *report = reinterpret_cast<const IPTSReport *>(pos);
+        pos += sizeof(IPTSReport);
+        if (report->size > end - pos)
+            break;
+        
+        switch (report->type) {
+            case IPTS_REPORT_TYPE_STYLUS_V1:
+                emitStylus(report, true);
+                break;
+            case IPTS_REPORT_TYPE_STYLUS_V2:
+                emitStylus(report, false);
+                break;
+            case IPTS_REPORT_TYPE_HEATMAP_TIMESTAMP:
+                if (report->size >= sizeof(IPTSHeatmapTimestamp)) {
+                    const IPTSHeatmapTimestamp *ts = reinterpret_cast<const IPTSHeatmapTimestamp *>(report->data);
+                    heatmap_timestamp = ts->timestamp;
+                    heatmap_count = ts->count;
+                }
+                break;
+            case IPTS_REPORT_TYPE_HEATMAP_DIM:
+                if (report->size >= sizeof(IPTSHeatmapDim)) {
+                    heatmap_dim = *reinterpret_cast<const IPTSHeatmapDim *>(report->data);
+                    has_heatmap_dim = true;
+                }
+                break;
+            case IPTS_REPORT_TYPE_HEATMAP:
+                if (options & IPTSDecodeContacts)
+                    emitContacts(report);
+                if (!(options & IPTSDecodeContacts) || !(options & IPTSDecodeSkipHeatmap))
+                    emitHeatmap(report);
+                break;
+            default:
+                break;
+        }
+        pos += report->size;
+    }
+}
+
+void IPTSReportDecoder::emitStylus(const IPTSReport *report, bool legacy) {
+    if (report->size < sizeof(IPTSStylusReport))
+        return;
+    const IPTSStylusReport *stylus = reinterpret_cast<const IPTSStylusReport *>(report->data);
+    UInt32 elem_size = legacy ? sizeof(IPTSStylusReportDataV1) : sizeof(IPTSStylusReportData);
+    UInt32 count = (report->size - sizeof(IPTSStylusReport)) / elem_size;
+    if (stylus->elements < count)
+        count = stylus->elements;
+    if (!count)
+        return;
+    
+    UInt32 record_len = IPTS_ALIGN(sizeof(IPTSCompactFrame) + count * sizeof(IPTSStylusSample));
+    UInt8 *record = ring->reserve(record_len);
+    if (!record) {
+        ring->drop();
+        return;
+    }
+    
+    IPTSCompactFrame *frame = reinterpret_cast<IPTSCompactFrame *>(record);
+    frame->hdr.size = record_len;
+    frame->hdr.kind = IPTSCompactStylus;
+    frame->hdr.count = count;
+    frame->counter = counter;
+    frame->serial = stylus->serial;
+    
+    IPTSStylusSample *sample = reinterpret_cast<IPTSStylusSample *>(frame + 1);
+    for (UInt32 i = 0; i < count; i++, sample++) {
+        if (legacy) {
+            const IPTSStylusReportDataV1 *in = reinterpret_cast<const IPTSStylusReportDataV1 *>(stylus->data) + i;
+            sample->timestamp = 0;
+            sample->mode = in->mode;
+            sample->x = in->x;
+            sample->y = in->y;
+            sample->pressure = in->pressure * 4;    // V1 reports 0-1023, V2 0-4095
+            sample->altitude = 0;
+            sample->azimuth = 0;
+        } else {
+            const IPTSStylusReportData *in = reinterpret_cast<const IPTSStylusReportData *>(stylus->data) + i;
+            sample->timestamp = in->timestamp;
+            sample->mode = in->mode;
+            sample->x = in->x;
+            sample->y = in->y;
+            sample->pressure = in->pressure;
+            sample->altitude = in->altitude;
+            sample->azimuth = in->azimuth;
+        }
+        sample->reserved = 0;
+    }
+    
+    ring->commit(record_len);
+    stats.records++;
+    stats.compact_bytes += record_len;
+}
+
+void IPTSReportDecoder::emitHeatmap(const IPTSReport *report) {
+    if (!has_heatmap_dim)
+        return;
+    UInt32 heatmap_len = heatmap_dim.width * heatmap_dim.height;
+    if (!heatmap_len || report->size < heatmap_len)
+        return;
+    
+    UInt32 record_len = IPTS_ALIGN(sizeof(IPTSCompactFrame) + sizeof(IPTSHeatmapDescriptor) + heatmap_len);
+    UInt8 *record = ring->reserve(record_len);
+    if (!record) {
+        ring->drop();
+        return;
+    }
+    
+    IPTSCompactFrame *frame = reinterpret_cast<IPTSCompactFrame *>(record);
+    frame->hdr.size = record_len;
+    frame->hdr.kind = IPTSCompactHeatmap;
+    frame->hdr.count = 1;
+    frame->counter = counter;
+    frame->serial = 0;
+    
+    IPTSHeatmapDescriptor *desc = reinterpret_cast<IPTSHeatmapDescriptor *>(frame + 1);
+    desc->dim = heatmap_dim;
+    desc->timestamp = heatmap_timestamp;
+    desc->count = heatmap_count;
+    desc->reserved = 0;
+    memcpy(desc->data, report->data, heatmap_len);
+    
+    ring->commit(record_len);
+    stats.records++;
+    stats.compact_bytes += record_len;
+}
+
+void IPTSReportDecoder::emitContacts(const IPTSReport *report) {
+    if (!has_heatmap_dim || report->size < heatmap_dim.width * heatmap_dim.height)
+        return;
+    
+    UInt64 start;
+    clock_get_uptime(&start);
+    UInt32 count = detector.detect(&heatmap_dim, report->data, contacts, IPTS_MAX_CONTACTS);
+    detect_time.recordSince(start);
+    
+    UInt32 record_len = IPTS_ALIGN(sizeof(IPTSCompactFrame) + sizeof(IPTSHeatmapDescriptor) + count * sizeof(IPTSContact));
+    UInt8 *record = ring->reserve(record_len);
+    if (!record) {
+        ring->drop();
+        return;
+    }
+    
+    IPTSCompactFrame *frame = reinterpret_cast<IPTSCompactFrame *>(record);
+    frame->hdr.size = record_len;
+    frame->hdr.kind = IPTSCompactContacts;
+    frame->hdr.count = count;
+    frame->counter = counter;
+    frame->serial = 0;
+    
+    IPTSHeatmapDescriptor *desc = reinterpret_cast<IPTSHeatmapDescriptor *>(frame + 1);
+    desc->dim = heatmap_dim;
+    desc->timestamp = heatmap_timestamp;
+    desc->count = heatmap_count;
+    desc->reserved = 0;
+    memcpy(desc->data, contacts, count * sizeof(IPTSContact));
+    
+    ring->commit(record_len);
+    stats.records++;
+    stats.compact_bytes += record_len;
+}
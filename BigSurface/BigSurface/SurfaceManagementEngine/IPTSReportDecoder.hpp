@@ -0,0 +1,100 @@
+//
+//  IPTSReportDecoder.hpp
+//  SurfaceTouchScreen
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef IPTSReportDecoder_hpp
+#define IPTSReportDecoder_hpp
+
+#include <IOKit/IOBufferMemoryDescriptor.h>
+
+#include "IPTSContactDetector.hpp"
+#include "../helpers.hpp"
+#include "../LatencyHistogram.hpp"
+#include "../TaggedAllocator.hpp"
+
+#define IPTS_FRAME_RING_SIZE    (256 * 1024)
+
+enum IPTSDecoderOptions {
+    IPTSDecodeEnable        = BIT(0),
+    IPTSDecodeContacts      = BIT(1),   // run contact detection on heatmaps
+    IPTSDecodeSkipHeatmap   = BIT(2),   // only send contacts, not the heatmap itself
+};
+
+/*
+ * Single producer ring of compact records mapped into the daemon, the kernel
+ * only moves head and user space only moves tail. Records and header are
+ * mapped read only, the tail lives on a page of its own.
+ */
+class IPTSFrameRing : public TaggedObject<AllocTagIPTS> {
+public:
+    ~IPTSFrameRing();
+    
+    bool init(UInt32 ring_size);
+    
+    IOBufferMemoryDescriptor *getMemory() { return memory; }
+    
+    IOBufferMemoryDescriptor *getTailMemory() { return tail_memory; }
+    
+    // returns nullptr if the record does not fit, len must be aligned
+    UInt8 *reserve(UInt32 len);
+    
+    void commit(UInt32 len);
+    
+    void drop() { header->dropped++; }
+    
+private:
+    IOBufferMemoryDescriptor*   memory {nullptr};
+    IOBufferMemoryDescriptor*   tail_memory {nullptr};
+    IPTSFrameRingHeader*        header {nullptr};
+    IPTSFrameRingTail*          consumer {nullptr};
+    UInt8*                      data {nullptr};
+    UInt32                      size {0};
+    UInt32                      head {0};
+    UInt32                      reserved_head {0};
+};
+
+struct IPTSDecoderStats {
+    UInt64 containers;
+    UInt64 records;
+    UInt64 raw_bytes;
+    UInt64 compact_bytes;
+};
+
+class IPTSReportDecoder {
+public:
+    // returns false if the message is not a touch payload and should be delivered raw
+    bool decode(const UInt8 *buf, UInt32 len, IPTSFrameRing *ring);
+    
+    void resetStats() {
+        memset(&stats, 0, sizeof(stats));
+        detect_time.reset();
+    }
+    
+    IPTSDecoderStats    stats {};
+    LatencyHistogram    detect_time {};
+    UInt32              options {0};
+    
+private:
+    IPTSContactDetector detector;
+    IPTSContact         contacts[IPTS_MAX_CONTACTS];
+
+    IPTSFrameRing*  ring {nullptr};
+    UInt32          counter {0};
+    IPTSHeatmapDim  heatmap_dim {};
+    UInt32          heatmap_timestamp {0};
+    UInt16          heatmap_count {0};
+    bool            has_heatmap_dim {false};
+    
+    void decodeReports(const UInt8 *buf, UInt32 len);
+    
+    void emitStylus(const IPTSReport *report, bool legacy);
+    
+    void emitHeatmap(const IPTSReport *report);
+    
+    void emitContacts(const IPTSReport *report);
+};
+
+#endif /* IPTSReportDecoder_hpp */
@@ -0,0 +1,44 @@
+//
+//  MEIMappedRegisters.hpp
+//  SurfaceTouchScreen
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef MEIMappedRegisters_hpp
+#define MEIMappedRegisters_hpp
+
+#include <IOKit/IOMemoryDescriptor.h>
+
+#include "MEIRegisterInterface.hpp"
+#include "../TaggedAllocator.hpp"
+
+// registers of the PCI device mapped into the kernel
+class MEIMappedRegisters : public MEIRegisterInterface, public TaggedObject<AllocTagMEI> {
+public:
+    explicit MEIMappedRegisters(IOMemoryMap *map) : mmap(map) {
+        mmap->retain();
+    }
+    
+    ~MEIMappedRegisters() override {
+        OSSafeReleaseNULL(mmap);
+    }
+    
+    UInt32 read(int offset) override {
+        IOVirtualAddress address = mmap->getVirtualAddress();
+        if (address != 0)
+            return *(const volatile UInt32 *)(address + offset);
+        return 0;
+    }
+    
+    void write(UInt32 value, int offset) override {
+        IOVirtualAddress address = mmap->getVirtualAddress();
+        if (address != 0)
+            *(volatile UInt32 *)(address + offset) = value;
+    }
+    
+private:
+    IOMemoryMap *mmap;
+};
+
+#endif /* MEIMappedRegisters_hpp */
@@ -9,7 +9,9 @@
 #ifndef MEIProtocol_h
 #define MEIProtocol_h
 
-#include "../helpers.hpp"
+#include <uuid/uuid.h>
+
+#include "../CoreTypes.h"
 
 /*
  * IPTS MEI constants and communication protocol ported from linux
@@ -67,9 +69,29 @@
 #define MEI_DATA_TO_SLOTS(len)      (((len)+MEI_SLOT_SIZE-1)/MEI_SLOT_SIZE)
 #define MEI_SLOTS_TO_DATA(slots)    ((slots) * MEI_SLOT_SIZE)
 
+/* Occupied slots of a circular buffer, the 8 bit pointers wrap around */
+static inline UInt8 mei_csr_filled_slots(UInt32 csr)
+{
+    UInt8 read_ptr = (csr & MEI_CSR_BUF_RPOINTER) >> 8;
+    UInt8 write_ptr = (csr & MEI_CSR_BUF_WPOINTER) >> 16;
+    return write_ptr - read_ptr;
+}
+
+static inline UInt8 mei_csr_depth(UInt32 csr)
+{
+    return (csr & MEI_CSR_BUF_DEPTH) >> 24;
+}
+
 #define MEI_MAX_CLIENT_NUM      256     /* SHOULD be dividable by 8 */
 #define MEI_MAX_CONSEC_RESET    3
 
+#define MEI_RESET_BACKOFF_MIN   10      /* First delayed retry in ms */
+#define MEI_RESET_BACKOFF_MAX   30000   /* Cap of the retry delay in ms */
+#define MEI_RESET_STABLE_TIME   10      /* Seconds without failure that end a reset storm */
+
+#define MEI_TX_POOL_SIZE        16      /* Preallocated client transactions */
+#define MEI_TX_POOL_BUF_SIZE    512     /* Larger messages fall back to the heap */
+
 #ifndef PACKED
 #define PACKED __attribute__((packed))
 #endif
@@ -85,7 +107,7 @@
 #define MEI_D0I3_TIMEOUT                5  /* D0i3 set/unset max response time */
 #define MEI_HOST_BUS_MSG_TIMEOUT        1  /* 1 second */
 
-#define MEI_DEVICE_IDLE_TIMEOUT         5
+#define MEI_DEVICE_IDLE_TOLERANCE       1000    // ms
 
 #define MEI_CLIENT_SEND_MSG_TIMEOUT     500 /* 500 ms*/
 
@@ -0,0 +1,27 @@
+//
+//  MEIRegisterInterface.hpp
+//  SurfaceTouchScreen
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef MEIRegisterInterface_hpp
+#define MEIRegisterInterface_hpp
+
+#include "../CoreTypes.h"
+
+/*
+ * All accesses to MEI_H_CB_WW, MEI_H_CSR, MEI_ME_CB_RW, MEI_ME_CSR and
+ * MEI_H_D0I3C go through this interface, so the driver can be driven by
+ * something other than a live ME, e.g. a register level emulator.
+ */
+class MEIRegisterInterface {
+public:
+    virtual ~MEIRegisterInterface() {}
+    
+    virtual UInt32 read(int offset) = 0;
+    
+    virtual void write(UInt32 value, int offset) = 0;
+};
+
+#endif /* MEIRegisterInterface_hpp */
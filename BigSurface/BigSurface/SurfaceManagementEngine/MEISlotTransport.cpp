@@ -0,0 +1,101 @@
+//
+//  MEISlotTransport.cpp
+//  SurfaceTouchScreen
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <string.h>
+
+#include "MEISlotTransport.hpp"
+
+static const char *status_strings[] = {
+    "OK",
+    "Header not slot aligned!",
+    "Filled slots exceed the buffer!",
+    "Message too large!",
+    "Hardware not ready!",
+};
+
+MEISlotStatus meiHostEmptySlots(MEIRegisterInterface *regs, UInt8 depth, UInt8 *empty_slots) {
+    UInt8 filled_slots = mei_csr_filled_slots(regs->read(MEI_H_CSR));
+    if (filled_slots > depth)
+        return MEISlotOverrun;
+
+    *empty_slots = depth - filled_slots;
+    return MEISlotOK;
+}
+
+MEISlotStatus meiMEFilledSlots(MEIRegisterInterface *regs, UInt8 *filled_slots) {
+    UInt32 mecsr = regs->read(MEI_ME_CSR);
+    UInt8 slots = mei_csr_filled_slots(mecsr);
+
+    if (slots > mei_csr_depth(mecsr))
+        return MEISlotOverrun;
+
+    *filled_slots = slots;
+    return MEISlotOK;
+}
+
+void meiSetHostCSR(MEIRegisterInterface *regs, UInt32 hcsr) {
+    hcsr &= ~MEI_H_CSR_INT_STA_MASK;
+    regs->write(hcsr, MEI_H_CSR);
+}
+
+void meiSetHostInterrupt(MEIRegisterInterface *regs) {
+    UInt32 hcsr = regs->read(MEI_H_CSR);
+    hcsr |= MEI_H_CSR_INT_GEN;
+    meiSetHostCSR(regs, hcsr);
+}
+
+void meiReadSlots(MEIRegisterInterface *regs, UInt8 *buffer, UInt16 len) {
+    UInt32 slot;
+    for (; len >= MEI_SLOT_SIZE; len -= MEI_SLOT_SIZE, buffer += MEI_SLOT_SIZE) {
+        slot = regs->read(MEI_ME_CB_RW);
+        memcpy(buffer, &slot, MEI_SLOT_SIZE);
+    }
+    if (len > 0) {
+        slot = regs->read(MEI_ME_CB_RW);
+        memcpy(buffer, &slot, len);
+    }
+    meiSetHostInterrupt(regs);
+}
+
+MEISlotStatus meiWriteSlots(MEIRegisterInterface *regs, UInt8 depth, const UInt8 *header, UInt16 header_len, const UInt8 *data, UInt16 data_len) {
+    if (header_len % MEI_SLOT_SIZE)
+        return MEISlotInvalid;
+
+    UInt8 empty_slots;
+    MEISlotStatus status = meiHostEmptySlots(regs, depth, &empty_slots);
+    if (status != MEISlotOK)
+        return status;
+    if (MEI_DATA_TO_SLOTS(header_len + data_len) > empty_slots)
+        return MEISlotTooLarge;
+
+    UInt32 slot;
+    for (UInt16 i = 0; i < header_len; i += MEI_SLOT_SIZE) {
+        memcpy(&slot, header + i, MEI_SLOT_SIZE);
+        regs->write(slot, MEI_H_CB_WW);
+    }
+    for (; data_len >= MEI_SLOT_SIZE; data_len -= MEI_SLOT_SIZE, data += MEI_SLOT_SIZE) {
+        memcpy(&slot, data, MEI_SLOT_SIZE);
+        regs->write(slot, MEI_H_CB_WW);
+    }
+    if (data_len > 0) {
+        slot = 0;
+        memcpy(&slot, data, data_len);
+        regs->write(slot, MEI_H_CB_WW);
+    }
+
+    meiSetHostInterrupt(regs);
+
+    if (!(regs->read(MEI_ME_CSR) & MEI_ME_CSR_READY))
+        return MEISlotNotReady;
+    return MEISlotOK;
+}
+
+const char *meiSlotStatusString(MEISlotStatus status) {
+    if (status > MEISlotNotReady)
+        return "unknown";
+    return status_strings[status];
+}
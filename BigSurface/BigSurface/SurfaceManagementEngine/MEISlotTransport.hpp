@@ -0,0 +1,46 @@
+//
+//  MEISlotTransport.hpp
+//  SurfaceTouchScreen
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef MEISlotTransport_hpp
+#define MEISlotTransport_hpp
+
+#include "MEIProtocol.h"
+#include "MEIRegisterInterface.hpp"
+
+/*
+ * Moving messages through the host and ME circular buffers one slot at a
+ * time, free of IOKit. The driver owns the bus state machine and only calls
+ * in here to touch the windows, so an emulator can stand in for the ME.
+ */
+enum MEISlotStatus {
+    MEISlotOK = 0,
+    MEISlotInvalid,         // header is not slot aligned
+    MEISlotOverrun,         // pointers claim more slots than the buffer holds
+    MEISlotTooLarge,        // message does not fit the empty slots
+    MEISlotNotReady,        // ME dropped ready while the message went out
+};
+
+// slots the host may still write, depth as read from MEI_H_CSR during config
+MEISlotStatus meiHostEmptySlots(MEIRegisterInterface *regs, UInt8 depth, UInt8 *empty_slots);
+
+// slots the ME has written and the host not yet read
+MEISlotStatus meiMEFilledSlots(MEIRegisterInterface *regs, UInt8 *filled_slots);
+
+// write MEI_H_CSR without acknowledging pending interrupts
+void meiSetHostCSR(MEIRegisterInterface *regs, UInt32 hcsr);
+
+void meiSetHostInterrupt(MEIRegisterInterface *regs);
+
+// copy len bytes out of the ME buffer, then tell the ME the slots are free
+void meiReadSlots(MEIRegisterInterface *regs, UInt8 *buffer, UInt16 len);
+
+// header and data go out back to back, the last slot is zero padded
+MEISlotStatus meiWriteSlots(MEIRegisterInterface *regs, UInt8 depth, const UInt8 *header, UInt16 header_len, const UInt8 *data, UInt16 data_len);
+
+const char *meiSlotStatusString(MEISlotStatus status);
+
+#endif /* MEISlotTransport_hpp */
@@ -6,7 +6,12 @@
 //  Copyright © 2022 Xia Shangning. All rights reserved.
 //
 
+
 #include "SurfaceManagementEngineClient.hpp"
+#include "SurfaceManagementEngineUserClient.hpp"
+#include "../BigSurfaceDiagnostics/Tracepoints.hpp"
+
+extern "C" kern_return_t thread_policy_set(thread_t thread, thread_policy_flavor_t flavor, thread_policy_t policy_info, mach_msg_type_number_t count);
 
 #define super IOService
 OSDefineMetaClassAndStructors(SurfaceManagementEngineClient, IOService)
@@ -20,6 +25,7 @@ bool SurfaceManagementEngineClient::attach(IOService* provider) {
         return false;
     
     queue_head_init(rx_queue);
+    queue_head_init(rx_free);
 
     return true;
 }
@@ -39,17 +45,50 @@ bool SurfaceManagementEngineClient::start(IOService *provider) {
         goto exit;
     }
     
-    work_loop = IOWorkLoop::workLoop();
+    // bookkeeping stays on the telemetry band
+    work_loop = WorkLoopBands::acquire(WorkLoopBandTelemetry);
     if (!work_loop) {
         LOG("Failed to create work loop");
         goto exit;
     }
+    stats_timer = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &SurfaceManagementEngineClient::publishStatistics));
+    if (!stats_timer) {
+        LOG("Failed to create statistics timer");
+        goto exit;
+    }
+    work_loop->addEventSource(stats_timer);
+    trace_source = IOInterruptEventSource::interruptEventSource(this, OSMemberFunctionCast(IOInterruptEventAction, this, &SurfaceManagementEngineClient::dumpTrace));
+    if (!trace_source) {
+        LOG("Failed to create trace source");
+        goto exit;
+    }
+    work_loop->addEventSource(trace_source);
+    
+    // messages are handed to the handler from the real time input band
+    delivery_loop = WorkLoopBands::acquire(WorkLoopBandInput);
+    if (!delivery_loop) {
+        LOG("Failed to create delivery work loop");
+        goto exit;
+    }
     interrupt_source = IOInterruptEventSource::interruptEventSource(this, OSMemberFunctionCast(IOInterruptEventAction, this, &SurfaceManagementEngineClient::notifyMessage));
     if (!interrupt_source) {
         LOG("Failed to create interrupt source");
         goto exit;
     }
-    work_loop->addEventSource(interrupt_source);
+    delivery_loop->addEventSource(interrupt_source);
+    delivery_gate = IOCommandGate::commandGate(this);
+    if (!delivery_gate) {
+        LOG("Failed to create delivery gate");
+        goto exit;
+    }
+    delivery_loop->addEventSource(delivery_gate);
+    doorbell_timer = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &SurfaceManagementEngineClient::pollDoorbell));
+    if (!doorbell_timer) {
+        LOG("Failed to create doorbell timer");
+        goto exit;
+    }
+    delivery_loop->addEventSource(doorbell_timer);
+    resetLatency();
     
     uuid_t swapped_uuid;
     uuid_string_t uuid_str;
@@ -62,9 +101,20 @@ bool SurfaceManagementEngineClient::start(IOService *provider) {
     setProperty("MEIClientAddress", properties.fixed_address, 32);
     setProperty("MEIClientMaxMessageLength", properties.max_msg_length, 32);
     
-    rx_cache = new UInt8[properties.max_msg_length];
+    rx_pool = new MEIClientMessage[MEI_CLIENT_RX_SLOTS];
+    rx_storage = tagNewArray<UInt8>(AllocTagIPTS, MEI_CLIENT_RX_SLOTS * properties.max_msg_length);
+    if (!rx_pool || !rx_storage) {
+        LOG("Failed to allocate receive slots");
+        goto exit;
+    }
+    for (int i = 0; i < MEI_CLIENT_RX_SLOTS; i++) {
+        rx_pool[i].msg = rx_storage + i * properties.max_msg_length;
+        rx_pool[i].pooled = true;
+        enqueue(&rx_free, &rx_pool[i].entry);
+    }
     
     initial = false;
+    TimerCoalescer::setTimeoutMS(stats_timer, MEI_CLIENT_STATS_INTERVAL, MEI_CLIENT_STATS_TOLERANCE);
     
     PMinit();
     api->joinPMtree(this);
@@ -90,20 +140,64 @@ IOReturn SurfaceManagementEngineClient::setPowerState(unsigned long whichState,
 
 void SurfaceManagementEngineClient::releaseResources() {
     MEIClientMessage *msg;
-    qe_foreach_element_safe(msg, &rx_queue, entry) {
-        remqueue(&msg->entry);
-        delete[] msg->msg;
-        delete msg;
-    }
-    if (rx_cache)
-        delete[] rx_cache;
     
+    // stop delivery first, it uses the messages, the decoder and the ring
+    if (doorbell_timer) {
+        doorbell_timer->cancelTimeout();
+        doorbell_timer->disable();
+        delivery_loop->removeEventSource(doorbell_timer);
+        OSSafeReleaseNULL(doorbell_timer);
+    }
+    if (delivery_gate) {
+        delivery_loop->removeEventSource(delivery_gate);
+        OSSafeReleaseNULL(delivery_gate);
+    }
     if (interrupt_source) {
         interrupt_source->disable();
-        work_loop->removeEventSource(interrupt_source);
+        delivery_loop->removeEventSource(interrupt_source);
         OSSafeReleaseNULL(interrupt_source);
     }
-    OSSafeReleaseNULL(work_loop);
+    WorkLoopBands::release(WorkLoopBandInput, delivery_loop);
+    
+    qe_foreach_element_safe(msg, &rx_queue, entry) {
+        remqueue(&msg->entry);
+        releaseMessage(msg);
+    }
+    if (rx_current) {
+        releaseMessage(rx_current);
+        rx_current = nullptr;
+    }
+    while (dequeue(&rx_free));
+    if (rx_pool) {
+        delete[] rx_pool;
+        rx_pool = nullptr;
+    }
+    if (rx_storage) {
+        tagFree(rx_storage);
+        rx_storage = nullptr;
+    }
+    decoder.options = 0;
+    if (frame_ring) {
+        delete frame_ring;
+        frame_ring = nullptr;
+    }
+    buffer_mode = false;
+    if (buffers) {
+        delete buffers;
+        buffers = nullptr;
+    }
+    if (trace_source) {
+        trace_source->disable();
+        work_loop->removeEventSource(trace_source);
+        OSSafeReleaseNULL(trace_source);
+    }
+    if (stats_timer) {
+        stats_timer->cancelTimeout();
+        stats_timer->disable();
+        work_loop->removeEventSource(stats_timer);
+        OSSafeReleaseNULL(stats_timer);
+    }
+    WorkLoopBands::release(WorkLoopBandTelemetry, work_loop);
     if (queue_lock)
         IOLockFree(queue_lock);
 }
@@ -135,6 +229,116 @@ IOReturn SurfaceManagementEngineClient::sendMessage(UInt8 *data, UInt16 data_len
     return api->sendClientMessage(this, data, data_len, blocking);
 }
 
+IOReturn SurfaceManagementEngineClient::newUserClient(task_t owningTask, void *securityID, UInt32 type, OSDictionary *props, IOUserClient **handler) {
+    SurfaceManagementEngineUserClient *client = OSTypeAlloc(SurfaceManagementEngineUserClient);
+    if (!client)
+        return kIOReturnNoMemory;
+    
+    if (!client->initWithTask(owningTask, securityID, type, props) || !client->attach(this)) {
+        client->release();
+        return kIOReturnError;
+    }
+    if (!client->start(this)) {
+        client->detach(this);
+        client->release();
+        return kIOReturnError;
+    }
+    *handler = client;
+    return kIOReturnSuccess;
+}
+
+void SurfaceManagementEngineClient::copyLatencyReport(MEILatencyReport *report) {
+    report->stage_cnt = MEILatencyStageCount;
+    IOLockLock(queue_lock);
+    report->dropped_pickups = pickup_dropped;
+    memcpy(report->stages, latency, sizeof(latency));
+    IOLockUnlock(queue_lock);
+}
+
+void SurfaceManagementEngineClient::resetLatency() {
+    IOLockLock(queue_lock);
+    for (int i = 0; i < MEILatencyStageCount; i++)
+        latency[i].reset();
+    pickup_head = pickup_cnt = 0;
+    pickup_dropped = 0;
+    IOLockUnlock(queue_lock);
+}
+
+void SurfaceManagementEngineClient::setTracing(bool enable) {
+    IOLockLock(queue_lock);
+    tracing = enable;
+    trace_head = trace_cnt = 0;
+    IOLockUnlock(queue_lock);
+    LOG("Latency tracing %s", enable ? "enabled" : "disabled");
+}
+
+IOReturn SurfaceManagementEngineClient::setDecoding(UInt32 options) {
+    if (!delivery_gate)
+        return kIOReturnNotReady;
+    // the decoder and the ring belong to the delivery band, change them between two deliveries
+    return delivery_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &SurfaceManagementEngineClient::setDecodingGated), &options);
+}
+
+IOReturn SurfaceManagementEngineClient::setDecodingGated(UInt32 *options_ptr) {
+    UInt32 options = *options_ptr;
+    if ((options & IPTSDecodeEnable) && !frame_ring) {
+        IPTSFrameRing *ring = new IPTSFrameRing;
+        if (!ring)
+            return kIOReturnNoMemory;
+        if (!ring->init(IPTS_FRAME_RING_SIZE)) {
+            delete ring;
+            return kIOReturnNoMemory;
+        }
+        decoder.resetStats();
+        frame_ring = ring;
+    }
+    decoder.options = options;
+    LOG("In-kernel IPTS decoding options 0x%x", options);
+    return kIOReturnSuccess;
+}
+
+IOMemoryDescriptor *SurfaceManagementEngineClient::copyFrameRing() {
+    if (!frame_ring)
+        return nullptr;
+    IOMemoryDescriptor *memory = frame_ring->getMemory();
+    memory->retain();
+    return memory;
+}
+
+IOMemoryDescriptor *SurfaceManagementEngineClient::copyFrameRingTail() {
+    if (!frame_ring)
+        return nullptr;
+    IOMemoryDescriptor *memory = frame_ring->getTailMemory();
+    memory->retain();
+    return memory;
+}
+
+void SurfaceManagementEngineClient::markPickup() {
+    UInt64 now;
+    clock_get_uptime(&now);
+    
+    bool dump = false;
+    IOLockLock(queue_lock);
+    if (pickup_cnt) {
+        UInt64 dispatched = pickup_fifo[pickup_head];
+        UInt32 seq = pickup_seq[pickup_head];
+        pickup_head = (pickup_head + 1) % MEI_CLIENT_PICKUP_DEPTH;
+        pickup_cnt--;
+        latency[MEILatencyPickup].recordInterval(dispatched, now);
+        for (int i = 0; tracing && i < trace_cnt; i++) {
+            MEIClientFrameTrace *trace = &trace_ring[(trace_head + i) % MEI_CLIENT_TRACE_DEPTH];
+            if (trace->seq == seq) {
+                trace->stamps[MEIStampPickup] = now;
+                dump = true;
+                break;
+            }
+        }
+    }
+    IOLockUnlock(queue_lock);
+    if (dump)
+        trace_source->interruptOccurred(nullptr, this, 0);
+}
+
 void SurfaceManagementEngineClient::resetProperties(MEIClientProperty *client_props, UInt8 me_addr) {
     active = true;
     properties = *client_props;
@@ -142,10 +346,26 @@ void SurfaceManagementEngineClient::resetProperties(MEIClientProperty *client_pr
 }
 
 void SurfaceManagementEngineClient::hostRequestDisconnect() {
-    rx_cache_pos = 0;
+    MEIClientMessage *msg;
     
+    // the device forgets the memory window on reset
+    buffer_mode = false;
+    window_pending = false;
+    
+    if (rx_current) {
+        releaseMessage(rx_current);
+        rx_current = nullptr;
+    }
     IOLockLock(queue_lock);
-    while (dequeue(&rx_queue));
+    qe_foreach_element_safe(msg, &rx_queue, entry) {
+        remqueue(&msg->entry);
+        if (msg->pooled)
+            enqueue(&rx_free, &msg->entry);
+        else {
+            tagFree(msg->msg);
+            delete msg;
+        }
+    }
     IOLockUnlock(queue_lock);
 }
 
@@ -153,15 +373,56 @@ void SurfaceManagementEngineClient::hostRequestReconnect() {
     
 }
 
+MEIClientMessage *SurfaceManagementEngineClient::allocMessage() {
+    MEIClientMessage *client_msg = nullptr;
+    queue_entry *item;
+    
+    if (!rx_storage)
+        return nullptr;
+    
+    IOLockLock(queue_lock);
+    if ((item = dequeue(&rx_free)) != nullptr)
+        client_msg = qe_element(item, MEIClientMessage, entry);
+    IOLockUnlock(queue_lock);
+    
+    if (!client_msg) {
+        // delivery fell behind, do not drop the message
+        client_msg = new MEIClientMessage;
+        if (!client_msg)
+            return nullptr;
+        client_msg->msg = tagNewArray<UInt8>(AllocTagIPTS, properties.max_msg_length);
+        if (!client_msg->msg) {
+            delete client_msg;
+            return nullptr;
+        }
+        client_msg->pooled = false;
+        rx_overflow++;
+    }
+    client_msg->len = 0;
+    memset(client_msg->stamps, 0, sizeof(client_msg->stamps));
+    return client_msg;
+}
+
+void SurfaceManagementEngineClient::releaseMessage(MEIClientMessage *client_msg) {
+    if (client_msg->pooled) {
+        IOLockLock(queue_lock);
+        enqueue(&rx_free, &client_msg->entry);
+        IOLockUnlock(queue_lock);
+    } else {
+        tagFree(client_msg->msg);
+        delete client_msg;
+    }
+}
+
 void SurfaceManagementEngineClient::messageComplete() {
-    if (!rx_cache_pos)
+    MEIClientMessage *client_msg = rx_current;
+    if (!client_msg || !client_msg->len)
         return;
     
-    MEIClientMessage *client_msg = new MEIClientMessage;
-    client_msg->msg = new UInt8[rx_cache_pos];
-    client_msg->len = rx_cache_pos;
-    memcpy(client_msg->msg, rx_cache, rx_cache_pos);
-    rx_cache_pos = 0;
+    // the slot the fragments were read into is delivered as is
+    rx_current = nullptr;
+    clock_get_uptime(&client_msg->stamps[MEIStampComplete]);
+    TRACEPOINT(TraceMEI, TraceMEIMessageComplete, addr, client_msg->len);
     
     IOLockLock(queue_lock);
     enqueue(&rx_queue, &client_msg->entry);
@@ -178,12 +439,246 @@ void SurfaceManagementEngineClient::notifyMessage(IOInterruptEventSource *sender
         IOLockUnlock(queue_lock);
         client_msg = qe_element(item, MEIClientMessage, entry);
         
-        if (handler)
-            handler(target, this, client_msg->msg, client_msg->len);
+        UInt64 *stamps = client_msg->stamps;
+        clock_get_uptime(&stamps[MEIStampDispatch]);
+        TRACEPOINT(TraceMEI, TraceMEIDelivery, client_msg->len, stamps[MEIStampDispatch] - stamps[MEIStampInterrupt]);
+        
+        if (window_pending || buffer_mode)
+            handleBufferResponse(client_msg->msg, client_msg->len);
+        deliverMessage(client_msg->msg, client_msg->len);
         
-        delete[] client_msg->msg;
-        delete client_msg;
+        IOLockLock(queue_lock);
+        // under the lock, resetLatency may clear the histograms at any time
+        latency[MEILatencyRead].recordInterval(stamps[MEIStampInterrupt], stamps[MEIStampRead]);
+        latency[MEILatencyComplete].recordInterval(stamps[MEIStampRead], stamps[MEIStampComplete]);
+        latency[MEILatencyDispatch].recordInterval(stamps[MEIStampComplete], stamps[MEIStampDispatch]);
+        latency[MEILatencyTotal].recordInterval(stamps[MEIStampInterrupt], stamps[MEIStampDispatch]);
+        if (pickup_cnt == MEI_CLIENT_PICKUP_DEPTH) {
+            // nobody is picking up, forget the oldest one
+            pickup_head = (pickup_head + 1) % MEI_CLIENT_PICKUP_DEPTH;
+            pickup_cnt--;
+            pickup_dropped++;
+        }
+        pickup_fifo[(pickup_head + pickup_cnt) % MEI_CLIENT_PICKUP_DEPTH] = stamps[MEIStampDispatch];
+        pickup_seq[(pickup_head + pickup_cnt++) % MEI_CLIENT_PICKUP_DEPTH] = frame_seq;
+        if (tracing) {
+            MEIClientFrameTrace *trace = &trace_ring[(trace_head + trace_cnt) % MEI_CLIENT_TRACE_DEPTH];
+            if (trace_cnt < MEI_CLIENT_TRACE_DEPTH)
+                trace_cnt++;
+            else
+                trace_head = (trace_head + 1) % MEI_CLIENT_TRACE_DEPTH;
+            trace->seq = frame_seq;
+            trace->len = client_msg->len;
+            memcpy(trace->stamps, stamps, sizeof(trace->stamps));
+        }
+        frame_seq++;
+        // traces normally wait for their pickup, only a ring nobody picks up from is dumped here
+        bool dump = tracing && trace_cnt > MEI_CLIENT_TRACE_DEPTH / 2;
+        IOLockUnlock(queue_lock);
+        if (dump)
+            trace_source->interruptOccurred(nullptr, this, 0);
+        
+        releaseMessage(client_msg);
         IOLockLock(queue_lock);
     }
     IOLockUnlock(queue_lock);
 }
+
+void SurfaceManagementEngineClient::publishStatistics(IOTimerEventSource *timer) {
+    static const char *stage_names[MEILatencyStageCount] = {"Read", "Complete", "Dispatch", "Pickup", "Total"};
+    OSDictionary *stats = OSDictionary::withCapacity(MEILatencyStageCount);
+    if (stats) {
+        for (int i = 0; i < MEILatencyStageCount; i++) {
+            OSDictionary *summary = latency[i].copySummary();
+            if (summary) {
+                stats->setObject(stage_names[i], summary);
+                summary->release();
+            }
+        }
+        setProperty("MEIClientLatency", stats);
+        stats->release();
+    }
+    
+    if (frame_ring) {
+        OSDictionary *decoder_stats = OSDictionary::withCapacity(4);
+        if (decoder_stats) {
+            const char *keys[] = {"Containers", "Records", "RawBytes", "CompactBytes"};
+            UInt64 values[] = {decoder.stats.containers, decoder.stats.records, decoder.stats.raw_bytes, decoder.stats.compact_bytes};
+            for (int i = 0; i < 4; i++) {
+                OSNumber *num = OSNumber::withNumber(values[i], 64);
+                if (num) {
+                    decoder_stats->setObject(keys[i], num);
+                    num->release();
+                }
+            }
+            OSDictionary *detect = decoder.detect_time.copySummary();
+            if (detect) {
+                decoder_stats->setObject("ContactDetectionTime", detect);
+                detect->release();
+            }
+            setProperty("IPTSDecoder", decoder_stats);
+            decoder_stats->release();
+        }
+    }
+    if (buffers)
+        setProperty("IPTSBufferedFrames", buffers->filled_cnt, 64);
+    setProperty("MEIClientRxOverflow", rx_overflow, 32);
+    TimerCoalescer::setTimeoutMS(timer, MEI_CLIENT_STATS_INTERVAL, MEI_CLIENT_STATS_TOLERANCE);
+}
+
+void SurfaceManagementEngineClient::dumpTrace(IOInterruptEventSource *sender, int count) {
+    MEIClientFrameTrace trace;
+    UInt64 us[MEIStampPickup];
+    UInt64 total;
+    
+    IOLockLock(queue_lock);
+    // pickups come in dispatch order, so only the oldest trace can be complete
+    while (trace_cnt && (trace_ring[trace_head].stamps[MEIStampPickup] || trace_cnt > MEI_CLIENT_TRACE_DEPTH / 2)) {
+        trace = trace_ring[trace_head];
+        trace_head = (trace_head + 1) % MEI_CLIENT_TRACE_DEPTH;
+        trace_cnt--;
+        IOLockUnlock(queue_lock);
+        
+        for (int i = 0; i < MEIStampPickup; i++) {
+            us[i] = 0;
+            if (trace.stamps[i] && trace.stamps[i + 1] >= trace.stamps[i]) {
+                absolutetime_to_nanoseconds(trace.stamps[i + 1] - trace.stamps[i], &us[i]);
+                us[i] /= 1000;
+            }
+        }
+        total = 0;
+        if (trace.stamps[MEIStampInterrupt] && trace.stamps[MEIStampPickup] >= trace.stamps[MEIStampInterrupt]) {
+            absolutetime_to_nanoseconds(trace.stamps[MEIStampPickup] - trace.stamps[MEIStampInterrupt], &total);
+            total /= 1000;
+        }
+        // pickup and total stay 0 for frames nobody picked up
+        LOG("frame %u len %d: irq->read %llu us, read->complete %llu us, complete->dispatch %llu us, dispatch->pickup %llu us, total %llu us", trace.seq, trace.len, us[MEIStampInterrupt], us[MEIStampRead], us[MEIStampComplete], us[MEIStampDispatch], total);
+        IOLockLock(queue_lock);
+    }
+    IOLockUnlock(queue_lock);
+}
+
+void SurfaceManagementEngineClient::deliverMessage(UInt8 *msg, UInt32 len) {
+    if ((decoder.options & IPTSDecodeEnable) && frame_ring && decoder.decode(msg, len, frame_ring))
+        return;
+    if (len > 0xFFFF) {
+        LOG("Message too large for the handler, %u bytes", len);
+        return;
+    }
+    if (handler)
+        handler(target, this, msg, static_cast<UInt16>(len));
+}
+
+IOReturn SurfaceManagementEngineClient::startBufferMode(UInt32 data_size, UInt32 feedback_size) {
+    if (!active || !delivery_gate)
+        return kIOReturnNoDevice;
+    if (!data_size || !feedback_size || data_size > IPTS_BUFFER_MAX_SIZE || feedback_size > IPTS_BUFFER_MAX_SIZE)
+        return kIOReturnBadArgument;
+    return delivery_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &SurfaceManagementEngineClient::startBufferModeGated), &data_size, &feedback_size);
+}
+
+void SurfaceManagementEngineClient::stopBufferMode() {
+    if (delivery_gate)
+        delivery_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &SurfaceManagementEngineClient::stopBufferModeGated));
+}
+
+IOReturn SurfaceManagementEngineClient::startBufferModeGated(UInt32 *data_size, UInt32 *feedback_size) {
+    if (!buffers) {
+        buffers = new IPTSBufferManager;
+        if (!buffers)
+            return kIOReturnNoMemory;
+    }
+    
+    IOReturn ret = buffers->allocate(*data_size, *feedback_size);
+    if (ret != kIOReturnSuccess) {
+        LOG("Failed to allocate IPTS buffers, 0x%x", ret);
+        return ret;
+    }
+    
+    IPTSSetMemWindow window;
+    buffers->fillMemoryWindow(&window);
+    buffer_mode = false;
+    window_pending = true;
+    ret = sendCommand(IPTS_CMD_SET_MEM_WINDOW, &window, sizeof(window));
+    if (ret != kIOReturnSuccess)
+        window_pending = false;
+    return ret;
+}
+
+void SurfaceManagementEngineClient::stopBufferModeGated() {
+    doorbell_timer->cancelTimeout();
+    if (buffer_mode)
+        sendCommand(IPTS_CMD_CLEAR_MEM_WINDOW, nullptr, 0);
+    buffer_mode = false;
+    window_pending = false;
+}
+
+void SurfaceManagementEngineClient::handleBufferResponse(UInt8 *msg, UInt32 len) {
+    if (len < sizeof(UInt32) * 2)
+        return;
+    IPTSResponse *rsp = reinterpret_cast<IPTSResponse *>(msg);
+    
+    switch (rsp->code) {
+        case IPTS_RSP(IPTS_CMD_SET_MEM_WINDOW):
+            if (!window_pending)
+                break;
+            window_pending = false;
+            if (rsp->status != IPTS_STATUS_SUCCESS) {
+                LOG("Device rejected the memory window, status 0x%x", rsp->status);
+                break;
+            }
+            buffer_mode = true;
+            sendCommand(IPTS_CMD_READY_FOR_DATA, nullptr, 0);
+            TimerCoalescer::setTimeoutMS(doorbell_timer, IPTS_DOORBELL_POLL_INTERVAL, IPTS_DOORBELL_POLL_TOLERANCE);
+            break;
+        case IPTS_RSP(IPTS_CMD_READY_FOR_DATA):
+            // event mode, the device tells us a buffer is filled
+            if (buffer_mode) {
+                drainBuffers();
+                doorbell_drained = true;
+                sendCommand(IPTS_CMD_READY_FOR_DATA, nullptr, 0);
+            }
+            break;
+        case IPTS_RSP(IPTS_CMD_CLEAR_MEM_WINDOW):
+            buffer_mode = false;
+            break;
+        default:
+            break;
+    }
+}
+
+IOReturn SurfaceManagementEngineClient::sendCommand(UInt32 code, void *payload, UInt16 payload_len) {
+    IPTSCommand cmd;
+    if (payload_len > sizeof(cmd.payload))
+        return kIOReturnMessageTooLarge;
+    cmd.code = code;
+    if (payload_len)
+        memcpy(cmd.payload, payload, payload_len);
+    return sendMessage(reinterpret_cast<UInt8 *>(&cmd), sizeof(cmd.code) + payload_len, false);
+}
+
+void SurfaceManagementEngineClient::drainBuffers() {
+    const UInt8 *buffer;
+    UInt32 index, len;
+    
+    while ((buffer = buffers->peekFilled(&index, &len)) != nullptr) {
+        deliverMessage(const_cast<UInt8 *>(buffer), len);
+        
+        // hand the buffer back to the device
+        IPTSFeedback feedback;
+        memset(&feedback, 0, sizeof(feedback));
+        feedback.buffer = index;
+        sendCommand(IPTS_CMD_FEEDBACK, &feedback, sizeof(feedback));
+        buffers->consumed();
+    }
+}
+
+void SurfaceManagementEngineClient::pollDoorbell(IOTimerEventSource *timer) {
+    if (!buffer_mode)
+        return;
+    // only look at the doorbell when no response came in for a whole interval
+    if (!doorbell_drained)
+        drainBuffers();
+    doorbell_drained = false;
+    TimerCoalescer::setTimeoutMS(timer, IPTS_DOORBELL_POLL_INTERVAL, IPTS_DOORBELL_POLL_TOLERANCE);
+}
@@ -10,11 +10,58 @@
 #define SurfaceManagementEngineClient_hpp
 
 #include "SurfaceManagementEngineDriver.hpp"
+#include "IPTSReportDecoder.hpp"
+#include "IPTSBufferManager.hpp"
+#include "../LatencyHistogram.hpp"
+#include "../WorkLoopBands.hpp"
 
-struct MEIClientMessage {
+#define MEI_CLIENT_STATS_INTERVAL       5000    // ms
+#define MEI_CLIENT_STATS_TOLERANCE      1000    // ms
+
+#define MEI_CLIENT_PICKUP_DEPTH         64
+#define MEI_CLIENT_TRACE_DEPTH          32
+
+// receive slots of max_msg_length bytes, fragments are read straight into them
+#define MEI_CLIENT_RX_SLOTS             8
+
+// points in the receive path where a message is timestamped
+enum MEIClientStamp {
+    MEIStampInterrupt = 0,  // interrupt filter
+    MEIStampRead,           // last fragment read from the slots
+    MEIStampComplete,       // messageComplete
+    MEIStampDispatch,       // handed to the handler
+    MEIStampPickup,         // picked up by user space
+    MEIStampCount,
+};
+
+// stage i spans stamp i to stamp i+1, the last one is end to end
+enum MEIClientLatencyStage {
+    MEILatencyRead = 0,
+    MEILatencyComplete,
+    MEILatencyDispatch,
+    MEILatencyPickup,
+    MEILatencyTotal,
+    MEILatencyStageCount,
+};
+
+struct MEILatencyReport {
+    UInt32              stage_cnt;
+    UInt32              dropped_pickups;
+    LatencyHistogram    stages[MEILatencyStageCount];
+};
+
+struct MEIClientFrameTrace {
+    UInt32  seq;
+    UInt16  len;
+    UInt64  stamps[MEIStampCount];
+};
+
+struct MEIClientMessage : TaggedObject<AllocTagIPTS> {
     queue_entry entry;
     UInt8*      msg;
     UInt16      len;
+    bool        pooled;
+    UInt64      stamps[MEIStampCount];
 };
 
 class EXPORT SurfaceManagementEngineClient : public IOService {
@@ -41,18 +88,70 @@ public:
     
     IOReturn sendMessage(UInt8 *data, UInt16 data_len, bool blocking);
     
+    IOReturn newUserClient(task_t owningTask, void *securityID, UInt32 type, OSDictionary *props, IOUserClient **handler) override;
+    
+    void copyLatencyReport(MEILatencyReport *report);
+    
+    void resetLatency();
+    
+    void setTracing(bool enable);
+    
+    // user space consumed the oldest dispatched message
+    void markPickup();
+    
+    // touch payloads go to the frame ring as compact records instead of the handler
+    IOReturn setDecoding(UInt32 options);
+    
+    IOMemoryDescriptor *copyFrameRing();
+    
+    IOMemoryDescriptor *copyFrameRingTail();
+    
+    // register host data buffers with the device, frames then arrive through the doorbell, sizes come from the device info
+    IOReturn startBufferMode(UInt32 data_size, UInt32 feedback_size);
+    
+    void stopBufferMode();
+    
 private:
     SurfaceManagementEngineDriver*      api {nullptr};
     IOLock*                             queue_lock {nullptr};
     IOWorkLoop*                         work_loop {nullptr};
+    IOWorkLoop*                         delivery_loop {nullptr};
     IOInterruptEventSource*             interrupt_source {nullptr};
+    IOTimerEventSource*                 stats_timer {nullptr};
+    IOInterruptEventSource*             trace_source {nullptr};
+    IOCommandGate*                      delivery_gate {nullptr};
+    IOTimerEventSource*                 doorbell_timer {nullptr};
     MEIClientProperty                   properties;
     
     OSObject*       target {nullptr};
     MessageHandler  handler {nullptr};
     queue_head_t    rx_queue;
-    UInt8*          rx_cache {nullptr};
-    UInt16          rx_cache_pos {0};
+    queue_head_t    rx_free;
+    MEIClientMessage*   rx_pool {nullptr};
+    UInt8*              rx_storage {nullptr};
+    MEIClientMessage*   rx_current {nullptr};   // message being reassembled
+    UInt32              rx_overflow {0};        // messages that did not fit in the pool
+    
+    LatencyHistogram    latency[MEILatencyStageCount];
+    UInt64              pickup_fifo[MEI_CLIENT_PICKUP_DEPTH];
+    UInt32              pickup_seq[MEI_CLIENT_PICKUP_DEPTH];    // frame of each entry, to stamp its trace
+    UInt16              pickup_head {0};
+    UInt16              pickup_cnt {0};
+    UInt32              pickup_dropped {0};
+    
+    bool                tracing {false};
+    UInt32              frame_seq {0};
+    MEIClientFrameTrace trace_ring[MEI_CLIENT_TRACE_DEPTH];
+    UInt16              trace_head {0};
+    UInt16              trace_cnt {0};
+    
+    IPTSReportDecoder   decoder;
+    IPTSFrameRing*      frame_ring {nullptr};
+    
+    IPTSBufferManager*  buffers {nullptr};
+    bool                window_pending {false};
+    bool                buffer_mode {false};
+    bool                doorbell_drained {false};   // by a response since the last poll
     
     UInt8   addr;
     bool    active {false};
@@ -66,9 +165,33 @@ private:
     
     void hostRequestReconnect();
     
+    MEIClientMessage *allocMessage();
+    
+    void releaseMessage(MEIClientMessage *client_msg);
+    
     void messageComplete();
     
     void notifyMessage(IOInterruptEventSource *sender, int count);
+    
+    void publishStatistics(IOTimerEventSource *timer);
+    
+    void dumpTrace(IOInterruptEventSource *sender, int count);
+    
+    void deliverMessage(UInt8 *msg, UInt32 len);
+    
+    IOReturn setDecodingGated(UInt32 *options);
+    
+    IOReturn startBufferModeGated(UInt32 *data_size, UInt32 *feedback_size);
+    
+    void stopBufferModeGated();
+    
+    void handleBufferResponse(UInt8 *msg, UInt32 len);
+    
+    IOReturn sendCommand(UInt32 code, void *payload, UInt16 payload_len);
+    
+    void drainBuffers();
+    
+    void pollDoorbell(IOTimerEventSource *timer);
 };
 
 #endif /* SurfaceManagementEngineClient_hpp */
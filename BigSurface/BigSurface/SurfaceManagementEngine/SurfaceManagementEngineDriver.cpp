@@ -8,10 +8,16 @@
 
 #include "SurfaceManagementEngineDriver.hpp"
 #include "SurfaceManagementEngineClient.hpp"
+#include "../BigSurfaceDiagnostics/Tracepoints.hpp"
+#include "../BootTimeline.hpp"
 
 #define super IOService
 OSDefineMetaClassAndStructors(SurfaceManagementEngineDriver, IOService);
 
+static const char *counter_names[MEICounterCount] = {
+    "Interrupts", "Resets", "D0i3Entries", "D0i3Exits", "RxMessages", "RxBytes", "TxDirect", "TxQueued",
+};
+
 void bitmap_set_bit(UInt8 *map, UInt addr, bool set) {
     UInt i = addr / 8;
     UInt offset = addr % 8;
@@ -41,6 +47,18 @@ bool SurfaceManagementEngineDriver::init(OSDictionary* properties) {
     memset(&device, 0, sizeof(MEIPhysicalDevice));
     memset(&bus, 0, sizeof(MEIBus));
     queue_init(&bus.tx_queue);
+    queue_init(&bus.tx_free);
+    
+    // descriptors stay small, the message buffers live in one array of their own
+    bus.tx_pool = new MEIClientTransaction[MEI_TX_POOL_SIZE]();
+    bus.tx_pool_buf = tagNewArray<UInt8>(AllocTagMEI, MEI_TX_POOL_SIZE * MEI_TX_POOL_BUF_SIZE);
+    if (!bus.tx_pool || !bus.tx_pool_buf)
+        return false;
+    for (int i = 0; i < MEI_TX_POOL_SIZE; i++) {
+        bus.tx_pool[i].pooled = true;
+        bus.tx_pool[i].storage = bus.tx_pool_buf + i * MEI_TX_POOL_BUF_SIZE;
+        enqueue(&bus.tx_free, &bus.tx_pool[i].entry);
+    }
     
     return true;
 }
@@ -57,16 +75,20 @@ IOService* SurfaceManagementEngineDriver::probe(IOService* provider, SInt32* sco
 }
 
 bool SurfaceManagementEngineDriver::start(IOService* provider) {
+    BootTimeline::begin(BootStageMEIStart);
     if (!super::start(provider))
         return false;
     
     int interrupt_type, interrupt_idx=0;
     
+    // not a band, the interrupt handler reads the hardware FIFO and must not
+    // queue behind anything else
     work_loop = IOWorkLoop::workLoop();
     if (!work_loop) {
         LOG("Could not get work loop");
         goto exit;
     }
+    counters = PerfCounterGroup::create(getName(), counter_names, MEICounterCount);
     command_gate = IOCommandGate::commandGate(this);
     if (!command_gate) {
         LOG("Could not open command gate");
@@ -84,6 +106,12 @@ bool SurfaceManagementEngineDriver::start(IOService* provider) {
     work_loop->addEventSource(reset_work);
     work_loop->addEventSource(rescan_work);
     work_loop->addEventSource(resume_work);
+    reset_timer = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &SurfaceManagementEngineDriver::retryReset));
+    if (!reset_timer) {
+        LOG("Could not create reset timer");
+        goto exit;
+    }
+    work_loop->addEventSource(reset_timer);
     
     if (!device.pci_dev->open(this)) {
         LOG("Could not open provider");
@@ -110,12 +138,18 @@ bool SurfaceManagementEngineDriver::start(IOService* provider) {
         goto exit;
     }
     
+    if (!PowerOrchestrator::registerDomain(PowerDomainMEI, this, OSMemberFunctionCast(PowerOrchestrator::Transition, this, &SurfaceManagementEngineDriver::powerTransition))) {
+        LOG("Failed to register power domain");
+        goto exit;
+    }
+    
     PMinit();
     device.pci_dev->joinPMtree(this);
     registerPowerDriver(this, MyIOPMPowerStates, kIOPMNumberPowerStates);
 
     device.pci_dev->retain();
     registerService();
+    BootTimeline::end(BootStageMEIStart);
     return true;
 exit:
     releaseResources();
@@ -138,13 +172,25 @@ void SurfaceManagementEngineDriver::stop(IOService *provider) {
 }
 
 void SurfaceManagementEngineDriver::free() {
+    if (bus.tx_pool) {
+        delete[] bus.tx_pool;
+        bus.tx_pool = nullptr;
+    }
+    if (bus.tx_pool_buf) {
+        tagFree(bus.tx_pool_buf);
+        bus.tx_pool_buf = nullptr;
+    }
     super::free();
 }
 
 IOReturn SurfaceManagementEngineDriver::setPowerState(unsigned long whichState, IOService *whatDevice) {
     if (whatDevice != this)
         return kIOReturnInvalid;
-    if (whichState == 0) {
+    return PowerOrchestrator::scheduleTransition(PowerDomainMEI, whichState != 0);
+}
+
+void SurfaceManagementEngineDriver::powerTransition(bool wake) {
+    if (!wake) {
         if (awake) {
             command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &SurfaceManagementEngineDriver::stopDeviceGated));
             disableInterrupts();
@@ -164,10 +210,10 @@ IOReturn SurfaceManagementEngineDriver::setPowerState(unsigned long whichState,
             DBG_LOG("Woke up");
         }
     }
-    return kIOPMAckImplied;
 }
 
 void SurfaceManagementEngineDriver::releaseResources() {
+    PowerOrchestrator::unregisterDomain(PowerDomainMEI, this);
     if (interrupt_source) {
         disableInterrupts();
         interrupt_source->disable();
@@ -186,6 +232,12 @@ void SurfaceManagementEngineDriver::releaseResources() {
         work_loop->removeEventSource(idle_timeout);
         OSSafeReleaseNULL(idle_timeout);
     }
+    if (reset_timer) {
+        reset_timer->cancelTimeout();
+        reset_timer->disable();
+        work_loop->removeEventSource(reset_timer);
+        OSSafeReleaseNULL(reset_timer);
+    }
     if (reset_work) {
         reset_work->disable();
         work_loop->removeEventSource(reset_work);
@@ -209,6 +261,10 @@ void SurfaceManagementEngineDriver::releaseResources() {
         OSSafeReleaseNULL(command_gate);
     }
     OSSafeReleaseNULL(work_loop);
+    if (counters) {
+        PerfCounterGroup::destroy(counters);
+        counters = nullptr;
+    }
     if (ipts_client) {
         ipts_client->stop(this);
         ipts_client->detach(this);
@@ -272,6 +328,8 @@ err:
 
 void SurfaceManagementEngineDriver::stopDeviceGated() {
     device.state = MEIDevicePowerDown;
+    reset_timer->cancelTimeout();
+    reset_pending = false;
     
     init_timeout->disable();
 
@@ -290,70 +348,58 @@ IOReturn SurfaceManagementEngineDriver::restartDeviceGated() {
         return kIOReturnDeviceError;
     }
     if (ret != kIOReturnSuccess)
-        reset_work->interruptOccurred(nullptr, this, 0);
+        requestReset(MEIFailureRecoverable);
     
     return kIOReturnSuccess;
 }
 
 IOReturn SurfaceManagementEngineDriver::mapMemory() {
-    if (device.pci_dev->getDeviceMemoryCount() == 0) {
+    if (device.pci_dev->getDeviceMemoryCount() == 0)
         return kIOReturnDeviceError;
-    } else {
-        device.mmap = device.pci_dev->mapDeviceMemoryWithIndex(0);
-        if (!device.mmap) return kIOReturnDeviceError;
-        return kIOReturnSuccess;
-    }
+    
+    IOMemoryMap *mmap = device.pci_dev->mapDeviceMemoryWithIndex(0);
+    if (!mmap)
+        return kIOReturnDeviceError;
+    device.regs = new MEIMappedRegisters(mmap);
+    mmap->release();
+    return device.regs ? kIOReturnSuccess : kIOReturnNoMemory;
 }
 
 void SurfaceManagementEngineDriver::unmapMemory() {
-    OSSafeReleaseNULL(device.mmap);
+    if (device.regs) {
+        delete device.regs;
+        device.regs = nullptr;
+    }
 }
 
 inline UInt32 SurfaceManagementEngineDriver::readRegister(int offset) {
-    if (device.mmap) {
-         IOVirtualAddress address = device.mmap->getVirtualAddress();
-         if (address != 0)
-             return *(const volatile UInt32 *)(address + offset);
-     }
-     return kIOReturnSuccess;
+    if (device.regs)
+        return device.regs->read(offset);
+    return 0;
 }
 
 inline void SurfaceManagementEngineDriver::writeRegister(UInt32 value, int offset) {
-    if (device.mmap) {
-        IOVirtualAddress address = device.mmap->getVirtualAddress();
-        if (address != 0)
-            *(volatile UInt32 *)(address + offset) = value;
-    }
+    if (device.regs)
+        device.regs->write(value, offset);
 }
 
 UInt8 SurfaceManagementEngineDriver::calcFilledSlots() {
-    UInt32 hcsr = readRegister(MEI_H_CSR);
-    SInt8 read_ptr = (hcsr & MEI_CSR_BUF_RPOINTER) >> 8;
-    SInt8 write_ptr = (hcsr & MEI_CSR_BUF_WPOINTER) >> 16;
-    
-    return write_ptr - read_ptr;
+    return mei_csr_filled_slots(readRegister(MEI_H_CSR));
 }
 
 IOReturn SurfaceManagementEngineDriver::findEmptySlots(UInt8 *empty_slots) {
-    UInt8 filled_slots = calcFilledSlots();
-    if (filled_slots > device.tx_buf_depth)
+    if (!device.regs)
+        return kIOReturnNoDevice;
+    if (meiHostEmptySlots(device.regs, device.tx_buf_depth, empty_slots) != MEISlotOK)
         return kIOReturnOverrun;
-    
-    *empty_slots = device.tx_buf_depth - filled_slots;
     return kIOReturnSuccess;
 }
 
 IOReturn SurfaceManagementEngineDriver::countRxSlots(UInt8 *filled_slots) {
-    UInt32 mecsr = readRegister(MEI_ME_CSR);
-    UInt8 buffer_depth = (mecsr & MEI_CSR_BUF_DEPTH) >> 24;
-    SInt8 read_ptr = (mecsr & MEI_CSR_BUF_RPOINTER) >> 8;
-    SInt8 write_ptr = (mecsr & MEI_CSR_BUF_WPOINTER) >> 16;
-    UInt8 slots = write_ptr - read_ptr;
-    
-    if (slots > buffer_depth)
+    if (!device.regs)
+        return kIOReturnNoDevice;
+    if (meiMEFilledSlots(device.regs, filled_slots) != MEISlotOK)
         return kIOReturnOverrun;
-    
-    *filled_slots = slots;
     return kIOReturnSuccess;
 }
 
@@ -387,8 +433,8 @@ bool SurfaceManagementEngineDriver::isWriteQueueEmpty() {
 }
 
 inline void SurfaceManagementEngineDriver::setHostCSR(UInt32 hcsr) {
-    hcsr &= ~MEI_H_CSR_INT_STA_MASK;
-    writeRegister(hcsr, MEI_H_CSR);
+    if (device.regs)
+        meiSetHostCSR(device.regs, hcsr);
 }
 
 void SurfaceManagementEngineDriver::clearInterrupts() {
@@ -410,9 +456,8 @@ void SurfaceManagementEngineDriver::disableInterrupts() {
 }
 
 void SurfaceManagementEngineDriver::setHostInterrupt() {
-    UInt32 hcsr = readRegister(MEI_H_CSR);
-    hcsr |= MEI_H_CSR_INT_GEN;
-    setHostCSR(hcsr);
+    if (device.regs)
+        meiSetHostInterrupt(device.regs);
 }
 
 void SurfaceManagementEngineDriver::configDevice() {
@@ -550,6 +595,7 @@ sw_reset:
     
     device.state = MEIDeviceInitClients;
     // Send start request
+    BootTimeline::begin(BootStageMEIEnumeration);
     bus.state = MEIBusIdle;
     ret = sendStartRequest();
     if (ret) {
@@ -737,6 +783,7 @@ IOReturn SurfaceManagementEngineDriver::enterPowerGatingSync() {
 on:
     ret = kIOReturnSuccess;
     device.pg_state = MEIPowerGatingOn;
+    PERF_COUNT(counters, MEICounterD0i3Entries);
     LOG("Enter d0i3 mode");
 out:
     device.pg_event = MEIPowerGatingEventIdle;
@@ -774,6 +821,7 @@ IOReturn SurfaceManagementEngineDriver::exitPowerGatingSync() {
 off:
     ret = kIOReturnSuccess;
     device.pg_state = MEIPowerGatingOff;
+    PERF_COUNT(counters, MEICounterD0i3Exits);
     LOG("Exit d0i3 mode");
 out:
     device.pg_event = MEIPowerGatingEventIdle;
@@ -781,14 +829,8 @@ out:
 }
 
 void SurfaceManagementEngineDriver::readMessage(UInt8 *buffer, UInt16 buffer_len) {
-    UInt32 *buf = reinterpret_cast<UInt32 *>(buffer);
-    for (; buffer_len >= MEI_SLOT_SIZE; buffer_len -= MEI_SLOT_SIZE)
-        *buf++ = readRegister(MEI_ME_CB_RW);
-    if (buffer_len > 0) {
-        UInt32 reg = readRegister(MEI_ME_CB_RW);
-        memcpy(buf, &reg, buffer_len);
-    }
-    setHostInterrupt();
+    if (device.regs)
+        meiReadSlots(device.regs, buffer, buffer_len);
 }
 
 IOReturn SurfaceManagementEngineDriver::writeMessage(UInt8 *header, UInt16 header_len, UInt8 *data, UInt16 data_len) {
@@ -796,40 +838,27 @@ IOReturn SurfaceManagementEngineDriver::writeMessage(UInt8 *header, UInt16 heade
         LOG("Message invalid!");
         return kIOReturnInvalid;
     }
+    if (!device.regs)
+        return kIOReturnNoDevice;
 
-    UInt8 empty_slots;
-    if (findEmptySlots(&empty_slots) != kIOReturnSuccess) {
-        LOG("WTF? Filled slots is bigger than host buffer");
-        return kIOReturnOverrun;
-    }
-
-    UInt8 slots_needed = MEI_DATA_TO_SLOTS(header_len + data_len);
-    if (slots_needed > empty_slots) {
-        LOG("Message too large! need %d, empty %d", slots_needed, empty_slots);
-        return kIOReturnMessageTooLarge;
-    }
-
-    const MEI_SLOT_TYPE *buf = reinterpret_cast<MEI_SLOT_TYPE *>(header);
-    for (int i = 0; i < header_len / MEI_SLOT_SIZE; i++)
-        writeRegister(buf[i], MEI_H_CB_WW);
-    buf = reinterpret_cast<MEI_SLOT_TYPE *>(data);
-    for (int i = 0; i < data_len / MEI_SLOT_SIZE; i++)
-        writeRegister(buf[i], MEI_H_CB_WW);
-    UInt8 tail = data_len % MEI_SLOT_SIZE;
-    if (tail > 0) {
-        UInt32 reg = 0;
-        memcpy(&reg, data + data_len - tail, tail);
-        writeRegister(reg, MEI_H_CB_WW);
-    }
-
-    setHostInterrupt();
-    
-    if (!isHardwareReady()) {
-        LOG("WTF? Hardware is not ready yet");
-        return kIOReturnIOError;
+    UInt8 empty_slots = 0;
+    switch (meiWriteSlots(device.regs, device.tx_buf_depth, header, header_len, data, data_len)) {
+        case MEISlotOK:
+            return kIOReturnSuccess;
+        case MEISlotOverrun:
+            LOG("WTF? Filled slots is bigger than host buffer");
+            return kIOReturnOverrun;
+        case MEISlotTooLarge:
+            findEmptySlots(&empty_slots);
+            LOG("Message too large! need %d, empty %d", MEI_DATA_TO_SLOTS(header_len + data_len), empty_slots);
+            return kIOReturnMessageTooLarge;
+        case MEISlotNotReady:
+            LOG("WTF? Hardware is not ready yet");
+            return kIOReturnIOError;
+        default:
+            LOG("Message invalid!");
+            return kIOReturnInvalid;
     }
-
-    return kIOReturnSuccess;
 }
 
 inline void SurfaceManagementEngineDriver::setupMessageHeader(MEIBusMessageHeader *header, UInt16 length) {
@@ -856,19 +885,30 @@ IOReturn SurfaceManagementEngineDriver::sendClientMessageGated(SurfaceManagement
         return kIOReturnAborted;
     }
     
-    MEIClientTransaction *tx = new MEIClientTransaction;
-    tx->client = client;
-    tx->data_len = *buffer_len;
-    tx->data = new UInt8[tx->data_len];
-    memcpy(tx->data, buffer, tx->data_len);
-    tx->completed = false;
-    tx->blocking = *blocking;
-    
     IOReturn ret = kIOReturnSuccess;
-    if (acquireWriteBuffer() && submitTransaction(tx)) {
-        delete[] tx->data;
-        delete tx;
+    
+    // Fast path, write straight from the caller's buffer
+    MEIClientTransaction direct {};
+    direct.client = client;
+    direct.data = buffer;
+    direct.data_len = *buffer_len;
+    if (acquireWriteBuffer() && submitTransaction(&direct)) {
+        if (!direct.completed)
+            ret = kIOReturnIOError;
+        else
+            PERF_COUNT(counters, MEICounterTxDirect);
     } else {
+        // Only copy what is left when the message has to wait in the queue
+        MEIClientTransaction *tx = allocTransaction(direct.data_len);
+        if (!tx)
+            return kIOReturnNoMemory;
+        tx->client = client;
+        tx->data_len = direct.data_len;
+        memcpy(tx->data, direct.data, tx->data_len);
+        tx->completed = false;
+        tx->blocking = *blocking;
+        
+        PERF_COUNT(counters, MEICounterTxQueued);
         enqueue(&bus.tx_queue, &tx->entry);
         if (tx->blocking) {
             AbsoluteTime abstime, deadline;
@@ -880,12 +920,11 @@ IOReturn SurfaceManagementEngineDriver::sendClientMessageGated(SurfaceManagement
                 ret = kIOReturnTimeout;
             }
             remqueue(&tx->entry);
-            delete[] tx->data;
-            delete tx;
+            releaseTransaction(tx);
         }
     }
     
-    idle_timeout->setTimeoutMS(MEI_DEVICE_IDLE_TIMEOUT * 1000);
+    scheduleIdle();
     return ret;
 }
 
@@ -974,9 +1013,15 @@ IOReturn SurfaceManagementEngineDriver::sendClientPropertyRequest(UInt start_idx
         bus.state = MEIBusStarted;
         device.state = MEIDeviceEnabled;
         device.reset_cnt = 0;
+        BootTimeline::end(BootStageMEIEnumeration);
+        if (failure_episode) {
+            reset_stats.recovery.recordSince(failure_episode);
+            failure_episode = 0;
+            publishResetStatistics();
+        }
         rescan_work->interruptOccurred(nullptr, this, 0);
         // Enable idle (d0i3 mode)
-        idle_timeout->setTimeoutMS(MEI_DEVICE_IDLE_TIMEOUT * 1000);
+        scheduleIdle();
         return kIOReturnSuccess;
     }
     
@@ -1006,18 +1051,99 @@ IOReturn SurfaceManagementEngineDriver::sendAddClientResponse(UInt8 me_addr, MEI
     return writeHostMessage(&header, MEI_TO_MSG(&res));
 }
 
+void SurfaceManagementEngineDriver::requestReset(MEIFailureType type) {
+    UInt64 now, ns;
+    
+    reset_stats.failures[type]++;
+    // coalesce failures reported while a reset is already scheduled
+    if (reset_pending)
+        return;
+    
+    clock_get_uptime(&now);
+    absolutetime_to_nanoseconds(now - last_failure, &ns);
+    if (!last_failure || ns > MEI_RESET_STABLE_TIME * 1000000000ULL) {
+        // isolated glitch, reset right away
+        reset_backoff = 0;
+        failure_episode = now;
+    }
+    last_failure = now;
+    reset_pending = true;
+    TRACEPOINT(TraceMEI, TraceMEIReset, type, reset_backoff);
+    
+    if (!reset_backoff) {
+        reset_backoff = MEI_RESET_BACKOFF_MIN;
+        reset_work->interruptOccurred(nullptr, this, 0);
+    } else {
+        DBG_LOG("Reset storm, retrying in %u ms", reset_backoff);
+        reset_stats.backoffs++;
+        reset_timer->setTimeoutMS(reset_backoff);
+        reset_backoff = reset_backoff * 2 > MEI_RESET_BACKOFF_MAX ? MEI_RESET_BACKOFF_MAX : reset_backoff * 2;
+    }
+}
+
 void SurfaceManagementEngineDriver::scheduleReset(IOInterruptEventSource *sender, int count) {
+    runReset();
+}
+
+void SurfaceManagementEngineDriver::retryReset(IOTimerEventSource *timer) {
+    runReset();
+}
+
+void SurfaceManagementEngineDriver::runReset() {
+    reset_pending = false;
     clearInterrupts();
     
+    reset_stats.resets++;
+    PERF_COUNT(counters, MEICounterResets);
     IOReturn ret = resetDevice();
     
     if (device.state == MEIDeviceDisabled) {
-        LOG("Error! Device disabled");
+        reset_stats.disabled++;
+        publishResetStatistics();
+        if (!awake)
+            return;
+        // persistent failure, keep touch alive but only try again rarely
+        LOG("Error! Device disabled, retrying in %d ms", MEI_RESET_BACKOFF_MAX);
+        device.reset_cnt = 0;
+        reset_backoff = MEI_RESET_BACKOFF_MAX;
+        reset_pending = true;
+        reset_timer->setTimeoutMS(MEI_RESET_BACKOFF_MAX);
         return;
     }
     // retry in case of failure
     if (ret != kIOReturnSuccess)
-        reset_work->interruptOccurred(nullptr, this, 0);
+        requestReset(MEIFailureRecoverable);
+    publishResetStatistics();
+}
+
+void SurfaceManagementEngineDriver::publishResetStatistics() {
+    static const char *failure_names[MEIFailureTypeCount] = {"Recoverable", "CorruptedHeader", "NotReady"};
+    OSDictionary *stats = OSDictionary::withCapacity(8);
+    if (!stats)
+        return;
+    
+    OSNumber *num;
+    for (int i = 0; i < MEIFailureTypeCount; i++) {
+        if ((num = OSNumber::withNumber(reset_stats.failures[i], 64))) {
+            stats->setObject(failure_names[i], num);
+            num->release();
+        }
+    }
+    const char *keys[] = {"Resets", "Backoffs", "Disabled", "CurrentBackoff", "ReadRetries"};
+    UInt64 values[] = {reset_stats.resets, reset_stats.backoffs, reset_stats.disabled, reset_backoff, reset_stats.read_retries};
+    for (int i = 0; i < 5; i++) {
+        if ((num = OSNumber::withNumber(values[i], 64))) {
+            stats->setObject(keys[i], num);
+            num->release();
+        }
+    }
+    OSDictionary *recovery = reset_stats.recovery.copySummary();
+    if (recovery) {
+        stats->setObject("RecoveryTime", recovery);
+        recovery->release();
+    }
+    setProperty("MEIResetStatistics", stats);
+    stats->release();
 }
 
 void SurfaceManagementEngineDriver::scheduleRescan(IOInterruptEventSource *sender, int count) {
@@ -1044,13 +1170,16 @@ void SurfaceManagementEngineDriver::scheduleRescan(IOInterruptEventSource *sende
 void SurfaceManagementEngineDriver::scheduleResume(IOInterruptEventSource *sender, int count) {
     if (exitPowerGatingSync() != kIOReturnSuccess) {
         LOG("Warning! Exit d0i3 failed. Resetting...");
-        reset_work->interruptOccurred(nullptr, this, 0);
+        requestReset(MEIFailureRecoverable);
     }
 }
 
 bool SurfaceManagementEngineDriver::filterInterrupt(IOFilterInterruptEventSource *sender) {
     UInt32 hcsr = readRegister(MEI_H_CSR);
-    return (hcsr & MEI_H_CSR_INT_STA_MASK) != 0;
+    if (!(hcsr & MEI_H_CSR_INT_STA_MASK))
+        return false;
+    clock_get_uptime(&irq_time);
+    return true;
 }
 
 void SurfaceManagementEngineDriver::handleInterrupt(IOInterruptEventSource *sender, int count) {
@@ -1059,13 +1188,15 @@ void SurfaceManagementEngineDriver::handleInterrupt(IOInterruptEventSource *send
     disableInterrupts();
     
     UInt32 hcsr = readRegister(MEI_H_CSR);
+    TRACEPOINT(TraceMEI, TraceMEIInterrupt, hcsr, 0);
+    PERF_COUNT(counters, MEICounterInterrupts);
     
     clearInterrupts();
     
     /* check if ME wants a reset */
     if (!isHardwareReady() && device.state != MEIDeviceResetting) {
         LOG("Hardware not ready! Resetting...");
-        reset_work->interruptOccurred(nullptr, this, 0);
+        requestReset(MEIFailureNotReady);
         goto end;
     }
 
@@ -1093,13 +1224,15 @@ void SurfaceManagementEngineDriver::handleInterrupt(IOInterruptEventSource *send
              * Not all data is always available immediately after the
              * interrupt, so try to read again on the next interrupt.
              */
-            if (ret == kIOReturnNotReadable)
+            if (ret == kIOReturnNotReadable) {
+                reset_stats.read_retries++;
                 break;
+            }
 
             if (ret != kIOReturnSuccess &&
                 (device.state != MEIDeviceResetting && device.state != MEIDevicePowerDown)) {
                 LOG("Read message failed! Resetting...");
-                reset_work->interruptOccurred(nullptr, this, 0);
+                requestReset(ret == kIOReturnInvalid ? MEIFailureCorruptedHeader : MEIFailureRecoverable);
                 goto end;
             }
         }
@@ -1500,25 +1633,40 @@ IOReturn SurfaceManagementEngineDriver::handleHostMessage(MEIBusMessageHeader *h
 }
 
 IOReturn SurfaceManagementEngineDriver::handleClientMessage(SurfaceManagementEngineClient *client, MEIBusMessageHeader *mei_hdr, MEIBusExtendedMetaHeader *meta) {
-    UInt16 data_len;
+    MEIClientMessage *rx;
+    UInt32 data_len;
     UInt16 length = mei_hdr->length;
     
     if (mei_hdr->extended || mei_hdr->dma_ring)
         goto discard;
 
-    data_len = length + client->rx_cache_pos;
+    if (!client->rx_current && !(client->rx_current = client->allocMessage())) {
+        LOG("Warning, no receive buffer for client %d", client->addr);
+        goto discard;
+    }
+    rx = client->rx_current;
+
+    data_len = length + rx->len;
     if (client->properties.max_msg_length < data_len) {
         LOG("Warning, message overflow. client max msg size %d, rx msg size %d", client->properties.max_msg_length, data_len);
         goto discard;
     }
 
-    readMessage(client->rx_cache + client->rx_cache_pos, length);
-    client->rx_cache_pos += length;
+    if (!rx->len)
+        rx->stamps[MEIStampInterrupt] = irq_time;
+    readMessage(rx->msg + rx->len, length);
+    rx->len += length;
+    TRACEPOINT(TraceMEI, TraceMEIClientRead, client->addr, length);
+    if (counters)
+        counters->add(MEICounterRxBytes, length);
+    clock_get_uptime(&rx->stamps[MEIStampRead]);
 
-    if (mei_hdr->msg_complete)
+    if (mei_hdr->msg_complete) {
+        PERF_COUNT(counters, MEICounterRxMessages);
         client->messageComplete();
+    }
     
-    idle_timeout->setTimeoutMS(MEI_DEVICE_IDLE_TIMEOUT * 1000);
+    scheduleIdle();
 
     return kIOReturnSuccess;
 discard:
@@ -1547,9 +1695,44 @@ void SurfaceManagementEngineDriver::completeTransaction(MEIClientTransaction *tx
         command_gate->commandWakeup(&tx->wait);
     else {
         remqueue(&tx->entry);
-        delete[] tx->data;
-        delete tx;
+        releaseTransaction(tx);
+    }
+}
+
+MEIClientTransaction *SurfaceManagementEngineDriver::allocTransaction(UInt16 data_len) {
+    MEIClientTransaction *tx;
+    queue_entry *item = dequeue(&bus.tx_free);
+    if (item)
+        tx = qe_element(item, MEIClientTransaction, entry);
+    else {
+        DBG_LOG("Transaction pool exhausted");
+        tx = new MEIClientTransaction();
+        if (!tx)
+            return nullptr;
+    }
+    
+    tx->heap_buf = nullptr;
+    if (!tx->storage || data_len > MEI_TX_POOL_BUF_SIZE) {
+        tx->heap_buf = tagNewArray<UInt8>(AllocTagMEI, data_len);
+        if (!tx->heap_buf) {
+            releaseTransaction(tx);
+            return nullptr;
+        }
+        tx->data = tx->heap_buf;
+    } else
+        tx->data = tx->storage;
+    return tx;
+}
+
+void SurfaceManagementEngineDriver::releaseTransaction(MEIClientTransaction *tx) {
+    if (tx->heap_buf) {
+        tagFree(tx->heap_buf);
+        tx->heap_buf = nullptr;
     }
+    if (tx->pooled)
+        enqueue(&bus.tx_free, &tx->entry);
+    else
+        delete tx;
 }
 
 bool SurfaceManagementEngineDriver::submitTransaction(MEIClientTransaction *tx) {
@@ -1606,9 +1789,18 @@ void SurfaceManagementEngineDriver::enterIdle(IOTimerEventSource *timer) {
     
     if (ret != kIOReturnSuccess && ret != kIOReturnBusy) {
         LOG("Warning! Enter d0i3 failed. Resetting...");
-        reset_work->interruptOccurred(nullptr, this, 0);
+        requestReset(MEIFailureRecoverable);
     } else if (ret == kIOReturnBusy)
-        idle_timeout->setTimeoutMS(MEI_DEVICE_IDLE_TIMEOUT * 1000);
+        scheduleIdle();
+}
+
+void SurfaceManagementEngineDriver::scheduleIdle() {
+    UInt32 timeout = Tunables::get(BigSurfaceTunableMEIIdleTimeout);
+    // 0 keeps the device in d0
+    if (timeout)
+        TimerCoalescer::setTimeoutMS(idle_timeout, timeout, MEI_DEVICE_IDLE_TOLERANCE);
+    else
+        idle_timeout->cancelTimeout();
 }
 
 void SurfaceManagementEngineDriver::initialiseTimeout(IOTimerEventSource *timer) {
@@ -17,7 +17,16 @@
 #include <IOKit/IOBufferMemoryDescriptor.h>
 #include <IOKit/IODMACommand.h>
 
+#include "../helpers.hpp"
 #include "MEIProtocol.h"
+#include "MEIMappedRegisters.hpp"
+#include "MEISlotTransport.hpp"
+#include "../LatencyHistogram.hpp"
+#include "../BigSurfaceDiagnostics/PerfCounters.hpp"
+#include "../PowerOrchestrator.hpp"
+#include "../TimerCoalescer.hpp"
+#include "../Tunables.hpp"
+#include "../TaggedAllocator.hpp"
 
 #define kIOPMPowerOff                       0
 #define kIOPMNumberPowerStates              2
@@ -87,9 +96,44 @@ enum MEIPowerGatingState {
     MEIPowerGatingOn  = 1,
 };
 
+/**
+ * enum MEIFailureType - classes of failures leading to a reset
+ *
+ * @MEIFailureRecoverable       : protocol or power gating error, a reset brings the link back
+ * @MEIFailureCorruptedHeader   : message header out of sync with the circular buffer
+ * @MEIFailureNotReady          : ME not ready
+ */
+enum MEIFailureType {
+    MEIFailureRecoverable = 0,
+    MEIFailureCorruptedHeader,
+    MEIFailureNotReady,
+    MEIFailureTypeCount,
+};
+
+enum MEICounter {
+    MEICounterInterrupts = 0,
+    MEICounterResets,
+    MEICounterD0i3Entries,
+    MEICounterD0i3Exits,
+    MEICounterRxMessages,
+    MEICounterRxBytes,
+    MEICounterTxDirect,
+    MEICounterTxQueued,
+    MEICounterCount,
+};
+
+struct MEIResetStatistics {
+    UInt64  failures[MEIFailureTypeCount];
+    UInt64  resets;         // resets actually run
+    UInt64  backoffs;       // resets delayed because of a storm
+    UInt64  disabled;       // times MEI_MAX_CONSEC_RESET was hit
+    UInt64  read_retries;   // reads put off to the next interrupt, not a failure
+    LatencyHistogram recovery;  // first failure to device enabled
+};
+
 struct MEIPhysicalDevice {
-    IOPCIDevice*        pci_dev;
-    IOMemoryMap*        mmap;
+    IOPCIDevice*            pci_dev;
+    MEIRegisterInterface*   regs;
     MEIDeviceState      state;
     MEIPowerGatingEvent pg_event;
     MEIPowerGatingState pg_state;
@@ -116,14 +160,17 @@ struct MEIPhysicalDevice {
 
 class SurfaceManagementEngineClient;
 
-struct MEIClientTransaction {
+struct MEIClientTransaction : TaggedObject<AllocTagMEI> {
     queue_entry entry;
     SurfaceManagementEngineClient *client;
-    UInt8*  data;
+    UInt8*  data;           // part of the message not written yet
     UInt16  data_len;
     bool    completed;
     bool    blocking;
     bool    wait;
+    bool    pooled;
+    UInt8*  storage;        // MEI_TX_POOL_BUF_SIZE bytes of tx_pool_buf, nullptr outside the pool
+    UInt8*  heap_buf;       // message did not fit into storage
 };
 
 struct MEIBus {
@@ -134,6 +181,9 @@ struct MEIBus {
     bool            tx_buf_ready;
     UInt8           tx_queue_limit;
     queue_head_t    tx_queue;
+    queue_head_t    tx_free;
+    MEIClientTransaction*   tx_pool;
+    UInt8*                  tx_pool_buf;
 };
 
 UUID_DEFINE(SURFACE_IPTS_CLIENT_UUID, 0x70, 0x08, 0x8d, 0x3e, 0x1a, 0x27, 0x08, 0x42, 0x8e, 0xb5, 0x9a, 0xcb, 0x94, 0x02, 0xae, 0x04);
@@ -174,12 +224,21 @@ private:
     IOInterruptEventSource*         resume_work {nullptr};
     IOTimerEventSource*             init_timeout {nullptr};
     IOTimerEventSource*             idle_timeout {nullptr};
+    IOTimerEventSource*             reset_timer {nullptr};
+    PerfCounterGroup*               counters {nullptr};
     SurfaceManagementEngineClient*  ipts_client {nullptr};
     IOCommandGate::Action           client_msg_action {nullptr};
     
     MEIPhysicalDevice   device;
     MEIBus              bus;
     UInt8               me_client_map[MEI_MAX_CLIENT_NUM/8];
+    UInt64              irq_time {0};
+    
+    MEIResetStatistics  reset_stats {};
+    UInt32              reset_backoff {0};
+    UInt64              last_failure {0};
+    UInt64              failure_episode {0};
+    bool                reset_pending {false};
     
     bool awake {true};
     bool wait_hw_ready {false};
@@ -188,6 +247,8 @@ private:
 
     void releaseResources();
     
+    void powerTransition(bool wake);
+    
     IOReturn startDeviceGated();
     void stopDeviceGated();
     IOReturn restartDeviceGated();
@@ -240,7 +301,11 @@ private:
     IOReturn sendClientPropertyRequest(UInt client_idx);
     IOReturn sendAddClientResponse(UInt8 me_addr, MEIHostBusMessageReturnType status);
     
+    void requestReset(MEIFailureType type);
     void scheduleReset(IOInterruptEventSource *sender, int count);
+    void retryReset(IOTimerEventSource *timer);
+    void runReset();
+    void publishResetStatistics();
     void scheduleRescan(IOInterruptEventSource *sender, int count);
     void scheduleResume(IOInterruptEventSource *sender, int count);
     
@@ -256,9 +321,12 @@ private:
         
     IOReturn handleWrite();
     void completeTransaction(MEIClientTransaction *tx);
+    MEIClientTransaction *allocTransaction(UInt16 data_len);
+    void releaseTransaction(MEIClientTransaction *tx);
     bool submitTransaction(MEIClientTransaction *tx);
     
     void enterIdle(IOTimerEventSource *timer);
+    void scheduleIdle();
     void initialiseTimeout(IOTimerEventSource *timer);
     
     IOReturn addClient(MEIClientProperty *client_props, UInt8 addr);
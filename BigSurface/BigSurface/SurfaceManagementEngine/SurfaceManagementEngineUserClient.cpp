@@ -0,0 +1,141 @@
+//
+//  SurfaceManagementEngineUserClient.cpp
+//  SurfaceTouchScreen
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include "SurfaceManagementEngineUserClient.hpp"
+
+#define super IOUserClient
+OSDefineMetaClassAndStructors(SurfaceManagementEngineUserClient, IOUserClient)
+
+const IOExternalMethodDispatch SurfaceManagementEngineUserClient::methods[kMEIUserClientMethodCount] = {
+    {   // kMEIUserClientGetLatency
+        reinterpret_cast<IOExternalMethodAction>(&SurfaceManagementEngineUserClient::getLatency), 0, 0, 0, sizeof(MEILatencyReport)
+    },
+    {   // kMEIUserClientResetLatency
+        reinterpret_cast<IOExternalMethodAction>(&SurfaceManagementEngineUserClient::resetLatency), 0, 0, 0, 0
+    },
+    {   // kMEIUserClientSetTracing
+        reinterpret_cast<IOExternalMethodAction>(&SurfaceManagementEngineUserClient::setTracing), 1, 0, 0, 0
+    },
+    {   // kMEIUserClientMarkPickup
+        reinterpret_cast<IOExternalMethodAction>(&SurfaceManagementEngineUserClient::markPickup), 0, 0, 0, 0
+    },
+    {   // kMEIUserClientSetDecoding
+        reinterpret_cast<IOExternalMethodAction>(&SurfaceManagementEngineUserClient::setDecoding), 1, 0, 0, 0
+    },
+    {   // kMEIUserClientSetBufferMode
+        reinterpret_cast<IOExternalMethodAction>(&SurfaceManagementEngineUserClient::setBufferMode), 2, 0, 0, 0
+    },
+};
+
+bool SurfaceManagementEngineUserClient::initWithTask(task_t owningTask, void *securityID, UInt32 type, OSDictionary *properties) {
+    if (!super::initWithTask(owningTask, securityID, type, properties))
+        return false;
+    // anybody may read the statistics, only admin may change what the delivery path does
+    privileged = clientHasPrivilege(owningTask, kIOClientPrivilegeAdministrator) == kIOReturnSuccess;
+    return true;
+}
+
+bool SurfaceManagementEngineUserClient::start(IOService *provider) {
+    owner = OSDynamicCast(SurfaceManagementEngineClient, provider);
+    if (!owner)
+        return false;
+    return super::start(provider);
+}
+
+IOReturn SurfaceManagementEngineUserClient::clientClose() {
+    // nobody would hand the buffers back to the device any more
+    if (buffer_mode) {
+        owner->stopBufferMode();
+        buffer_mode = false;
+    }
+    if (!isInactive())
+        terminate();
+    return kIOReturnSuccess;
+}
+
+IOReturn SurfaceManagementEngineUserClient::clientMemoryForType(UInt32 type, IOOptionBits *options, IOMemoryDescriptor **memory) {
+    // the ring carries every touch, only the privileged daemon gets to see it
+    if (!privileged)
+        return kIOReturnNotPrivileged;
+    
+    // the daemon has to turn on decoding before mapping the ring
+    switch (type) {
+        case kMEIUserClientFrameRing:
+            *memory = owner->copyFrameRing();
+            *options = kIOMapReadOnly;
+            break;
+        case kMEIUserClientFrameRingTail:
+            *memory = owner->copyFrameRingTail();
+            *options = 0;
+            break;
+        default:
+            return kIOReturnBadArgument;
+    }
+    if (!*memory)
+        return kIOReturnNotReady;
+    return kIOReturnSuccess;
+}
+
+IOReturn SurfaceManagementEngineUserClient::externalMethod(uint32_t selector, IOExternalMethodArguments *arguments, IOExternalMethodDispatch *dispatch, OSObject *target, void *reference) {
+    if (selector >= kMEIUserClientMethodCount)
+        return kIOReturnUnsupported;
+    
+    dispatch = const_cast<IOExternalMethodDispatch *>(&methods[selector]);
+    target = this;
+    return super::externalMethod(selector, arguments, dispatch, target, reference);
+}
+
+IOReturn SurfaceManagementEngineUserClient::getLatency(SurfaceManagementEngineUserClient *target, void *reference, IOExternalMethodArguments *arguments) {
+    target->owner->copyLatencyReport(static_cast<MEILatencyReport *>(arguments->structureOutput));
+    return kIOReturnSuccess;
+}
+
+IOReturn SurfaceManagementEngineUserClient::resetLatency(SurfaceManagementEngineUserClient *target, void *reference, IOExternalMethodArguments *arguments) {
+    if (!target->privileged)
+        return kIOReturnNotPrivileged;
+    target->owner->resetLatency();
+    return kIOReturnSuccess;
+}
+
+IOReturn SurfaceManagementEngineUserClient::setTracing(SurfaceManagementEngineUserClient *target, void *reference, IOExternalMethodArguments *arguments) {
+    if (!target->privileged)
+        return kIOReturnNotPrivileged;
+    target->owner->setTracing(arguments->scalarInput[0] != 0);
+    return kIOReturnSuccess;
+}
+
+IOReturn SurfaceManagementEngineUserClient::markPickup(SurfaceManagementEngineUserClient *target, void *reference, IOExternalMethodArguments *arguments) {
+    if (!target->privileged)
+        return kIOReturnNotPrivileged;
+    target->owner->markPickup();
+    return kIOReturnSuccess;
+}
+
+IOReturn SurfaceManagementEngineUserClient::setDecoding(SurfaceManagementEngineUserClient *target, void *reference, IOExternalMethodArguments *arguments) {
+    if (!target->privileged)
+        return kIOReturnNotPrivileged;
+    return target->owner->setDecoding(static_cast<UInt32>(arguments->scalarInput[0]));
+}
+
+IOReturn SurfaceManagementEngineUserClient::setBufferMode(SurfaceManagementEngineUserClient *target, void *reference, IOExternalMethodArguments *arguments) {
+    if (!target->privileged)
+        return kIOReturnNotPrivileged;
+    
+    if (arguments->scalarInput[0] > IPTS_BUFFER_MAX_SIZE || arguments->scalarInput[1] > IPTS_BUFFER_MAX_SIZE)
+        return kIOReturnBadArgument;
+    UInt32 data_size = static_cast<UInt32>(arguments->scalarInput[0]);
+    UInt32 feedback_size = static_cast<UInt32>(arguments->scalarInput[1]);
+    if (!data_size && !feedback_size) {
+        target->owner->stopBufferMode();
+        target->buffer_mode = false;
+        return kIOReturnSuccess;
+    }
+    IOReturn ret = target->owner->startBufferMode(data_size, feedback_size);
+    if (ret == kIOReturnSuccess)
+        target->buffer_mode = true;
+    return ret;
+}
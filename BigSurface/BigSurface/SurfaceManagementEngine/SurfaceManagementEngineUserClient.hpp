@@ -0,0 +1,59 @@
+//
+//  SurfaceManagementEngineUserClient.hpp
+//  SurfaceTouchScreen
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef SurfaceManagementEngineUserClient_hpp
+#define SurfaceManagementEngineUserClient_hpp
+
+#include <IOKit/IOUserClient.h>
+
+#include "SurfaceManagementEngineClient.hpp"
+
+enum MEIUserClientMethod {
+    kMEIUserClientGetLatency = 0,   // out: MEILatencyReport
+    kMEIUserClientResetLatency,
+    kMEIUserClientSetTracing,       // in: enable
+    kMEIUserClientMarkPickup,       // called by the daemon for every message it consumed
+    kMEIUserClientSetDecoding,      // in: IPTSDecoderOptions
+    kMEIUserClientSetBufferMode,    // in: data size, feedback size from the device info, 0 to stop
+    kMEIUserClientMethodCount,
+};
+
+enum MEIUserClientMemoryType {
+    kMEIUserClientFrameRing = 0,    // IPTSFrameRingHeader followed by compact records, read only
+    kMEIUserClientFrameRingTail,    // IPTSFrameRingTail
+};
+
+class EXPORT SurfaceManagementEngineUserClient : public IOUserClient {
+    OSDeclareDefaultStructors(SurfaceManagementEngineUserClient);
+    
+public:
+    bool initWithTask(task_t owningTask, void *securityID, UInt32 type, OSDictionary *properties) override;
+    
+    bool start(IOService *provider) override;
+    
+    IOReturn clientClose() override;
+    
+    IOReturn clientMemoryForType(UInt32 type, IOOptionBits *options, IOMemoryDescriptor **memory) override;
+    
+    IOReturn externalMethod(uint32_t selector, IOExternalMethodArguments *arguments, IOExternalMethodDispatch *dispatch, OSObject *target, void *reference) override;
+    
+private:
+    SurfaceManagementEngineClient*  owner {nullptr};
+    bool                            privileged {false};
+    bool                            buffer_mode {false};    // started by this client, stopped when it goes away
+    
+    static const IOExternalMethodDispatch methods[kMEIUserClientMethodCount];
+    
+    static IOReturn getLatency(SurfaceManagementEngineUserClient *target, void *reference, IOExternalMethodArguments *arguments);
+    static IOReturn resetLatency(SurfaceManagementEngineUserClient *target, void *reference, IOExternalMethodArguments *arguments);
+    static IOReturn setTracing(SurfaceManagementEngineUserClient *target, void *reference, IOExternalMethodArguments *arguments);
+    static IOReturn markPickup(SurfaceManagementEngineUserClient *target, void *reference, IOExternalMethodArguments *arguments);
+    static IOReturn setDecoding(SurfaceManagementEngineUserClient *target, void *reference, IOExternalMethodArguments *arguments);
+    static IOReturn setBufferMode(SurfaceManagementEngineUserClient *target, void *reference, IOExternalMethodArguments *arguments);
+};
+
+#endif /* SurfaceManagementEngineUserClient_hpp */
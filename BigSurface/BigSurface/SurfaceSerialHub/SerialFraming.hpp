@@ -0,0 +1,54 @@
+//
+//  SerialFraming.hpp
+//  SurfaceSerialHub
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef SerialFraming_hpp
+#define SerialFraming_hpp
+
+#include "SerialProtocol.h"
+
+/*
+ * SSH frame encoding and validation, free of IOKit. The hub driver only
+ * moves the bytes and acts on the result.
+ */
+#define CRC_INITIAL                 0xFFFF
+#define SSH_CONTROL_FRAME_LENGTH    (SSH_PAYLOAD_OFFSET+2)
+#define SSH_FRAME_OVERHEAD          (SSH_PAYLOAD_OFFSET+2)  // frame around a payload
+#define SSH_COMMAND_LENGTH(len)     (SSH_FRAME_OVERHEAD+sizeof(SurfaceSerialCommand)+(len))
+
+enum SerialFrameStatus {
+    SerialFrameOK = 0,
+    SerialFrameIncomplete,
+    SerialFrameBadSyn,
+    SerialFrameBadCRC,
+    SerialFrameBadLength,
+    SerialFrameBadACK,
+    SerialFrameBadPayloadCRC,
+    SerialFrameUnknownType,
+};
+
+struct SerialFrameInfo {
+    UInt8                   type;
+    UInt8                   seq_id;
+    SurfaceSerialCommand*   command;    // data frames only
+    UInt8*                  data;
+    UInt16                  data_len;
+};
+
+UInt16 crc_ccitt_false(UInt16 crc, const UInt8 *buffer, size_t len);
+
+// ACK or NAK, buffer holds SSH_CONTROL_FRAME_LENGTH bytes
+UInt16 sshBuildControlFrame(UInt8 *buffer, UInt8 type, UInt8 seq_id);
+
+// buffer holds SSH_COMMAND_LENGTH(payload_len) bytes, returns the frame length
+UInt16 sshBuildCommand(UInt8 *buffer, bool seq, UInt8 seq_id, UInt16 request_id, UInt8 tc, UInt8 tid, UInt8 iid, UInt8 cid, const UInt8 *payload, UInt16 payload_len);
+
+// check a complete frame, info points into buffer
+SerialFrameStatus sshParseFrame(UInt8 *buffer, UInt16 len, SerialFrameInfo *info);
+
+const char *sshFrameStatusString(SerialFrameStatus status);
+
+#endif /* SerialFraming_hpp */
@@ -10,6 +10,8 @@
 #include "../../../Dependencies/VoodooSerial/VoodooSerial/ACPIParser/VoodooACPIResourcesParser.hpp"
 #include "../SurfaceSerialHubDevices/SurfaceBatteryNub.hpp"
 #include "../SurfaceSerialHubDevices/SurfaceHIDNub.hpp"
+#include "../BigSurfaceDiagnostics/Tracepoints.hpp"
+#include "../BootTimeline.hpp"
 
 struct SurfaceSerialEventRegistryConfig {
     UInt8 target_category;
@@ -24,6 +26,61 @@ static const SurfaceSerialEventRegistryConfig event_conf[] = {
     {SSH_TC_KIP, SSH_TID_SECONDARY, SSH_CID_KIP_ENABLE_EVENT, SSH_CID_KIP_DISABLE_EVENT},
 };
 
+struct SurfaceSerialProbe {
+    UInt8   tc;
+    UInt8   tid;
+    UInt8   iid;
+    UInt8   cid;
+    UInt8   payload[SURFACE_HID_DESC_HEADER_SIZE];
+    UInt16  payload_len;
+};
+
+/*
+ * The HID nub asks for the legacy keyboard descriptor first and falls back to
+ * the HID one, only one of them exists on a given SAM. Both are probed at once.
+ */
+static const SurfaceSerialProbe probes[SSH_PROBE_CNT] = {
+    {SSH_TC_KBD, SSH_TID_SECONDARY, SurfaceLegacyKeyboardDevice, SSH_CID_KBD_GET_DESCRIPTOR, {SurfaceHIDDescriptorEntry}, 1},
+    // SurfaceHIDDescriptorBufferHeader asking for the first 0x76 bytes
+    {SSH_TC_HID, SSH_TID_SECONDARY, SurfaceKeyboardDevice, SSH_CID_HID_GET_DESCRIPTOR, {SurfaceHIDDescriptorEntry, 0, 0, 0, 0, 0x76, 0, 0, 0, 0}, SURFACE_HID_DESC_HEADER_SIZE},
+};
+
+/*
+ * The descriptor query that timed out while its alternative answered fails at
+ * once instead of costing SSH_WAIT_TIMEOUT on every fallback. Only the exact
+ * probed command is cached. An entry expires after SSH_UNSUPPORTED_EXPIRY,
+ * the next call is then sent again and either clears or renews it. The cache
+ * outlives restarts of the hub and is dropped when the SAM version changes.
+ * Races between callers only cost an extra round trip.
+ */
+static struct {
+    UInt32  sam_version;
+    UInt64  unsupported_until[SSH_PROBE_CNT];   // deadline, 0 when not cached
+} capabilities;
+
+static int probeIndex(UInt8 tc, UInt8 tid, UInt8 iid, UInt8 cid) {
+    for (int i = 0; i < SSH_PROBE_CNT; i++) {
+        if (probes[i].tc == tc && probes[i].tid == tid && probes[i].iid == iid && probes[i].cid == cid)
+            return i;
+    }
+    return -1;
+}
+
+static void markUnsupported(int probe) {
+    AbsoluteTime abstime, deadline;
+    nanoseconds_to_absolutetime(SSH_UNSUPPORTED_EXPIRY * 1000000ULL, &abstime);
+    clock_absolutetime_interval_to_deadline(abstime, &deadline);
+    capabilities.unsupported_until[probe] = deadline;
+}
+
+static bool commandUnsupported(int probe) {
+    if (probe < 0 || !capabilities.unsupported_until[probe])
+        return false;
+    UInt64 now;
+    clock_get_uptime(&now);
+    return now < capabilities.unsupported_until[probe];
+}
+
 OSDefineMetaClassAndAbstractStructors(SurfaceSerialHubClient, IOService);
 
 #define super IOService
@@ -57,6 +114,10 @@ bool judge_sync(UInt8 *buffer, UInt16 len) {
     return false;
 }
 
+static const char *counter_names[SSHCounterCount] = {
+    "Frames", "CRCErrors", "FramingErrors", "Retransmits", "Overruns", "NAKsReceived", "NAKsSent", "Timeouts", "Events",
+};
+
 int find_sync_bytes(UInt8 *buffer, UInt16 len) {
     for (int i=0; i<len-1; i++) {
         if (buffer[i] == SSH_SYN_BYTE_1 && judge_sync(buffer+i+1, len-i-1))
@@ -70,9 +131,11 @@ void SurfaceSerialHubDriver::bufferReceived(VoodooUARTController *sender, UInt8
         return;
     if (SSH_RING_BUFFER_NEXT(last) == current && ring_buffer[current].filled_len) {
         LOG("Overrun!");
+        PERF_COUNT(counters, SSHCounterOverruns);
         return;
     }
     
+    TRACEPOINT(TraceSSH, TraceSSHRxBuffer, length, 0);
     last = SSH_RING_BUFFER_NEXT(last);
     memcpy(ring_buffer[last].buffer, buffer, length);
     ring_buffer[last].filled_len = length;
@@ -137,62 +200,59 @@ void SurfaceSerialHubDriver::_process(UInt8 *buffer, UInt16 length) {
     }
 }
 
-#define ERR_DUMP_MSG(str) err_dump(getName(), str, rx_msg.cache, rx_msg.pos)
+#define ERR_DUMP_MSG(str) do {                                      \
+    TRACEPOINT(TraceSSH, TraceSSHFrameError, rx_msg.pos, 0);        \
+    err_dump(getName(), str, rx_msg.cache, rx_msg.pos);             \
+} while (0)
 
 IOReturn SurfaceSerialHubDriver::processMessage() {
-    if (rx_msg.pos < 10) {
-        sendNAK();
-        ERR_DUMP_MSG("Message received incomplete! Protential data loss!");
-        return kIOReturnError;
-    }
-    SurfaceSerialMessage *message = reinterpret_cast<SurfaceSerialMessage *>(rx_msg.cache);
+    SerialFrameInfo frame;
     SurfaceSerialCommand *command;
     UInt8 *rx_data;
-    UInt16 calc_crc, crc, rx_data_len;
+    UInt16 rx_data_len;
     WaitingRequest *req;
     PendingCommand *cmd;
     bool found = false;
-    if (message->syn != SSH_SYN_BYTES) {
-        sendNAK();
-        ERR_DUMP_MSG("syn btyes error!");
-        return kIOReturnError;
-    }
-    if (message->frame_crc != crc_ccitt_false(CRC_INITIAL, rx_msg.cache+2, sizeof(SurfaceSerialFrame))) {
-        sendNAK();
-        ERR_DUMP_MSG("frame crc error!");
-        return kIOReturnError;
-    }
-    if (rx_msg.pos != message->frame.length+10) {
-        sendNAK();
-        ERR_DUMP_MSG("data length error!");
-        return kIOReturnError;
+    SerialFrameStatus status = sshParseFrame(rx_msg.cache, rx_msg.pos, &frame);
+    switch (status) {
+        case SerialFrameOK:
+            break;
+        case SerialFrameBadCRC:
+        case SerialFrameBadPayloadCRC:
+            PERF_COUNT(counters, SSHCounterCRCErrors);
+            goto nak;
+        case SerialFrameIncomplete:
+        case SerialFrameBadSyn:
+        case SerialFrameBadLength:
+            PERF_COUNT(counters, SSHCounterFramingErrors);
+            goto nak;
+        default:
+            goto nak;
     }
-    switch (message->frame.type) {
+    TRACEPOINT(TraceSSH, TraceSSHFrame, frame.type, frame.seq_id);
+    PERF_COUNT(counters, SSHCounterFrames);
+    switch (frame.type) {
         case SSH_FRAME_TYPE_ACK:
-            if (rx_msg.cache[SSH_PAYLOAD_OFFSET]!=0xFF || rx_msg.cache[SSH_PAYLOAD_OFFSET+1]!=0xFF) {
-                sendNAK();
-                ERR_DUMP_MSG("payload crc for ACK should be 0xFFFF!");
-                return kIOReturnError;
-            }
             qe_foreach_element_safe(cmd, &pending_list, entry) {
                 SurfaceSerialMessage *pending_msg = reinterpret_cast<SurfaceSerialMessage *>(cmd->buffer);
-                if (pending_msg->frame.seq_id == message->frame.seq_id) {
+                if (pending_msg->frame.seq_id == frame.seq_id) {
                     found = true;
                     remqueue(&cmd->entry);
                     cmd->timer->cancelTimeout();
                     cmd->timer->disable();
                     work_loop->removeEventSource(cmd->timer);
                     OSSafeReleaseNULL(cmd->timer);
-                    delete[] cmd->buffer;
+                    tagFree(cmd->buffer);
                     delete cmd;
                     break;
                 }
             }
             if (!found)
-                DBG_LOG("Warning, no pending command found for seq_id %d", message->frame.seq_id);
+                DBG_LOG("Warning, no pending command found for seq_id %d", frame.seq_id);
             break;
         case SSH_FRAME_TYPE_NAK:
             LOG("Warning, NAK received! Resending all pending messages!");
+            PERF_COUNT(counters, SSHCounterNAKsReceived);
             qe_foreach_element(cmd, &pending_list, entry) {
                 if (cmd->trial_count) {     // not a NSQ command
                     cmd->trial_count = 1;
@@ -202,35 +262,34 @@ IOReturn SurfaceSerialHubDriver::processMessage() {
             }
             break;
         case SSH_FRAME_TYPE_DATA_SEQ:
-            sendACK(message->frame.seq_id);
+            sendACK(frame.seq_id);
         case SSH_FRAME_TYPE_DATA_NSQ:
-            command = reinterpret_cast<SurfaceSerialCommand *>(rx_msg.cache+SSH_PAYLOAD_OFFSET);
-            rx_data = command->data;
-            rx_data_len = message->frame.length - sizeof(SurfaceSerialCommand);
-            calc_crc = crc_ccitt_false(CRC_INITIAL, rx_msg.cache+SSH_PAYLOAD_OFFSET, message->frame.length);
-            crc = *(reinterpret_cast<UInt16 *>(rx_data+rx_data_len));
-            if (crc != calc_crc) {
-                sendNAK();
-                ERR_DUMP_MSG("payload crc error!");
-                return kIOReturnError;
-            }
+            command = frame.command;
+            rx_data = frame.data;
+            rx_data_len = frame.data_len;
             if (command->request_id >= SSH_REQID_MIN) { // a message
                 qe_foreach_element_safe(req, &waiting_list, entry) {
                     if (req->req_id == command->request_id) {
                         found = true;
+                        TRACEPOINT(TraceSSH, TraceSSHResponse, req->req_id, rx_data_len);
                         if (rx_data_len) {
-                            req->data = new UInt8[rx_data_len];
-                            req->data_len = rx_data_len;
-                            memcpy(req->data, rx_data, rx_data_len);
+                            req->data = tagNewArray<UInt8>(AllocTagSSH, rx_data_len);
+                            if (req->data) {
+                                req->data_len = rx_data_len;
+                                memcpy(req->data, rx_data, rx_data_len);
+                            }
                         }
-                        command_gate->commandWakeup(&req->waiting);
                         remqueue(&req->entry);
+                        req->completed = true;
+                        command_gate->commandWakeup(&req->waiting);
                         break;
                     }
                 }
                 if (!found)
                     DBG_LOG("Warning, received data with unknown tc %x, cid %x", command->target_category, command->command_id);
             } else {    // an event
+                TRACEPOINT(TraceSSH, TraceSSHEvent, command->target_category << 8 | command->command_id, command->instance_id);
+                PERF_COUNT(counters, SSHCounterEvents);
                 if (!queue_empty(&event_handler_lists[command->request_id]) || !queue_empty(&event_handler_lists[0])) {
                     EventHandler *h;
                     bool handled = false;
@@ -252,83 +311,54 @@ IOReturn SurfaceSerialHubDriver::processMessage() {
                     ERR_DUMP_MSG("Event unregistered!");
             }
             break;
-        default:
-            sendNAK();
-            ERR_DUMP_MSG("Unknown message type!");
-            return kIOReturnError;
     }
     
     rx_msg.pos = 0;
     rx_msg.len = SSH_MSG_LENGTH_UNKNOWN;
     
     return kIOReturnSuccess;
+nak:
+    sendNAK();
+    ERR_DUMP_MSG(sshFrameStatusString(status));
+    return kIOReturnError;
 }
 
 IOReturn SurfaceSerialHubDriver::sendACK(UInt8 seq_id) {
-    UInt8 buffer[SSH_PAYLOAD_OFFSET+2];
-    SurfaceSerialMessage *msg = reinterpret_cast<SurfaceSerialMessage *>(buffer);
-    msg->syn = SSH_SYN_BYTES;
-    msg->frame.type = SSH_FRAME_TYPE_ACK;
-    msg->frame.length = 0;
-    msg->frame.seq_id = seq_id;
-    msg->frame_crc = crc_ccitt_false(CRC_INITIAL, buffer+2, sizeof(SurfaceSerialFrame));
-    buffer[SSH_PAYLOAD_OFFSET] = 0xFF;
-    buffer[SSH_PAYLOAD_OFFSET+1] = 0xFF;
-    return uart_controller->transmitData(buffer, SSH_PAYLOAD_OFFSET+2);
+    UInt8 buffer[SSH_CONTROL_FRAME_LENGTH];
+    return uart_controller->transmitData(buffer, sshBuildControlFrame(buffer, SSH_FRAME_TYPE_ACK, seq_id));
 }
 
 IOReturn SurfaceSerialHubDriver::sendNAK() {
-    UInt8 buffer[SSH_PAYLOAD_OFFSET+2];
-    SurfaceSerialMessage *msg = reinterpret_cast<SurfaceSerialMessage *>(buffer);
-    msg->syn = SSH_SYN_BYTES;
-    msg->frame.type = SSH_FRAME_TYPE_NAK;
-    msg->frame.length = 0;
-    msg->frame.seq_id = 0;
-    msg->frame_crc = crc_ccitt_false(CRC_INITIAL, buffer+2, sizeof(SurfaceSerialFrame));
-    buffer[SSH_PAYLOAD_OFFSET] = 0xFF;
-    buffer[SSH_PAYLOAD_OFFSET+1] = 0xFF;
-    return uart_controller->transmitData(buffer, SSH_PAYLOAD_OFFSET+2);
+    PERF_COUNT(counters, SSHCounterNAKsSent);
+    UInt8 buffer[SSH_CONTROL_FRAME_LENGTH];
+    return uart_controller->transmitData(buffer, sshBuildControlFrame(buffer, SSH_FRAME_TYPE_NAK, 0));
 }
 
 UInt16 SurfaceSerialHubDriver::sendCommand(UInt8 tc, UInt8 tid, UInt8 iid, UInt8 cid, UInt8 *payload, UInt16 payload_len, bool seq) {
     if (!awake)
         return 0;
     
-    UInt16 len = sizeof(SurfaceSerialMessage)+sizeof(SurfaceSerialCommand)+payload_len+2;
-    UInt8 *buffer = new UInt8[len];
-    
-    SurfaceSerialMessage *msg = reinterpret_cast<SurfaceSerialMessage *>(buffer);
-    msg->syn = SSH_SYN_BYTES;
-    msg->frame.type = seq ? SSH_FRAME_TYPE_DATA_SEQ : SSH_FRAME_TYPE_DATA_NSQ;
-    msg->frame.length = payload_len + 8;
-    msg->frame.seq_id = seq_counter.getID();
-    msg->frame_crc = crc_ccitt_false(CRC_INITIAL, buffer+2, sizeof(SurfaceSerialFrame));
-    
-    SurfaceSerialCommand *cmd = reinterpret_cast<SurfaceSerialCommand *>(msg->payload);
-    cmd->type = SSH_PAYLOAD_TYPE_COMMAND;
-    cmd->target_category = tc;
-    cmd->target_id_out = tid;
-    cmd->target_id_in = 0x00;
-    cmd->instance_id = iid;
-    cmd->request_id = req_counter.getID();
-    cmd->command_id = cid;
-    
-    if (payload_len > 0)
-        memcpy(cmd->data, payload, payload_len);
-    
-    *(reinterpret_cast<UInt16 *>(cmd->data+payload_len)) = crc_ccitt_false(CRC_INITIAL, msg->payload, sizeof(SurfaceSerialCommand)+payload_len);
+    UInt16 len = SSH_COMMAND_LENGTH(payload_len);
+    UInt8 *buffer = tagNewArray<UInt8>(AllocTagSSH, len);
+    if (!buffer)
+        return 0;
+    UInt16 request_id = req_counter.getID();
+    sshBuildCommand(buffer, seq, seq_counter.getID(), request_id, tc, tid, iid, cid, payload, payload_len);
+    TRACEPOINT(TraceSSH, TraceSSHCommand, tc << 24 | tid << 16 | cid << 8 | iid, request_id);
     
     if (command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &SurfaceSerialHubDriver::sendCommandGated), buffer, &len, &seq) != kIOReturnSuccess) {
         LOG("Sending command failed!");
-        delete[] buffer;
+        tagFree(buffer);
         return 0;
     }
     
-    return cmd->request_id;
+    return request_id;
 }
 
 IOReturn SurfaceSerialHubDriver::sendCommandGated(UInt8 *tx_buffer, UInt16 *len, bool *seq) {
     PendingCommand *cmd = new PendingCommand;
+    if (!cmd)
+        return kIOReturnNoMemory;
     cmd->buffer = tx_buffer;
     cmd->len = *len;
     cmd->trial_count = *seq ? 1 : 0;   // if no ACK is needed, count is set to 0
@@ -359,19 +389,22 @@ void SurfaceSerialHubDriver::commandTimeout(IOTimerEventSource* timer) {
             } else if (cmd->trial_count > SSH_CMD_TRAIL_CNT) {
                 LOG("Receive no ACK for command tc %x, tid %x, cid %x, iid %x!", cmd_data->target_category, cmd_data->target_id_out, cmd_data->command_id, cmd_data->instance_id);
             } else {
-                if (cmd->trial_count > 1)
+                if (cmd->trial_count > 1) {
                     DBG_LOG("Timeout, trial count: %d", cmd->trial_count);
+                    TRACEPOINT(TraceSSH, TraceSSHRetransmit, reinterpret_cast<SurfaceSerialMessage *>(cmd->buffer)->frame.seq_id, cmd->trial_count);
+                    PERF_COUNT(counters, SSHCounterRetransmits);
+                }
                 if (uart_controller->transmitData(cmd->buffer, cmd->len) != kIOReturnSuccess)
                     LOG("Sending SEQ command failed for tc %x, tid %x, cid %x, iid %x!", cmd_data->target_category, cmd_data->target_id_out, cmd_data->command_id, cmd_data->instance_id);
                 cmd->trial_count++;
-                cmd->timer->setTimeoutMS(SSH_ACK_TIMEOUT);
+                TimerCoalescer::setTimeoutMS(cmd->timer, SSH_ACK_TIMEOUT, SSH_ACK_TOLERANCE);
                 break;
             }
             remqueue(&cmd->entry);
             cmd->timer->disable();
             work_loop->removeEventSource(cmd->timer);
             OSSafeReleaseNULL(cmd->timer);
-            delete[] cmd->buffer;
+            tagFree(cmd->buffer);
             delete cmd;
             break;
         }
@@ -381,11 +414,23 @@ void SurfaceSerialHubDriver::commandTimeout(IOTimerEventSource* timer) {
 }
 
 IOReturn SurfaceSerialHubDriver::getResponse(UInt8 tc, UInt8 tid, UInt8 iid, UInt8 cid, UInt8 *payload, UInt16 payload_len, bool seq, UInt8 *buffer, UInt16 buffer_len) {
+    int probe = probeIndex(tc, tid, iid, cid);
+    if (commandUnsupported(probe))
+        return kIOReturnUnsupported;
+    
     UInt16 req_id = sendCommand(tc, tid, iid, cid, payload, payload_len, seq);
     
-    if (req_id != 0)
-        return command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &SurfaceSerialHubDriver::waitResponse), &req_id, buffer, &buffer_len);
-    return kIOReturnError;
+    if (req_id == 0)
+        return kIOReturnError;
+    IOReturn ret = command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &SurfaceSerialHubDriver::waitResponse), &req_id, buffer, &buffer_len);
+    // an expired entry, this call was the retry
+    if (probe >= 0 && capabilities.unsupported_until[probe]) {
+        if (ret == kIOReturnSuccess)
+            capabilities.unsupported_until[probe] = 0;
+        else if (ret == kIOReturnTimeout)
+            markUnsupported(probe);
+    }
+    return ret;
 }
 
 IOReturn SurfaceSerialHubDriver::waitResponse(UInt16 *req_id, UInt8 *buffer, UInt16 *buffer_len) {
@@ -393,7 +438,10 @@ IOReturn SurfaceSerialHubDriver::waitResponse(UInt16 *req_id, UInt8 *buffer, UIn
     IOReturn sleep;
     
     WaitingRequest *w = new WaitingRequest;
+    if (!w)
+        return kIOReturnNoMemory;
     w->waiting = false;
+    w->completed = false;
     w->req_id = *req_id;
     w->data = nullptr;
     w->data_len = 0;
@@ -403,11 +451,16 @@ IOReturn SurfaceSerialHubDriver::waitResponse(UInt16 *req_id, UInt8 *buffer, UIn
     clock_absolutetime_interval_to_deadline(abstime, &deadline);
     sleep = command_gate->commandSleep(&w->waiting, deadline, THREAD_INTERRUPTIBLE);
     
-    if (sleep == THREAD_TIMED_OUT) {
-        LOG("Timeout waiting for response");
+    // a response that raced the timeout already took the request off the list
+    if (!w->completed) {
+        if (sleep == THREAD_TIMED_OUT) {
+            LOG("Timeout waiting for response");
+            TRACEPOINT(TraceSSH, TraceSSHTimeout, *req_id, 0);
+            PERF_COUNT(counters, SSHCounterTimeouts);
+        }
         remqueue(&w->entry);
         delete w;
-        return kIOReturnTimeout;
+        return sleep == THREAD_TIMED_OUT ? kIOReturnTimeout : kIOReturnAborted;
     }
     if (*buffer_len != w->data_len)
         DBG_LOG("Warning, given buffer_len(%d) and received data_len(%d) mismatched!", *buffer_len, w->data_len);
@@ -415,12 +468,97 @@ IOReturn SurfaceSerialHubDriver::waitResponse(UInt16 *req_id, UInt8 *buffer, UIn
         if (*buffer_len < w->data_len)
             w->data_len = *buffer_len;
         memcpy(buffer, w->data, w->data_len);
-        delete[] w->data;
     }
+    tagFree(w->data);
     delete w;
     return kIOReturnSuccess;
 }
 
+IOReturn SurfaceSerialHubDriver::probeCapabilitiesGated() {
+    WaitingRequest *requests[SSH_PROBE_CNT] = {};
+    bool timed_out[SSH_PROBE_CNT] = {};
+    int answered = 0;
+    AbsoluteTime abstime, deadline;
+    IOReturn sleep = THREAD_AWAKENED;
+    
+    // all probes are in flight together, so the missing one costs a single timeout
+    for (int i = 0; i < SSH_PROBE_CNT; i++) {
+        const SurfaceSerialProbe *probe = &probes[i];
+        UInt16 len = SSH_COMMAND_LENGTH(probe->payload_len);
+        bool seq = true;
+        UInt8 *buffer = tagNewArray<UInt8>(AllocTagSSH, len);
+        WaitingRequest *w = new WaitingRequest;
+        if (!buffer || !w) {
+            tagFree(buffer);
+            delete w;
+            continue;
+        }
+        w->waiting = false;
+        w->completed = false;
+        w->req_id = req_counter.getID();
+        w->data = nullptr;
+        w->data_len = 0;
+        sshBuildCommand(buffer, seq, seq_counter.getID(), w->req_id, probe->tc, probe->tid, probe->iid, probe->cid, probe->payload, probe->payload_len);
+        // waiting before sending, the answer may arrive before we sleep
+        enqueue(&waiting_list, &w->entry);
+        if (sendCommandGated(buffer, &len, &seq) != kIOReturnSuccess) {
+            remqueue(&w->entry);
+            tagFree(buffer);
+            delete w;
+            continue;
+        }
+        requests[i] = w;
+    }
+    
+    nanoseconds_to_absolutetime(SSH_WAIT_TIMEOUT * 1000000, &abstime);
+    clock_absolutetime_interval_to_deadline(abstime, &deadline);
+    for (int i = 0; i < SSH_PROBE_CNT; i++) {
+        WaitingRequest *w = requests[i];
+        if (!w)
+            continue;
+        if (!w->completed && sleep != THREAD_INTERRUPTED)
+            sleep = command_gate->commandSleep(&w->waiting, deadline, THREAD_INTERRUPTIBLE);
+        if (w->completed)
+            answered++;
+        else {
+            remqueue(&w->entry);
+            // an interrupted probe says nothing about the firmware
+            timed_out[i] = sleep == THREAD_TIMED_OUT;
+        }
+        tagFree(w->data);
+        delete w;
+    }
+    
+    // a timeout only means unsupported when the alternative answered, otherwise SAM is busy or gone
+    if (sleep == THREAD_INTERRUPTED || !answered)
+        return kIOReturnAborted;
+    for (int i = 0; i < SSH_PROBE_CNT; i++) {
+        if (timed_out[i]) {
+            LOG("SAM does not answer tc %x, iid %x, cid %x", probes[i].tc, probes[i].iid, probes[i].cid);
+            markUnsupported(i);
+        }
+    }
+    return kIOReturnSuccess;
+}
+
+void SurfaceSerialHubDriver::publishCapabilities() {
+    OSArray *unsupported = OSArray::withCapacity(SSH_PROBE_CNT);
+    if (!unsupported)
+        return;
+    for (int i = 0; i < SSH_PROBE_CNT; i++) {
+        if (!capabilities.unsupported_until[i])
+            continue;
+        OSNumber *cmd = OSNumber::withNumber(probes[i].tc << 16 | probes[i].iid << 8 | probes[i].cid, 32);
+        if (cmd) {
+            unsupported->setObject(cmd);
+            cmd->release();
+        }
+    }
+    setProperty("SAMVersion", capabilities.sam_version, 32);
+    setProperty("UnsupportedCommands", unsupported);
+    unsupported->release();
+}
+
 IOReturn SurfaceSerialHubDriver::registerEvent(SurfaceSerialHubClient *client, SurfaceSerialEventRegistryType type, UInt8 tc, UInt8 iid) {
     if (type >= SurfaceSerialEventTypeCount)
         return kIOReturnInvalid;
@@ -446,6 +584,8 @@ IOReturn SurfaceSerialHubDriver::registerEvent(SurfaceSerialHubClient *client, S
         }
         
         h = new EventHandler;
+        if (!h)
+            return kIOReturnNoMemory;
         h->target_iid = iid;
         h->client = client;
         enqueue(&event_handler_lists[tc], &h->entry);
@@ -513,6 +653,7 @@ bool SurfaceSerialHubDriver::init(OSDictionary *properties) {
 }
 
 IOService* SurfaceSerialHubDriver::probe(IOService *provider, SInt32 *score) {
+    BootTimeline::begin(BootStageSSHProbe);
     if (!super::probe(provider, score))
         return nullptr;
     
@@ -525,6 +666,7 @@ IOService* SurfaceSerialHubDriver::probe(IOService *provider, SInt32 *score) {
         return nullptr;
     }
     
+    BootTimeline::begin(BootStageSSHControllerWait);
     gpio_controller = getGPIOController();
     if (!gpio_controller) {
         LOG("Could not find GPIO controller, exiting");
@@ -535,29 +677,41 @@ IOService* SurfaceSerialHubDriver::probe(IOService *provider, SInt32 *score) {
         LOG("Could not find UART controller, exiting");
         return nullptr;
     }
+    BootTimeline::end(BootStageSSHControllerWait);
     // Give the UART controller some time to load
+    BootTimeline::begin(BootStageSSHSettle);
     IOSleep(100);
+    BootTimeline::end(BootStageSSHSettle);
     
     // Allocate a ring buffer with size SSH_BUFFER_SIZE to store buffer from UART
-    for (int i=0; i < SSH_RING_BUFFER_SIZE; i++)
-        ring_buffer[i].buffer = new UInt8[fifo_size];
+    for (int i=0; i < SSH_RING_BUFFER_SIZE; i++) {
+        ring_buffer[i].buffer = tagNewArray<UInt8>(AllocTagSSH, fifo_size);
+        if (!ring_buffer[i].buffer) {
+            LOG("Could not allocate receive buffers");
+            return nullptr;
+        }
+    }
     
     LOG("Surface Serial Hub found!");
+    BootTimeline::end(BootStageSSHProbe);
     return this;
 }
 
 bool SurfaceSerialHubDriver::start(IOService *provider) {
     UInt32 version;
     UInt8 ret;
+    BootTimeline::begin(BootStageSSHStart);
     if (!super::start(provider))
         return false;
     
-    work_loop = IOWorkLoop::workLoop();
+    work_loop = WorkLoopBands::acquire(WorkLoopBandControl);
     if (!work_loop) {
         LOG("Could not get work loop");
         goto exit;
     }
     
+    counters = PerfCounterGroup::create(getName(), counter_names, SSHCounterCount);
+    
     command_gate = IOCommandGate::commandGate(this);
     if (!command_gate) {
         LOG("Could not open command gate");
@@ -573,6 +727,7 @@ bool SurfaceSerialHubDriver::start(IOService *provider) {
     work_loop->addEventSource(publish_timer);
     // publishing nubs after 20s
     publish_timer->setTimeoutMS(20000);
+    BootTimeline::begin(BootStageSSHNubDelay);
     
     uart_interrupt = IOInterruptEventSource::interruptEventSource(this, OSMemberFunctionCast(IOInterruptEventAction, this, &SurfaceSerialHubDriver::processReceivedBuffer));
     if (!uart_interrupt) {
@@ -605,11 +760,24 @@ bool SurfaceSerialHubDriver::start(IOService *provider) {
     if (getResponse(SSH_TC_SAM, SSH_TID_PRIMARY, 0, SSH_CID_SAM_DISPLAY_ON, nullptr, 0, true, &ret, 1) != kIOReturnSuccess || ret != 0)
         DBG_LOG("Unexpected response from display-on notification, ret=%x", ret);
     
+    if (capabilities.sam_version != version) {
+        bzero(&capabilities, sizeof(capabilities));
+        if (command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &SurfaceSerialHubDriver::probeCapabilitiesGated)) == kIOReturnSuccess)
+            capabilities.sam_version = version;
+    }
+    publishCapabilities();
+    
+    if (!PowerOrchestrator::registerDomain(PowerDomainSSH, this, OSMemberFunctionCast(PowerOrchestrator::Transition, this, &SurfaceSerialHubDriver::powerTransition))) {
+        LOG("Failed to register power domain");
+        goto exit_connected;
+    }
+    
     PMinit();
     uart_controller->joinPMtree(this);
     registerPowerDriver(this, myIOPMPowerStates, kIOPMNumberPowerStates);
     
     registerService();
+    BootTimeline::end(BootStageSSHStart);
     return true;
     
 exit_connected:
@@ -645,7 +813,7 @@ IOReturn SurfaceSerialHubDriver::flushCacheGated() {
             cmd->timer->disable();
             work_loop->removeEventSource(cmd->timer);
             OSSafeReleaseNULL(cmd->timer);
-            delete[] cmd->buffer;
+            tagFree(cmd->buffer);
             delete cmd;
         }
     }
@@ -666,7 +834,11 @@ IOReturn SurfaceSerialHubDriver::flushCacheGated() {
 IOReturn SurfaceSerialHubDriver::setPowerState(unsigned long whichState, IOService *whatDevice) {
     if (whatDevice != this)
         return kIOReturnInvalid;
-    if (whichState == 0) {
+    return PowerOrchestrator::scheduleTransition(PowerDomainSSH, whichState != 0);
+}
+
+void SurfaceSerialHubDriver::powerTransition(bool wake) {
+    if (!wake) {
         if (awake) {
             UInt8 ret;
             if (getResponse(SSH_TC_SAM, SSH_TID_PRIMARY, 0, SSH_CID_SAM_DISPLAY_OFF, nullptr, 0, true, &ret, 1) != kIOReturnSuccess || ret != 0)
@@ -690,10 +862,10 @@ IOReturn SurfaceSerialHubDriver::setPowerState(unsigned long whichState, IOServi
             DBG_LOG("Woke up");
         }
     }
-    return kIOPMAckImplied;
 }
 
 void SurfaceSerialHubDriver::releaseResources() {
+    PowerOrchestrator::unregisterDomain(PowerDomainSSH, this);
     if (battery_nub) {
         battery_nub->stop(this);
         battery_nub->detach(this);
@@ -714,8 +886,7 @@ void SurfaceSerialHubDriver::releaseResources() {
     WaitingRequest *req;
     qe_foreach_element_safe(req, &waiting_list, entry) {
         remqueue(&req->entry);
-        if (req->data_len)
-            delete[] req->data;
+        tagFree(req->data);
         delete req;
     }
     PendingCommand *cmd;
@@ -725,11 +896,11 @@ void SurfaceSerialHubDriver::releaseResources() {
         cmd->timer->disable();
         work_loop->removeEventSource(cmd->timer);
         OSSafeReleaseNULL(cmd->timer);
-        delete[] cmd->buffer;
+        tagFree(cmd->buffer);
         delete cmd;
     }
     for (int i=0; i < SSH_RING_BUFFER_SIZE; i++) {
-        delete[] ring_buffer[i].buffer;
+        tagFree(ring_buffer[i].buffer);
     }
     if (uart_interrupt) {
         uart_interrupt->disable();
@@ -751,7 +922,11 @@ void SurfaceSerialHubDriver::releaseResources() {
         work_loop->removeEventSource(command_gate);
         OSSafeReleaseNULL(command_gate);
     }
-    OSSafeReleaseNULL(work_loop);
+    WorkLoopBands::release(WorkLoopBandControl, work_loop);
+    if (counters) {
+        PerfCounterGroup::destroy(counters);
+        counters = nullptr;
+    }
 }
 
 VoodooGPIO* SurfaceSerialHubDriver::getGPIOController() {
@@ -841,6 +1016,7 @@ IOReturn SurfaceSerialHubDriver::getDeviceResources() {
 }
 
 void SurfaceSerialHubDriver::delayedPublishingNubs(IOTimerEventSource *sender) {
+    BootTimeline::end(BootStageSSHNubDelay);
     battery_nub = OSTypeAlloc(SurfaceBatteryNub);
     if (!battery_nub || !battery_nub->init() || !battery_nub->attach(this)) {
         LOG("Failed to init Surface Battery nub!");
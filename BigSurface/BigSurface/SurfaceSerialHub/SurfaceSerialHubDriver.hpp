@@ -13,7 +13,13 @@
 
 #include "../../../Dependencies/VoodooGPIO/VoodooGPIO/VoodooGPIO.hpp"
 #include "../../../Dependencies/VoodooSerial/VoodooSerial/VoodooUART/VoodooUARTController.hpp"
-#include "SerialProtocol.h"
+#include "../helpers.hpp"
+#include "SerialFraming.hpp"
+#include "../BigSurfaceDiagnostics/PerfCounters.hpp"
+#include "../PowerOrchestrator.hpp"
+#include "../WorkLoopBands.hpp"
+#include "../TimerCoalescer.hpp"
+#include "../TaggedAllocator.hpp"
 
 enum SurfaceSerialEventRegistryType {
     SurfaceSerialEventHostManagedV1 = 0,
@@ -22,14 +28,30 @@ enum SurfaceSerialEventRegistryType {
     SurfaceSerialEventTypeCount
 };
 
+enum SurfaceSerialCounter {
+    SSHCounterFrames = 0,
+    SSHCounterCRCErrors,
+    SSHCounterFramingErrors,
+    SSHCounterRetransmits,
+    SSHCounterOverruns,
+    SSHCounterNAKsReceived,
+    SSHCounterNAKsSent,
+    SSHCounterTimeouts,
+    SSHCounterEvents,
+    SSHCounterCount,
+};
+
 #define SSH_REQID_MIN           SSH_TC_COUNT+1
 #define SSH_MSG_CACHE_SIZE      256     // max length for a single message
 #define SSH_MSG_LENGTH_UNKNOWN  (SSH_MSG_CACHE_SIZE+1)
 #define SSH_RING_BUFFER_SIZE    10
 #define SSH_RING_BUFFER_NEXT(pos)   ((pos) + 1) % SSH_RING_BUFFER_SIZE
 #define SSH_ACK_TIMEOUT         50
+#define SSH_ACK_TOLERANCE       10
 #define SSH_CMD_TRAIL_CNT       3
 #define SSH_WAIT_TIMEOUT        (SSH_ACK_TIMEOUT * SSH_CMD_TRAIL_CNT)
+#define SSH_PROBE_CNT           2
+#define SSH_UNSUPPORTED_EXPIRY  600000  // ms until a command that did not answer is tried again
 
 
 class EXPORT SurfaceSerialHubClient : public IOService {
@@ -102,15 +124,16 @@ private:
         }
     };
 
-    struct WaitingRequest {
+    struct WaitingRequest : TaggedObject<AllocTagSSH> {
         queue_entry entry;
         bool    waiting;
+        bool    completed;      // response arrived and the request left the list
         UInt16  req_id;
         UInt8*  data;
         UInt16  data_len;
     };
 
-    struct PendingCommand {
+    struct PendingCommand : TaggedObject<AllocTagSSH> {
         queue_entry entry;
         UInt8*  buffer {nullptr};
         UInt16  len {0};
@@ -130,7 +153,7 @@ private:
         UInt16 filled_len;
     };
     
-    struct EventHandler {
+    struct EventHandler : TaggedObject<AllocTagSSH> {
         queue_entry entry;
         UInt8 target_iid;
         SurfaceSerialHubClient *client;
@@ -146,6 +169,7 @@ private:
     VoodooGPIO*             gpio_controller {nullptr};
     SurfaceBatteryNub*      battery_nub {nullptr};
     SurfaceHIDNub*          hid_nub {nullptr};
+    PerfCounterGroup*       counters {nullptr};
     
     bool            awake {true};
     RingBuffer      ring_buffer[SSH_RING_BUFFER_SIZE];
@@ -192,6 +216,10 @@ private:
     
     IOReturn sendEventCommand(SurfaceSerialEventRegistryType type, UInt8 tc, UInt8 iid, bool enable);
     
+    IOReturn probeCapabilitiesGated();
+    
+    void publishCapabilities();
+    
     IOReturn getDeviceResources();
     
     VoodooUARTController* getUARTController();
@@ -201,6 +229,8 @@ private:
     IOReturn flushCacheGated();
     
     void releaseResources();
+    
+    void powerTransition(bool wake);
 };
 
 #endif /* SurfaceSerialHubDriver_hpp */
@@ -0,0 +1,211 @@
+//
+//  TaggedAllocator.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <IOKit/IOLib.h>
+#include <IOKit/IOLocks.h>
+#include <libkern/OSAtomic.h>
+#include <libkern/c++/OSNumber.h>
+#include <libkern/c++/OSString.h>
+#include <kern/queue.h>
+
+#include "TaggedAllocator.hpp"
+
+#define TAG_ALLOC_MAGIC     0x42534154  // BSAT
+#define TAG_MAX_SITES       64
+
+struct __attribute__((aligned(16))) AllocHeader {
+#ifdef DEBUG
+    queue_chain_t   entry;      // zero while not on the live list
+#endif
+    uintptr_t       site;       // return address into the allocating function
+    size_t          size;
+    UInt32          tag;
+    UInt32          magic;
+};
+
+struct AllocStatistics {
+    volatile SInt64 live_bytes;
+    volatile SInt64 live_cnt;
+    volatile UInt64 peak_bytes;
+    volatile SInt64 allocs;
+    volatile SInt64 frees;
+};
+
+static const char *tag_names[AllocTagCount] = {"SSH", "MEI", "IPTS", "Diagnostics"};
+
+static AllocStatistics statistics[AllocTagCount];
+
+#ifdef DEBUG
+static IOSimpleLock *live_lock = nullptr;
+static queue_head_t live_list = {&live_list, &live_list};
+
+static IOSimpleLock *liveLock() {
+    if (!live_lock) {
+        IOSimpleLock *lock = IOSimpleLockAlloc();
+        if (lock && !OSCompareAndSwapPtr(nullptr, lock, reinterpret_cast<void * volatile *>(&live_lock)))
+            IOSimpleLockFree(lock);
+    }
+    return live_lock;
+}
+#endif
+
+void *tagMalloc(AllocTag tag, size_t size) {
+    uintptr_t site = reinterpret_cast<uintptr_t>(__builtin_return_address(0));
+    AllocHeader *hdr = static_cast<AllocHeader *>(IOMalloc(sizeof(AllocHeader) + size));
+    if (!hdr)
+        return nullptr;
+    bzero(hdr, sizeof(AllocHeader) + size);
+    hdr->site = site;
+    hdr->size = size;
+    hdr->tag = tag;
+    hdr->magic = TAG_ALLOC_MAGIC;
+
+    AllocStatistics *stats = &statistics[tag];
+    UInt64 live = static_cast<UInt64>(OSAddAtomic64(static_cast<SInt64>(size), &stats->live_bytes)) + size;
+    UInt64 peak;
+    while (live > (peak = stats->peak_bytes) && !OSCompareAndSwap64(peak, live, &stats->peak_bytes));
+    OSIncrementAtomic64(&stats->live_cnt);
+    OSIncrementAtomic64(&stats->allocs);
+
+#ifdef DEBUG
+    IOSimpleLock *lock = liveLock();
+    if (lock) {
+        IOSimpleLockLock(lock);
+        enqueue(&live_list, &hdr->entry);
+        IOSimpleLockUnlock(lock);
+    }
+#endif
+    return hdr + 1;
+}
+
+void tagFree(void *ptr) {
+    if (!ptr)
+        return;
+
+    AllocHeader *hdr = static_cast<AllocHeader *>(ptr) - 1;
+    if (hdr->magic != TAG_ALLOC_MAGIC || hdr->tag >= AllocTagCount) {
+        // leaking it is better than corrupting somebody else's memory
+        IOLog("TaggedAllocator::%p was not allocated here\n", ptr);
+        return;
+    }
+    size_t size = hdr->size;
+    AllocStatistics *stats = &statistics[hdr->tag];
+
+#ifdef DEBUG
+    if (hdr->entry.next) {
+        IOSimpleLockLock(live_lock);
+        remqueue(&hdr->entry);
+        IOSimpleLockUnlock(live_lock);
+    }
+#endif
+
+    OSAddAtomic64(-static_cast<SInt64>(size), &stats->live_bytes);
+    OSDecrementAtomic64(&stats->live_cnt);
+    OSIncrementAtomic64(&stats->frees);
+    hdr->magic = 0;
+    IOFree(hdr, sizeof(AllocHeader) + size);
+}
+
+const char *tagName(AllocTag tag) {
+    return tag_names[tag];
+}
+
+UInt64 tagLiveBytes(AllocTag tag) {
+    return static_cast<UInt64>(statistics[tag].live_bytes);
+}
+
+static void setNumber(OSDictionary *dict, const char *key, UInt64 value) {
+    OSNumber *num = OSNumber::withNumber(value, 64);
+    if (num) {
+        dict->setObject(key, num);
+        num->release();
+    }
+}
+
+OSDictionary *tagCopyStatistics() {
+    OSDictionary *result = OSDictionary::withCapacity(AllocTagCount);
+    if (!result)
+        return nullptr;
+
+    for (int i = 0; i < AllocTagCount; i++) {
+        AllocStatistics *stats = &statistics[i];
+        OSDictionary *entry = OSDictionary::withCapacity(5);
+        if (!entry)
+            continue;
+        setNumber(entry, "LiveBytes", static_cast<UInt64>(stats->live_bytes));
+        setNumber(entry, "LiveCount", static_cast<UInt64>(stats->live_cnt));
+        setNumber(entry, "PeakBytes", stats->peak_bytes);
+        setNumber(entry, "Allocations", static_cast<UInt64>(stats->allocs));
+        setNumber(entry, "Frees", static_cast<UInt64>(stats->frees));
+        result->setObject(tag_names[i], entry);
+        entry->release();
+    }
+    return result;
+}
+
+OSArray *tagCopyLiveSites() {
+#ifdef DEBUG
+    struct LiveSite {
+        uintptr_t   site;
+        UInt32      tag;
+        UInt32      cnt;
+        UInt64      bytes;
+    };
+    LiveSite sites[TAG_MAX_SITES];
+    int site_cnt = 0;
+    IOSimpleLock *lock = liveLock();
+    if (!lock)
+        return nullptr;
+
+    // only aggregate under the lock, objects are created afterwards
+    IOSimpleLockLock(lock);
+    AllocHeader *hdr;
+    qe_foreach_element(hdr, &live_list, entry) {
+        int i = 0;
+        for (; i < site_cnt; i++) {
+            if (sites[i].site == hdr->site && sites[i].tag == hdr->tag)
+                break;
+        }
+        if (i == site_cnt) {
+            // the last slot collects whatever does not fit
+            if (site_cnt == TAG_MAX_SITES)
+                i = TAG_MAX_SITES - 1;
+            else {
+                site_cnt++;
+                sites[i] = {hdr->site, hdr->tag, 0, 0};
+            }
+        }
+        sites[i].cnt++;
+        sites[i].bytes += hdr->size;
+    }
+    IOSimpleLockUnlock(lock);
+
+    OSArray *result = OSArray::withCapacity(site_cnt ? site_cnt : 1);
+    if (!result)
+        return nullptr;
+    uintptr_t base = reinterpret_cast<uintptr_t>(&tagMalloc);
+    for (int i = 0; i < site_cnt; i++) {
+        OSDictionary *entry = OSDictionary::withCapacity(4);
+        if (!entry)
+            continue;
+        OSString *tag = OSString::withCStringNoCopy(tag_names[sites[i].tag]);
+        if (tag) {
+            entry->setObject("Tag", tag);
+            tag->release();
+        }
+        // an offset does not reveal the kernel slide
+        setNumber(entry, "Site", static_cast<UInt64>(sites[i].site - base));
+        setNumber(entry, "Count", sites[i].cnt);
+        setNumber(entry, "Bytes", sites[i].bytes);
+        result->setObject(entry);
+        entry->release();
+    }
+    return result;
+#else
+    return nullptr;
+#endif
+}
@@ -0,0 +1,83 @@
+//
+//  TaggedAllocator.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef TaggedAllocator_hpp
+#define TaggedAllocator_hpp
+
+#include <libkern/c++/OSArray.h>
+#include <libkern/c++/OSDictionary.h>
+
+/*
+ * Every plain allocation of the drivers goes through here with the tag of
+ * the subsystem that owns it, so live bytes and the number of allocations
+ * per subsystem are always known. A steady state path is allocation free
+ * when its tag's allocation count does not move. DEBUG builds also keep
+ * every live allocation with the address it was made from, so whatever is
+ * left after a soak run points at its call site.
+ *
+ * OSObjects and memory descriptors are reference counted and already show
+ * up in ioclasscount, they are not routed through here. That covers all of
+ * the battery and HID nub code: BatteryManager is an OSObject, the history
+ * ring is a memory descriptor and the rest lives on the stack, so there is
+ * no tag for them. The cache line aligned per CPU counter values and the
+ * SMC values handed over to VirtualSMC are not tagged either.
+ */
+enum AllocTag {
+    AllocTagSSH = 0,
+    AllocTagMEI,
+    AllocTagIPTS,
+    AllocTagDiagnostics,
+    AllocTagCount,
+};
+
+// zero filled, nullptr on failure
+__attribute__((noinline)) void *tagMalloc(AllocTag tag, size_t size);
+
+void tagFree(void *ptr);
+
+template <typename T>
+__attribute__((always_inline)) inline T *tagNewArray(AllocTag tag, size_t cnt) {
+    static_assert(__is_trivial(T), "only plain data, objects derive from TaggedObject");
+    return static_cast<T *>(tagMalloc(tag, cnt * sizeof(T)));
+}
+
+/*
+ * Base of plain structures allocated with new, the operators are inlined so
+ * the recorded site is the new expression itself.
+ */
+template <AllocTag Tag>
+struct TaggedObject {
+    __attribute__((always_inline)) static void *operator new(size_t size) noexcept {
+        return tagMalloc(Tag, size);
+    }
+
+    __attribute__((always_inline)) static void *operator new[](size_t size) noexcept {
+        return tagMalloc(Tag, size);
+    }
+
+    static void operator delete(void *ptr) {
+        tagFree(ptr);
+    }
+
+    static void operator delete[](void *ptr) {
+        tagFree(ptr);
+    }
+};
+
+const char *tagName(AllocTag tag);
+
+UInt64 tagLiveBytes(AllocTag tag);
+
+// {tag: {LiveBytes, LiveCount, PeakBytes, Allocations, Frees}}, caller releases
+OSDictionary *tagCopyStatistics();
+
+// [{Tag, Site, Count, Bytes}] of live allocations grouped by call site, Site
+// is the signed offset from tagMalloc in the kext binary, nullptr unless DEBUG,
+// caller releases
+OSArray *tagCopyLiveSites();
+
+#endif /* TaggedAllocator_hpp */
@@ -0,0 +1,82 @@
+//
+//  TimerCoalescer.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <IOKit/IOLib.h>
+#include <IOKit/IOLocks.h>
+#include <libkern/OSAtomic.h>
+
+#include "TimerCoalescer.hpp"
+#include "BigSurfaceDiagnostics/PerfCounters.hpp"
+
+static const char *counter_names[TimerCoalescerCounterCount] = {"Armed", "Wakeups", "Coalesced"};
+
+static IOLock *coalesce_lock = nullptr;
+static PerfCounterGroup *counters = nullptr;
+static UInt64 wakeups[TIMER_COALESCE_SLOTS];
+
+static IOLock *coalesceLock() {
+    if (!coalesce_lock) {
+        IOLock *lock = IOLockAlloc();
+        if (lock && !OSCompareAndSwapPtr(nullptr, lock, reinterpret_cast<void * volatile *>(&coalesce_lock)))
+            IOLockFree(lock);
+    }
+    return coalesce_lock;
+}
+
+IOReturn TimerCoalescer::setTimeoutMS(IOTimerEventSource *timer, UInt32 period_ms, UInt32 tolerance_ms) {
+    UInt64 now, earliest, latest, interval, grid, deadline = 0;
+    IOLock *lock = coalesceLock();
+    if (!lock || !tolerance_ms)
+        return timer->setTimeoutMS(period_ms);
+
+    clock_get_uptime(&now);
+    nanoseconds_to_absolutetime(period_ms * 1000000ULL, &interval);
+    earliest = now + interval;
+    nanoseconds_to_absolutetime(tolerance_ms * 1000000ULL, &interval);
+    latest = earliest + interval;
+
+    IOLockLock(lock);
+    if (!counters)
+        counters = PerfCounterGroup::create("TimerCoalescer", counter_names, TimerCoalescerCounterCount);
+    PERF_COUNT(counters, TimerCoalescerArmed);
+
+    int free_slot = -1;
+    for (int i = 0; i < TIMER_COALESCE_SLOTS; i++) {
+        if (wakeups[i] <= now) {
+            wakeups[i] = 0;
+            if (free_slot < 0)
+                free_slot = i;
+        } else if (wakeups[i] >= earliest && wakeups[i] <= latest && (!deadline || wakeups[i] < deadline)) {
+            deadline = wakeups[i];
+        }
+    }
+
+    if (deadline) {
+        PERF_COUNT(counters, TimerCoalescerCoalesced);
+    } else {
+        nanoseconds_to_absolutetime(TIMER_COALESCE_GRID * 1000000ULL, &grid);
+        deadline = latest - latest % grid;
+        if (deadline < earliest)
+            deadline = latest;
+        // table full: wakeups nobody joins are simply not remembered
+        if (free_slot >= 0)
+            wakeups[free_slot] = deadline;
+        PERF_COUNT(counters, TimerCoalescerWakeups);
+    }
+    IOLockUnlock(lock);
+
+    return timer->wakeAtTime(kIOTimeOptionsWithLeeway, deadline, latest - deadline);
+}
+
+void TimerCoalescer::teardown() {
+    PerfCounterGroup::destroy(counters);
+    counters = nullptr;
+    if (coalesce_lock) {
+        IOLockFree(coalesce_lock);
+        coalesce_lock = nullptr;
+    }
+}
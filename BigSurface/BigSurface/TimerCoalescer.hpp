@@ -0,0 +1,39 @@
+//
+//  TimerCoalescer.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef TimerCoalescer_hpp
+#define TimerCoalescer_hpp
+
+#include <IOKit/IOTimerEventSource.h>
+
+/*
+ * Periodic work declares how late it may run. A timer whose window contains
+ * a wakeup some other driver already asked for joins it, otherwise it opens
+ * a new wakeup at the end of its window, aligned to a common grid, so the
+ * next timers have a chance to join. The remaining tolerance is passed on as
+ * leeway for the kernel's own coalescing.
+ */
+#define TIMER_COALESCE_SLOTS    16      // upcoming wakeups remembered
+#define TIMER_COALESCE_GRID     100     // ms
+
+enum TimerCoalescerCounter {
+    TimerCoalescerArmed = 0,
+    TimerCoalescerWakeups,
+    TimerCoalescerCoalesced,    // wakeups saved
+    TimerCoalescerCounterCount,
+};
+
+class TimerCoalescer {
+public:
+    // fires after period_ms, and no later than period_ms + tolerance_ms
+    static IOReturn setTimeoutMS(IOTimerEventSource *timer, UInt32 period_ms, UInt32 tolerance_ms);
+
+    // module stop only, no timer may be armed through it any more
+    static void teardown();
+};
+
+#endif /* TimerCoalescer_hpp */
@@ -0,0 +1,154 @@
+//
+//  Tunables.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <IOKit/IOLib.h>
+#include <IOKit/IOLocks.h>
+#include <libkern/OSAtomic.h>
+
+#include "Tunables.hpp"
+
+struct TunableRange {
+    UInt32  initial;
+    UInt32  minimum;
+    UInt32  maximum;
+};
+
+static const TunableRange ranges[BigSurfaceTunableCount] = {
+    {1, 1, 4},              // BigSurfaceTunablePerformanceMode
+    {30000, 5000, 600000},  // BigSurfaceTunableBatteryPollInterval
+    {1000, 100, 60000},     // BigSurfaceTunableALSPollInterval
+    {0, 0, 10000},          // BigSurfaceTunableALSChangeThreshold
+    {5000, 0, 600000},      // BigSurfaceTunableMEIIdleTimeout
+};
+
+static volatile UInt32 values[BigSurfaceTunableCount] = {
+    ranges[BigSurfaceTunablePerformanceMode].initial,
+    ranges[BigSurfaceTunableBatteryPollInterval].initial,
+    ranges[BigSurfaceTunableALSPollInterval].initial,
+    ranges[BigSurfaceTunableALSChangeThreshold].initial,
+    ranges[BigSurfaceTunableMEIIdleTimeout].initial,
+};
+
+static IOLock *tunable_lock = nullptr;
+static TunableListener listeners[BigSurfaceTunableCount];
+static void *listener_targets[BigSurfaceTunableCount];
+static bool delivering[BigSurfaceTunableCount];
+
+static IOLock *tunableLock() {
+    if (!tunable_lock) {
+        IOLock *lock = IOLockAlloc();
+        if (lock && !OSCompareAndSwapPtr(nullptr, lock, reinterpret_cast<void * volatile *>(&tunable_lock)))
+            IOLockFree(lock);
+    }
+    return tunable_lock;
+}
+
+static bool validSetting(UInt32 tunable, UInt32 value) {
+    return tunable < BigSurfaceTunableCount && value >= ranges[tunable].minimum && value <= ranges[tunable].maximum;
+}
+
+// called with tunable_lock held, true when the caller has to deliver the change
+static bool applySetting(BigSurfaceTunable tunable, UInt32 value) {
+    if (values[tunable] == value)
+        return false;
+    values[tunable] = value;
+    // whoever is already delivering picks up the new value before it finishes
+    if (!listeners[tunable] || delivering[tunable])
+        return false;
+    delivering[tunable] = true;
+    return true;
+}
+
+/*
+ * Called with tunable_lock held. Listeners may block on the hardware, so the
+ * lock is dropped around the call, unsubscribe waits for the delivery to end.
+ */
+static void deliverSetting(IOLock *lock, BigSurfaceTunable tunable) {
+    while (listeners[tunable]) {
+        TunableListener listener = listeners[tunable];
+        void *target = listener_targets[tunable];
+        UInt32 value = values[tunable];
+        IOLockUnlock(lock);
+        listener(target, tunable, value);
+        IOLockLock(lock);
+        if (values[tunable] == value)
+            break;
+    }
+    delivering[tunable] = false;
+    IOLockWakeup(lock, &delivering[tunable], false);
+}
+
+UInt32 Tunables::get(BigSurfaceTunable tunable) {
+    return values[tunable];
+}
+
+IOReturn Tunables::set(BigSurfaceTunable tunable, UInt32 value) {
+    BigSurfaceTunableSetting setting {static_cast<UInt32>(tunable), value};
+    return setBatch(&setting, 1);
+}
+
+IOReturn Tunables::setBatch(const BigSurfaceTunableSetting *settings, UInt32 cnt) {
+    for (UInt32 i = 0; i < cnt; i++) {
+        if (!validSetting(settings[i].tunable, settings[i].value))
+            return kIOReturnBadArgument;
+    }
+
+    IOLock *lock = tunableLock();
+    if (!lock)
+        return kIOReturnNoMemory;
+    bool deliver[BigSurfaceTunableCount] {};
+    IOLockLock(lock);
+    for (UInt32 i = 0; i < cnt; i++) {
+        if (applySetting(static_cast<BigSurfaceTunable>(settings[i].tunable), settings[i].value))
+            deliver[settings[i].tunable] = true;
+    }
+    for (int i = 0; i < BigSurfaceTunableCount; i++) {
+        if (deliver[i])
+            deliverSetting(lock, static_cast<BigSurfaceTunable>(i));
+    }
+    IOLockUnlock(lock);
+    return kIOReturnSuccess;
+}
+
+void Tunables::copyTable(BigSurfaceTunableTable *table) {
+    table->count = BigSurfaceTunableCount;
+    for (int i = 0; i < BigSurfaceTunableCount; i++) {
+        table->value[i] = values[i];
+        table->minimum[i] = ranges[i].minimum;
+        table->maximum[i] = ranges[i].maximum;
+    }
+}
+
+bool Tunables::subscribe(BigSurfaceTunable tunable, TunableListener listener, void *target) {
+    IOLock *lock = tunableLock();
+    if (!lock)
+        return false;
+
+    IOLockLock(lock);
+    bool ret = !listeners[tunable];
+    if (ret) {
+        listeners[tunable] = listener;
+        listener_targets[tunable] = target;
+    }
+    IOLockUnlock(lock);
+    return ret;
+}
+
+void Tunables::unsubscribe(BigSurfaceTunable tunable, void *target) {
+    if (!tunable_lock)
+        return;
+
+    IOLockLock(tunable_lock);
+    if (listener_targets[tunable] == target) {
+        listeners[tunable] = nullptr;
+        listener_targets[tunable] = nullptr;
+        // the target may go away once we return, let a running listener finish first
+        while (delivering[tunable])
+            IOLockSleep(tunable_lock, &delivering[tunable], THREAD_UNINT);
+    }
+    IOLockUnlock(tunable_lock);
+}
@@ -0,0 +1,41 @@
+//
+//  Tunables.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef Tunables_hpp
+#define Tunables_hpp
+
+#include <IOKit/IOReturn.h>
+
+#include "BigSurfaceDiagnostics/BigSurfaceControl.h"
+
+/*
+ * Runtime knobs shared by all drivers. Drivers read the current value every
+ * time they need it, so most changes apply from the next poll on. A driver
+ * that has to push a change to the hardware subscribes to its tunable.
+ */
+typedef void (*TunableListener)(void *target, BigSurfaceTunable tunable, UInt32 value);
+
+class Tunables {
+public:
+    static UInt32 get(BigSurfaceTunable tunable);
+
+    // kIOReturnBadArgument when out of range
+    static IOReturn set(BigSurfaceTunable tunable, UInt32 value);
+
+    // check every setting first, then apply all of them
+    static IOReturn setBatch(const BigSurfaceTunableSetting *settings, UInt32 cnt);
+
+    static void copyTable(BigSurfaceTunableTable *table);
+
+    // one listener per tunable, called without driver or tunable locks held
+    static bool subscribe(BigSurfaceTunable tunable, TunableListener listener, void *target);
+
+    // waits for a running listener, so never call it from the listener itself
+    static void unsubscribe(BigSurfaceTunable tunable, void *target);
+};
+
+#endif /* Tunables_hpp */
@@ -0,0 +1,92 @@
+//
+//  WorkLoopBands.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <IOKit/IOLib.h>
+#include <IOKit/IOLocks.h>
+#include <libkern/OSAtomic.h>
+#include <mach/thread_policy.h>
+
+#include "WorkLoopBands.hpp"
+
+static const char *band_names[WorkLoopBandCount] = {"Input", "Control", "Telemetry", "HubClient"};
+
+static IOLock *band_lock = nullptr;
+static IOWorkLoop *band_loops[WorkLoopBandCount];
+static UInt32 band_users[WorkLoopBandCount];
+
+static IOLock *bandLock() {
+    if (!band_lock) {
+        IOLock *lock = IOLockAlloc();
+        if (lock && !OSCompareAndSwapPtr(nullptr, lock, reinterpret_cast<void * volatile *>(&band_lock)))
+            IOLockFree(lock);
+    }
+    return band_lock;
+}
+
+static void setRealtimePolicy(IOWorkLoop *loop) {
+    thread_time_constraint_policy_data_t policy;
+    UInt64 abstime;
+
+    // touch reports arrive aperiodically, only bound the computation and constraint
+    policy.period = 0;
+    nanoseconds_to_absolutetime(WORKLOOP_INPUT_RT_COMPUTATION * 1000ULL, &abstime);
+    policy.computation = static_cast<uint32_t>(abstime);
+    nanoseconds_to_absolutetime(WORKLOOP_INPUT_RT_CONSTRAINT * 1000ULL, &abstime);
+    policy.constraint = static_cast<uint32_t>(abstime);
+    policy.preemptible = TRUE;
+
+    if (thread_policy_set(loop->getThread(), THREAD_TIME_CONSTRAINT_POLICY, reinterpret_cast<thread_policy_t>(&policy), THREAD_TIME_CONSTRAINT_POLICY_COUNT) == KERN_SUCCESS)
+        return;
+
+    thread_precedence_policy_data_t precedence;
+    precedence.importance = 63;
+    if (thread_policy_set(loop->getThread(), THREAD_PRECEDENCE_POLICY, reinterpret_cast<thread_policy_t>(&precedence), THREAD_PRECEDENCE_POLICY_COUNT) != KERN_SUCCESS)
+        IOLog("WorkLoopBands::Failed to raise input band priority, using default scheduling\n");
+}
+
+IOWorkLoop *WorkLoopBands::acquire(WorkLoopBand band) {
+    IOLock *lock = bandLock();
+    if (!lock)
+        return nullptr;
+
+    IOLockLock(lock);
+    if (!band_loops[band]) {
+        band_loops[band] = IOWorkLoop::workLoop();
+        if (!band_loops[band]) {
+            IOLockUnlock(lock);
+            IOLog("WorkLoopBands::Failed to create %s band\n", band_names[band]);
+            return nullptr;
+        }
+        if (band == WorkLoopBandInput)
+            setRealtimePolicy(band_loops[band]);
+    }
+    band_users[band]++;
+    IOWorkLoop *loop = band_loops[band];
+    IOLockUnlock(lock);
+    return loop;
+}
+
+void WorkLoopBands::release(WorkLoopBand band, IOWorkLoop *&loop) {
+    if (!loop || !band_lock)
+        return;
+
+    IOLockLock(band_lock);
+    if (loop == band_loops[band] && --band_users[band] == 0) {
+        // the last user removed its event sources, stop the thread
+        band_loops[band]->release();
+        band_loops[band] = nullptr;
+    }
+    IOLockUnlock(band_lock);
+    loop = nullptr;
+}
+
+void WorkLoopBands::teardown() {
+    if (band_lock) {
+        IOLockFree(band_lock);
+        band_lock = nullptr;
+    }
+}
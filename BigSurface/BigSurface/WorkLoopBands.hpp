@@ -0,0 +1,49 @@
+//
+//  WorkLoopBands.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef WorkLoopBands_hpp
+#define WorkLoopBands_hpp
+
+#include <IOKit/IOWorkLoop.h>
+
+/*
+ * A few shared work loops instead of one thread per driver. Drivers attach
+ * their event sources to the band matching the latency they need:
+ *   Input      real time thread, touch delivery and buttons
+ *   Control    serial hub transport
+ *   Telemetry  SMBus, light sensor and bookkeeping timers
+ *   HubClient  drivers waiting synchronously for serial hub responses
+ * Anything that blocks synchronously on another band must never be put on
+ * that band, and a blocking round trip never goes on Telemetry, where it
+ * would stall every other driver's timers behind it.
+ */
+
+// time constraint policy of the input band, in us
+#define WORKLOOP_INPUT_RT_COMPUTATION   500
+#define WORKLOOP_INPUT_RT_CONSTRAINT    2000
+
+enum WorkLoopBand {
+    WorkLoopBandInput = 0,
+    WorkLoopBandControl,
+    WorkLoopBandTelemetry,
+    WorkLoopBandHubClient,
+    WorkLoopBandCount,
+};
+
+class WorkLoopBands {
+public:
+    // created on first use, stays valid until the matching release()
+    static IOWorkLoop *acquire(WorkLoopBand band);
+
+    // tolerates nullptr and clears the caller's pointer
+    static void release(WorkLoopBand band, IOWorkLoop *&loop);
+
+    // module stop only, every band has been released by then
+    static void teardown();
+};
+
+#endif /* WorkLoopBands_hpp */
@@ -12,6 +12,8 @@
 #include <IOKit/IOService.h>
 #include <IOKit/IOLib.h>
 
+#include "CoreTypes.h"
+
 #ifndef EXPORT
 #define EXPORT __attribute__((visibility("default")))
 #endif
@@ -19,12 +21,6 @@
 #define kIOPMPowerOff                       0
 #define kIOPMNumberPowerStates              2
 
-#define BIT(nr) (1UL << (nr))
-
-#ifndef GENMASK
-#define GENMASK(h, l) (((~0UL) << (l)) & (~0UL >> (64 - 1 - (h))))
-#endif
-
 static IOPMPowerState myIOPMPowerStates[kIOPMNumberPowerStates] = {
     {1, kIOPMPowerOff, kIOPMPowerOff, kIOPMPowerOff, 0, 0, 0, 0, 0, 0, 0, 0},
     {1, kIOPMPowerOn, kIOPMPowerOn, kIOPMPowerOn, 0, 0, 0, 0, 0, 0, 0, 0}
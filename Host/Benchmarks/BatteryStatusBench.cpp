@@ -0,0 +1,23 @@
+//
+//  BatteryStatusBench.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <benchmark/benchmark.h>
+
+#include "Reference/BatteryStatusVectors.hpp"
+
+static void BM_ApplyStatus(benchmark::State &state) {
+    const BatteryStatusVector &v = battery_status_vectors[state.range(0)];
+    BatteryInfo::State st;
+
+    batteryPrepareState(st, v);
+    for (auto _ : state) {
+        BatteryStatusCore::applyStatus(st, v.bst, v.elapsed_ms);
+        benchmark::DoNotOptimize(st);
+    }
+    state.SetLabel(v.name);
+}
+BENCHMARK(BM_ApplyStatus)->DenseRange(0, BATTERY_STATUS_VECTOR_CNT - 1);
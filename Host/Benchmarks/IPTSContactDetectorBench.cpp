@@ -0,0 +1,48 @@
+//
+//  IPTSContactDetectorBench.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <benchmark/benchmark.h>
+
+#include "Reference/HeatmapVectors.hpp"
+
+#define BENCH_FRAME_CNT     16
+
+/*
+ * One full heatmap frame per iteration. items_per_second is frames per
+ * second, the time column is the per-frame cost in microseconds.
+ */
+static void BM_DetectContacts(benchmark::State &state) {
+    static IPTSContactDetector detector;
+    static UInt8 frames[BENCH_FRAME_CNT][HEATMAP_WIDTH * HEATMAP_HEIGHT];
+    IPTSHeatmapDim dim = heatmapDim(HEATMAP_WIDTH, HEATMAP_HEIGHT);
+    IPTSContact contacts[IPTS_MAX_CONTACTS];
+    HeatmapTouch touches[10];
+    UInt32 finger_cnt = static_cast<UInt32>(state.range(0));
+    bool palm = state.range(1);
+    UInt64 found = 0;
+
+    for (UInt32 i = 0; i < BENCH_FRAME_CNT; i++) {
+        UInt32 touch_cnt = heatmapRandomTouches(touches, finger_cnt, dim, i + 1);
+        if (palm)
+            touches[touch_cnt++] = {48, 30, 9, 7, 160};
+        heatmapRender(frames[i], dim, touches, touch_cnt, i + 1, 24);
+    }
+
+    UInt32 frame = 0;
+    for (auto _ : state) {
+        found += detector.detect(&dim, frames[frame], contacts, IPTS_MAX_CONTACTS);
+        benchmark::ClobberMemory();
+        frame = (frame + 1) % BENCH_FRAME_CNT;
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * HEATMAP_WIDTH * HEATMAP_HEIGHT);
+    state.counters["contacts"] = benchmark::Counter(static_cast<double>(found), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_DetectContacts)
+    ->ArgNames({"fingers", "palm"})
+    ->Args({0, 0})->Args({1, 0})->Args({2, 0})->Args({5, 0})->Args({10, 0})->Args({2, 1})
+    ->Unit(benchmark::kMicrosecond);
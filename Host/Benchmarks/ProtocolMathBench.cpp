@@ -0,0 +1,41 @@
+//
+//  ProtocolMathBench.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <benchmark/benchmark.h>
+
+#include "SurfaceManagementEngine/MEIProtocol.h"
+#include "SurfaceAmbientLightSensor/APDS9960Constants.h"
+
+static void BM_MeiFilledSlots(benchmark::State &state) {
+    UInt32 csr = 0x80000000;
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mei_csr_filled_slots(csr));
+        csr += 0x00010100 + 0x00010000;     // advance both pointers, write runs ahead
+    }
+}
+BENCHMARK(BM_MeiFilledSlots);
+
+static void BM_MeiDataToSlots(benchmark::State &state) {
+    UInt32 len = 0;
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(MEI_DATA_TO_SLOTS(len));
+        len = (len + 13) & 0x1FF;
+    }
+}
+BENCHMARK(BM_MeiDataToSlots);
+
+static void BM_ClearToLux(benchmark::State &state) {
+    UInt16 clear = 0;
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(apds9960ClearToLux(clear));
+        clear += 97;
+    }
+}
+BENCHMARK(BM_ClearToLux);
@@ -0,0 +1,82 @@
+//
+//  SerialFramingBench.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <string.h>
+
+#include <benchmark/benchmark.h>
+
+#include "Reference/SerialFramingVectors.hpp"
+
+static void BM_CrcCcittFalse(benchmark::State &state) {
+    UInt8 buffer[1024];
+    size_t len = static_cast<size_t>(state.range(0));
+
+    for (size_t i = 0; i < len; i++)
+        buffer[i] = static_cast<UInt8>(i * 31 + 7);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(crc_ccitt_false(CRC_INITIAL, buffer, len));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(len));
+}
+BENCHMARK(BM_CrcCcittFalse)->Arg(6)->Arg(18)->Arg(64)->Arg(256)->Arg(1024);
+
+static void BM_BuildControlFrame(benchmark::State &state) {
+    UInt8 buffer[SSH_CONTROL_FRAME_LENGTH];
+    UInt8 seq_id = 0;
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(sshBuildControlFrame(buffer, SSH_FRAME_TYPE_ACK, seq_id++));
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_BuildControlFrame);
+
+static void BM_BuildCommand(benchmark::State &state) {
+    UInt8 payload[255] = {};
+    UInt8 buffer[SSH_COMMAND_LENGTH(sizeof(payload))];
+    UInt16 len = static_cast<UInt16>(state.range(0));
+    UInt8 seq_id = 0;
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(sshBuildCommand(buffer, true, seq_id++, 0x0042, SSH_TC_HID, SSH_TID_SECONDARY, 0x01, SSH_CID_HID_OUT_REPORT, payload, len));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * SSH_COMMAND_LENGTH(len));
+}
+BENCHMARK(BM_BuildCommand)->Arg(0)->Arg(10)->Arg(64)->Arg(255);
+
+static void BM_ParseFrame(benchmark::State &state, const UInt8 *frame, UInt16 len) {
+    UInt8 buffer[64];
+    SerialFrameInfo info;
+
+    memcpy(buffer, frame, len);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(sshParseFrame(buffer, len, &info));
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * len);
+}
+BENCHMARK_CAPTURE(BM_ParseFrame, ack, ssh_ack_seq_05, sizeof(ssh_ack_seq_05));
+BENCHMARK_CAPTURE(BM_ParseFrame, bat_bst, ssh_bat_bst_request, sizeof(ssh_bat_bst_request));
+BENCHMARK_CAPTURE(BM_ParseFrame, hid_descriptor, ssh_hid_descriptor_request, sizeof(ssh_hid_descriptor_request));
+
+// what the receive path does per input event: parse the data frame, answer with an ACK
+static void BM_ReceiveAndAck(benchmark::State &state) {
+    UInt8 buffer[64];
+    UInt8 ack[SSH_CONTROL_FRAME_LENGTH];
+    SerialFrameInfo info;
+
+    memcpy(buffer, ssh_hid_descriptor_request, sizeof(ssh_hid_descriptor_request));
+    for (auto _ : state) {
+        if (sshParseFrame(buffer, sizeof(ssh_hid_descriptor_request), &info) == SerialFrameOK)
+            sshBuildControlFrame(ack, SSH_FRAME_TYPE_ACK, info.seq_id);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+BENCHMARK(BM_ReceiveAndAck);
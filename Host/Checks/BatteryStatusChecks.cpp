@@ -0,0 +1,56 @@
+//
+//  BatteryStatusChecks.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include "Check.hpp"
+#include "Reference/BatteryStatusVectors.hpp"
+
+CORE_CHECK(battery_status_reference) {
+    for (size_t i = 0; i < BATTERY_STATUS_VECTOR_CNT; i++) {
+        const BatteryStatusVector &v = battery_status_vectors[i];
+        BatteryInfo::State st;
+        int before = failures;
+
+        batteryPrepareState(st, v);
+        BatteryStatusCore::applyStatus(st, v.bst, v.elapsed_ms);
+
+        CHECK_EQ(st.state, v.bst[BatteryStatusCore::BSTState]);
+        CHECK_EQ(st.presentVoltage, v.bst[BatteryStatusCore::BSTPresentVoltage]);
+        CHECK_EQ(st.presentRate, v.present_rate);
+        CHECK_EQ(st.remainingCapacity, v.remaining_capacity);
+        CHECK_EQ(st.lastRemainingCapacity, v.remaining_capacity);
+        CHECK_EQ(st.averageRate, v.average_rate);
+        CHECK_EQ(st.averageTimeToEmpty, v.average_time_to_empty);
+        CHECK_EQ(st.runTimeToEmpty, v.run_time_to_empty);
+        CHECK_EQ(st.timeToFull, v.time_to_full);
+        CHECK_EQ(st.signedPresentRate, v.signed_present_rate);
+        CHECK_EQ(st.signedAverageRate, v.signed_average_rate);
+        CHECK_EQ(st.calculatedACAdapterConnected, v.ac_connected);
+        CHECK_EQ(st.batteryIsFull, v.full);
+        CHECK_EQ(st.critical, v.critical);
+        CHECK_EQ(st.bad, v.bad);
+        CHECK_EQ(st.bogus, v.bogus);
+        if (failures != before)
+            printf("  in vector \"%s\"\n", v.name);
+    }
+}
+
+CORE_CHECK(battery_average_converges) {
+    BatteryInfo::State st;
+    const UInt32 bst[] = {BatteryStatusCore::BSTDischarging, 1000, 3000, 7600};
+
+    batteryPrepareState(st, battery_status_vectors[0]);
+    st.averageRate = 4000;
+    // a steady load pulls the one minute average toward the present rate, never past it
+    UInt32 previous = st.averageRate;
+    for (int i = 0; i < 200; i++) {
+        BatteryStatusCore::applyStatus(st, bst, 5000);
+        CHECK(st.averageRate <= previous);
+        CHECK(st.averageRate >= 1000);
+        previous = st.averageRate;
+    }
+    CHECK(st.averageRate < 1020);
+}
@@ -0,0 +1,55 @@
+//
+//  Check.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef Check_hpp
+#define Check_hpp
+
+#include <stdio.h>
+
+/*
+ * Just enough of a test runner to hold the cores to their reference
+ * vectors, so the checks need nothing beyond a compiler.
+ */
+struct CoreCheck {
+    typedef void (*Function)(int &failures);
+
+    const char* name;
+    Function    run;
+    CoreCheck*  next;
+
+    static CoreCheck *head;
+
+    CoreCheck(const char *name, Function run) : name(name), run(run), next(head) {
+        head = this;
+    }
+};
+
+#define CORE_CHECK(check_name)                                          \
+    static void check_name(int &failures);                              \
+    static CoreCheck check_name##_entry(#check_name, check_name);       \
+    static void check_name(int &failures)
+
+#define CHECK(cond)                                                     \
+    do {                                                                \
+        if (!(cond)) {                                                  \
+            printf("  %s:%d: %s\n", __FILE__, __LINE__, #cond);          \
+            failures++;                                                 \
+        }                                                               \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                      \
+    do {                                                                \
+        long long _a = static_cast<long long>(actual);                  \
+        long long _e = static_cast<long long>(expected);                \
+        if (_a != _e) {                                                 \
+            printf("  %s:%d: %s is %lld, expected %lld\n",              \
+                   __FILE__, __LINE__, #actual, _a, _e);                \
+            failures++;                                                 \
+        }                                                               \
+    } while (0)
+
+#endif /* Check_hpp */
@@ -0,0 +1,25 @@
+//
+//  CheckMain.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include "Check.hpp"
+
+CoreCheck *CoreCheck::head = nullptr;
+
+int main() {
+    int failed = 0;
+    int total = 0;
+
+    for (CoreCheck *check = CoreCheck::head; check; check = check->next, total++) {
+        int failures = 0;
+        check->run(failures);
+        printf("%s %s\n", failures ? "FAIL" : "ok  ", check->name);
+        if (failures)
+            failed++;
+    }
+    printf("%d of %d checks passed\n", total - failed, total);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,141 @@
+//
+//  IPTSContactDetectorChecks.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include "Check.hpp"
+#include "Reference/HeatmapVectors.hpp"
+
+static IPTSContactDetector detector;
+static UInt8 heatmap[IPTS_HEATMAP_MAX_SIZE];
+
+static UInt32 detect(const IPTSHeatmapDim &dim, const HeatmapTouch *touches, UInt32 touch_cnt, IPTSContact *contacts, UInt32 max_contacts, UInt8 noise = 0) {
+    heatmapRender(heatmap, dim, touches, touch_cnt, 1, noise);
+    return detector.detect(&dim, heatmap, contacts, max_contacts);
+}
+
+CORE_CHECK(ipts_rejects_bad_dimensions) {
+    IPTSContact contacts[IPTS_MAX_CONTACTS];
+    IPTSHeatmapDim dim = heatmapDim(HEATMAP_WIDTH, HEATMAP_HEIGHT);
+    const HeatmapTouch touch = {20, 15, 4, 4, 200};
+
+    heatmapRender(heatmap, dim, &touch, 1, 1, 0);
+    dim.z_min = dim.z_max;
+    CHECK_EQ(detector.detect(&dim, heatmap, contacts, IPTS_MAX_CONTACTS), 0);
+    dim = heatmapDim(0, HEATMAP_HEIGHT);
+    CHECK_EQ(detector.detect(&dim, heatmap, contacts, IPTS_MAX_CONTACTS), 0);
+    dim = heatmapDim(255, 255);
+    CHECK_EQ(detector.detect(&dim, heatmap, contacts, IPTS_MAX_CONTACTS), 0);
+}
+
+CORE_CHECK(ipts_noise_only) {
+    IPTSContact contacts[IPTS_MAX_CONTACTS];
+    IPTSHeatmapDim dim = heatmapDim(HEATMAP_WIDTH, HEATMAP_HEIGHT);
+
+    CHECK_EQ(detect(dim, nullptr, 0, contacts, IPTS_MAX_CONTACTS, 20), 0);
+}
+
+CORE_CHECK(ipts_single_finger) {
+    IPTSContact contacts[IPTS_MAX_CONTACTS];
+    IPTSHeatmapDim dim = heatmapDim(HEATMAP_WIDTH, HEATMAP_HEIGHT);
+    const HeatmapTouch touch = {20, 15, 4, 4, 200};
+
+    CHECK_EQ(detect(dim, &touch, 1, contacts, IPTS_MAX_CONTACTS), 1);
+    CHECK_EQ(contacts[0].x, 20 * 256);
+    CHECK_EQ(contacts[0].y, 15 * 256);
+    CHECK_EQ(contacts[0].major, contacts[0].minor);
+    CHECK(contacts[0].major > 256 && contacts[0].major < 8 * 256);
+    CHECK_EQ(contacts[0].peak, 200);
+    CHECK_EQ(contacts[0].confidence, 200);
+}
+
+CORE_CHECK(ipts_elongated_finger) {
+    IPTSContact contacts[IPTS_MAX_CONTACTS];
+    IPTSHeatmapDim dim = heatmapDim(HEATMAP_WIDTH, HEATMAP_HEIGHT);
+    const HeatmapTouch touch = {30, 20, 6, 3, 180};
+
+    CHECK_EQ(detect(dim, &touch, 1, contacts, IPTS_MAX_CONTACTS), 1);
+    CHECK_EQ(contacts[0].x, 30 * 256);
+    CHECK_EQ(contacts[0].y, 20 * 256);
+    CHECK(contacts[0].major > contacts[0].minor * 3 / 2);
+}
+
+CORE_CHECK(ipts_single_pixel_is_dropped) {
+    IPTSContact contacts[IPTS_MAX_CONTACTS];
+    IPTSHeatmapDim dim = heatmapDim(HEATMAP_WIDTH, HEATMAP_HEIGHT);
+    const HeatmapTouch touch = {10, 10, 1, 1, 200};
+
+    CHECK_EQ(detect(dim, &touch, 1, contacts, IPTS_MAX_CONTACTS), 0);
+}
+
+CORE_CHECK(ipts_palm_confidence) {
+    IPTSContact contacts[IPTS_MAX_CONTACTS];
+    IPTSHeatmapDim dim = heatmapDim(HEATMAP_WIDTH, HEATMAP_HEIGHT);
+    const HeatmapTouch touch = {32, 22, 10, 10, 200};
+
+    CHECK_EQ(detect(dim, &touch, 1, contacts, IPTS_MAX_CONTACTS), 1);
+    CHECK_EQ(contacts[0].x, 32 * 256);
+    CHECK_EQ(contacts[0].y, 22 * 256);
+    CHECK_EQ(contacts[0].confidence, 100);
+}
+
+CORE_CHECK(ipts_five_fingers) {
+    IPTSContact contacts[IPTS_MAX_CONTACTS];
+    IPTSHeatmapDim dim = heatmapDim(HEATMAP_WIDTH, HEATMAP_HEIGHT);
+    const HeatmapTouch touches[] = {
+        {8, 30, 3, 3, 150}, {20, 12, 3, 3, 160}, {32, 8, 3, 3, 170}, {44, 12, 3, 3, 180}, {56, 30, 3, 3, 190},
+    };
+
+    CHECK_EQ(detect(dim, touches, 5, contacts, IPTS_MAX_CONTACTS), 5);
+    for (UInt32 i = 0; i < 5; i++) {
+        bool found = false;
+        for (UInt32 j = 0; j < 5; j++) {
+            if (contacts[j].x == touches[i].x * 256 && contacts[j].y == touches[i].y * 256 && contacts[j].peak == touches[i].depth)
+                found = true;
+        }
+        CHECK(found);
+    }
+    // the caller's array bounds the result
+    CHECK_EQ(detect(dim, touches, 5, contacts, 3), 3);
+}
+
+CORE_CHECK(ipts_odd_size_tail) {
+    IPTSContact contacts[IPTS_MAX_CONTACTS];
+    // 37 * 23 is no multiple of the vector width, the touch sits in the tail
+    IPTSHeatmapDim dim = heatmapDim(37, 23);
+    const HeatmapTouch touch = {34, 20, 2, 2, 200};
+
+    CHECK_EQ(detect(dim, &touch, 1, contacts, IPTS_MAX_CONTACTS), 1);
+    CHECK_EQ(contacts[0].x, 34 * 256);
+    CHECK_EQ(contacts[0].y, 20 * 256);
+}
+
+/*
+ * Noisy random frames folded into one digest. The value is the output of the
+ * scalar path the kext runs, the vector paths have to reproduce it exactly.
+ */
+#define IPTS_RANDOM_FRAME_CNT       256
+#define IPTS_RANDOM_FRAME_DIGEST    0x9B591B3BU
+
+CORE_CHECK(ipts_random_frames_digest) {
+    IPTSContact contacts[IPTS_MAX_CONTACTS];
+    HeatmapTouch touches[8];
+    IPTSHeatmapDim dim = heatmapDim(HEATMAP_WIDTH, HEATMAP_HEIGHT);
+    UInt32 digest = 2166136261U;
+    UInt32 total = 0;
+
+    for (UInt32 frame = 0; frame < IPTS_RANDOM_FRAME_CNT; frame++) {
+        UInt32 touch_cnt = heatmapRandomTouches(touches, frame % 9 ? frame % 9 - 1 : 0, dim, frame);
+        heatmapRender(heatmap, dim, touches, touch_cnt, frame, 24);
+        UInt32 cnt = detector.detect(&dim, heatmap, contacts, IPTS_MAX_CONTACTS);
+        const UInt8 *bytes = reinterpret_cast<const UInt8 *>(contacts);
+        for (size_t i = 0; i < cnt * sizeof(IPTSContact); i++)
+            digest = (digest ^ bytes[i]) * 16777619U;
+        digest = (digest ^ cnt) * 16777619U;
+        total += cnt;
+    }
+    CHECK(total > IPTS_RANDOM_FRAME_CNT);
+    CHECK_EQ(digest, IPTS_RANDOM_FRAME_DIGEST);
+}
@@ -0,0 +1,85 @@
+//
+//  MEISlotTransportChecks.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include "Check.hpp"
+#include "Emulator/MEIHostModel.hpp"
+#include "SurfaceManagementEngine/MEISlotTransport.hpp"
+
+CORE_CHECK(mei_slot_write_limits) {
+    MEIEmulatorConfig config;
+    config.host_depth = 8;
+    MEIEmulator emu(config);
+    UInt8 header[4] = {};
+    UInt8 data[32] = {};
+    UInt8 empty_slots = 0;
+
+    CHECK_EQ(meiWriteSlots(&emu, 8, header, 3, data, 4), MEISlotInvalid);
+    // header and 32 bytes need 9 slots
+    CHECK_EQ(meiWriteSlots(&emu, 8, header, sizeof(header), data, sizeof(data)), MEISlotTooLarge);
+    CHECK_EQ(meiHostEmptySlots(&emu, 8, &empty_slots), MEISlotOK);
+    CHECK_EQ(empty_slots, 8);
+
+    // the ME dropped ready, the slots still land but the caller has to reset
+    emu.injectReset();
+    CHECK_EQ(meiWriteSlots(&emu, 8, header, sizeof(header), data, 5), MEISlotNotReady);
+    CHECK_EQ(meiHostEmptySlots(&emu, 8, &empty_slots), MEISlotOK);
+    CHECK_EQ(empty_slots, 5);
+    CHECK_EQ(meiHostEmptySlots(&emu, 2, &empty_slots), MEISlotOverrun);
+    CHECK_EQ(emu.getStats().overflows, 0);
+}
+
+CORE_CHECK(mei_link_stream) {
+    MEIEmulatorConfig config;
+    config.stream_len = 61;     // odd length, the last slot is padded
+    MEIEmulator emu(config);
+    MEIHostModel host(emu, config.stream_len);
+
+    CHECK(host.start());
+    CHECK(emu.isStreaming());
+    // enough traffic for both 8 bit buffer pointers to wrap several times
+    for (int i = 0; i < 100000 && host.getStats().stream_messages < 1000; i++)
+        CHECK(host.poll());
+
+    const MEIHostModelStats &stats = host.getStats();
+    CHECK_EQ(stats.stream_messages, 1000);
+    CHECK_EQ(stats.stream_slots, 1000 * (1 + 16));
+    CHECK_EQ(stats.lost_messages, 0);
+    CHECK_EQ(stats.payload_errors, 0);
+    CHECK_EQ(emu.getStats().protocol_errors, 0);
+    CHECK_EQ(emu.getStats().underflows, 0);
+}
+
+CORE_CHECK(mei_link_reset_and_d0i3) {
+    MEIEmulator emu;
+    MEIHostModel host(emu, MEIEmulatorConfig().stream_len);
+    const MEIHostModelStats &stats = host.getStats();
+
+    CHECK(host.start());
+    for (int i = 0; i < 1000; i++)
+        CHECK(host.poll());
+
+    emu.injectReset();
+    CHECK(host.poll());
+    CHECK_EQ(stats.resets, 1);
+    CHECK(host.isConnected());
+    CHECK(emu.isStreaming());
+
+    CHECK(host.cycleD0i3(true));
+    CHECK(host.cycleD0i3(false));
+    CHECK_EQ(stats.d0i3_cycles, 2);
+    CHECK_EQ(stats.d0i3_wakes, 1);
+    CHECK_EQ(emu.getStats().d0i3_entries, 2);
+    CHECK_EQ(emu.getStats().d0i3_exits, 2);
+
+    UInt64 received = stats.stream_messages;
+    for (int i = 0; i < 1000; i++)
+        CHECK(host.poll());
+    CHECK(stats.stream_messages > received);
+    CHECK_EQ(stats.payload_errors, 0);
+    CHECK_EQ(stats.timeouts, 0);
+    CHECK_EQ(emu.getStats().protocol_errors, 0);
+}
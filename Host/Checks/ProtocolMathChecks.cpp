@@ -0,0 +1,32 @@
+//
+//  ProtocolMathChecks.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include "Check.hpp"
+#include "SurfaceManagementEngine/MEIProtocol.h"
+#include "SurfaceAmbientLightSensor/APDS9960Constants.h"
+
+CORE_CHECK(mei_slot_math) {
+    CHECK_EQ(MEI_DATA_TO_SLOTS(0), 0);
+    CHECK_EQ(MEI_DATA_TO_SLOTS(1), 1);
+    CHECK_EQ(MEI_DATA_TO_SLOTS(4), 1);
+    CHECK_EQ(MEI_DATA_TO_SLOTS(5), 2);
+    CHECK_EQ(MEI_DATA_TO_SLOTS(512), 128);
+    CHECK_EQ(MEI_SLOTS_TO_DATA(128), 512);
+
+    CHECK_EQ(mei_csr_depth(0x80000000), 0x80);
+    CHECK_EQ(mei_csr_filled_slots(0x80000000), 0);
+    CHECK_EQ(mei_csr_filled_slots(0x80100400), 0x0C);
+    // write pointer wrapped past 0xFF, read pointer not yet
+    CHECK_EQ(mei_csr_filled_slots(0x8005FE00), 7);
+}
+
+CORE_CHECK(als_lux_math) {
+    CHECK_EQ(apds9960ClearToLux(0), 0);
+    CHECK_EQ(apds9960ClearToLux(1), 1);
+    CHECK_EQ(apds9960ClearToLux(1000), 1500);
+    CHECK_EQ(apds9960ClearToLux(0xFFFF), 98302);
+}
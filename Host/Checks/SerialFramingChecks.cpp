@@ -0,0 +1,119 @@
+//
+//  SerialFramingChecks.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <string.h>
+
+#include "Check.hpp"
+#include "Reference/SerialFramingVectors.hpp"
+
+CORE_CHECK(crc_check_value) {
+    CHECK_EQ(crc_ccitt_false(CRC_INITIAL, ssh_crc_check_input, sizeof(ssh_crc_check_input)), SSH_CRC_CHECK_VALUE);
+    // split input has to continue where the first part stopped
+    UInt16 crc = crc_ccitt_false(CRC_INITIAL, ssh_crc_check_input, 4);
+    CHECK_EQ(crc_ccitt_false(crc, ssh_crc_check_input+4, sizeof(ssh_crc_check_input)-4), SSH_CRC_CHECK_VALUE);
+}
+
+CORE_CHECK(build_control_frames) {
+    UInt8 buffer[SSH_CONTROL_FRAME_LENGTH];
+
+    CHECK_EQ(sshBuildControlFrame(buffer, SSH_FRAME_TYPE_ACK, 0x05), sizeof(ssh_ack_seq_05));
+    CHECK(!memcmp(buffer, ssh_ack_seq_05, sizeof(ssh_ack_seq_05)));
+    CHECK_EQ(sshBuildControlFrame(buffer, SSH_FRAME_TYPE_NAK, 0x7F), sizeof(ssh_nak_seq_7f));
+    CHECK(!memcmp(buffer, ssh_nak_seq_7f, sizeof(ssh_nak_seq_7f)));
+}
+
+CORE_CHECK(build_commands) {
+    UInt8 buffer[64];
+
+    CHECK_EQ(sshBuildCommand(buffer, true, 0x03, 0x1234, SSH_TC_BAT, SSH_TID_PRIMARY, 0x01, SSH_CID_BAT_BST, nullptr, 0), sizeof(ssh_bat_bst_request));
+    CHECK(!memcmp(buffer, ssh_bat_bst_request, sizeof(ssh_bat_bst_request)));
+
+    CHECK_EQ(sshBuildCommand(buffer, true, 0xFE, 0x0042, SSH_TC_HID, SSH_TID_SECONDARY, 0x01, SSH_CID_HID_GET_DESCRIPTOR,
+                             ssh_hid_descriptor_payload, sizeof(ssh_hid_descriptor_payload)), sizeof(ssh_hid_descriptor_request));
+    CHECK(!memcmp(buffer, ssh_hid_descriptor_request, sizeof(ssh_hid_descriptor_request)));
+}
+
+CORE_CHECK(parse_reference_frames) {
+    UInt8 buffer[64];
+    SerialFrameInfo info;
+
+    memcpy(buffer, ssh_ack_seq_05, sizeof(ssh_ack_seq_05));
+    CHECK_EQ(sshParseFrame(buffer, sizeof(ssh_ack_seq_05), &info), SerialFrameOK);
+    CHECK_EQ(info.type, SSH_FRAME_TYPE_ACK);
+    CHECK_EQ(info.seq_id, 0x05);
+    CHECK(!info.command);
+
+    memcpy(buffer, ssh_nak_seq_7f, sizeof(ssh_nak_seq_7f));
+    CHECK_EQ(sshParseFrame(buffer, sizeof(ssh_nak_seq_7f), &info), SerialFrameOK);
+    CHECK_EQ(info.type, SSH_FRAME_TYPE_NAK);
+
+    memcpy(buffer, ssh_hid_descriptor_request, sizeof(ssh_hid_descriptor_request));
+    CHECK_EQ(sshParseFrame(buffer, sizeof(ssh_hid_descriptor_request), &info), SerialFrameOK);
+    CHECK_EQ(info.type, SSH_FRAME_TYPE_DATA_SEQ);
+    CHECK_EQ(info.seq_id, 0xFE);
+    CHECK(info.command);
+    if (info.command) {
+        CHECK_EQ(info.command->target_category, SSH_TC_HID);
+        CHECK_EQ(info.command->request_id, 0x0042);
+        CHECK_EQ(info.command->command_id, SSH_CID_HID_GET_DESCRIPTOR);
+    }
+    CHECK_EQ(info.data_len, sizeof(ssh_hid_descriptor_payload));
+    CHECK(info.data && !memcmp(info.data, ssh_hid_descriptor_payload, sizeof(ssh_hid_descriptor_payload)));
+}
+
+CORE_CHECK(parse_damaged_frames) {
+    UInt8 buffer[64];
+    SerialFrameInfo info;
+
+    memcpy(buffer, ssh_bat_bst_request, sizeof(ssh_bat_bst_request));
+    CHECK_EQ(sshParseFrame(buffer, SSH_FRAME_OVERHEAD-1, &info), SerialFrameIncomplete);
+    CHECK_EQ(sshParseFrame(buffer, sizeof(ssh_bat_bst_request)-1, &info), SerialFrameBadLength);
+
+    buffer[1] ^= 0xFF;
+    CHECK_EQ(sshParseFrame(buffer, sizeof(ssh_bat_bst_request), &info), SerialFrameBadSyn);
+
+    memcpy(buffer, ssh_bat_bst_request, sizeof(ssh_bat_bst_request));
+    buffer[5] ^= 0x01;      // seq_id, covered by the frame CRC
+    CHECK_EQ(sshParseFrame(buffer, sizeof(ssh_bat_bst_request), &info), SerialFrameBadCRC);
+
+    memcpy(buffer, ssh_bat_bst_request, sizeof(ssh_bat_bst_request));
+    buffer[15] ^= 0x01;     // command_id, covered by the payload CRC
+    CHECK_EQ(sshParseFrame(buffer, sizeof(ssh_bat_bst_request), &info), SerialFrameBadPayloadCRC);
+
+    memcpy(buffer, ssh_ack_seq_05, sizeof(ssh_ack_seq_05));
+    buffer[SSH_PAYLOAD_OFFSET] = 0x00;
+    CHECK_EQ(sshParseFrame(buffer, sizeof(ssh_ack_seq_05), &info), SerialFrameBadACK);
+
+    // well formed frame of a type nobody sends
+    memcpy(buffer, ssh_ack_seq_05, sizeof(ssh_ack_seq_05));
+    buffer[2] = 0x10;
+    UInt16 crc = crc_ccitt_false(CRC_INITIAL, buffer+2, sizeof(SurfaceSerialFrame));
+    memcpy(buffer+2+sizeof(SurfaceSerialFrame), &crc, sizeof(crc));
+    CHECK_EQ(sshParseFrame(buffer, sizeof(ssh_ack_seq_05), &info), SerialFrameUnknownType);
+}
+
+CORE_CHECK(round_trip_payload_sizes) {
+    UInt8 payload[255];
+    UInt8 buffer[SSH_COMMAND_LENGTH(sizeof(payload))];
+    SerialFrameInfo info;
+
+    for (UInt16 i = 0; i < sizeof(payload); i++)
+        payload[i] = static_cast<UInt8>(i * 7 + 3);
+    for (UInt16 len = 0; len <= sizeof(payload); len++) {
+        UInt16 frame_len = sshBuildCommand(buffer, len & 1, static_cast<UInt8>(len), len, SSH_TC_SAM, SSH_TID_PRIMARY, 0x00, 0x13, payload, len);
+        CHECK_EQ(frame_len, SSH_COMMAND_LENGTH(len));
+        CHECK_EQ(sshParseFrame(buffer, frame_len, &info), SerialFrameOK);
+        CHECK_EQ(info.data_len, len);
+        CHECK_EQ(info.seq_id, static_cast<UInt8>(len));
+    }
+}
+
+CORE_CHECK(status_strings) {
+    for (int status = SerialFrameOK; status <= SerialFrameUnknownType; status++)
+        CHECK(sshFrameStatusString(static_cast<SerialFrameStatus>(status)));
+    CHECK(!strcmp(sshFrameStatusString(static_cast<SerialFrameStatus>(SerialFrameUnknownType+1)), "unknown"));
+}
@@ -0,0 +1,381 @@
+//
+//  MEIEmulator.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <string.h>
+
+#include "MEIEmulator.hpp"
+#include "SurfaceManagementEngine/IPTSProtocol.h"
+
+// same bytes as SURFACE_IPTS_CLIENT_UUID in the driver
+static const uuid_t ipts_client_uuid = {
+    0x70, 0x08, 0x8d, 0x3e, 0x1a, 0x27, 0x08, 0x42, 0x8e, 0xb5, 0x9a, 0xcb, 0x94, 0x02, 0xae, 0x04,
+};
+
+#define MEI_EMULATOR_OUTBOX_LIMIT   2   // streamed messages queued ahead of the ME buffer
+
+MEIEmulator::MEIEmulator(const MEIEmulatorConfig &config) : config(config) {
+    me_ready = true;
+}
+
+void MEIEmulator::fillStreamPayload(UInt8 *buffer, UInt16 len, UInt32 seq) {
+    UInt16 i = 0;
+    for (; i < len && i < sizeof(seq); i++)
+        buffer[i] = static_cast<UInt8>(seq >> (8 * i));
+    for (; i < len; i++)
+        buffer[i] = static_cast<UInt8>(seq * 31 + i);
+}
+
+UInt32 MEIEmulator::read(int offset) {
+    stats.register_accesses++;
+    switch (offset) {
+        case MEI_H_CSR:
+            return (static_cast<UInt32>(config.host_depth) << 24) | (host_buf.wp << 16) | (host_buf.rp << 8) | host_ctl | host_sta;
+        case MEI_ME_CSR:
+            return (static_cast<UInt32>(config.me_depth) << 24) | (me_buf.wp << 16) | (me_buf.rp << 8) |
+                (me_ready ? MEI_ME_CSR_READY : 0) | (me_reset ? MEI_ME_CSR_RESET : 0) | MEI_ME_CSR_POWER_GATE_ISO_CAP;
+        case MEI_ME_CB_RW:
+            if (!me_buf.filled()) {
+                stats.underflows++;
+                return 0;
+            }
+            stats.me_slots++;
+            return me_buf.slots[me_buf.rp++];
+        case MEI_H_D0I3C:
+            return d0i3c;
+        default:
+            return 0;
+    }
+}
+
+void MEIEmulator::write(UInt32 value, int offset) {
+    UInt32 old_ctl;
+    bool enter;
+
+    stats.register_accesses++;
+    switch (offset) {
+        case MEI_H_CB_WW:
+            if (host_buf.filled() >= config.host_depth) {
+                stats.overflows++;
+                break;
+            }
+            host_buf.slots[host_buf.wp++] = value;
+            break;
+        case MEI_H_CSR:
+            host_sta &= ~(value & MEI_H_CSR_INT_STA_MASK);
+            old_ctl = host_ctl;
+            host_ctl = value & (MEI_H_CSR_INT_ENABLE_MASK | MEI_H_CSR_READY | MEI_H_CSR_RESET);
+            if ((host_ctl & MEI_H_CSR_RESET) && !(old_ctl & MEI_H_CSR_RESET))
+                resetLink();
+            if (value & MEI_H_CSR_INT_GEN)
+                hostInterrupt();
+            break;
+        case MEI_H_D0I3C:
+            enter = value & MEI_H_D0I3C_I3;
+            if (enter == !!(d0i3c & MEI_H_D0I3C_I3))
+                break;
+            d0i3c = (d0i3c & MEI_H_D0I3C_CIP) | (value & (MEI_H_D0I3C_I3 | MEI_H_D0I3C_IR));
+            if (enter)
+                stats.d0i3_entries++;
+            else
+                stats.d0i3_exits++;
+            // with interrupt request set the host reads CIP back and waits for the d0i3 interrupt
+            if ((value & MEI_H_D0I3C_IR) && config.d0i3_async) {
+                d0i3c |= MEI_H_D0I3C_CIP;
+                d0i3_pending = true;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void MEIEmulator::step() {
+    if (d0i3_pending) {
+        d0i3_pending = false;
+        d0i3c &= ~MEI_H_D0I3C_CIP;
+        raise(MEI_H_CSR_D0I3C_INT_STA);
+    }
+    if (!me_ready || !(host_ctl & MEI_H_CSR_READY))
+        return;
+
+    if (d0i3c & MEI_H_D0I3C_I3) {
+        // data waiting while gated, interrupt so the host brings the link back up
+        if (!outbox.empty() || (connected && me_credits && (streaming || !client_outbox.empty()))) {
+            if (!(host_sta & MEI_H_CSR_INT_STA))
+                stats.wake_requests++;
+            raise(MEI_H_CSR_INT_STA);
+        }
+        return;
+    }
+    sendClientTraffic();
+    flushOutbox();
+}
+
+void MEIEmulator::injectReset() {
+    stats.me_resets++;
+    me_ready = false;
+    me_reset = true;
+    host_buf = Ring();
+    me_buf = Ring();
+    outbox.clear();
+    client_outbox.clear();
+    started = connected = streaming = false;
+    me_credits = host_credits = 0;
+    raise(MEI_H_CSR_INT_STA);
+}
+
+void MEIEmulator::resetLink() {
+    // firmware restarts right away and comes back ready while the host holds reset
+    stats.host_resets++;
+    host_ctl &= ~MEI_H_CSR_READY;
+    host_buf = Ring();
+    me_buf = Ring();
+    outbox.clear();
+    client_outbox.clear();
+    started = connected = streaming = false;
+    me_credits = host_credits = 0;
+    d0i3c = 0;
+    d0i3_pending = false;
+    me_reset = false;
+    me_ready = true;
+    raise(MEI_H_CSR_INT_STA);
+}
+
+void MEIEmulator::hostInterrupt() {
+    if (!me_ready || (host_ctl & MEI_H_CSR_RESET))
+        return;
+    if (d0i3c & MEI_H_D0I3C_I3) {
+        if (host_buf.filled())
+            stats.protocol_errors++;
+        return;
+    }
+    consumeHostBuffer();
+    sendClientTraffic();
+    flushOutbox();
+}
+
+void MEIEmulator::consumeHostBuffer() {
+    UInt8 msg[MEI_SLOTS_TO_DATA(256)];
+
+    while (host_buf.filled()) {
+        UInt32 hdr_slot = host_buf.slots[host_buf.rp];
+        MEIBusMessageHeader hdr;
+        memcpy(&hdr, &hdr_slot, sizeof(hdr));
+        UInt8 slots = 1 + MEI_DATA_TO_SLOTS(hdr.length);
+        if (!hdr_slot || hdr.reserved || host_buf.filled() < slots) {
+            // the host always writes whole messages before raising the interrupt
+            stats.protocol_errors++;
+            host_buf.rp = host_buf.wp;
+            return;
+        }
+        host_buf.rp++;
+        for (UInt8 i = 1; i < slots; i++)
+            memcpy(msg + MEI_SLOTS_TO_DATA(i - 1), &host_buf.slots[host_buf.rp++], MEI_SLOT_SIZE);
+        stats.host_messages++;
+        stats.host_slots += slots;
+
+        if (!hdr.me_addr && !hdr.host_addr)
+            handleBusMessage(msg, hdr.length);
+        else if (connected && hdr.me_addr == MEI_EMULATOR_IPTS_ADDR && hdr.host_addr == host_addr)
+            handleClientMessage(msg, hdr.length);
+        else
+            stats.protocol_errors++;
+    }
+}
+
+void MEIEmulator::handleBusMessage(const UInt8 *msg, UInt16 len) {
+    if (!len) {
+        stats.protocol_errors++;
+        return;
+    }
+
+    switch (msg[0]) {
+        case MEI_HOST_START_REQ_CMD: {
+            MEIBusHostVersionResponse res {};
+            res.cmd = MEI_HOST_START_RES_CMD;
+            res.host_version_supported = 1;
+            res.me_max_version_minor = MEI_HBM_MINOR_VERSION;
+            res.me_max_version_major = MEI_HBM_MAJOR_VERSION;
+            started = true;
+            post(0, 0, &res, sizeof(res));
+            break;
+        }
+        case MEI_HOST_STOP_REQ_CMD: {
+            MEIBusHostStopResponse res {};
+            res.cmd = MEI_HOST_STOP_RES_CMD;
+            started = connected = streaming = false;
+            post(0, 0, &res, sizeof(res));
+            break;
+        }
+        case MEI_CAPABILITIES_REQ_CMD: {
+            MEIBusCapabilityResponse res {};
+            res.cmd = MEI_CAPABILITIES_RES_CMD;
+            post(0, 0, &res, sizeof(res));
+            break;
+        }
+        case MEI_HOST_ENUM_REQ_CMD: {
+            if (!started) {
+                stats.protocol_errors++;
+                break;
+            }
+            MEIBusHostEnumerationResponse res {};
+            res.cmd = MEI_HOST_ENUM_RES_CMD;
+            res.valid_addresses[MEI_EMULATOR_IPTS_ADDR / 8] = BIT(MEI_EMULATOR_IPTS_ADDR % 8);
+            post(0, 0, &res, sizeof(res));
+            break;
+        }
+        case MEI_HOST_CLIENT_PROP_REQ_CMD: {
+            const MEIBusClientPropertyRequest *req = reinterpret_cast<const MEIBusClientPropertyRequest *>(msg);
+            MEIBusClientPropertyResponse res {};
+            res.cmd = MEI_HOST_CLIENT_PROP_RES_CMD;
+            res.me_addr = req->me_addr;
+            if (req->me_addr == MEI_EMULATOR_IPTS_ADDR) {
+                res.status = MEIHostBusMessageReturnSuccess;
+                memcpy(res.client_properties.uuid, ipts_client_uuid, sizeof(uuid_t));
+                res.client_properties.protocol_version = 1;
+                res.client_properties.max_connection_num = 1;
+                res.client_properties.max_msg_length = config.max_msg_length;
+            } else
+                res.status = MEIHostBusMessageReturnClientNotFound;
+            post(0, 0, &res, sizeof(res));
+            break;
+        }
+        case MEI_CLIENT_CONNECT_REQ_CMD: {
+            const MEIBusClientConnectionRequest *req = reinterpret_cast<const MEIBusClientConnectionRequest *>(msg);
+            MEIBusClientConnectionResponse res {};
+            res.cmd = MEI_CLIENT_CONNECT_RES_CMD;
+            res.me_addr = req->me_addr;
+            res.host_addr = req->host_addr;
+            if (req->me_addr != MEI_EMULATOR_IPTS_ADDR)
+                res.status = MEIClientConnectionNotFound;
+            else if (connected)
+                res.status = MEIClientConnectionAlreadyStarted;
+            else
+                res.status = MEIClientConnectionSuccess;
+            post(0, 0, &res, sizeof(res));
+            if (res.status != MEIClientConnectionSuccess)
+                break;
+
+            // a fresh connection may send one message before the next credit
+            connected = true;
+            host_addr = req->host_addr;
+            me_credits = 0;
+            host_credits = 1;
+            MEIBusFlowControl fc {};
+            fc.cmd = MEI_FLOW_CONTROL_CMD;
+            fc.me_addr = MEI_EMULATOR_IPTS_ADDR;
+            fc.host_addr = host_addr;
+            post(0, 0, &fc, sizeof(fc));
+            break;
+        }
+        case MEI_CLIENT_DISCONNECT_REQ_CMD: {
+            const MEIBusClientConnectionRequest *req = reinterpret_cast<const MEIBusClientConnectionRequest *>(msg);
+            MEIBusClientConnectionResponse res {};
+            res.cmd = MEI_CLIENT_DISCONNECT_RES_CMD;
+            res.me_addr = req->me_addr;
+            res.host_addr = req->host_addr;
+            res.status = connected ? MEIClientConnectionSuccess : MEIClientConnectionNotFound;
+            connected = streaming = false;
+            client_outbox.clear();
+            post(0, 0, &res, sizeof(res));
+            break;
+        }
+        case MEI_FLOW_CONTROL_CMD: {
+            const MEIBusFlowControl *fc = reinterpret_cast<const MEIBusFlowControl *>(msg);
+            if (!connected || fc->me_addr != MEI_EMULATOR_IPTS_ADDR || fc->host_addr != host_addr) {
+                stats.protocol_errors++;
+                break;
+            }
+            me_credits++;
+            break;
+        }
+        case MEI_PG_ISOLATION_ENTRY_REQ_CMD: {
+            MEIBusPowerGatingResponse res {};
+            res.cmd = MEI_PG_ISOLATION_ENTRY_RES_CMD;
+            post(0, 0, &res, sizeof(res));
+            break;
+        }
+        default:
+            stats.protocol_errors++;
+            break;
+    }
+}
+
+void MEIEmulator::handleClientMessage(const UInt8 *msg, UInt16 len) {
+    if (!host_credits || len < sizeof(UInt32)) {
+        stats.protocol_errors++;
+        return;
+    }
+    host_credits--;
+
+    UInt32 code;
+    memcpy(&code, msg, sizeof(code));
+    if (code == IPTS_CMD_READY_FOR_DATA)
+        streaming = true;
+    else if (code == IPTS_CMD_QUIESCE_IO)
+        streaming = false;
+
+    UInt32 rsp[2] = {IPTS_RSP(code), IPTS_STATUS_SUCCESS};
+    client_outbox.emplace_back(reinterpret_cast<UInt8 *>(rsp), reinterpret_cast<UInt8 *>(rsp) + sizeof(rsp));
+
+    // ready for the next command
+    host_credits++;
+    MEIBusFlowControl fc {};
+    fc.cmd = MEI_FLOW_CONTROL_CMD;
+    fc.me_addr = MEI_EMULATOR_IPTS_ADDR;
+    fc.host_addr = host_addr;
+    post(0, 0, &fc, sizeof(fc));
+}
+
+void MEIEmulator::post(UInt8 me_addr, UInt8 to_host_addr, const void *msg, UInt16 len) {
+    MEIBusMessageHeader hdr {};
+    hdr.me_addr = me_addr;
+    hdr.host_addr = to_host_addr;
+    hdr.length = len;
+    hdr.msg_complete = 1;
+
+    std::vector<UInt32> slots(1 + MEI_DATA_TO_SLOTS(len), 0);
+    memcpy(&slots[0], &hdr, sizeof(hdr));
+    if (len)
+        memcpy(&slots[1], msg, len);
+    outbox.push_back(std::move(slots));
+}
+
+void MEIEmulator::sendClientTraffic() {
+    std::vector<UInt8> payload;
+
+    while (connected && me_credits) {
+        if (!client_outbox.empty()) {
+            payload = std::move(client_outbox.front());
+            client_outbox.pop_front();
+        } else if (streaming && outbox.size() < MEI_EMULATOR_OUTBOX_LIMIT) {
+            payload.resize(config.stream_len);
+            fillStreamPayload(payload.data(), config.stream_len, stream_seq++);
+            stats.stream_messages++;
+        } else
+            break;
+        me_credits--;
+        post(MEI_EMULATOR_IPTS_ADDR, host_addr, payload.data(), static_cast<UInt16>(payload.size()));
+    }
+}
+
+void MEIEmulator::flushOutbox() {
+    bool posted = false;
+
+    while (!outbox.empty()) {
+        const std::vector<UInt32> &slots = outbox.front();
+        if (config.me_depth - me_buf.filled() < static_cast<int>(slots.size()))
+            break;
+        for (UInt32 slot : slots)
+            me_buf.slots[me_buf.wp++] = slot;
+        stats.me_messages++;
+        outbox.pop_front();
+        posted = true;
+    }
+    if (posted)
+        raise(MEI_H_CSR_INT_STA);
+}
@@ -0,0 +1,123 @@
+//
+//  MEIEmulator.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef MEIEmulator_hpp
+#define MEIEmulator_hpp
+
+#include <deque>
+#include <vector>
+
+#include "SurfaceManagementEngine/MEIProtocol.h"
+#include "SurfaceManagementEngine/MEIRegisterInterface.hpp"
+
+/*
+ * Register level stand-in for the ME behind MEIRegisterInterface. It keeps
+ * both circular buffers with 8 bit wrapping pointers, answers the host bus
+ * messages the driver sends during bring-up, follows d0i3 through
+ * MEI_H_D0I3C and runs one IPTS like client that streams payloads while the
+ * host grants flow control credit. Nothing runs on its own, step() stands
+ * for the firmware making progress between host accesses.
+ */
+#define MEI_EMULATOR_IPTS_ADDR      5
+
+struct MEIEmulatorConfig {
+    UInt8   host_depth {128};           // slots in the host buffer
+    UInt8   me_depth {128};             // slots in the ME buffer
+    UInt16  stream_len {256};           // bytes per streamed client message
+    UInt32  max_msg_length {4096};      // advertised in the client properties
+    bool    d0i3_async {true};          // d0i3 completes with an interrupt on the next step
+};
+
+struct MEIEmulatorStats {
+    UInt64  register_accesses;
+    UInt64  host_messages;
+    UInt64  host_slots;
+    UInt64  me_messages;
+    UInt64  me_slots;
+    UInt64  stream_messages;
+    UInt64  host_resets;
+    UInt64  me_resets;
+    UInt64  d0i3_entries;
+    UInt64  d0i3_exits;
+    UInt64  wake_requests;
+    UInt64  protocol_errors;            // malformed or unexpected traffic from the host
+    UInt64  overflows;                  // host wrote a full buffer
+    UInt64  underflows;                 // host read an empty buffer
+};
+
+class MEIEmulator : public MEIRegisterInterface {
+public:
+    explicit MEIEmulator(const MEIEmulatorConfig &config = MEIEmulatorConfig());
+
+    UInt32 read(int offset) override;
+
+    void write(UInt32 value, int offset) override;
+
+    void step();
+
+    // firmware error, the ME drops ready and waits for the host to reset the link
+    void injectReset();
+
+    bool isStreaming() const { return streaming; }
+
+    const MEIEmulatorStats &getStats() const { return stats; }
+
+    // payload of streamed message seq, the host checks what it receives against it
+    static void fillStreamPayload(UInt8 *buffer, UInt16 len, UInt32 seq);
+
+private:
+    struct Ring {
+        UInt32  slots[256];
+        UInt8   rp {0};
+        UInt8   wp {0};
+
+        UInt8 filled() const { return wp - rp; }
+    };
+
+    MEIEmulatorConfig   config;
+    MEIEmulatorStats    stats {};
+
+    UInt32  host_ctl {0};               // enable, ready and reset bits as last written
+    UInt32  host_sta {0};               // interrupt status, write one to clear
+    UInt32  d0i3c {0};
+    bool    d0i3_pending {false};
+    bool    me_ready {false};
+    bool    me_reset {false};
+    Ring    host_buf;
+    Ring    me_buf;
+
+    std::deque<std::vector<UInt32>> outbox;         // waiting for room in the ME buffer
+    std::deque<std::vector<UInt8>>  client_outbox;  // waiting for flow control credit
+
+    bool    started {false};
+    bool    connected {false};
+    UInt8   host_addr {0};
+    UInt32  me_credits {0};             // client messages the host can take
+    UInt32  host_credits {0};           // client messages the ME can take
+    bool    streaming {false};
+    UInt32  stream_seq {0};
+
+    void raise(UInt32 status) { host_sta |= status; }
+
+    void resetLink();
+
+    void hostInterrupt();
+
+    void consumeHostBuffer();
+
+    void handleBusMessage(const UInt8 *msg, UInt16 len);
+
+    void handleClientMessage(const UInt8 *msg, UInt16 len);
+
+    void post(UInt8 me_addr, UInt8 to_host_addr, const void *msg, UInt16 len);
+
+    void sendClientTraffic();
+
+    void flushOutbox();
+};
+
+#endif /* MEIEmulator_hpp */
@@ -0,0 +1,136 @@
+//
+//  MEIEmulatorMain.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "MEIHostModel.hpp"
+
+/*
+ * Streams client messages from the emulated ME to the host model and
+ * reports what the link costs:
+ *
+ *   MEIEmulatorRun [--messages N] [--msg-len BYTES] [--d0i3-every N] [--reset-every N]
+ *
+ * d0i3 cycles alternate between a quiesced gate and one the ME has to wake
+ * the host from. Resets are injected on the firmware side, the host has to
+ * notice and bring the link back. Exits non-zero when a message went missing
+ * outside a reset, a payload did not match or the link did not recover.
+ */
+struct RunOptions {
+    UInt64  messages {100000};
+    UInt16  msg_len {256};
+    UInt64  d0i3_every {0};
+    UInt64  reset_every {0};
+};
+
+static bool parseOptions(int argc, char **argv, RunOptions &options) {
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc)
+            return false;
+        unsigned long long value = strtoull(argv[++i], nullptr, 0);
+        if (!strcmp(argv[i - 1], "--messages"))
+            options.messages = value;
+        else if (!strcmp(argv[i - 1], "--msg-len"))
+            options.msg_len = static_cast<UInt16>(value);
+        else if (!strcmp(argv[i - 1], "--d0i3-every"))
+            options.d0i3_every = value;
+        else if (!strcmp(argv[i - 1], "--reset-every"))
+            options.reset_every = value;
+        else
+            return false;
+    }
+    // has to hold the sequence number and fit the ME buffer next to its header
+    return options.msg_len >= sizeof(UInt32) && options.msg_len <= MEI_SLOTS_TO_DATA(MEIEmulatorConfig().me_depth - 1) && options.messages;
+}
+
+static double perMessage(UInt64 value, UInt64 messages) {
+    return messages ? static_cast<double>(value) / messages : 0;
+}
+
+int main(int argc, char **argv) {
+    RunOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "usage: %s [--messages N] [--msg-len 4..508] [--d0i3-every N] [--reset-every N]\n", argv[0]);
+        return 2;
+    }
+
+    MEIEmulatorConfig config;
+    config.stream_len = options.msg_len;
+    MEIEmulator emu(config);
+    MEIHostModel host(emu, options.msg_len);
+
+    if (!host.start()) {
+        fprintf(stderr, "link bring-up failed\n");
+        return 1;
+    }
+
+    const MEIHostModelStats &stats = host.getStats();
+    UInt64 accesses = emu.getStats().register_accesses;
+    UInt64 next_d0i3 = options.d0i3_every;
+    UInt64 next_reset = options.reset_every;
+    UInt64 d0i3_cycles = 0;
+    UInt64 last_received = 0;
+    UInt32 idle_polls = 0;
+    bool ok = true;
+
+    auto begin = std::chrono::steady_clock::now();
+    while (stats.stream_messages < options.messages) {
+        if (!host.poll()) {
+            ok = false;
+            break;
+        }
+        if (stats.stream_messages != last_received) {
+            last_received = stats.stream_messages;
+            idle_polls = 0;
+        } else if (++idle_polls > MEI_HOST_MODEL_MAX_STEPS) {
+            fprintf(stderr, "stream stalled after %llu messages\n", static_cast<unsigned long long>(last_received));
+            ok = false;
+            break;
+        }
+        if (next_reset && stats.stream_messages >= next_reset) {
+            next_reset += options.reset_every;
+            emu.injectReset();
+        }
+        if (next_d0i3 && stats.stream_messages >= next_d0i3) {
+            next_d0i3 += options.d0i3_every;
+            if (!host.cycleD0i3(!(d0i3_cycles++ & 1))) {
+                ok = false;
+                break;
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    accesses = emu.getStats().register_accesses - accesses;
+
+    const MEIEmulatorStats &me = emu.getStats();
+    printf("messages           %llu x %u bytes\n", static_cast<unsigned long long>(stats.stream_messages), options.msg_len);
+    printf("throughput         %.1f MB/s, %.0f msg/s\n", seconds > 0 ? stats.stream_bytes / seconds / 1e6 : 0, seconds > 0 ? stats.stream_messages / seconds : 0);
+    printf("slots per message  %.2f\n", perMessage(stats.stream_slots, stats.stream_messages));
+    printf("accesses per msg   %.2f\n", perMessage(accesses, stats.stream_messages));
+    printf("interrupts         %llu\n", static_cast<unsigned long long>(stats.interrupts));
+    printf("flow control       %llu\n", static_cast<unsigned long long>(stats.flow_control_sent));
+    printf("d0i3 cycles        %llu, %llu woken by the ME, mean %.1f us\n", static_cast<unsigned long long>(stats.d0i3_cycles), static_cast<unsigned long long>(stats.d0i3_wakes), perMessage(stats.d0i3_ns, stats.d0i3_cycles) / 1e3);
+    printf("resets             %llu, recovery mean %.1f us max %.1f us, %.0f accesses\n", static_cast<unsigned long long>(stats.resets), perMessage(stats.recovery_ns, stats.resets) / 1e3, stats.recovery_ns_max / 1e3, perMessage(stats.recovery_accesses, stats.resets));
+    printf("lost in resets     %llu\n", static_cast<unsigned long long>(stats.lost_messages));
+    printf("errors             payload %llu, write %llu, timeout %llu, reset %llu, d0i3 %llu, firmware %llu, overflow %llu, underflow %llu\n",
+           static_cast<unsigned long long>(stats.payload_errors), static_cast<unsigned long long>(stats.write_errors),
+           static_cast<unsigned long long>(stats.timeouts), static_cast<unsigned long long>(stats.reset_failures),
+           static_cast<unsigned long long>(stats.d0i3_failures), static_cast<unsigned long long>(me.protocol_errors),
+           static_cast<unsigned long long>(me.overflows), static_cast<unsigned long long>(me.underflows));
+
+    if (stats.payload_errors || stats.write_errors || stats.timeouts || stats.reset_failures || stats.d0i3_failures ||
+        me.protocol_errors || me.overflows || me.underflows)
+        ok = false;
+    // a message may only go missing when the ME was reset under it
+    if (stats.lost_messages && !stats.resets)
+        ok = false;
+    return ok ? 0 : 1;
+}
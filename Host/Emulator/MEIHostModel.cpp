@@ -0,0 +1,330 @@
+//
+//  MEIHostModel.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <string.h>
+
+#include <chrono>
+
+#include "MEIHostModel.hpp"
+#include "SurfaceManagementEngine/IPTSProtocol.h"
+#include "SurfaceManagementEngine/MEISlotTransport.hpp"
+
+static UInt64 nowNs() {
+    return static_cast<UInt64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+MEIHostModel::MEIHostModel(MEIEmulator &emu, UInt16 stream_len) : emu(emu), regs(&emu), stream_len(stream_len) {}
+
+template <typename Condition>
+bool MEIHostModel::waitFor(Condition done) {
+    for (UInt32 i = 0; i < MEI_HOST_MODEL_MAX_STEPS; i++) {
+        service();
+        if (done())
+            return true;
+        if (reset_requested)
+            return false;
+        emu.step();
+    }
+    stats.timeouts++;
+    return false;
+}
+
+void MEIHostModel::service() {
+    UInt32 hcsr = regs->read(MEI_H_CSR);
+    if (!(hcsr & MEI_H_CSR_INT_STA_MASK))
+        return;
+    stats.interrupts++;
+    regs->write(hcsr, MEI_H_CSR);
+
+    if (hcsr & MEI_H_CSR_D0I3C_INT_STA)
+        d0i3_done = true;
+    if (!(regs->read(MEI_ME_CSR) & MEI_ME_CSR_READY)) {
+        reset_requested = true;
+        return;
+    }
+    // link still coming up or gated, nothing may be read
+    if (!(hcsr & MEI_H_CSR_READY))
+        return;
+    if (gated) {
+        if (hcsr & MEI_H_CSR_INT_STA)
+            wake_requested = true;
+        return;
+    }
+
+    readPending();
+}
+
+void MEIHostModel::readPending() {
+    // only what was there when the interrupt came in, a streaming ME would keep the loop going
+    UInt8 filled_slots;
+    if (meiMEFilledSlots(regs, &filled_slots) != MEISlotOK) {
+        reset_requested = true;
+        return;
+    }
+    while (filled_slots) {
+        if (!readMessage(&filled_slots))
+            return;
+    }
+}
+
+bool MEIHostModel::readMessage(UInt8 *filled_slots) {
+    UInt32 hdr_slot = regs->read(MEI_ME_CB_RW);
+    MEIBusMessageHeader hdr;
+    memcpy(&hdr, &hdr_slot, sizeof(hdr));
+    if (!hdr_slot || hdr.reserved || MEI_DATA_TO_SLOTS(hdr.length) >= *filled_slots) {
+        reset_requested = true;
+        return false;
+    }
+    meiReadSlots(regs, rx_buf, hdr.length);
+
+    if (!hdr.me_addr && !hdr.host_addr) {
+        const MEIBusFlowControl *fc = reinterpret_cast<const MEIBusFlowControl *>(rx_buf);
+        if (fc->cmd == MEI_FLOW_CONTROL_CMD) {
+            if (connected && fc->me_addr == ipts_addr && fc->host_addr == MEI_HOST_MODEL_HOST_ADDR)
+                host_credits++;
+        } else {
+            // the first credit follows the connect response, possibly in the same interrupt
+            if (fc->cmd == MEI_CLIENT_CONNECT_RES_CMD)
+                connected = reinterpret_cast<const MEIBusClientConnectionResponse *>(rx_buf)->status == MEIClientConnectionSuccess;
+            memcpy(bus_msg, rx_buf, hdr.length < sizeof(bus_msg) ? hdr.length : static_cast<UInt16>(sizeof(bus_msg)));
+            bus_pending = true;
+        }
+    } else if (connected && hdr.me_addr == ipts_addr && hdr.host_addr == MEI_HOST_MODEL_HOST_ADDR) {
+        handleClientMessage(hdr.length);
+    } else
+        stats.payload_errors++;
+
+    *filled_slots -= 1 + MEI_DATA_TO_SLOTS(hdr.length);
+    return true;
+}
+
+void MEIHostModel::handleClientMessage(UInt16 len) {
+    UInt32 code;
+    memcpy(&code, rx_buf, sizeof(code));
+    if (len == 2 * sizeof(UInt32) && (code & IPTS_RSP_BIT)) {
+        rsp_code = code;
+        rsp_pending = true;
+    } else if (len != stream_len) {
+        stats.payload_errors++;
+    } else {
+        UInt32 seq = code;
+        if (have_seq && seq != next_seq) {
+            if (seq > next_seq)
+                stats.lost_messages += seq - next_seq;
+            else
+                stats.payload_errors++;
+        }
+        MEIEmulator::fillStreamPayload(expected, len, seq);
+        if (memcmp(rx_buf, expected, len))
+            stats.payload_errors++;
+        have_seq = true;
+        next_seq = seq + 1;
+        stats.stream_messages++;
+        stats.stream_bytes += len;
+        stats.stream_slots += 1 + MEI_DATA_TO_SLOTS(len);
+    }
+    // one receive buffer, hand it back for the next message
+    sendFlowControl();
+}
+
+bool MEIHostModel::sendMessage(UInt8 me_addr, UInt8 host_addr, const void *msg, UInt16 len) {
+    MEIBusMessageHeader hdr {};
+    hdr.me_addr = me_addr;
+    hdr.host_addr = host_addr;
+    hdr.length = len;
+    hdr.msg_complete = 1;
+
+    if (meiWriteSlots(regs, tx_depth, reinterpret_cast<const UInt8 *>(&hdr), sizeof(hdr), static_cast<const UInt8 *>(msg), len) != MEISlotOK) {
+        stats.write_errors++;
+        return false;
+    }
+    return true;
+}
+
+bool MEIHostModel::sendFlowControl() {
+    MEIBusFlowControl fc {};
+    fc.cmd = MEI_FLOW_CONTROL_CMD;
+    fc.me_addr = ipts_addr;
+    fc.host_addr = MEI_HOST_MODEL_HOST_ADDR;
+    if (!sendMessage(0, 0, &fc, sizeof(fc)))
+        return false;
+    stats.flow_control_sent++;
+    return true;
+}
+
+bool MEIHostModel::sendBusRequest(const void *msg, UInt16 len, UInt8 response_cmd) {
+    bus_pending = false;
+    if (!sendMessage(0, 0, msg, len))
+        return false;
+    return waitFor([&] { return bus_pending && bus_msg[0] == response_cmd; });
+}
+
+bool MEIHostModel::sendClientCommand(UInt32 code) {
+    UInt32 cmd[2] = {code, 0};
+
+    if (!waitFor([&] { return host_credits > 0; }))
+        return false;
+    host_credits--;
+    rsp_pending = false;
+    if (!sendMessage(ipts_addr, MEI_HOST_MODEL_HOST_ADDR, cmd, sizeof(cmd)))
+        return false;
+    return waitFor([&] { return rsp_pending && rsp_code == IPTS_RSP(code); });
+}
+
+bool MEIHostModel::resetLink() {
+    UInt32 hcsr = regs->read(MEI_H_CSR);
+    if (hcsr & MEI_H_CSR_RESET) {
+        hcsr &= ~MEI_H_CSR_RESET;
+        meiSetHostCSR(regs, hcsr);
+        hcsr = regs->read(MEI_H_CSR);
+    }
+    hcsr |= MEI_H_CSR_RESET | MEI_H_CSR_INT_GEN | MEI_H_CSR_INT_STA_MASK;
+    regs->write(hcsr, MEI_H_CSR);
+
+    reset_requested = false;
+    if (!waitFor([&] { return (regs->read(MEI_ME_CSR) & MEI_ME_CSR_READY) != 0; }))
+        return false;
+
+    // dereset, then tell the ME the host is ready
+    hcsr = regs->read(MEI_H_CSR);
+    hcsr |= MEI_H_CSR_INT_GEN;
+    hcsr &= ~MEI_H_CSR_RESET;
+    meiSetHostCSR(regs, hcsr);
+    hcsr = regs->read(MEI_H_CSR);
+    hcsr |= MEI_H_CSR_INT_ENABLE_MASK | MEI_H_CSR_INT_GEN | MEI_H_CSR_READY;
+    meiSetHostCSR(regs, hcsr);
+
+    tx_depth = mei_csr_depth(regs->read(MEI_H_CSR));
+    return true;
+}
+
+bool MEIHostModel::start() {
+    connected = gated = false;
+    host_credits = 0;
+    if (!resetLink())
+        return false;
+
+    MEIBusHostVersionRequest start_req {};
+    start_req.cmd = MEI_HOST_START_REQ_CMD;
+    start_req.host_version_minor = MEI_HBM_MINOR_VERSION;
+    start_req.host_version_major = MEI_HBM_MAJOR_VERSION;
+    if (!sendBusRequest(&start_req, sizeof(start_req), MEI_HOST_START_RES_CMD))
+        return false;
+    if (!reinterpret_cast<MEIBusHostVersionResponse *>(bus_msg)->host_version_supported)
+        return false;
+
+    MEIBusHostEnumerationRequest enum_req {};
+    enum_req.cmd = MEI_HOST_ENUM_REQ_CMD;
+    if (!sendBusRequest(&enum_req, sizeof(enum_req), MEI_HOST_ENUM_RES_CMD))
+        return false;
+    const MEIBusHostEnumerationResponse *enum_res = reinterpret_cast<MEIBusHostEnumerationResponse *>(bus_msg);
+    ipts_addr = 0;
+    for (UInt32 addr = 1; addr < MEI_MAX_CLIENT_NUM && !ipts_addr; addr++) {
+        if (enum_res->valid_addresses[addr / 8] & BIT(addr % 8))
+            ipts_addr = static_cast<UInt8>(addr);
+    }
+    if (!ipts_addr)
+        return false;
+
+    MEIBusClientPropertyRequest prop_req {};
+    prop_req.cmd = MEI_HOST_CLIENT_PROP_REQ_CMD;
+    prop_req.me_addr = ipts_addr;
+    if (!sendBusRequest(&prop_req, sizeof(prop_req), MEI_HOST_CLIENT_PROP_RES_CMD))
+        return false;
+    const MEIBusClientPropertyResponse *prop_res = reinterpret_cast<MEIBusClientPropertyResponse *>(bus_msg);
+    if (prop_res->status != MEIHostBusMessageReturnSuccess || prop_res->client_properties.max_msg_length < stream_len)
+        return false;
+
+    MEIBusClientConnectionRequest connect_req {};
+    connect_req.cmd = MEI_CLIENT_CONNECT_REQ_CMD;
+    connect_req.me_addr = ipts_addr;
+    connect_req.host_addr = MEI_HOST_MODEL_HOST_ADDR;
+    if (!sendBusRequest(&connect_req, sizeof(connect_req), MEI_CLIENT_CONNECT_RES_CMD))
+        return false;
+    if (!connected)
+        return false;
+
+    if (!sendFlowControl())
+        return false;
+    return sendClientCommand(IPTS_CMD_READY_FOR_DATA);
+}
+
+bool MEIHostModel::poll() {
+    emu.step();
+    service();
+    if (!reset_requested)
+        return true;
+
+    stats.resets++;
+    UInt64 begin = nowNs();
+    UInt64 accesses = emu.getStats().register_accesses;
+    if (!start()) {
+        stats.reset_failures++;
+        return false;
+    }
+    UInt64 elapsed = nowNs() - begin;
+    stats.recovery_ns += elapsed;
+    if (elapsed > stats.recovery_ns_max)
+        stats.recovery_ns_max = elapsed;
+    stats.recovery_accesses += emu.getStats().register_accesses - accesses;
+    return true;
+}
+
+bool MEIHostModel::setD0i3(bool enter) {
+    UInt32 reg = regs->read(MEI_H_D0I3C);
+    if (!!(reg & MEI_H_D0I3C_I3) == enter)
+        return true;
+
+    d0i3_done = false;
+    if (enter)
+        reg |= MEI_H_D0I3C_I3 | MEI_H_D0I3C_IR;
+    else {
+        reg &= ~MEI_H_D0I3C_I3;
+        reg |= MEI_H_D0I3C_IR;
+    }
+    regs->write(reg, MEI_H_D0I3C);
+    // read back, the transition is only pending while CIP is set
+    reg = regs->read(MEI_H_D0I3C);
+    if (!(reg & MEI_H_D0I3C_CIP))
+        return true;
+    return waitFor([&] { return d0i3_done; });
+}
+
+bool MEIHostModel::cycleD0i3(bool quiesce) {
+    UInt64 begin = nowNs();
+
+    if (quiesce && !sendClientCommand(IPTS_CMD_QUIESCE_IO))
+        goto fail;
+
+    gated = true;
+    wake_requested = false;
+    if (!setD0i3(true))
+        goto fail;
+    // a streaming ME has data right away and asks the host to wake up
+    if (!quiesce) {
+        if (!waitFor([&] { return wake_requested; }))
+            goto fail;
+        stats.d0i3_wakes++;
+    }
+    if (!setD0i3(false))
+        goto fail;
+    gated = false;
+
+    // ready may have been lost while gated, the wake interrupt is already acknowledged
+    meiSetHostCSR(regs, regs->read(MEI_H_CSR) | MEI_H_CSR_INT_ENABLE_MASK | MEI_H_CSR_INT_GEN | MEI_H_CSR_READY);
+    readPending();
+    if (quiesce && !sendClientCommand(IPTS_CMD_READY_FOR_DATA))
+        goto fail;
+
+    stats.d0i3_cycles++;
+    stats.d0i3_ns += nowNs() - begin;
+    return true;
+fail:
+    gated = false;
+    stats.d0i3_failures++;
+    return false;
+}
@@ -0,0 +1,108 @@
+//
+//  MEIHostModel.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef MEIHostModel_hpp
+#define MEIHostModel_hpp
+
+#include "MEIEmulator.hpp"
+
+/*
+ * The host half of the link, driving MEIEmulator through the same slot
+ * transport the kext uses. It follows the driver's sequences for link
+ * reset, bus start, enumeration, client connect, flow control and d0i3,
+ * single threaded and polled instead of interrupt driven.
+ */
+#define MEI_HOST_MODEL_MAX_STEPS    10000   // firmware steps before a wait times out
+#define MEI_HOST_MODEL_HOST_ADDR    1
+
+struct MEIHostModelStats {
+    UInt64  interrupts;
+    UInt64  stream_messages;
+    UInt64  stream_bytes;
+    UInt64  stream_slots;           // header slot included
+    UInt64  lost_messages;          // dropped by the ME across a reset
+    UInt64  payload_errors;
+    UInt64  flow_control_sent;
+    UInt64  write_errors;
+    UInt64  timeouts;
+    UInt64  resets;
+    UInt64  reset_failures;
+    UInt64  recovery_ns;            // summed over resets
+    UInt64  recovery_ns_max;
+    UInt64  recovery_accesses;      // register accesses summed over resets
+    UInt64  d0i3_cycles;
+    UInt64  d0i3_wakes;             // cycles ended by the ME having data
+    UInt64  d0i3_failures;
+    UInt64  d0i3_ns;
+};
+
+class MEIHostModel {
+public:
+    MEIHostModel(MEIEmulator &emu, UInt16 stream_len);
+
+    // link reset, bus bring-up, client connect and start of the stream
+    bool start();
+
+    // one firmware step and interrupt pass, recovers the link when the ME asks for it
+    bool poll();
+
+    // gate the link and bring it back, quiesce first or let the ME wake the host
+    bool cycleD0i3(bool quiesce);
+
+    bool isConnected() const { return connected; }
+
+    const MEIHostModelStats &getStats() const { return stats; }
+
+private:
+    MEIEmulator&        emu;
+    MEIRegisterInterface* regs;
+    MEIHostModelStats   stats {};
+    UInt16  stream_len;
+    UInt8   tx_depth {0};
+    UInt8   ipts_addr {0};
+    bool    connected {false};
+    bool    gated {false};
+    bool    reset_requested {false};
+    bool    wake_requested {false};
+    bool    d0i3_done {false};
+    UInt32  host_credits {0};
+    bool    have_seq {false};
+    UInt32  next_seq {0};
+
+    bool    bus_pending {false};
+    UInt8   bus_msg[MEI_SLOTS_TO_DATA(128)];
+    bool    rsp_pending {false};
+    UInt32  rsp_code {0};
+
+    UInt8   rx_buf[MEI_SLOTS_TO_DATA(256)];
+    UInt8   expected[MEI_SLOTS_TO_DATA(256)];
+
+    template <typename Condition>
+    bool waitFor(Condition done);
+
+    void service();
+
+    void readPending();
+
+    bool readMessage(UInt8 *filled_slots);
+
+    void handleClientMessage(UInt16 len);
+
+    bool sendMessage(UInt8 me_addr, UInt8 host_addr, const void *msg, UInt16 len);
+
+    bool sendFlowControl();
+
+    bool sendBusRequest(const void *msg, UInt16 len, UInt8 response_cmd);
+
+    bool sendClientCommand(UInt32 code);
+
+    bool resetLink();
+
+    bool setD0i3(bool enter);
+};
+
+#endif /* MEIHostModel_hpp */
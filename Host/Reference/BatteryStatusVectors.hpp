@@ -0,0 +1,91 @@
+//
+//  BatteryStatusVectors.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef BatteryStatusVectors_hpp
+#define BatteryStatusVectors_hpp
+
+#include "SurfaceBattery/BatteryStatusCore.hpp"
+
+/*
+ * _BST packages with the state BatteryStatusCore::applyStatus must derive
+ * from them. Expected values were worked out by hand from the ACPI units,
+ * with the same truncating integer division the kext uses.
+ */
+struct BatteryStatusVector {
+    const char *name;
+
+    // BIX derived inputs
+    bool    power_unit_is_watt;
+    UInt32  design_voltage;
+    UInt32  last_full_charge_capacity;
+    UInt32  design_capacity_warning;
+    UInt32  design_capacity_low;
+    UInt32  prior_average_rate;
+
+    UInt32  bst[4];
+    UInt32  elapsed_ms;
+
+    // expected
+    UInt32  present_rate;
+    UInt32  remaining_capacity;
+    UInt32  average_rate;
+    UInt32  average_time_to_empty;
+    UInt32  run_time_to_empty;
+    UInt32  time_to_full;
+    SInt32  signed_present_rate;
+    SInt32  signed_average_rate;
+    bool    ac_connected;
+    bool    full;
+    bool    critical;
+    bool    bad;
+    bool    bogus;
+};
+
+static const BatteryStatusVector battery_status_vectors[] = {
+    {
+        "discharging, first sample",
+        false, 7700, 5000, 250, 100, 0,
+        {1, 1200, 3000, 7600}, 5000,
+        1200, 3000, 1200, 150, 150, 0, -1200, -1200,
+        false, false, false, false, false,
+    },
+    {
+        "charging in mW, averaged over 30 s",
+        true, 7600, 6000, 300, 120, 800,
+        {2, 15200, 38000, 8100}, 30000,
+        2000, 5000, 1200, 250, 150, 50, 2000, 1200,
+        true, false, false, false, false,
+    },
+    {
+        "idle on AC, capped capacity, firmware critical, worn",
+        false, 7700, 4000, 2100, 100, 500,
+        {4, 0, 4500, 8000}, 60000,
+        0, 4000, 250, 960, 369, 0, 0, 250,
+        true, true, true, true, false,
+    },
+    {
+        "charging and discharging at once",
+        false, 7700, 5000, 250, 100, 0,
+        {3, 100, 50, 7000}, 1000,
+        100, 50, 100, 30, 30, 0, 0, 0,
+        false, false, true, false, true,
+    },
+};
+
+#define BATTERY_STATUS_VECTOR_CNT   (sizeof(battery_status_vectors) / sizeof(battery_status_vectors[0]))
+
+static inline void batteryPrepareState(BatteryInfo::State &st, const BatteryStatusVector &v) {
+    st = BatteryInfo::State();
+    st.powerUnitIsWatt = v.power_unit_is_watt;
+    st.designVoltage = v.design_voltage;
+    st.lastFullChargeCapacity = v.last_full_charge_capacity;
+    st.designCapacityWarning = v.design_capacity_warning;
+    st.designCapacityLow = v.design_capacity_low;
+    st.averageRate = v.prior_average_rate;
+}
+
+#endif /* BatteryStatusVectors_hpp */
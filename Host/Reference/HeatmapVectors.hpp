@@ -0,0 +1,81 @@
+//
+//  HeatmapVectors.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef HeatmapVectors_hpp
+#define HeatmapVectors_hpp
+
+#include <string.h>
+
+#include "SurfaceManagementEngine/IPTSContactDetector.hpp"
+
+/*
+ * Synthetic IPTS heatmaps. The sensor reports z_max for no touch and lower
+ * values under a finger, a touch here is a cone centred on a pixel so its
+ * centroid is exact and its ellipse is a circle.
+ */
+#define HEATMAP_WIDTH       64
+#define HEATMAP_HEIGHT      44
+
+struct HeatmapTouch {
+    UInt8 x;
+    UInt8 y;
+    UInt8 radius_x;
+    UInt8 radius_y;
+    UInt8 depth;
+};
+
+// small LCG so every run and every host sees the same noise
+static inline UInt32 heatmapRandom(UInt32 &seed) {
+    seed = seed * 1664525U + 1013904223U;
+    return seed >> 16;
+}
+
+static inline IPTSHeatmapDim heatmapDim(UInt8 width, UInt8 height) {
+    IPTSHeatmapDim dim;
+    memset(&dim, 0, sizeof(dim));
+    dim.width = width;
+    dim.height = height;
+    dim.x_max = width - 1;
+    dim.y_max = height - 1;
+    dim.z_min = 0;
+    dim.z_max = 255;
+    return dim;
+}
+
+// noise stays below the detector threshold on its own
+static inline void heatmapRender(UInt8 *heatmap, const IPTSHeatmapDim &dim, const HeatmapTouch *touches, UInt32 touch_cnt, UInt32 seed, UInt8 noise) {
+    for (UInt32 y = 0; y < dim.height; y++) {
+        for (UInt32 x = 0; x < dim.width; x++) {
+            UInt32 drop = noise ? heatmapRandom(seed) % (noise + 1) : 0;
+            for (UInt32 i = 0; i < touch_cnt; i++) {
+                const HeatmapTouch &t = touches[i];
+                SInt32 dx = static_cast<SInt32>(x) - t.x;
+                SInt32 dy = static_cast<SInt32>(y) - t.y;
+                // (dx/rx)^2 + (dy/ry)^2 scaled by (rx*ry)^2
+                SInt32 scale = t.radius_x * t.radius_x * t.radius_y * t.radius_y;
+                SInt32 dist = dx * dx * t.radius_y * t.radius_y + dy * dy * t.radius_x * t.radius_x;
+                if (dist < scale)
+                    drop += static_cast<UInt32>(t.depth) * static_cast<UInt32>(scale - dist) / static_cast<UInt32>(scale);
+            }
+            heatmap[y * dim.width + x] = drop >= dim.z_max ? dim.z_min : static_cast<UInt8>(dim.z_max - drop);
+        }
+    }
+}
+
+// n fingers spread over the panel, the same for a given seed
+static inline UInt32 heatmapRandomTouches(HeatmapTouch *touches, UInt32 cnt, const IPTSHeatmapDim &dim, UInt32 seed) {
+    for (UInt32 i = 0; i < cnt; i++) {
+        touches[i].radius_x = 2 + heatmapRandom(seed) % 3;
+        touches[i].radius_y = 2 + heatmapRandom(seed) % 3;
+        touches[i].x = 4 + heatmapRandom(seed) % (dim.width - 8);
+        touches[i].y = 4 + heatmapRandom(seed) % (dim.height - 8);
+        touches[i].depth = 80 + heatmapRandom(seed) % 150;
+    }
+    return cnt;
+}
+
+#endif /* HeatmapVectors_hpp */
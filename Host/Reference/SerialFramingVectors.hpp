@@ -0,0 +1,47 @@
+//
+//  SerialFramingVectors.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef SerialFramingVectors_hpp
+#define SerialFramingVectors_hpp
+
+#include "SurfaceSerialHub/SerialFraming.hpp"
+
+/*
+ * Frames as they appear on the wire, computed independently of the kext
+ * (CRC-16/CCITT-FALSE, poly 0x1021, init 0xFFFF, little endian on the wire).
+ */
+static const UInt8 ssh_crc_check_input[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+#define SSH_CRC_CHECK_VALUE     0x29B1
+
+static const UInt8 ssh_ack_seq_05[] = {
+    0xAA, 0x55, 0x40, 0x00, 0x00, 0x05, 0xF9, 0xBA, 0xFF, 0xFF,
+};
+
+static const UInt8 ssh_nak_seq_7f[] = {
+    0xAA, 0x55, 0x04, 0x00, 0x00, 0x7F, 0x49, 0xC1, 0xFF, 0xFF,
+};
+
+// sequenced _BST request, seq 3, request 0x1234, TC 0x02 TID 1 IID 1 CID 0x03
+static const UInt8 ssh_bat_bst_request[] = {
+    0xAA, 0x55, 0x80, 0x08, 0x00, 0x03, 0x3A, 0xC0,
+    0x80, 0x02, 0x01, 0x00, 0x01, 0x34, 0x12, 0x03,
+    0x5F, 0xD3,
+};
+
+// sequenced HID descriptor request, seq 0xFE, request 0x0042, TC 0x15 TID 2 IID 1 CID 0x04
+static const UInt8 ssh_hid_descriptor_payload[] = {
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x76, 0x00, 0x00, 0x00, 0x00,
+};
+
+static const UInt8 ssh_hid_descriptor_request[] = {
+    0xAA, 0x55, 0x80, 0x12, 0x00, 0xFE, 0x2A, 0x7A,
+    0x80, 0x15, 0x02, 0x00, 0x01, 0x42, 0x00, 0x04,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x76, 0x00, 0x00, 0x00, 0x00,
+    0xC0, 0xEA,
+};
+
+#endif /* SerialFramingVectors_hpp */
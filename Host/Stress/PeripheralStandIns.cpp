@@ -0,0 +1,167 @@
+//
+//  PeripheralStandIns.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <string.h>
+
+#include "PeripheralStandIns.hpp"
+#include "SurfaceAmbientLightSensor/APDS9960Constants.h"
+#include "SurfaceSerialHub/SerialProtocol.h"
+
+SAMStandIn::SAMStandIn(UInt32 seed, UInt32 damage_permille) : rng(seed), damage_permille(damage_permille) {
+    bst[0] = 1;         // discharging
+    bst[1] = 1200;
+    bst[2] = SAM_FULL_CAPACITY / 2;
+    bst[3] = 7600;
+}
+
+void SAMStandIn::putOnLine(const std::vector<UInt8> &frame, bool data) {
+    to_host.push_back(frame);
+    stats.frames_sent++;
+    if (data && roll(damage_permille)) {
+        std::vector<UInt8> &damaged = to_host.back();
+        damaged[rng() % damaged.size()] ^= static_cast<UInt8>(1 + rng() % 255);
+        stats.damaged++;
+    }
+}
+
+void SAMStandIn::queueData(UInt16 request_id, UInt8 tc, UInt8 tid, UInt8 cid, const UInt8 *payload, UInt16 payload_len) {
+    std::vector<UInt8> frame(SSH_COMMAND_LENGTH(payload_len));
+    sshBuildCommand(frame.data(), true, seq_id++, request_id, tc, tid, 0x01, cid, payload, payload_len);
+    // the SAM answers on the incoming target id
+    frame[SSH_PAYLOAD_OFFSET + offsetof(SurfaceSerialCommand, target_id_in)] = tid;
+    frame[SSH_PAYLOAD_OFFSET + offsetof(SurfaceSerialCommand, target_id_out)] = 0;
+    UInt16 crc = crc_ccitt_false(CRC_INITIAL, frame.data() + SSH_PAYLOAD_OFFSET, sizeof(SurfaceSerialCommand) + payload_len);
+    memcpy(frame.data() + SSH_PAYLOAD_OFFSET + sizeof(SurfaceSerialCommand) + payload_len, &crc, sizeof(crc));
+
+    unacked.push_back(std::move(frame));
+    if (unacked.size() == 1)
+        putOnLine(unacked.front(), true);
+}
+
+void SAMStandIn::receive(const UInt8 *frame, UInt16 len) {
+    UInt8 buffer[SAM_FRAME_BUF_SIZE];
+    SerialFrameInfo info;
+
+    if (len > sizeof(buffer))
+        return;
+    memcpy(buffer, frame, len);
+    stats.frames_received++;
+
+    bool data = len > SSH_CONTROL_FRAME_LENGTH;
+    if (data && roll(damage_permille)) {
+        buffer[rng() % len] ^= static_cast<UInt8>(1 + rng() % 255);
+        stats.damaged++;
+    }
+
+    std::vector<UInt8> control(SSH_CONTROL_FRAME_LENGTH);
+    if (sshParseFrame(buffer, len, &info) != SerialFrameOK) {
+        sshBuildControlFrame(control.data(), SSH_FRAME_TYPE_NAK, 0);
+        putOnLine(control, false);
+        return;
+    }
+
+    switch (info.type) {
+        case SSH_FRAME_TYPE_ACK:
+            if (unacked.empty() || reinterpret_cast<const SurfaceSerialMessage *>(unacked.front().data())->frame.seq_id != info.seq_id) {
+                stats.protocol_errors++;
+                break;
+            }
+            unacked.pop_front();
+            if (!unacked.empty())
+                putOnLine(unacked.front(), true);
+            break;
+        case SSH_FRAME_TYPE_NAK:
+            if (!unacked.empty()) {
+                putOnLine(unacked.front(), true);
+                stats.resent++;
+            }
+            break;
+        default:
+            sshBuildControlFrame(control.data(), SSH_FRAME_TYPE_ACK, info.seq_id);
+            putOnLine(control, false);
+            handleCommand(info);
+            break;
+    }
+}
+
+bool SAMStandIn::transmit(std::vector<UInt8> &frame) {
+    if (to_host.empty())
+        return false;
+    frame = std::move(to_host.front());
+    to_host.pop_front();
+    return true;
+}
+
+void SAMStandIn::advanceBattery() {
+    // discharge to a quarter, charge back to full and around again
+    if (bst[0] & 1) {
+        bst[2] -= bst[1] / 100;
+        if (bst[2] <= SAM_FULL_CAPACITY / 4)
+            bst[0] = 2;
+    } else {
+        bst[2] += bst[1] / 100;
+        if (bst[2] >= SAM_FULL_CAPACITY) {
+            bst[2] = SAM_FULL_CAPACITY;
+            bst[0] = 1;
+        }
+    }
+    bst[1] = 800 + rng() % 1600;
+}
+
+void SAMStandIn::handleCommand(const SerialFrameInfo &info) {
+    const SurfaceSerialCommand *cmd = info.command;
+
+    if (cmd->target_category == SSH_TC_BAT && cmd->command_id == SSH_CID_BAT_BST) {
+        advanceBattery();
+        queueData(cmd->request_id, cmd->target_category, cmd->target_id_out, cmd->command_id, reinterpret_cast<const UInt8 *>(bst), sizeof(bst));
+    } else
+        queueData(cmd->request_id, cmd->target_category, cmd->target_id_out, cmd->command_id, nullptr, 0);
+}
+
+void SAMStandIn::raiseInputEvent(UInt8 tid) {
+    UInt8 report[12];
+    UInt32 cnt = event_cnt[tid == SSH_TID_SECONDARY]++;
+
+    memcpy(report, &cnt, sizeof(cnt));
+    for (UInt32 i = sizeof(cnt); i < sizeof(report); i++)
+        report[i] = static_cast<UInt8>(cnt * 7 + i);
+    queueData(SAM_EVENT_REQUEST_ID, SSH_TC_HID, tid, SSH_CID_HID_OUT_REPORT, report, sizeof(report));
+}
+
+ALSStandIn::ALSStandIn(UInt32 seed, UInt32 nak_permille) : rng(seed), nak_permille(nak_permille) {
+    regs[APDS9960_ID] = 0xAB;
+}
+
+void ALSStandIn::setClear(UInt16 clear) {
+    for (UInt8 reg = APDS9960_CDATAL; reg <= APDS9960_BDATAH; reg += 2) {
+        regs[reg] = static_cast<UInt8>(clear);
+        regs[reg + 1] = static_cast<UInt8>(clear >> 8);
+    }
+}
+
+bool ALSStandIn::readRegisters(UInt8 reg, UInt8 *values, size_t len) {
+    if (rng() % 1000 < nak_permille) {
+        naks++;
+        return false;
+    }
+    for (size_t i = 0; i < len; i++)
+        values[i] = regs[static_cast<UInt8>(reg + i)];
+    return true;
+}
+
+void GPIOStandIn::setLevel(int pin, bool level, UInt32 bounce) {
+    if (levels[pin] == level)
+        return;
+    levels[pin] = level;
+    edges[pin] += 1 + 2 * bounce;
+}
+
+UInt32 GPIOStandIn::takeInterrupts(int pin) {
+    UInt32 cnt = edges[pin];
+    edges[pin] = 0;
+    return cnt;
+}
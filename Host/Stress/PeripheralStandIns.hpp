@@ -0,0 +1,124 @@
+//
+//  PeripheralStandIns.hpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#ifndef PeripheralStandIns_hpp
+#define PeripheralStandIns_hpp
+
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "SurfaceSerialHub/SerialFraming.hpp"
+
+/*
+ * Host side stand-ins for the peripherals the stress harness drives, the ME
+ * lives in Emulator/. All of them are synchronous, the caller decides when
+ * the device makes progress, and damage is injected at a per mille rate
+ * from their own seeded generator so a run can be repeated.
+ */
+
+/*
+ * The SAM end of the serial hub. Data frames wait for an ACK one at a time
+ * and are resent on NAK, in both directions they may be damaged on the
+ * line. Control frames always arrive intact, so neither side needs timeouts.
+ */
+#define SAM_FRAME_BUF_SIZE      128
+#define SAM_EVENT_REQUEST_ID    0x0001      // reserved id events are sent with
+#define SAM_FULL_CAPACITY       5000        // mAh, matches the BIX the host assumes
+
+struct SAMStandInStats {
+    UInt64  frames_received;
+    UInt64  frames_sent;
+    UInt64  damaged;                // frames damaged on the line, either direction
+    UInt64  resent;
+    UInt64  protocol_errors;        // ACK for a frame that was not sent
+};
+
+class SAMStandIn {
+public:
+    SAMStandIn(UInt32 seed, UInt32 damage_permille);
+
+    // one frame from the host
+    void receive(const UInt8 *frame, UInt16 len);
+
+    // next frame for the host, false when the line is idle
+    bool transmit(std::vector<UInt8> &frame);
+
+    // input report on the keyboard (primary) or touchpad (secondary) target, payload starts with a per target count
+    void raiseInputEvent(UInt8 tid);
+
+    // _BST values the last battery status response carried
+    const UInt32 *getBatteryStatus() const { return bst; }
+
+    const SAMStandInStats &getStats() const { return stats; }
+
+private:
+    std::mt19937    rng;
+    UInt32          damage_permille;
+    SAMStandInStats stats {};
+    UInt8           seq_id {0};
+    UInt32          event_cnt[2] {};
+    UInt32          bst[4];
+
+    std::deque<std::vector<UInt8>>  to_host;
+    std::deque<std::vector<UInt8>>  unacked;     // front is on the line
+
+    bool roll(UInt32 permille) { return rng() % 1000 < permille; }
+
+    void putOnLine(const std::vector<UInt8> &frame, bool data);
+
+    void queueData(UInt16 request_id, UInt8 tc, UInt8 tid, UInt8 cid, const UInt8 *payload, UInt16 payload_len);
+
+    void handleCommand(const SerialFrameInfo &info);
+
+    void advanceBattery();
+};
+
+/*
+ * APDS9960 behind I2C. Reads auto increment like the real part and fail as
+ * a whole at the NAK rate.
+ */
+class ALSStandIn {
+public:
+    ALSStandIn(UInt32 seed, UInt32 nak_permille);
+
+    bool readRegisters(UInt8 reg, UInt8 *values, size_t len);
+
+    // new light level, all four channels follow the clear channel
+    void setClear(UInt16 clear);
+
+    UInt64 getNaks() const { return naks; }
+
+private:
+    std::mt19937    rng;
+    UInt32          nak_permille;
+    UInt8           regs[256] {};
+    UInt64          naks {0};
+};
+
+/*
+ * GPIO pins of the buttons. Contact bounce adds pairs of edges, the
+ * interrupt source coalesces them into one count the way
+ * IOInterruptEventSource hands them to the driver.
+ */
+#define GPIO_PIN_CNT    3
+
+class GPIOStandIn {
+public:
+    void setLevel(int pin, bool level, UInt32 bounce);
+
+    bool getPinStatus(int pin) const { return levels[pin]; }
+
+    // edges since the last call
+    UInt32 takeInterrupts(int pin);
+
+private:
+    bool    levels[GPIO_PIN_CNT] {};
+    UInt32  edges[GPIO_PIN_CNT] {};
+};
+
+#endif /* PeripheralStandIns_hpp */
@@ -0,0 +1,472 @@
+//
+//  StressMain.cpp
+//  BigSurface
+//
+//  Created by agent on 2026/10/18.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include <chrono>
+#include <random>
+
+#include "PeripheralStandIns.hpp"
+#include "Emulator/MEIHostModel.hpp"
+#include "LatencyHistogram.hpp"
+#include "Reference/BatteryStatusVectors.hpp"
+#include "Reference/HeatmapVectors.hpp"
+#include "SurfaceAmbientLightSensor/APDS9960Constants.h"
+#include "SurfaceSerialHub/SerialProtocol.h"
+
+/*
+ * Mixed workload over every stand-in for as long as asked:
+ *
+ *   BigSurfaceStress [--seconds N] [--seed N] [--damage-permille N] [--reset-permille N] [--report-every N]
+ *
+ * Each operation picks a subsystem by weight, drives it through the same
+ * cores the kext runs (serial framing, battery status, MEI slot transport,
+ * contact detection, lux math) and checks the outcome against what the
+ * stand-in was told. Latency is per operation in ns, damage and resets are
+ * injected on purpose and only count as errors when they are not recovered.
+ * Exits non-zero on any error.
+ */
+#define STRESS_HEATMAP_FRAMES   16
+#define STRESS_MAX_POLLS        1000    // ME polls for one streamed message
+#define STRESS_MAX_FRAMES       64      // serial frames for one operation
+#define STRESS_ALS_TRIES        3
+
+enum Subsystem {
+    SubsystemKeyboard,
+    SubsystemTouchpad,
+    SubsystemTouch,
+    SubsystemBattery,
+    SubsystemALS,
+    SubsystemButtons,
+    SubsystemSleep,
+    SubsystemCount
+};
+
+static const char *subsystem_names[SubsystemCount] = {
+    "keyboard", "touchpad", "touch", "battery", "als", "buttons", "sleep",
+};
+
+// per mille of all operations
+static const UInt32 subsystem_weights[SubsystemCount] = {
+    300, 200, 300, 50, 100, 40, 10,
+};
+
+struct SubsystemStats {
+    UInt64              ops;
+    UInt64              errors;
+    UInt64              retries;    // damaged frames, NAKs and I2C retries that recovered
+    UInt64              resets;
+    LatencyHistogram    latency;
+};
+
+struct StressOptions {
+    UInt64  seconds {10};
+    UInt32  seed {1};
+    UInt32  damage_permille {5};
+    UInt32  reset_permille {1};
+    UInt64  report_every {60};
+};
+
+/*
+ * Host end of the serial hub, one request at a time like the driver's
+ * command gate, events are taken whenever they arrive.
+ */
+class SAMHost {
+public:
+    SAMHost(SAMStandIn &sam, SubsystemStats *keyboard, SubsystemStats *touchpad) : sam(sam), event_stats{keyboard, touchpad} {}
+
+    bool request(UInt8 tc, UInt8 tid, UInt8 cid, UInt8 *response, UInt16 *response_len, SubsystemStats &stats) {
+        UInt8 frame[SAM_FRAME_BUF_SIZE];
+        // 0 is never pending and the event id is taken
+        if (++request_id <= SAM_EVENT_REQUEST_ID)
+            request_id = SAM_EVENT_REQUEST_ID + 1;
+        UInt16 len = sshBuildCommand(frame, true, seq_id++, request_id, tc, tid, 0x01, cid, nullptr, 0);
+        last_request.assign(frame, frame + len);
+        pending_id = request_id;
+        answered = false;
+        rsp = response;
+        rsp_len = response_len;
+        sam.receive(frame, len);
+        return pump(stats) && answered;
+    }
+
+    // take everything the SAM has on the line
+    bool pump(SubsystemStats &stats) {
+        std::vector<UInt8> frame;
+        SerialFrameInfo info;
+
+        for (UInt32 frames = 0; sam.transmit(frame); frames++) {
+            if (frames > STRESS_MAX_FRAMES)
+                return false;
+            if (sshParseFrame(frame.data(), static_cast<UInt16>(frame.size()), &info) != SerialFrameOK) {
+                stats.retries++;
+                sendControl(SSH_FRAME_TYPE_NAK, 0);
+                continue;
+            }
+            switch (info.type) {
+                case SSH_FRAME_TYPE_ACK:
+                    last_request.clear();
+                    break;
+                case SSH_FRAME_TYPE_NAK:
+                    if (!last_request.empty()) {
+                        stats.retries++;
+                        sam.receive(last_request.data(), static_cast<UInt16>(last_request.size()));
+                    }
+                    break;
+                default:
+                    sendControl(SSH_FRAME_TYPE_ACK, info.seq_id);
+                    if (info.command->request_id == SAM_EVENT_REQUEST_ID)
+                        handleEvent(info);
+                    else if (pending_id && info.command->request_id == pending_id && info.data_len <= *rsp_len) {
+                        memcpy(rsp, info.data, info.data_len);
+                        *rsp_len = info.data_len;
+                        answered = true;
+                        pending_id = 0;
+                    } else
+                        stats.errors++;
+                    break;
+            }
+        }
+        return true;
+    }
+
+    UInt64 getEvents(int target) const { return events[target]; }
+
+private:
+    SAMStandIn&         sam;
+    SubsystemStats*     event_stats[2];
+    UInt8               seq_id {0};
+    UInt16              request_id {SAM_EVENT_REQUEST_ID};
+    UInt16              pending_id {0};
+    bool                answered {false};
+    UInt8*              rsp {nullptr};
+    UInt16*             rsp_len {nullptr};
+    std::vector<UInt8>  last_request;       // until the SAM acknowledged it
+    UInt32              next_event[2] {};
+    UInt64              events[2] {};
+
+    void sendControl(UInt8 type, UInt8 seq) {
+        UInt8 frame[SSH_CONTROL_FRAME_LENGTH];
+        sam.receive(frame, sshBuildControlFrame(frame, type, seq));
+    }
+
+    void handleEvent(const SerialFrameInfo &info) {
+        int target = info.command->target_id_in == SSH_TID_SECONDARY;
+        UInt32 cnt;
+        if (info.data_len < sizeof(cnt)) {
+            event_stats[target]->errors++;
+            return;
+        }
+        memcpy(&cnt, info.data, sizeof(cnt));
+        bool intact = cnt == next_event[target];
+        for (UInt32 i = sizeof(cnt); i < info.data_len; i++)
+            intact &= info.data[i] == static_cast<UInt8>(cnt * 7 + i);
+        if (!intact)
+            event_stats[target]->errors++;
+        next_event[target] = cnt + 1;
+        events[target]++;
+    }
+};
+
+struct StressRig {
+    std::mt19937        rng;
+    const StressOptions &options;
+    SubsystemStats      stats[SubsystemCount] {};
+
+    SAMStandIn          sam;
+    SAMHost             sam_host;
+    BatteryInfo::State  battery;
+
+    MEIEmulator         emu;
+    MEIHostModel        me_host;
+    IPTSContactDetector detector;
+    IPTSHeatmapDim      dim;
+    UInt8               frames[STRESS_HEATMAP_FRAMES][HEATMAP_WIDTH * HEATMAP_HEIGHT];
+    UInt32              frame {0};
+    UInt32              d0i3_cycles {0};
+
+    ALSStandIn          als;
+    GPIOStandIn         gpio;
+    bool                buttons[GPIO_PIN_CNT] {};
+    bool                reported[GPIO_PIN_CNT] {};
+
+    explicit StressRig(const StressOptions &options) :
+        rng(options.seed), options(options),
+        sam(options.seed + 1, options.damage_permille),
+        sam_host(sam, &stats[SubsystemKeyboard], &stats[SubsystemTouchpad]),
+        me_host(emu, MEIEmulatorConfig().stream_len),
+        dim(heatmapDim(HEATMAP_WIDTH, HEATMAP_HEIGHT)),
+        als(options.seed + 2, options.damage_permille) {
+        batteryPrepareState(battery, battery_status_vectors[0]);
+        battery.lastFullChargeCapacity = SAM_FULL_CAPACITY;
+
+        HeatmapTouch touches[10];
+        for (UInt32 i = 0; i < STRESS_HEATMAP_FRAMES; i++) {
+            UInt32 touch_cnt = heatmapRandomTouches(touches, i % 6, dim, options.seed + i);
+            heatmapRender(frames[i], dim, touches, touch_cnt, options.seed + i, 24);
+        }
+    }
+
+    bool start() {
+        return me_host.start();
+    }
+
+    bool roll(UInt32 permille) { return rng() % 1000 < permille; }
+
+    Subsystem pick() {
+        UInt32 value = rng() % 1000;
+        for (int i = 0; i < SubsystemCount; i++) {
+            if (value < subsystem_weights[i])
+                return static_cast<Subsystem>(i);
+            value -= subsystem_weights[i];
+        }
+        return SubsystemKeyboard;
+    }
+
+    void run(Subsystem subsystem) {
+        SubsystemStats &st = stats[subsystem];
+        bool ok = true;
+
+        auto begin = std::chrono::steady_clock::now();
+        switch (subsystem) {
+            case SubsystemKeyboard:
+            case SubsystemTouchpad:
+                ok = inputEvent(subsystem == SubsystemKeyboard ? SSH_TID_PRIMARY : SSH_TID_SECONDARY, st);
+                break;
+            case SubsystemTouch:
+                ok = touchFrame(st);
+                break;
+            case SubsystemBattery:
+                ok = batteryStatus(st);
+                break;
+            case SubsystemALS:
+                ok = lightLevel(st);
+                break;
+            case SubsystemButtons:
+                ok = buttonPress();
+                break;
+            default:
+                ok = sleepCycle(st);
+                break;
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+        st.latency.record(static_cast<UInt64>(elapsed));
+        st.ops++;
+        if (!ok)
+            st.errors++;
+    }
+
+    bool inputEvent(UInt8 tid, SubsystemStats &st) {
+        int target = tid == SSH_TID_SECONDARY;
+        UInt64 before = sam_host.getEvents(target);
+        sam.raiseInputEvent(tid);
+        return sam_host.pump(st) && sam_host.getEvents(target) == before + 1;
+    }
+
+    bool batteryStatus(SubsystemStats &st) {
+        UInt32 bst[4];
+        UInt16 len = sizeof(bst);
+        if (!sam_host.request(SSH_TC_BAT, SSH_TID_PRIMARY, SSH_CID_BAT_BST, reinterpret_cast<UInt8 *>(bst), &len, st) || len != sizeof(bst))
+            return false;
+        BatteryStatusCore::applyStatus(battery, bst, 5000);
+        return !memcmp(bst, sam.getBatteryStatus(), sizeof(bst)) && battery.remainingCapacity == bst[BatteryStatusCore::BSTRemainingCapacity];
+    }
+
+    bool touchFrame(SubsystemStats &st) {
+        const MEIHostModelStats &me = me_host.getStats();
+        UInt64 resets = me.resets;
+        UInt64 received = me.stream_messages;
+
+        if (roll(options.reset_permille))
+            emu.injectReset();
+        for (UInt32 i = 0; i < STRESS_MAX_POLLS && me.stream_messages == received; i++) {
+            if (!me_host.poll())
+                return false;
+        }
+        st.resets += me.resets - resets;
+        if (me.stream_messages == received)
+            return false;
+
+        IPTSContact contacts[IPTS_MAX_CONTACTS];
+        UInt32 cnt = detector.detect(&dim, frames[frame], contacts, IPTS_MAX_CONTACTS);
+        frame = (frame + 1) % STRESS_HEATMAP_FRAMES;
+        return cnt <= IPTS_MAX_CONTACTS;
+    }
+
+    bool lightLevel(SubsystemStats &st) {
+        UInt16 clear = static_cast<UInt16>(rng());
+        UInt16 color[4];
+
+        als.setClear(clear);
+        for (int i = 0; i < STRESS_ALS_TRIES; i++) {
+            if (als.readRegisters(APDS9960_CDATAL, reinterpret_cast<UInt8 *>(color), sizeof(color)))
+                return apds9960ClearToLux(color[0]) == apds9960ClearToLux(clear);
+            st.retries++;
+        }
+        return false;
+    }
+
+    bool buttonPress() {
+        int pin = rng() % GPIO_PIN_CNT;
+        buttons[pin] = !buttons[pin];
+        gpio.setLevel(pin, buttons[pin], rng() % 4);
+
+        // the power button pin always reads high, its status comes from the edge count
+        UInt32 cnt = gpio.takeInterrupts(pin);
+        if (!pin)
+            reported[pin] ^= cnt & 1;
+        else if (cnt)
+            reported[pin] = gpio.getPinStatus(pin);
+        return reported[pin] == buttons[pin];
+    }
+
+    bool sleepCycle(SubsystemStats &st) {
+        UInt64 resets = me_host.getStats().resets;
+        bool ok = me_host.cycleD0i3(!(d0i3_cycles++ & 1));
+        st.resets += me_host.getStats().resets - resets;
+        return ok;
+    }
+};
+
+static bool parseOptions(int argc, char **argv, StressOptions &options) {
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc)
+            return false;
+        unsigned long long value = strtoull(argv[++i], nullptr, 0);
+        if (!strcmp(argv[i - 1], "--seconds"))
+            options.seconds = value;
+        else if (!strcmp(argv[i - 1], "--seed"))
+            options.seed = static_cast<UInt32>(value);
+        else if (!strcmp(argv[i - 1], "--damage-permille"))
+            options.damage_permille = static_cast<UInt32>(value);
+        else if (!strcmp(argv[i - 1], "--reset-permille"))
+            options.reset_permille = static_cast<UInt32>(value);
+        else if (!strcmp(argv[i - 1], "--report-every"))
+            options.report_every = value;
+        else
+            return false;
+    }
+    return options.seconds && options.damage_permille < 1000 && options.reset_permille <= 1000;
+}
+
+// resident set in KB
+static UInt64 residentKB() {
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm) {
+        unsigned long long size, resident;
+        int fields = fscanf(statm, "%llu %llu", &size, &resident);
+        fclose(statm);
+        if (fields == 2)
+            return resident * static_cast<UInt64>(sysconf(_SC_PAGESIZE)) / 1024;
+    }
+    // peak rather than current where there is no procfs, still shows growth
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<UInt64>(usage.ru_maxrss) / 1024;
+#else
+    return static_cast<UInt64>(usage.ru_maxrss);
+#endif
+}
+
+static void printInterval(double elapsed, const SubsystemStats *stats, const UInt64 *last_ops, double interval, UInt64 rss) {
+    printf("[%7.0f s] rss %llu KB", elapsed, static_cast<unsigned long long>(rss));
+    for (int i = 0; i < SubsystemCount; i++)
+        printf(" %s %.0f/s", subsystem_names[i], (stats[i].ops - last_ops[i]) / interval);
+    printf("\n");
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    StressOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "usage: %s [--seconds N] [--seed N] [--damage-permille 0..999] [--reset-permille 0..1000] [--report-every N]\n", argv[0]);
+        return 2;
+    }
+
+    StressRig *rig = new StressRig(options);
+    if (!rig->start()) {
+        fprintf(stderr, "ME link bring-up failed\n");
+        return 1;
+    }
+
+    // first touch of the code, stacks and tables is not growth
+    for (int i = 0; i < 4096; i++)
+        rig->run(rig->pick());
+
+    UInt64 rss_start = residentKB();
+    UInt64 rss_peak = rss_start;
+    // growth is measured from the first report on, rarely hit paths still allocate in the first seconds
+    UInt64 rss_settled = rss_start;
+    double settled_at = 0;
+    UInt64 last_ops[SubsystemCount] = {};
+    auto begin = std::chrono::steady_clock::now();
+    auto deadline = begin + std::chrono::seconds(options.seconds);
+    auto next_report = begin + std::chrono::seconds(options.report_every);
+    auto last_report = begin;
+
+    for (;;) {
+        // check the clock every few thousand operations only
+        for (int i = 0; i < 4096; i++)
+            rig->run(rig->pick());
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline)
+            break;
+        if (options.report_every && now >= next_report) {
+            UInt64 rss = residentKB();
+            if (rss > rss_peak)
+                rss_peak = rss;
+            if (last_report == begin) {
+                rss_settled = rss;
+                settled_at = std::chrono::duration<double>(now - begin).count();
+            }
+            printInterval(std::chrono::duration<double>(now - begin).count(), rig->stats, last_ops,
+                          std::chrono::duration<double>(now - last_report).count(), rss);
+            for (int i = 0; i < SubsystemCount; i++)
+                last_ops[i] = rig->stats[i].ops;
+            last_report = now;
+            next_report += std::chrono::seconds(options.report_every);
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    UInt64 rss_end = residentKB();
+    if (rss_end > rss_peak)
+        rss_peak = rss_end;
+
+    UInt64 errors = 0;
+    printf("%-9s %12s %10s %9s %9s %9s %9s %8s %8s %7s\n", "", "ops", "ops/s", "p50 ns", "p99 ns", "p99.9 ns", "max ns", "errors", "retries", "resets");
+    for (int i = 0; i < SubsystemCount; i++) {
+        const SubsystemStats &st = rig->stats[i];
+        printf("%-9s %12llu %10.0f %9llu %9llu %9llu %9llu %8llu %8llu %7llu\n", subsystem_names[i],
+               static_cast<unsigned long long>(st.ops), st.ops / seconds,
+               static_cast<unsigned long long>(st.latency.percentile(500)), static_cast<unsigned long long>(st.latency.percentile(990)),
+               static_cast<unsigned long long>(st.latency.percentile(999)), static_cast<unsigned long long>(st.latency.max),
+               static_cast<unsigned long long>(st.errors), static_cast<unsigned long long>(st.retries), static_cast<unsigned long long>(st.resets));
+        errors += st.errors;
+    }
+
+    const SAMStandInStats &sam = rig->sam.getStats();
+    const MEIEmulatorStats &me = rig->emu.getStats();
+    printf("serial    %llu frames to the host, %llu damaged, %llu resent, %llu protocol errors\n",
+           static_cast<unsigned long long>(sam.frames_sent), static_cast<unsigned long long>(sam.damaged),
+           static_cast<unsigned long long>(sam.resent), static_cast<unsigned long long>(sam.protocol_errors));
+    printf("me        %llu messages, %llu resets, %llu d0i3 entries, %llu protocol errors\n",
+           static_cast<unsigned long long>(me.me_messages), static_cast<unsigned long long>(me.me_resets),
+           static_cast<unsigned long long>(me.d0i3_entries), static_cast<unsigned long long>(me.protocol_errors));
+    printf("i2c       %llu NAKs\n", static_cast<unsigned long long>(rig->als.getNaks()));
+    printf("memory    %llu KB at start, %llu KB at end, %llu KB peak, %+.1f KB/h after %.0f s\n",
+           static_cast<unsigned long long>(rss_start), static_cast<unsigned long long>(rss_end), static_cast<unsigned long long>(rss_peak),
+           seconds > settled_at ? (static_cast<double>(rss_end) - static_cast<double>(rss_settled)) * 3600 / (seconds - settled_at) : 0, settled_at);
+
+    errors += sam.protocol_errors + me.protocol_errors + me.overflows + me.underflows;
+    delete rig;
+    return errors ? 1 : 0;
+}